@@ -0,0 +1,371 @@
+// Throughput benchmarks for each stage of the sentiment pipeline.
+//
+// Every benchmark reports items_per_second (documents per second) and
+// bytes_per_second (input text per second). Arguments sweep the document
+// length in words and the vocabulary size of the synthetic corpus, e.g.
+// BM_ExtractFeatures/64/16384 extracts 64-word documents drawn from
+// 16384 distinct words.
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "data_loader.h"
+#include "feature_extractor.h"
+#include "inference_context.h"
+#include "linear_model.h"
+#include "naive_bayes.h"
+#include "preprocessor.h"
+
+using namespace sentiment;
+
+namespace {
+
+// Deterministic corpus with a skewed (roughly Zipfian) word distribution
+std::vector<TextData> makeCorpus(size_t documents, size_t wordsPerDocument, size_t vocabularySize) {
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    auto next = [&state] {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return state >> 33;
+    };
+
+    const SentimentLabel labels[] = {
+        SentimentLabel::POSITIVE, SentimentLabel::NEGATIVE, SentimentLabel::NEUTRAL
+    };
+    std::vector<TextData> corpus(documents);
+    for (size_t d = 0; d < documents; ++d) {
+        std::string& text = corpus[d].text;
+        for (size_t w = 0; w < wordsPerDocument; ++w) {
+            // Squaring a uniform draw favors small word ids
+            double uniform = static_cast<double>(next() % 1000000) / 1000000.0;
+            size_t word = static_cast<size_t>(uniform * uniform * static_cast<double>(vocabularySize));
+            text += w == 0 ? "" : (w % 11 == 10 ? ", " : " ");
+            text += "Word" + std::to_string(word);
+        }
+        text += '.';
+        corpus[d].label = labels[d % 3];
+    }
+    return corpus;
+}
+
+// makeCorpus() with the words spelled in Latin-1, Cyrillic and Greek
+// capitals, so every token needs UTF-8 case folding
+std::vector<TextData> makeUtf8Corpus(size_t documents, size_t wordsPerDocument, size_t vocabularySize) {
+    const std::string prefixes[] = {"WÖRT", "СЛОВО", "ΛΈΞΗ"};
+    std::vector<TextData> corpus = makeCorpus(documents, wordsPerDocument, vocabularySize);
+    for (auto& document : corpus) {
+        std::string text;
+        size_t word = 0;
+        for (size_t i = 0; i < document.text.size(); ++i) {
+            if (document.text.compare(i, 4, "Word") == 0) {
+                text += prefixes[word++ % 3];
+                i += 3;
+            } else {
+                text += document.text[i];
+            }
+        }
+        document.text = std::move(text);
+    }
+    return corpus;
+}
+
+int64_t totalBytes(const std::vector<TextData>& corpus) {
+    int64_t bytes = 0;
+    for (const auto& document : corpus) {
+        bytes += static_cast<int64_t>(document.text.size());
+    }
+    return bytes;
+}
+
+// Report documents and bytes processed over all iterations
+void setThroughput(benchmark::State& state, const std::vector<TextData>& corpus) {
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(corpus.size()));
+    state.SetBytesProcessed(state.iterations() * totalBytes(corpus));
+}
+
+constexpr size_t kSampleDocuments = 1000; // Documents per iteration for per-document stages
+
+// Silence the progress messages printed by training and loading
+class QuietOutput {
+public:
+    QuietOutput() : saved(std::cout.rdbuf(sink.rdbuf())) {}
+    ~QuietOutput() { std::cout.rdbuf(saved); }
+
+private:
+    std::ostringstream sink;
+    std::streambuf* saved;
+};
+
+} // anonymous namespace
+
+static void BM_CleanText(benchmark::State& state) {
+    std::vector<TextData> corpus = makeCorpus(kSampleDocuments, state.range(0), 16384);
+    Preprocessor preprocessor(true);
+    for (auto _ : state) {
+        for (const auto& document : corpus) {
+            benchmark::DoNotOptimize(preprocessor.cleanText(document.text));
+        }
+    }
+    setThroughput(state, corpus);
+}
+BENCHMARK(BM_CleanText)->RangeMultiplier(4)->Range(16, 1024);
+
+static void BM_Tokenize(benchmark::State& state) {
+    std::vector<TextData> corpus = makeCorpus(kSampleDocuments, state.range(0), 16384);
+    Preprocessor preprocessor(true);
+    for (auto _ : state) {
+        for (const auto& document : corpus) {
+            benchmark::DoNotOptimize(preprocessor.preprocess(document.text));
+        }
+    }
+    setThroughput(state, corpus);
+}
+BENCHMARK(BM_Tokenize)->RangeMultiplier(4)->Range(16, 1024);
+
+static void BM_TokenizeInto(benchmark::State& state) {
+    std::vector<TextData> corpus = makeCorpus(kSampleDocuments, state.range(0), 16384);
+    Preprocessor preprocessor(true);
+    std::string buffer;
+    std::vector<std::string_view> tokens;
+    for (auto _ : state) {
+        for (const auto& document : corpus) {
+            preprocessor.tokenizeInto(document.text, buffer, tokens);
+            benchmark::DoNotOptimize(tokens.data());
+        }
+    }
+    setThroughput(state, corpus);
+}
+BENCHMARK(BM_TokenizeInto)->RangeMultiplier(4)->Range(16, 1024);
+
+static void BM_TokenizeIntoUtf8(benchmark::State& state) {
+    std::vector<TextData> corpus = makeUtf8Corpus(kSampleDocuments, state.range(0), 16384);
+    Preprocessor preprocessor(true);
+    std::string buffer;
+    std::vector<std::string_view> tokens;
+    for (auto _ : state) {
+        for (const auto& document : corpus) {
+            preprocessor.tokenizeInto(document.text, buffer, tokens);
+            benchmark::DoNotOptimize(tokens.data());
+        }
+    }
+    setThroughput(state, corpus);
+}
+BENCHMARK(BM_TokenizeIntoUtf8)->RangeMultiplier(4)->Range(16, 1024);
+
+static void BM_BuildVocabulary(benchmark::State& state) {
+    QuietOutput quiet;
+    std::vector<TextData> corpus = makeCorpus(state.range(0), 64, state.range(1));
+    Preprocessor preprocessor(true);
+    FeatureExtractor extractor(preprocessor);
+    for (auto _ : state) {
+        extractor.buildVocabulary(corpus, 2, 0);
+    }
+    setThroughput(state, corpus);
+}
+BENCHMARK(BM_BuildVocabulary)
+    ->ArgsProduct({{1000, 10000}, {1024, 16384, 262144}})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_ExtractFeatures(benchmark::State& state) {
+    QuietOutput quiet;
+    std::vector<TextData> corpus = makeCorpus(kSampleDocuments, state.range(0), state.range(1));
+    Preprocessor preprocessor(true);
+    FeatureExtractor extractor(preprocessor, FeatureExtractor::Method::TF_IDF);
+    extractor.buildVocabulary(corpus, 1, 0);
+
+    InferenceContext context;
+    for (auto _ : state) {
+        for (const auto& document : corpus) {
+            benchmark::DoNotOptimize(extractor.extractFeatures(document.text, context).indices.data());
+        }
+    }
+    setThroughput(state, corpus);
+}
+BENCHMARK(BM_ExtractFeatures)->ArgsProduct({{16, 64, 256, 1024}, {1024, 16384, 262144}});
+
+// Argument 1 selects the TF-IDF variant: 0 applies the IDF per document,
+// 1 leaves it to a model it was folded into (the bag-of-words cost), and
+// 2 adds sublinear counts and L2 normalization
+static void BM_TfIdfWeighting(benchmark::State& state) {
+    QuietOutput quiet;
+    std::vector<TextData> corpus = makeCorpus(kSampleDocuments, state.range(0), 16384);
+    Preprocessor preprocessor(true);
+    FeatureExtractor extractor(preprocessor, FeatureExtractor::Method::TF_IDF);
+    extractor.setTfIdfOptions(state.range(1) == 2, state.range(1) == 2);
+    extractor.buildVocabulary(corpus, 1, 0);
+    extractor.setIdfFolded(state.range(1) == 1);
+
+    InferenceContext context;
+    for (auto _ : state) {
+        for (const auto& document : corpus) {
+            benchmark::DoNotOptimize(extractor.extractFeatures(document.text, context).values.data());
+        }
+    }
+    setThroughput(state, corpus);
+}
+BENCHMARK(BM_TfIdfWeighting)->ArgsProduct({{64, 1024}, {0, 1, 2}});
+
+// Third argument is the number of counting threads
+static void BM_NaiveBayesTrain(benchmark::State& state) {
+    QuietOutput quiet;
+    std::vector<TextData> corpus = makeCorpus(state.range(0), 64, state.range(1));
+    Preprocessor preprocessor(true);
+    FeatureExtractor extractor(preprocessor);
+    extractor.buildVocabulary(corpus, 1, 0);
+    std::vector<FeatureVector> features = extractor.batchTransform(corpus);
+
+    NaiveBayes model;
+    if (state.range(2) > 1) {
+        model.setThreadPool(std::make_shared<ThreadPool>(state.range(2)));
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(model.train(features));
+    }
+    setThroughput(state, corpus);
+}
+BENCHMARK(BM_NaiveBayesTrain)
+    ->ArgsProduct({{1000, 10000}, {1024, 16384, 262144}, {1, 4}})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_NaiveBayesPredict(benchmark::State& state) {
+    QuietOutput quiet;
+    std::vector<TextData> corpus = makeCorpus(kSampleDocuments, state.range(0), state.range(1));
+    Preprocessor preprocessor(true);
+    FeatureExtractor extractor(preprocessor);
+    extractor.buildVocabulary(corpus, 1, 0);
+    std::vector<FeatureVector> features = extractor.batchTransform(corpus);
+    NaiveBayes model;
+    model.train(features);
+
+    for (auto _ : state) {
+        for (const auto& example : features) {
+            benchmark::DoNotOptimize(model.predict(example.features));
+        }
+    }
+    setThroughput(state, corpus);
+}
+BENCHMARK(BM_NaiveBayesPredict)->ArgsProduct({{16, 64, 256, 1024}, {1024, 16384, 262144}});
+
+static void BM_NaiveBayesPredictBatch(benchmark::State& state) {
+    QuietOutput quiet;
+    std::vector<TextData> corpus = makeCorpus(kSampleDocuments, state.range(0), 16384);
+    Preprocessor preprocessor(true);
+    FeatureExtractor extractor(preprocessor);
+    extractor.buildVocabulary(corpus, 1, 0);
+    std::vector<FeatureVector> examples = extractor.batchTransform(corpus);
+    NaiveBayes model;
+    model.train(examples);
+
+    std::vector<SparseVector> batch;
+    for (const auto& example : examples) {
+        batch.push_back(example.features);
+    }
+    std::vector<SentimentLabel> labels(batch.size());
+    for (auto _ : state) {
+        model.predictBatch(batch.data(), batch.size(), labels.data());
+        benchmark::DoNotOptimize(labels.data());
+    }
+    setThroughput(state, corpus);
+}
+BENCHMARK(BM_NaiveBayesPredictBatch)->RangeMultiplier(4)->Range(16, 1024);
+
+// Second argument is the number of named classes the documents are spread over
+static void BM_NaiveBayesPredictClassBatch(benchmark::State& state) {
+    QuietOutput quiet;
+    std::vector<TextData> corpus = makeCorpus(kSampleDocuments, state.range(0), 16384);
+    Preprocessor preprocessor(true);
+    FeatureExtractor extractor(preprocessor);
+    extractor.buildVocabulary(corpus, 1, 0);
+    std::vector<FeatureVector> examples = extractor.batchTransform(corpus);
+
+    std::vector<SparseVector> batch;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < examples.size(); ++i) {
+        batch.push_back(examples[i].features);
+        names.push_back("class" + std::to_string(i % static_cast<size_t>(state.range(1))));
+    }
+    NaiveBayes model;
+    model.trainClasses(batch, names);
+
+    std::vector<size_t> classes(batch.size());
+    for (auto _ : state) {
+        model.predictClassBatch(batch.data(), batch.size(), classes.data());
+        benchmark::DoNotOptimize(classes.data());
+    }
+    setThroughput(state, corpus);
+}
+BENCHMARK(BM_NaiveBayesPredictClassBatch)->ArgsProduct({{64, 256}, {4, 16, 64}});
+
+// Second argument is the number of SGD threads
+static void BM_LogisticRegressionTrain(benchmark::State& state) {
+    QuietOutput quiet;
+    std::vector<TextData> corpus = makeCorpus(10000, state.range(0), 16384);
+    Preprocessor preprocessor(true);
+    FeatureExtractor extractor(preprocessor);
+    extractor.buildVocabulary(corpus, 1, 0);
+    std::vector<FeatureVector> features = extractor.batchTransform(corpus);
+
+    SgdOptions options;
+    options.epochs = 1;
+    LogisticRegression model(options);
+    if (state.range(1) > 1) {
+        model.setThreadPool(std::make_shared<ThreadPool>(state.range(1)));
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(model.train(features));
+    }
+    setThroughput(state, corpus);
+}
+BENCHMARK(BM_LogisticRegressionTrain)
+    ->ArgsProduct({{64, 256}, {1, 2, 4}})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_LogisticRegressionPredictBatch(benchmark::State& state) {
+    QuietOutput quiet;
+    std::vector<TextData> corpus = makeCorpus(kSampleDocuments, state.range(0), 16384);
+    Preprocessor preprocessor(true);
+    FeatureExtractor extractor(preprocessor);
+    extractor.buildVocabulary(corpus, 1, 0);
+    std::vector<FeatureVector> examples = extractor.batchTransform(corpus);
+    LogisticRegression model;
+    model.train(examples);
+
+    std::vector<SparseVector> batch;
+    for (const auto& example : examples) {
+        batch.push_back(example.features);
+    }
+    std::vector<SentimentLabel> labels(batch.size());
+    for (auto _ : state) {
+        model.predictBatch(batch.data(), batch.size(), labels.data());
+        benchmark::DoNotOptimize(labels.data());
+    }
+    setThroughput(state, corpus);
+}
+BENCHMARK(BM_LogisticRegressionPredictBatch)->RangeMultiplier(4)->Range(16, 1024);
+
+static void BM_LoadCsv(benchmark::State& state) {
+    QuietOutput quiet;
+    std::vector<TextData> corpus = makeCorpus(state.range(0), 64, 16384);
+    std::string path = "sentiment_bench_" + std::to_string(state.range(0)) + ".csv";
+    {
+        std::ofstream file(path);
+        file << "text,label\n";
+        for (const auto& document : corpus) {
+            file << '"' << document.text << "\"," << sentimentToString(document.label) << '\n';
+        }
+    }
+
+    for (auto _ : state) {
+        DataLoader loader;
+        benchmark::DoNotOptimize(loader.loadFromCSV(path));
+    }
+    setThroughput(state, corpus);
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_LoadCsv)->Arg(1000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
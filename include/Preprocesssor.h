@@ -1,7 +1,9 @@
 #ifndef PREPROCESSOR_H
 #define PREPROCESSOR_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_set>
 
@@ -12,6 +14,16 @@ namespace sentiment {
  *
  * This class handles text cleaning, tokenization, and optional
  * stop word removal for NLP preprocessing.
+ *
+ * Text is read as UTF-8. ASCII is classified and lowercased 16 bytes at a
+ * time where SSE2 is available (with a lookup table otherwise); other
+ * characters are decoded and looked up in compact tables that case-fold
+ * Latin, Greek, Cyrillic and Armenian letters, fold fullwidth ASCII to
+ * ASCII, and treat Unicode punctuation and spaces (no-break space,
+ * guillemets, dashes, curly quotes, CJK punctuation ...) as separators.
+ * Letters of other scripts, digits, CJK and emoji are kept as they are.
+ * Folding never makes text longer. Bytes that are not valid UTF-8 are
+ * kept unchanged, and no Unicode normalization (composition) is applied.
  */
 class Preprocessor {
 public:
@@ -25,8 +37,8 @@ public:
      * @brief Clean and normalize text
      *
      * This function:
-     * - Converts text to lowercase
-     * - Removes punctuation
+     * - Case-folds text (ASCII and the scripts listed above)
+     * - Removes ASCII and Unicode punctuation
      * - Normalizes whitespace
      *
      * @param text Input text to clean
@@ -34,6 +46,17 @@ public:
      */
     std::string cleanText(const std::string& text) const;
 
+    /**
+     * @brief Hash the cleaned form of a text without building it
+     *
+     * Equal to hashBytes(cleanText(text)), so texts that differ only in
+     * case, punctuation or spacing hash the same. Makes no allocations.
+     *
+     * @param text Input text
+     * @return 64-bit hash of the cleaned text
+     */
+    uint64_t hashCleanText(std::string_view text) const;
+
     /**
      * @brief Tokenize text into words
      * @param text Text to tokenize
@@ -48,6 +71,27 @@ public:
      */
     std::vector<std::string> preprocess(const std::string& text) const;
 
+    /**
+     * @brief Clean and tokenize text in a single pass
+     *
+     * Fast path equivalent to preprocess(): lowercasing, punctuation
+     * splitting, whitespace collapsing and stop word removal are done in
+     * one scan over the input bytes, UTF-8 included. The normalized
+     * token characters are written to buffer and the returned views point
+     * into it, so they remain valid until buffer is modified or destroyed.
+     * Reusing the same buffer and token vector across calls avoids
+     * allocations once they have grown to the working size.
+     *
+     * @param text Text to preprocess
+     * @param buffer Caller-owned storage for the normalized characters
+     * @param tokens Receives views of the tokens (cleared first)
+     */
+    void tokenizeInto(
+        std::string_view text,
+        std::string& buffer,
+        std::vector<std::string_view>& tokens
+    ) const;
+
     /**
      * @brief Add custom stop words
      * @param words Vector of words to add as stop words
@@ -65,6 +109,23 @@ private:
     bool useStopWords; ///< Whether to use stop word removal
     std::unordered_set<std::string> stopWords; ///< Set of stop words
 
+    // Open-addressing copy of stopWords for string_view lookups
+    // (empty string marks a free slot; size is a power of two)
+    std::vector<std::string> stopWordSlots;
+    size_t maxStopWordLength = 0; ///< Longest stop word, for early rejection
+
+    /**
+     * @brief Check if a token view is a stop word
+     * @param word Token to check
+     * @return true if the token is a stop word, false otherwise
+     */
+    bool isStopWordView(std::string_view word) const;
+
+    /**
+     * @brief Rebuild the open-addressing stop word table from stopWords
+     */
+    void rebuildStopWordTable();
+
     /**
      * @brief Initialize default English stop words
      */
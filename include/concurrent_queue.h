@@ -0,0 +1,267 @@
+#ifndef CONCURRENT_QUEUE_H
+#define CONCURRENT_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
+namespace sentiment {
+
+/**
+ * @brief Round a queue capacity up to a power of two (at least 2)
+ * @param capacity Requested capacity
+ * @return Capacity the ring buffer uses
+ */
+inline size_t queueCapacity(size_t capacity) {
+    size_t rounded = 2;
+    while (rounded < capacity) {
+        rounded *= 2;
+    }
+    return rounded;
+}
+
+/**
+ * @brief Waiting strategy for threads polling an empty or full queue
+ *
+ * Spins briefly with a CPU pause, then yields, then sleeps, so a waiting
+ * stage reacts within microseconds while work flows but does not burn a
+ * core that another stage could use while it is idle.
+ */
+class Backoff {
+public:
+    /**
+     * @brief Wait a little longer than the previous call
+     */
+    void pause() {
+        if (attempts < kSpins) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            _mm_pause();
+#endif
+        } else if (attempts < kSpins + kYields) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        attempts++;
+    }
+
+    /**
+     * @brief Start spinning again after progress was made
+     */
+    void reset() {
+        attempts = 0;
+    }
+
+private:
+    static constexpr unsigned kSpins = 64;
+    static constexpr unsigned kYields = 64;
+    unsigned attempts = 0;
+};
+
+/**
+ * @brief Bounded lock-free queue for one producer and one consumer thread
+ *
+ * A ring buffer indexed by two monotonically increasing counters; each
+ * side only writes its own counter, so a push or pop is one acquire load
+ * and one release store. The counters live on separate cache lines.
+ */
+template<typename T>
+class SpscQueue {
+public:
+    /**
+     * @brief Constructor
+     * @param capacity Maximum number of queued elements (rounded up to a power of two)
+     */
+    explicit SpscQueue(size_t capacity)
+        : mask(queueCapacity(capacity) - 1), slots(new T[mask + 1]) {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * @brief Append an element (producer thread only)
+     * @param value Element to move into the queue
+     * @return false if the queue is full (value is left unchanged)
+     */
+    bool tryPush(T& value) {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - headIndex.load(std::memory_order_acquire) > mask) {
+            return false;
+        }
+        slots[tail & mask] = std::move(value);
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Remove the oldest element (consumer thread only)
+     * @param value Receives the element
+     * @return false if the queue is empty
+     */
+    bool tryPop(T& value) {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == tailIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(slots[head & mask]);
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Get the capacity
+     * @return Maximum number of queued elements
+     */
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+private:
+    const size_t mask;
+    std::unique_ptr<T[]> slots;
+    alignas(64) std::atomic<size_t> headIndex{0}; ///< Next element to pop
+    alignas(64) std::atomic<size_t> tailIndex{0}; ///< Next free slot
+};
+
+/**
+ * @brief Bounded lock-free queue for any number of producers and consumers
+ *
+ * Dmitry Vyukov's array queue: every slot carries a sequence number that
+ * tells producers and consumers whether it is free or filled for their
+ * turn, so threads claim slots with one compare-and-swap on a shared
+ * counter and never wait for each other to finish. Elements are popped in
+ * the order their pushes claimed slots.
+ */
+template<typename T>
+class MpmcQueue {
+public:
+    /**
+     * @brief Constructor
+     * @param capacity Maximum number of queued elements (rounded up to a power of two)
+     */
+    explicit MpmcQueue(size_t capacity)
+        : mask(queueCapacity(capacity) - 1), cells(new Cell[mask + 1]) {
+        for (size_t i = 0; i <= mask; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    /**
+     * @brief Append an element
+     * @param value Element to move into the queue
+     * @return false if the queue is full (value is left unchanged)
+     */
+    bool tryPush(T& value) {
+        size_t position = enqueueIndex.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[position & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (enqueueIndex.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false; // The slot still holds an element from the previous lap
+            } else {
+                position = enqueueIndex.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = std::move(value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Remove the oldest element
+     * @param value Receives the element
+     * @return false if the queue is empty
+     */
+    bool tryPop(T& value) {
+        size_t position = dequeueIndex.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[position & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (difference == 0) {
+                if (dequeueIndex.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false; // The slot has not been filled for this lap yet
+            } else {
+                position = dequeueIndex.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(cell->value);
+        cell->sequence.store(position + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Get the capacity
+     * @return Maximum number of queued elements
+     */
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence{0}; ///< Lap and state of the slot
+        T value{};
+    };
+
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    alignas(64) std::atomic<size_t> enqueueIndex{0}; ///< Next slot to fill
+    alignas(64) std::atomic<size_t> dequeueIndex{0}; ///< Next slot to empty
+};
+
+/**
+ * @brief Push into a queue, waiting while it is full
+ * @param queue SpscQueue or MpmcQueue
+ * @param value Element to move into the queue
+ */
+template<typename Queue, typename T>
+void pushWait(Queue& queue, T value) {
+    Backoff backoff;
+    while (!queue.tryPush(value)) {
+        backoff.pause();
+    }
+}
+
+/**
+ * @brief Pop from a queue, waiting while it is empty
+ * @param queue SpscQueue or MpmcQueue
+ * @return The oldest element
+ */
+template<typename T, typename Queue>
+T popWait(Queue& queue) {
+    T value{};
+    Backoff backoff;
+    while (!queue.tryPop(value)) {
+        backoff.pause();
+    }
+    return value;
+}
+
+} // namespace sentiment
+
+#endif // CONCURRENT_QUEUE_H
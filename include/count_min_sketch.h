@@ -0,0 +1,66 @@
+#ifndef COUNT_MIN_SKETCH_H
+#define COUNT_MIN_SKETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sentiment {
+
+/**
+ * @brief Fixed-size frequency estimator for 64-bit keys
+ *
+ * A count-min sketch keeps depth rows of width counters. Each key maps to
+ * one counter per row and its estimate is the smallest of them, so the
+ * estimate never undercounts and only overcounts through collisions.
+ * Updates are conservative (only the smallest counters grow), which
+ * tightens the overestimate. Memory is width * depth counters regardless
+ * of how many distinct keys are added.
+ */
+class CountMinSketch {
+public:
+    /**
+     * @brief Constructor
+     * @param width Counters per row (rounded up to a power of two)
+     * @param depth Number of rows
+     */
+    explicit CountMinSketch(size_t width = 0, size_t depth = 4);
+
+    /**
+     * @brief Count occurrences of a key
+     * @param key Key to count (should be a well-mixed hash)
+     * @param count Number of occurrences to add
+     * @return Estimated count of the key after the update
+     */
+    uint32_t add(uint64_t key, uint32_t count = 1);
+
+    /**
+     * @brief Estimate how often a key was added
+     * @param key Key to look up
+     * @return Upper bound on the count of the key
+     */
+    uint32_t estimate(uint64_t key) const;
+
+    /**
+     * @brief Check whether the sketch has any counters
+     * @return true for a default-constructed (zero-width) sketch
+     */
+    bool empty() const;
+
+private:
+    size_t width = 0;               ///< Counters per row (power of two)
+    size_t depth = 0;               ///< Number of rows
+    std::vector<uint32_t> counters; ///< Row-major counters
+
+    /**
+     * @brief Get the counter of a key in one row
+     * @param key Key to locate
+     * @param row Row index
+     * @return Index into counters
+     */
+    size_t counterIndex(uint64_t key, size_t row) const;
+};
+
+} // namespace sentiment
+
+#endif // COUNT_MIN_SKETCH_H
@@ -0,0 +1,157 @@
+#ifndef CROSS_VALIDATION_H
+#define CROSS_VALIDATION_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "feature_extractor.h"
+#include "preprocessor.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+namespace sentiment {
+
+/**
+ * @brief Hyperparameter values to evaluate; every combination is tried
+ */
+struct SearchGrid {
+    std::vector<double> alphas;              // Laplace smoothing values
+    std::vector<int> minWordFrequencies;     // Vocabulary frequency cutoffs
+    std::vector<size_t> maxVocabularySizes;  // Vocabulary size limits (0 = unlimited)
+};
+
+/**
+ * @brief Cross-validated score of one hyperparameter combination
+ */
+struct CrossValidationResult {
+    double alpha = 1.0;
+    int minWordFrequency = 0;        // 0 with feature hashing (no vocabulary)
+    size_t maxVocabularySize = 0;    // 0 with feature hashing (no vocabulary)
+    double meanAccuracy = 0.0;       // Mean held-out accuracy over the folds
+    double accuracyStdDev = 0.0;     // Standard deviation of the fold accuracies
+    double meanF1Score = 0.0;        // Mean held-out macro F1 score
+    std::vector<double> foldAccuracies; // Held-out accuracy of each fold
+};
+
+/**
+ * @brief K-fold cross-validation and grid search for Naive Bayes
+ *
+ * prepare() extracts the term counts of every document once, against a
+ * vocabulary of all terms, and sums them per fold and label. Naive Bayes
+ * only depends on these sums, so the training counts of every fold are
+ * the corpus totals minus the held-out fold, and each vocabulary cutoff
+ * and smoothing value is evaluated without tokenizing or extracting
+ * features again. With a thread pool the (fold, vocabulary) combinations
+ * are evaluated in parallel.
+ *
+ * Sublinear TF-IDF term frequencies are applied to each document before
+ * the sums are taken. L2-normalized TF-IDF makes every document depend on
+ * the training split's IDF weights, so it is rejected by prepare(). Apart
+ * from n-gram counts (counted through the extractor's sketch) the scores
+ * equal retraining the pipeline on each training split.
+ */
+class CrossValidator {
+public:
+    /**
+     * @brief Constructor
+     * @param preprocessor Preprocessor used to tokenize the documents
+     * @param settings Extractor whose method, n-gram range, hashing and
+     *        TF-IDF options are cross-validated (its vocabulary is not used)
+     * @param pool Optional thread pool for extraction and evaluation
+     */
+    CrossValidator(
+        const Preprocessor& preprocessor,
+        const FeatureExtractor& settings,
+        std::shared_ptr<ThreadPool> pool = nullptr
+    );
+
+    /**
+     * @brief Assign documents to folds and count their terms
+     *
+     * Documents are shuffled with the seed and dealt out per label, so
+     * every fold has about the same label distribution and the same seed
+     * always gives the same folds.
+     *
+     * @param data Labeled documents
+     * @param folds Number of folds (at least 2, at most data.size())
+     * @param seed Seed of the shuffle
+     * @return true if the folds were built, false for an invalid fold count
+     *         or L2-normalized TF-IDF settings
+     */
+    bool prepare(const std::vector<TextData>& data, size_t folds = 5, uint64_t seed = 42);
+
+    /**
+     * @brief Cross-validate every combination of the grid
+     *
+     * With feature hashing only the alphas are searched and the
+     * vocabulary lists are ignored.
+     *
+     * @param grid Values to try (every list must be non-empty)
+     * @return One result per combination, best mean accuracy first
+     */
+    std::vector<CrossValidationResult> search(const SearchGrid& grid) const;
+
+    /**
+     * @brief Get the number of folds built by prepare()
+     * @return Fold count (0 before prepare())
+     */
+    size_t getFoldCount() const;
+
+    /**
+     * @brief Get the fold of every document passed to prepare()
+     * @return Fold index of each document, in input order
+     */
+    const std::vector<uint32_t>& getFoldAssignment() const;
+
+private:
+    /// Count lanes per term (one per SentimentLabel value)
+    static constexpr size_t kLabelCount = 4;
+
+    /**
+     * @brief Held-out documents of one fold and the sums Naive Bayes needs
+     */
+    struct Fold {
+        std::vector<FeatureVector> documents;        ///< Term counts of the fold's documents
+        std::vector<double> termCounts;              ///< Term-major counts per label
+        std::vector<double> occurrences;             ///< Raw count of each term (vocabulary cutoffs)
+        std::vector<uint32_t> documentFrequencies;   ///< Documents containing each term
+        std::array<size_t, kLabelCount> labelExamples{}; ///< Documents per label
+    };
+
+    const Preprocessor& preprocessor;
+    FeatureExtractor::Method method;
+    unsigned hashBits;
+    bool signedHashing;
+    size_t ngramMin;
+    size_t ngramMax;
+    bool sublinearTf;
+    bool l2Normalize;
+    std::shared_ptr<ThreadPool> threadPool;
+
+    size_t dimension = 0;                 ///< Terms (or hashed features) counted
+    std::vector<uint32_t> termRanks;      ///< Alphabetical rank of each term
+    std::vector<Fold> folds;
+    Fold totals;                          ///< Sums over all folds (no documents)
+    std::vector<uint32_t> foldAssignment; ///< Fold of each input document
+
+    /**
+     * @brief Evaluate one vocabulary cutoff on one held-out fold
+     * @param fold Index of the held-out fold
+     * @param minFrequency Vocabulary frequency cutoff
+     * @param maxVocabSize Vocabulary size limit (0 = unlimited)
+     * @param alphas Smoothing values to evaluate
+     * @param metrics Receives the held-out metrics for each alpha
+     */
+    void evaluateFold(
+        size_t fold,
+        int minFrequency,
+        size_t maxVocabSize,
+        const std::vector<double>& alphas,
+        EvaluationMetrics* metrics
+    ) const;
+};
+
+} // namespace sentiment
+
+#endif // CROSS_VALIDATION_H
@@ -0,0 +1,95 @@
+#ifndef CSV_PARSER_H
+#define CSV_PARSER_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "thread_pool.h"
+
+namespace sentiment {
+
+/**
+ * @brief Zero-copy RFC 4180 record parser over a block of CSV text
+ *
+ * Fields are returned as views into the parsed text, which is typically a
+ * memory-mapped file. Quoted fields may contain commas, line breaks and
+ * doubled quotes; only fields with doubled quotes are unescaped, into
+ * scratch storage owned by the parser. Records end at LF or CRLF.
+ *
+ * The parser is lenient where the RFC is strict: characters between a
+ * closing quote and the next delimiter are ignored, quotes inside an
+ * unquoted field are kept literally, and an unterminated quoted field runs
+ * to the end of the text.
+ */
+class CsvParser {
+public:
+    /**
+     * @brief Constructor
+     * @param text CSV text to parse; must outlive the parser and its fields
+     */
+    explicit CsvParser(std::string_view text);
+
+    /**
+     * @brief Parse the next record
+     *
+     * The views stay valid until the next call to next(). Blank lines are
+     * skipped.
+     *
+     * @param fields Receives the fields of the record
+     * @return true if a record was parsed, false at the end of the text
+     */
+    bool next(std::vector<std::string_view>& fields);
+
+    /**
+     * @brief Get the raw text of the record returned by the last next()
+     * @return View of the record without its line terminator
+     */
+    std::string_view record() const;
+
+    /**
+     * @brief Get the text that has not been parsed yet
+     * @return View from the start of the next record to the end of the text
+     */
+    std::string_view remaining() const;
+
+    /**
+     * @brief Split CSV text into parts that start on record boundaries
+     *
+     * The text is cut at roughly equal byte offsets, and every cut is moved
+     * forward to the next line break outside a quoted field. The quote
+     * state at each cut is derived from the parity of the quotes before
+     * it, so parts can be parsed independently and in parallel. Cuts are
+     * exact for well-formed input; quotes inside unquoted fields can move
+     * a cut into the middle of a record.
+     *
+     * @param text CSV text to split
+     * @param parts Desired number of parts
+     * @param pool Optional thread pool used to count quotes
+     * @return Start offsets of the parts followed by text.size(); parts may be empty
+     */
+    static std::vector<size_t> splitRecords(
+        std::string_view text,
+        size_t parts,
+        ThreadPool* pool = nullptr
+    );
+
+private:
+    const char* cursor;          ///< Start of the unparsed text
+    const char* end;             ///< End of the text
+    std::string_view lastRecord; ///< Raw text of the last record
+
+    std::deque<std::string> scratch; ///< Unescaped copies of fields with doubled quotes
+    size_t scratchUsed = 0;          ///< Scratch strings used by the current record
+
+    /**
+     * @brief Parse a quoted field starting after its opening quote
+     * @return View of the field contents
+     */
+    std::string_view parseQuoted();
+};
+
+} // namespace sentiment
+
+#endif // CSV_PARSER_H
@@ -1,12 +1,25 @@
 #ifndef DATA_LOADER_H
 #define DATA_LOADER_H
 
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "thread_pool.h"
 #include "utils.h"
 
 namespace sentiment {
 
+/**
+ * @brief Training and validation rows of a DataLoader
+ */
+struct DataSplit {
+    ConstSpan<TextData> train;      ///< Rows to train on
+    ConstSpan<TextData> validation; ///< Rows held out for evaluation
+};
+
 /**
  * @brief Class for loading text data from files
  *
@@ -16,6 +29,14 @@ namespace sentiment {
  */
 class DataLoader {
 public:
+    /**
+     * @brief Callback receiving one chunk of parsed rows
+     *
+     * The chunk is only valid during the call and is reused for the next
+     * chunk. Returning false stops reading.
+     */
+    using ChunkCallback = std::function<bool(const std::vector<TextData>& chunk)>;
+
     /**
      * @brief Default constructor
      */
@@ -23,6 +44,12 @@ public:
 
     /**
      * @brief Load data from a CSV file
+     *
+     * The file is memory-mapped and parsed as RFC 4180 CSV, so quoted
+     * fields may contain commas, doubled quotes and line breaks. With a
+     * thread pool the file is split on record boundaries and the parts are
+     * parsed in parallel; rows keep their order in the file.
+     *
      * @param filePath Path to the CSV file
      * @param hasHeader Whether the CSV file has a header row
      * @param textColumn Index of the column containing text data
@@ -36,6 +63,38 @@ public:
         int labelColumn = 1
     );
 
+    /**
+     * @brief Stream a CSV file in fixed-size chunks
+     *
+     * Rows are parsed and handed to the callback chunkSize at a time, so
+     * peak memory is bounded by the chunk size rather than the file size.
+     * The loaded data returned by getData() is not modified.
+     *
+     * @param filePath Path to the CSV file
+     * @param chunkSize Maximum number of rows per chunk
+     * @param onChunk Callback invoked for every chunk
+     * @param hasHeader Whether the CSV file has a header row
+     * @param textColumn Index of the column containing text data
+     * @param labelColumn Index of the column containing sentiment labels
+     * @return true if the file was read, contained valid rows and every chunk
+     *         was accepted; false otherwise, including when the callback
+     *         returned false to stop the stream
+     */
+    static bool streamCSV(
+        const std::string& filePath,
+        size_t chunkSize,
+        const ChunkCallback& onChunk,
+        bool hasHeader = true,
+        int textColumn = 0,
+        int labelColumn = 1
+    );
+
+    /**
+     * @brief Set the thread pool used by loadFromCSV
+     * @param pool Shared thread pool (nullptr to parse on the calling thread)
+     */
+    void setThreadPool(std::shared_ptr<ThreadPool> pool);
+
     /**
      * @brief Get all loaded text data
      * @return Vector of TextData structures
@@ -44,14 +103,35 @@ public:
 
     /**
      * @brief Split data into training and validation sets
+     *
+     * Reorders the loaded rows in place (see trainValidationOrder()) so the
+     * training rows come first, and returns views of both parts. No row is
+     * copied. The views are invalidated by the next load.
+     *
      * @param trainRatio Ratio of data to use for training (between 0 and 1)
-     * @return A pair of vectors (train_data, validation_data)
+     * @param seed Seed of the shuffle; the same seed gives the same split
+     * @return Views of the training and validation rows of getData()
      */
-    std::pair<std::vector<TextData>, std::vector<TextData>>
-    splitTrainValidation(double trainRatio = 0.8) const;
+    DataSplit splitTrainValidation(double trainRatio = 0.8, uint64_t seed = 42);
 
 private:
     std::vector<TextData> data; ///< Loaded text data with labels
+    std::shared_ptr<ThreadPool> threadPool; ///< Optional pool for parallel parsing
+
+    /**
+     * @brief Convert the fields of one CSV record into a TextData row
+     * @param fields Fields of the record
+     * @param textColumn Index of the column containing text data
+     * @param labelColumn Index of the column containing sentiment labels
+     * @param row Receives the parsed row
+     * @return true if the record has enough columns, false otherwise
+     */
+    static bool parseRecord(
+        const std::vector<std::string_view>& fields,
+        int textColumn,
+        int labelColumn,
+        TextData& row
+    );
 };
 
 } // namespace sentiment
@@ -1,18 +1,97 @@
 #ifndef EVALUATOR_H
 #define EVALUATOR_H
 
+#include <array>
+#include <cstdint>
+#include <memory>
 #include <vector>
-#include <unordered_map>
 #include "model.h"
+#include "thread_pool.h"
 #include "utils.h"
 
 namespace sentiment {
 
+/**
+ * @brief Confusion matrix stored as a fixed-size array indexed by label
+ *
+ * Cell [actual][predicted] counts the examples of label actual that were
+ * predicted as predicted. Matrices from different batches or workers are
+ * combined with merge().
+ */
+struct ConfusionMatrix {
+    /// Number of distinct SentimentLabel values (rows and columns)
+    static constexpr size_t kLabelCount = 4;
+
+    std::array<uint64_t, kLabelCount * kLabelCount> counts{}; ///< Row-major by actual label
+
+    /**
+     * @brief Count examples in one cell
+     * @param actual True label
+     * @param predicted Predicted label
+     * @param count Number of examples to add
+     */
+    void add(SentimentLabel actual, SentimentLabel predicted, uint64_t count = 1) {
+        counts[static_cast<size_t>(actual) * kLabelCount + static_cast<size_t>(predicted)] += count;
+    }
+
+    /**
+     * @brief Get the count of one cell
+     * @param actual True label
+     * @param predicted Predicted label
+     * @return Number of examples
+     */
+    uint64_t at(SentimentLabel actual, SentimentLabel predicted) const {
+        return counts[static_cast<size_t>(actual) * kLabelCount + static_cast<size_t>(predicted)];
+    }
+
+    /**
+     * @brief Add the counts of another matrix
+     * @param other Matrix to merge into this one
+     */
+    void merge(const ConfusionMatrix& other);
+
+    /**
+     * @brief Get the number of examples with a true label
+     * @param label True label (row)
+     * @return Row sum
+     */
+    uint64_t actualCount(SentimentLabel label) const;
+
+    /**
+     * @brief Get the number of examples predicted as a label
+     * @param label Predicted label (column)
+     * @return Column sum
+     */
+    uint64_t predictedCount(SentimentLabel label) const;
+
+    /**
+     * @brief Get the number of counted examples
+     * @return Sum of all cells
+     */
+    uint64_t total() const;
+
+    /**
+     * @brief Compute accuracy and macro-averaged precision, recall and F1
+     *
+     * Precision and recall are averaged over the labels that occur as
+     * true labels; F1 is the harmonic mean of the two averages.
+     *
+     * @return Metrics (all zero when the matrix is empty)
+     */
+    EvaluationMetrics metrics() const;
+};
+
 /**
  * @brief Class for evaluating model performance
  *
  * This class handles evaluating a trained model on validation data
  * and computing various performance metrics.
+ *
+ * Validation data can be passed at once to evaluate(), or streamed in
+ * batches through accumulate() and finish(), so a held-out set never has
+ * to be in memory as a whole. With a thread pool every batch is split
+ * across the workers, each counting into its own confusion matrix, and
+ * the partial matrices are merged afterwards.
  */
 class Evaluator {
 public:
@@ -33,57 +112,63 @@ public:
     EvaluationMetrics evaluate(const std::vector<FeatureVector>& validationData);
 
     /**
-     * @brief Get confusion matrix
-     *
-     * Returns a map where key is true label and value is map of predicted label to count.
-     *
-     * @return Confusion matrix as nested unordered_map
+     * @brief Clear the counts before streaming a new validation set
      */
-    const std::unordered_map<SentimentLabel,
-          std::unordered_map<SentimentLabel, int>>& getConfusionMatrix() const;
+    void reset();
 
     /**
-     * @brief Print evaluation results
-     *
-     * Prints accuracy, precision, recall, F1 score, and confusion matrix.
+     * @brief Predict and count one batch of validation examples
+     * @param batch Validation examples
      */
-    void printResults() const;
+    void accumulate(const std::vector<FeatureVector>& batch);
 
-private:
-    const Model& model; ///< Reference to the model being evaluated
-    EvaluationMetrics metrics; ///< Computed evaluation metrics
+    /**
+     * @brief Predict and count documents through the model's batch path
+     * @param documents Pointer to count feature vectors
+     * @param labels Pointer to count true labels
+     * @param count Number of documents
+     */
+    void accumulate(const SparseVector* documents, const SentimentLabel* labels, size_t count);
 
-    // Confusion matrix: true_label -> predicted_label -> count
-    std::unordered_map<SentimentLabel,
-                      std::unordered_map<SentimentLabel, int>> confusionMatrix;
+    /**
+     * @brief Compute the metrics of everything counted since reset()
+     * @return EvaluationMetrics structure with computed metrics
+     */
+    EvaluationMetrics finish();
 
     /**
-     * @brief Compute precision for a label
-     * @param label Target sentiment label
-     * @return Precision value
+     * @brief Get confusion matrix
+     * @return Counts of the examples evaluated since the last reset
      */
-    double computePrecision(SentimentLabel label) const;
+    const ConfusionMatrix& getConfusionMatrix() const;
 
     /**
-     * @brief Compute recall for a label
-     * @param label Target sentiment label
-     * @return Recall value
+     * @brief Set the thread pool used to predict batches
+     * @param pool Shared thread pool (nullptr to predict on the calling thread)
      */
-    double computeRecall(SentimentLabel label) const;
+    void setThreadPool(std::shared_ptr<ThreadPool> pool);
 
     /**
-     * @brief Compute F1 score for a label
-     * @param precision Precision value
-     * @param recall Recall value
-     * @return F1 score
+     * @brief Print evaluation results
+     *
+     * Prints accuracy, precision, recall, F1 score, and confusion matrix.
      */
-    double computeF1(double precision, double recall) const;
+    void printResults() const;
+
+private:
+    const Model& model; ///< Reference to the model being evaluated
+    EvaluationMetrics metrics{}; ///< Computed evaluation metrics
+    ConfusionMatrix confusionMatrix; ///< Counts since the last reset
+    std::shared_ptr<ThreadPool> threadPool; ///< Optional pool for batch prediction
+    std::vector<ConfusionMatrix> workerMatrices; ///< Partial counts of each worker
 
     /**
-     * @brief Compute overall accuracy
-     * @return Accuracy value
+     * @brief Count a range of examples on every worker and merge the results
+     * @param count Number of examples
+     * @param countRange Counts [begin, end) into the given matrix
      */
-    double computeAccuracy() const;
+    template<typename CountRange>
+    void countParallel(size_t count, CountRange&& countRange);
 };
 
 } // namespace sentiment
@@ -1,11 +1,18 @@
 #ifndef FEATURE_EXTRACTOR_H
 #define FEATURE_EXTRACTOR_H
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include "count_min_sketch.h"
+#include "inference_context.h"
 #include "preprocessor.h"
+#include "term_interner.h"
+#include "thread_pool.h"
 #include "utils.h"
+#include "vocabulary_index.h"
 
 namespace sentiment {
 
@@ -13,7 +20,8 @@ namespace sentiment {
  * @brief Class for extracting features from text
  *
  * This class handles converting text to feature vectors
- * using Bag-of-Words (BoW) or TF-IDF representation.
+ * using Bag-of-Words (BoW) or TF-IDF representation over a vocabulary,
+ * or feature hashing into a fixed 2^k dimensional space.
  */
 class FeatureExtractor {
 public:
@@ -22,9 +30,16 @@ public:
      */
     enum class Method {
         BAG_OF_WORDS, ///< Bag of Words (term frequency)
-        TF_IDF        ///< Term Frequency-Inverse Document Frequency
+        TF_IDF,       ///< Term Frequency-Inverse Document Frequency
+        HASHING       ///< Term frequency of hashed terms; no vocabulary
     };
 
+    /// Largest supported hashed feature space (2^kMaxHashBits features)
+    static constexpr unsigned kMaxHashBits = 30;
+
+    /// Longest supported n-gram
+    static constexpr size_t kMaxNgramLength = 3;
+
     /**
      * @brief Constructor
      * @param preprocessor Reference to a Preprocessor object
@@ -40,25 +55,114 @@ public:
      *
      * This method processes the training data to:
      * - Extract unique words
-     * - Build the vocabulary mapping
+     * - Freeze the vocabulary into a VocabularyIndex
      * - Calculate document frequencies for TF-IDF
      *
+     * Tokens are interned into per-worker TermInterner tables and counted
+     * by term id; with a thread pool the workers count documents in
+     * parallel and their tables are merged afterwards. Ties in word
+     * frequency are broken alphabetically, so the resulting vocabulary is
+     * the same for any thread count.
+     *
      * @param textData Vector of TextData to build vocabulary from
      * @param minFrequency Minimum frequency for a word to be included in vocabulary
      * @param maxVocabSize Maximum vocabulary size (0 for unlimited)
+     *
+     * With Method::HASHING no vocabulary is needed and the documents are
+     * not read; only the document count is recorded.
+     *
+     * N-grams longer than one token are counted by hash in a fixed-size
+     * count-min sketch. Only a bounded table of the most frequent n-grams
+     * keeps their text, so memory does not grow with the number of
+     * distinct n-grams in the corpus. Their counts are upper-bound
+     * estimates, which can admit a rare n-gram that collides with
+     * frequent ones.
      */
     void buildVocabulary(
-        const std::vector<TextData>& textData,
+        ConstSpan<TextData> textData,
+        int minFrequency = 2,
+        size_t maxVocabSize = 5000
+    );
+
+    /**
+     * @brief Discard word counts accumulated by countVocabulary()
+     */
+    void resetVocabularyCounts();
+
+    /**
+     * @brief Accumulate word and document counts from a chunk of documents
+     *
+     * Together with finalizeVocabulary() this builds the same vocabulary as
+     * buildVocabulary() over the concatenation of all chunks, without
+     * needing the whole corpus in memory.
+     *
+     * @param textData Chunk of documents
+     */
+    void countVocabulary(ConstSpan<TextData> textData);
+
+    /**
+     * @brief Build the vocabulary from the counts accumulated so far
+     * @param minFrequency Minimum frequency for a word to be included in vocabulary
+     * @param maxVocabSize Maximum vocabulary size (0 for unlimited)
+     */
+    void finalizeVocabulary(int minFrequency = 2, size_t maxVocabSize = 5000);
+
+    /**
+     * @brief Grow the vocabulary with documents that arrive after it was built
+     *
+     * Words from the batch that are not yet in the vocabulary and occur at
+     * least minFrequency times in it are appended, so existing feature
+     * indices stay valid and feature vectors only gain dimensions. The
+     * document count and document frequencies are updated for TF-IDF.
+     *
+     * @param textData New documents
+     * @param minFrequency Minimum frequency in the batch for a new word
+     * @param maxVocabSize Maximum vocabulary size after growing (0 for unlimited)
+     * @return Number of words added
+     */
+    size_t extendVocabulary(
+        ConstSpan<TextData> textData,
         int minFrequency = 2,
         size_t maxVocabSize = 5000
     );
 
     /**
      * @brief Convert text to feature vector
+     *
+     * Only the words of the text that are in the vocabulary produce
+     * entries, so the cost is proportional to the document length.
+     *
      * @param text Text to convert
-     * @return Feature vector (sparse or dense based on method)
+     * @return Sparse feature vector with dimension getFeatureCount()
      */
-    std::vector<double> extractFeatures(const std::string& text) const;
+    SparseVector extractFeatures(const std::string& text) const;
+
+    /**
+     * @brief Convert text to a feature vector using reusable scratch storage
+     *
+     * Produces the same vector as extractFeatures(text), but every
+     * intermediate buffer and the result live in the context, so repeated
+     * calls with one context stop allocating once its buffers are large
+     * enough.
+     *
+     * @param text Text to convert
+     * @param context Scratch storage (the result is context.features)
+     * @return Reference to context.features, valid until the context is reused
+     */
+    const SparseVector& extractFeatures(std::string_view text, InferenceContext& context) const;
+
+    /**
+     * @brief Map a text to the vocabulary ids of its terms
+     *
+     * Emits one id per word or n-gram of the text that is in the
+     * vocabulary, in text order; out-of-vocabulary terms are skipped.
+     * Tokens are hashed once and looked up in the frozen vocabulary index,
+     * so no strings are built per token.
+     *
+     * @param text Text to map
+     * @param ids Receives the term ids (previous contents are replaced)
+     */
+    void extractTermIds(std::string_view text, std::vector<uint32_t>& ids) const;
 
     /**
      * @brief Convert TextData to FeatureVector
@@ -69,46 +173,252 @@ public:
 
     /**
      * @brief Convert a batch of TextData to FeatureVectors
+     *
+     * Runs on the thread pool when one is set; output order always
+     * matches the input order.
+     *
      * @param textDataBatch Vector of TextData to transform
      * @return Vector of FeatureVectors
      */
     std::vector<FeatureVector> batchTransform(
-        const std::vector<TextData>& textDataBatch
+        ConstSpan<TextData> textDataBatch
     ) const;
 
     /**
      * @brief Get the size of the vocabulary
-     * @return Number of words in vocabulary
+     * @return Number of words in vocabulary (0 with feature hashing)
      */
     size_t getVocabularySize() const;
 
     /**
-     * @brief Get the vocabulary map
-     * @return Unordered map of word to index
+     * @brief Get the dimension of the extracted feature vectors
+     * @return 2^hashBits with feature hashing, the vocabulary size otherwise
+     */
+    size_t getFeatureCount() const;
+
+    /**
+     * @brief Configure the feature space used by Method::HASHING
+     *
+     * Each token is hashed with FNV-1a; the low bits select the feature.
+     * With the sign trick the top hash bit decides whether the token adds
+     * +1 or -1, so collisions cancel out on average instead of piling up.
+     * Signed features suit linear models; Naive Bayes ignores negative
+     * feature values.
+     *
+     * @param bits Feature space size as a power of two (1 to kMaxHashBits)
+     * @param useSign Whether to apply the sign trick
+     * @return true if the options are valid, false otherwise
+     */
+    bool setHashing(unsigned bits, bool useSign = false);
+
+    /**
+     * @brief Set which n-gram lengths become features
+     *
+     * An n-gram term is its tokens joined by single spaces, e.g. "not good".
+     * N-grams are formed after stop word removal. Takes effect for the
+     * next vocabulary build (or immediately for Method::HASHING).
+     *
+     * @param minLength Shortest n-gram (1 includes single words)
+     * @param maxLength Longest n-gram (at most kMaxNgramLength)
+     * @return true if the range is valid, false otherwise
+     */
+    bool setNgramRange(size_t minLength, size_t maxLength);
+
+    /**
+     * @brief Get the shortest n-gram length used as a feature
+     * @return Minimum n-gram length
+     */
+    size_t getNgramMin() const;
+
+    /**
+     * @brief Get the longest n-gram length used as a feature
+     * @return Maximum n-gram length
+     */
+    size_t getNgramMax() const;
+
+    /**
+     * @brief Get the hashed feature space size as a power of two
+     * @return Number of hash bits
+     */
+    unsigned getHashBits() const;
+
+    /**
+     * @brief Check whether hashed features use the sign trick
+     * @return true if colliding tokens may have opposite signs
+     */
+    bool isSignedHashing() const;
+
+    /**
+     * @brief Get the vocabulary
+     *
+     * The frozen term arena and perfect hash that feature extraction and
+     * saved models use; find() gives the index of a term, term() the term
+     * at an index.
+     *
+     * @return Vocabulary index
+     */
+    const VocabularyIndex& getVocabularyIndex() const;
+
+    /**
+     * @brief Get document frequencies per vocabulary index (TF-IDF only)
+     * @return Document frequency table, empty for bag-of-words
+     */
+    const ConstArray<double>& getDocumentFrequencies() const;
+
+    /**
+     * @brief Get the number of documents the vocabulary was built from
+     * @return Document count used for IDF calculation
      */
-    const std::unordered_map<std::string, size_t>& getVocabulary() const;
+    size_t getDocumentCount() const;
+
+    /**
+     * @brief Get the IDF weight of every vocabulary index (TF-IDF only)
+     *
+     * Holds log(N / df) for N documents and document frequency df, or 0
+     * for terms that occur in no document. The table is computed once
+     * whenever the vocabulary or its document frequencies change, not per
+     * extracted document.
+     *
+     * @return IDF table, empty unless the method is TF_IDF
+     */
+    const ConstArray<double>& getIdfWeights() const;
+
+    /**
+     * @brief Set how TF-IDF values are computed
+     * @param sublinear Use 1 + log(tf) instead of the raw term count
+     * @param normalize Scale every document vector to unit L2 norm
+     */
+    void setTfIdfOptions(bool sublinear, bool normalize);
+
+    /**
+     * @brief Check whether TF-IDF uses sublinear term frequencies
+     * @return true if counts are replaced with 1 + log(tf)
+     */
+    bool isSublinearTf() const;
+
+    /**
+     * @brief Check whether TF-IDF vectors are L2-normalized
+     * @return true if every document vector has unit length
+     */
+    bool isL2Normalized() const;
+
+    /**
+     * @brief Leave the IDF weights out of extracted TF-IDF vectors
+     *
+     * Multiplying a feature's model parameters by its IDF gives the same
+     * scores as multiplying the feature value, for any model that is
+     * linear in its features. A frozen pipeline folds the IDF into its
+     * model that way (see NaiveBayes::scaleFeatures) and turns it off
+     * here, so TF-IDF extraction costs the same as bag-of-words. L2
+     * normalization depends on the weighted values, so it prevents
+     * folding.
+     *
+     * @param folded Whether the model applies the IDF weights
+     * @return true if the setting was applied, false if the IDF cannot be folded
+     */
+    bool setIdfFolded(bool folded);
+
+    /**
+     * @brief Check whether extracted vectors leave out the IDF weights
+     * @return true if the model applies them
+     */
+    bool isIdfFolded() const;
+
+    /**
+     * @brief Install a prebuilt vocabulary, e.g. from a saved model
+     *
+     * The arrays are used in place, so a vocabulary borrowed from a
+     * memory-mapped file is not copied.
+     *
+     * @param index Term lookup index
+     * @param frequencies Document frequencies per index (TF-IDF only)
+     * @param documents Document count for IDF calculation
+     * @param featureMethod Feature extraction method the vocabulary was built for
+     * @return true if the tables are consistent, false otherwise
+     */
+    bool setVocabulary(
+        VocabularyIndex index,
+        ConstArray<double> frequencies,
+        size_t documents,
+        Method featureMethod
+    );
 
     /**
      * @brief Get feature extraction method
-     * @return Current method (BAG_OF_WORDS or TF_IDF)
+     * @return Current method (BAG_OF_WORDS, TF_IDF or HASHING)
      */
     Method getMethod() const;
 
+    /**
+     * @brief Set the thread pool used by buildVocabulary and batchTransform
+     * @param pool Shared thread pool (nullptr to run on the calling thread)
+     */
+    void setThreadPool(std::shared_ptr<ThreadPool> pool);
+
 private:
     const Preprocessor& preprocessor; ///< Reference to text preprocessor
     Method method; ///< Feature extraction method
+    std::shared_ptr<ThreadPool> threadPool; ///< Optional pool for batch work
+    unsigned hashBits = 18; ///< Hashed feature space is 2^hashBits
+    bool signedHashing = false; ///< Whether hashed tokens get a random sign
+    size_t ngramMin = 1; ///< Shortest n-gram used as a feature
+    size_t ngramMax = 1; ///< Longest n-gram used as a feature
 
-    std::unordered_map<std::string, size_t> vocabulary; ///< Word to index mapping
-    std::vector<double> documentFrequencies; ///< Document frequencies for TF-IDF
+    VocabularyIndex vocabularyIndex; ///< Frozen term to index lookup
+    ConstArray<double> documentFrequencies; ///< Document frequencies for TF-IDF
     size_t documentCount = 0; ///< Total document count for IDF calculation
+    ConstArray<double> idfWeights; ///< log(documentCount / df) per vocabulary index
+    bool sublinearTf = false; ///< Whether TF-IDF uses 1 + log(tf)
+    bool l2Normalize = false; ///< Whether TF-IDF vectors get unit length
+    bool idfFolded = false; ///< Whether the model applies idfWeights instead
+
+    // Running counts for incremental vocabulary building
+    TermInterner pendingWords;               ///< Words counted so far, by id
+    std::vector<size_t> pendingWordCounts;    ///< Frequency of each word id
+    std::vector<size_t> pendingWordDocuments; ///< Document frequency of each word id
+    size_t pendingDocumentCount = 0;
+    std::unordered_map<uint64_t, std::string> pendingNgrams; ///< Frequent n-gram candidates by hash
+    CountMinSketch ngramFrequencies;         ///< Estimated n-gram frequencies
+    CountMinSketch ngramDocumentOccurrences; ///< Estimated n-gram document frequencies
+    uint32_t ngramAdmissionCount = 0;        ///< Estimate a new candidate must reach
+
+    /**
+     * @brief Recompute idfWeights from the document frequencies and count
+     */
+    void updateIdfWeights();
+
+    /**
+     * @brief Count the n-grams of one tokenized document
+     * @param tokens Preprocessed tokens of the document
+     * @param hashes hashBytes() of every token
+     */
+    void countNgrams(const std::vector<std::string_view>& tokens, const std::vector<uint64_t>& hashes);
+
+    /**
+     * @brief Drop the less frequent half of the n-gram candidates
+     */
+    void pruneNgrams();
+
+    /**
+     * @brief Visit every counted word and n-gram candidate
+     * @param visit Called with the term, its frequency and its document frequency
+     */
+    void forEachCountedTerm(
+        const std::function<void(std::string_view term, size_t count, size_t documents)>& visit
+    ) const;
+
+    /**
+     * @brief Look up the vocabulary ids of preprocessed tokens and their n-grams
+     * @param context Holds the tokens; receives the ids in text order in context.ids
+     */
+    void lookupTermIds(InferenceContext& context) const;
 
     /**
-     * @brief Calculate TF-IDF for a word in a document
-     * @param termFrequency Term frequency in the document
-     * @param wordIndex Index of the word in vocabulary
-     * @return TF-IDF value
+     * @brief Build a hashed feature vector from preprocessed tokens
+     * @param context Holds the tokens (n-grams are hashed too); receives the
+     *        vector with dimension 2^hashBits in context.features
      */
-    double calculateTfIdf(double termFrequency, size_t wordIndex) const;
+    void hashFeatures(InferenceContext& context) const;
 };
 
 } // namespace sentiment
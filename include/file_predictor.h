@@ -0,0 +1,82 @@
+#ifndef FILE_PREDICTOR_H
+#define FILE_PREDICTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "model_snapshot.h"
+
+namespace sentiment {
+
+/**
+ * @brief Options for FilePredictor
+ */
+struct FilePredictionConfig {
+    size_t workerThreads = 0;    // Threads extracting features and scoring (0 = all cores)
+    size_t batchLines = 1024;    // Lines handed between the stages at a time
+    size_t batchesInFlight = 0;  // Batches read ahead of the writer (0 = 4 per worker)
+};
+
+/**
+ * @brief Counters of the last FilePredictor::run()
+ */
+struct FilePredictionStats {
+    uint64_t lines = 0;      ///< Lines scored
+    uint64_t batches = 0;    ///< Batches the lines were split into
+    uint64_t bytesRead = 0;  ///< Size of the input file
+    double seconds = 0.0;    ///< Wall time of the run
+};
+
+/**
+ * @brief Scores a text file line by line through a pipeline of threads
+ *
+ * The input is memory-mapped and the calling thread acts as the reader:
+ * it splits the mapping into batches of line views and pushes them onto a
+ * bounded lock-free MPMC queue. Worker threads pop batches, extract and
+ * score them with a vectorized predictBatch call and format the result
+ * lines; finished batches go through a second MPMC queue to a writer
+ * thread, which writes them in input order and hands the buffers back to
+ * the reader through an SPSC queue. The fixed number of batch buffers
+ * bounds memory and makes a slow stage hold back the others, while
+ * reading and writing overlap with scoring.
+ *
+ * The output has one "label,score" line per input line (score is the log
+ * joint probability of the label). A trailing "\r" is dropped, and empty
+ * lines are scored like any other.
+ */
+class FilePredictor {
+public:
+    /**
+     * @brief Constructor
+     * @param snapshot Model to score with
+     * @param config Pipeline options
+     */
+    explicit FilePredictor(
+        std::shared_ptr<const ModelSnapshot> snapshot,
+        const FilePredictionConfig& config = FilePredictionConfig{}
+    );
+
+    /**
+     * @brief Score every line of a file
+     * @param inputPath File with one text per line
+     * @param outputPath File to write the predictions to (replaced)
+     * @return true if every line was scored and written, false otherwise
+     */
+    bool run(const std::string& inputPath, const std::string& outputPath);
+
+    /**
+     * @brief Get the counters of the last run
+     * @return Counters (zero before the first run)
+     */
+    const FilePredictionStats& getStats() const;
+
+private:
+    std::shared_ptr<const ModelSnapshot> snapshot;
+    FilePredictionConfig config;
+    FilePredictionStats stats;
+};
+
+} // namespace sentiment
+
+#endif // FILE_PREDICTOR_H
@@ -0,0 +1,34 @@
+#ifndef INFERENCE_CONTEXT_H
+#define INFERENCE_CONTEXT_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "utils.h"
+
+namespace sentiment {
+
+/**
+ * @brief Reusable scratch storage for predicting one text at a time
+ *
+ * Feature extraction needs a lowercased copy of the text, the token
+ * views into it, their hashes, the matched feature ids and the output
+ * vector. Passing the same context to successive predictions reuses that
+ * storage: buffers are cleared but keep their capacity, so once they have
+ * grown to fit the longest text seen, predicting makes no heap
+ * allocations. A context must not be shared between threads; give each
+ * thread its own.
+ */
+struct InferenceContext {
+    std::string buffer;                   ///< Preprocessed text that tokens point into
+    std::vector<std::string_view> tokens; ///< Preprocessed tokens
+    std::vector<uint64_t> hashes;         ///< hashBytes() of every token
+    std::vector<uint64_t> keys;           ///< Feature index and sign of every hashed term
+    std::vector<uint32_t> ids;            ///< Vocabulary ids of the matched terms
+    SparseVector features;                ///< Result of the last extraction
+};
+
+} // namespace sentiment
+
+#endif // INFERENCE_CONTEXT_H
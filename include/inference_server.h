@@ -0,0 +1,202 @@
+#ifndef INFERENCE_SERVER_H
+#define INFERENCE_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "model_snapshot.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+namespace sentiment {
+
+/**
+ * @brief Options for InferenceServer
+ */
+struct ServerConfig {
+    std::string host = "0.0.0.0";       // Address to listen on
+    uint16_t port = 8080;                // Port to listen on (0 picks a free port)
+    size_t connectionThreads = 8;        // Requests parsed and answered at the same time
+    size_t predictionThreads = 1;        // Threads scoring each batch (0 = all cores)
+    size_t maxBatchSize = 256;           // Texts scored by one predictBatch call
+    size_t maxQueuedConnections = 128;   // Connections with a request waiting for a thread
+    size_t maxIdleConnections = 1024;    // Open connections waiting for their next request
+    size_t maxQueuedTexts = 4096;        // Texts waiting to be scored
+    size_t maxRequestBytes = 1 << 20;    // Largest accepted request body
+    int keepAliveTimeoutMs = 5000;       // Idle time before a connection is closed
+};
+
+/**
+ * @brief HTTP/1.1 front end that serves predictions from a ModelSnapshot
+ *
+ * Endpoints:
+ *   POST /predict  Body holds one text per line; the response is a JSON
+ *                  object with one {"label", "score"} entry per line.
+ *   GET  /health   Returns 200 while the server is running.
+ *   GET  /metrics  Per-stage latency histograms in Prometheus text format.
+ *
+ * A poll thread accepts connections and watches the idle ones; only a
+ * connection with a request waiting is handed to one of a fixed set of
+ * connection threads, which answers it (and any requests pipelined behind
+ * it) and then gives the connection back to the poll set. Idle keep-alive
+ * clients therefore hold no thread, and are closed after keepAliveTimeoutMs.
+ * The texts of requests are handed to a single batching thread, which
+ * coalesces everything that arrived while the previous batch was being
+ * scored into one predictBatch call. Load beyond the
+ * configured queue limits is rejected with 503 and a Retry-After header
+ * instead of growing the queues, so latency stays bounded under overload.
+ *
+ * POSIX sockets only; start() fails on other platforms.
+ */
+class InferenceServer {
+public:
+    /**
+     * @brief Constructor
+     * @param snapshot Model to serve
+     * @param config Server options
+     */
+    explicit InferenceServer(
+        std::shared_ptr<const ModelSnapshot> snapshot,
+        const ServerConfig& config = ServerConfig{}
+    );
+
+    /**
+     * @brief Destructor; stops the server if it is running
+     */
+    ~InferenceServer();
+
+    InferenceServer(const InferenceServer&) = delete;
+    InferenceServer& operator=(const InferenceServer&) = delete;
+
+    /**
+     * @brief Bind the listening socket and start serving in the background
+     * @return true if the server is listening, false otherwise
+     */
+    bool start();
+
+    /**
+     * @brief Stop accepting, finish the requests in progress and join all threads
+     */
+    void stop();
+
+    /**
+     * @brief Get the port the server listens on
+     * @return Bound port (useful when ServerConfig::port is 0), or 0 if not started
+     */
+    uint16_t getPort() const;
+
+    /**
+     * @brief Serve a new model version
+     *
+     * Batches already being scored finish on the previous snapshot.
+     *
+     * @param snapshot Model to serve from now on
+     */
+    void setSnapshot(std::shared_ptr<const ModelSnapshot> snapshot);
+
+private:
+    /**
+     * @brief Open client connection
+     */
+    struct Connection {
+        int socket = -1;
+        std::string buffer;                              ///< Received bytes of the next requests
+        std::chrono::steady_clock::time_point idleSince; ///< When it was last given back to the poll set
+    };
+
+    /**
+     * @brief Texts of one request waiting for the batching thread
+     */
+    struct PredictionJob {
+        std::vector<std::string> texts;   ///< Texts to score
+        std::vector<SentimentLabel> labels; ///< Filled by the batching thread
+        std::vector<double> scores;       ///< Log joint score of each label
+        bool done = false;                ///< Set once labels and scores are filled
+    };
+
+    ServerConfig config;
+    std::shared_ptr<const ModelSnapshot> snapshot; ///< Accessed through std::atomic_load/store
+    std::unique_ptr<ThreadPool> predictionPool;    ///< Optional pool for batch scoring
+
+    int listenSocket = -1;
+    int wakePipe[2] = {-1, -1}; ///< Written to wake the poll thread
+    uint16_t boundPort = 0;
+    std::atomic<bool> running{false}; ///< Changed under connectionMutex and jobMutex
+
+    std::thread pollThread;
+    std::thread batchThread;
+    std::vector<std::thread> connectionWorkers;
+
+    std::mutex connectionMutex;
+    std::condition_variable connectionCondition;
+    std::deque<Connection> queuedConnections;  ///< Connections with a request, waiting for a worker
+    std::vector<Connection> returnedConnections; ///< Idle connections for the poll thread to watch
+
+    std::mutex jobMutex;
+    std::condition_variable jobCondition;  ///< Wakes the batching thread
+    std::condition_variable doneCondition; ///< Wakes workers waiting for results
+    std::deque<PredictionJob*> queuedJobs;
+    size_t queuedTexts = 0; ///< Texts in queuedJobs
+
+    /**
+     * @brief Accept connections, watch idle ones and hand readable ones to the workers
+     */
+    void pollLoop();
+
+    /**
+     * @brief Queue a connection with a request for the workers, or shed it if the queue is full
+     * @param connection Connection to hand over
+     */
+    void dispatch(Connection connection);
+
+    /**
+     * @brief Serve queued connections until the server stops
+     */
+    void connectionLoop();
+
+    /**
+     * @brief Score queued jobs in coalesced batches until the server stops
+     */
+    void batchLoop();
+
+    /**
+     * @brief Read and answer one request
+     * @param connection Connection to read from; unread bytes stay in its buffer
+     * @return true if the connection stays open, false if it must be closed
+     */
+    bool serveRequest(Connection& connection);
+
+    /**
+     * @brief Score the texts of a request through the batching thread
+     * @param job Job holding the texts; receives labels and scores
+     * @return false if the queue is full or the server is stopping
+     */
+    bool submit(PredictionJob& job);
+
+    /**
+     * @brief Build the response to one request
+     * @param method Request method
+     * @param path Request target
+     * @param body Request body
+     * @param keepAlive Whether the connection stays open afterwards
+     * @return Full HTTP response
+     */
+    std::string handleRequest(
+        const std::string& method,
+        const std::string& path,
+        const std::string& body,
+        bool keepAlive
+    );
+};
+
+} // namespace sentiment
+
+#endif // INFERENCE_SERVER_H
@@ -0,0 +1,232 @@
+#ifndef LINEAR_MODEL_H
+#define LINEAR_MODEL_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "model.h"
+#include "sparse_kernels.h"
+#include "thread_pool.h"
+
+namespace sentiment {
+
+/**
+ * @brief Options of the stochastic gradient descent trainer
+ */
+struct SgdOptions {
+    size_t epochs = 10;          // Passes over the training data
+    size_t batchSize = 32;       // Examples per mini-batch update
+    double learningRate = 0.1;   // Step size of the first epoch, then rate / (1 + epoch)
+    double l2 = 1e-5;            // L2 penalty on the weights a mini-batch touches
+    uint64_t seed = 42;          // Seed of the per-epoch shuffle
+};
+
+/**
+ * @brief Multiclass linear classifier trained with parallel SGD
+ *
+ * Every class lane scores bias + w . x. Weights are kept in a dense
+ * feature-major matrix like the Naive Bayes parameters, so prediction uses
+ * the same sparse row kernel: one pass over the nonzero features updates
+ * all class scores at once. Unlike Naive Bayes, negative feature values
+ * (e.g. from signed hashing) are used as they are.
+ *
+ * Training shuffles the examples every epoch and splits them across the
+ * thread pool. Workers update the shared weights without locks
+ * (Hogwild): each mini-batch computes its gradients from the current
+ * weights and writes the affected rows back with relaxed atomic stores, so
+ * concurrent updates to the same row may overwrite each other. With sparse
+ * text features collisions are rare and do not hurt convergence. One
+ * thread gives the same model for the same seed every time.
+ *
+ * Subclasses choose the loss through lossGradient().
+ */
+class LinearModel : public Model {
+public:
+    /// Number of class lanes per weight row
+    static constexpr size_t kClassStride = kKernelLanes;
+
+    /**
+     * @brief Constructor
+     * @param options Trainer options
+     */
+    explicit LinearModel(const SgdOptions& options = SgdOptions{});
+
+    /**
+     * @brief Train the model with mini-batch SGD
+     * @param trainingData Vector of training examples (feature vectors with labels)
+     * @return true if training was successful, false otherwise
+     */
+    bool train(const std::vector<FeatureVector>& trainingData) override;
+
+    using Model::predict;
+
+    /**
+     * @brief Predict sentiment for a feature vector
+     * @param features Input feature vector
+     * @return Label of the class lane with the highest score
+     */
+    SentimentLabel predict(const SparseVector& features) const override;
+
+    /**
+     * @brief Predict sentiment for a batch of feature vectors
+     * @param documents Pointer to count feature vectors
+     * @param count Number of documents
+     * @param labels Receives count predicted labels
+     * @param scores Optional; receives the linear score of each predicted label
+     */
+    void predictBatch(
+        const SparseVector* documents,
+        size_t count,
+        SentimentLabel* labels,
+        double* scores = nullptr
+    ) const override;
+
+    /**
+     * @brief Predict sentiment for a batch of labelled examples
+     * @param examples Pointer to count examples
+     * @param count Number of examples
+     * @param labels Receives count predicted labels
+     * @param scores Optional; receives the linear score of each predicted label
+     */
+    void predictBatch(
+        const FeatureVector* examples,
+        size_t count,
+        SentimentLabel* labels,
+        double* scores = nullptr
+    ) const override;
+
+    /**
+     * @brief Check if the model is trained
+     * @return true if the model is trained, false otherwise
+     */
+    bool isTrained() const override;
+
+    /**
+     * @brief Get the labels seen during training, sorted by enum value
+     * @return Vector of class labels in lane order
+     */
+    const std::vector<SentimentLabel>& getClassLabels() const;
+
+    /**
+     * @brief Get the feature-major weight matrix
+     *
+     * Entry [feature * kClassStride + lane] is the weight of the feature
+     * for the class lane.
+     *
+     * @return Matrix of getFeatureCount() * kClassStride values
+     */
+    const ConstArray<double>& getWeights() const;
+
+    /**
+     * @brief Get the bias of every class lane
+     * @return kClassStride biases (padding lanes are 0)
+     */
+    const ConstArray<double>& getBiases() const;
+
+    /**
+     * @brief Get the number of features the model was trained with
+     * @return Feature count
+     */
+    size_t getFeatureCount() const;
+
+    /**
+     * @brief Get the trainer options
+     * @return Options
+     */
+    const SgdOptions& getOptions() const;
+
+    /**
+     * @brief Get the mean loss of the last training epoch
+     * @return Mean loss per example (0 before training)
+     */
+    double getTrainingLoss() const;
+
+    /**
+     * @brief Set the thread pool used for training
+     * @param pool Shared thread pool (nullptr to train on the calling thread)
+     */
+    void setThreadPool(std::shared_ptr<ThreadPool> pool);
+
+protected:
+    /**
+     * @brief Compute the loss of one example and its gradient
+     * @param scores Score of each trained class lane
+     * @param classes Number of trained class lanes
+     * @param target Lane of the true label
+     * @param gradient Receives d(loss)/d(score) for each lane
+     * @return Loss of the example
+     */
+    virtual double lossGradient(
+        const double* scores,
+        size_t classes,
+        size_t target,
+        double* gradient
+    ) const = 0;
+
+private:
+    SgdOptions options;
+    std::shared_ptr<ThreadPool> threadPool;
+    bool trained = false;
+    size_t featureCount = 0;
+    double trainingLoss = 0.0;
+
+    std::vector<SentimentLabel> classLabels; ///< Label of each class lane
+    ConstArray<double> weights;              ///< Feature-major weights per lane
+    ConstArray<double> biases;               ///< Bias per lane
+
+    /**
+     * @brief Score every class lane of a document
+     * @param features Input feature vector (dimension must match)
+     * @param scores Receives kClassStride scores
+     * @return Index of the best trained lane (lowest lane wins ties)
+     */
+    size_t scoreLanes(const SparseVector& features, double* scores) const;
+
+    /**
+     * @brief Score a batch of documents
+     * @param document Returns the feature vector of a document index
+     * @param count Number of documents
+     * @param labels Receives count predicted labels
+     * @param scores Optional; receives the linear score of each predicted label
+     */
+    template<typename Document>
+    void scoreBatch(Document&& document, size_t count, SentimentLabel* labels, double* scores) const;
+};
+
+/**
+ * @brief Multinomial logistic regression (softmax cross-entropy loss)
+ */
+class LogisticRegression : public LinearModel {
+public:
+    using LinearModel::LinearModel;
+
+    /**
+     * @brief Get model name
+     * @return String "Logistic Regression"
+     */
+    std::string getName() const override;
+
+protected:
+    double lossGradient(const double* scores, size_t classes, size_t target, double* gradient) const override;
+};
+
+/**
+ * @brief Multiclass linear SVM (Crammer-Singer hinge loss)
+ */
+class LinearSVM : public LinearModel {
+public:
+    using LinearModel::LinearModel;
+
+    /**
+     * @brief Get model name
+     * @return String "Linear SVM"
+     */
+    std::string getName() const override;
+
+protected:
+    double lossGradient(const double* scores, size_t classes, size_t target, double* gradient) const override;
+};
+
+} // namespace sentiment
+
+#endif // LINEAR_MODEL_H
@@ -0,0 +1,65 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace sentiment {
+
+/**
+ * @brief Read-only memory mapping of a whole file
+ *
+ * Pages are loaded on demand by the operating system and shared between
+ * all processes that map the same file.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    /**
+     * @brief Destructor; unmaps the file
+     */
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Map a file into memory
+     * @param filePath Path of the file to map
+     * @return true if the file was mapped, false otherwise
+     */
+    bool open(const std::string& filePath);
+
+    /**
+     * @brief Hint that the mapping will be read front to back
+     *
+     * Lets the operating system read ahead aggressively and drop pages
+     * behind the reader, which suits one pass over a large data file.
+     */
+    void adviseSequential() const;
+
+    /**
+     * @brief Get the start of the mapped bytes
+     * @return Pointer to the first byte, or nullptr if nothing is mapped
+     */
+    const char* data() const;
+
+    /**
+     * @brief Get the number of mapped bytes
+     * @return File size in bytes
+     */
+    size_t size() const;
+
+private:
+    const char* bytes = nullptr; ///< Start of the mapping
+    size_t length = 0;           ///< Length of the mapping
+#ifdef _WIN32
+    void* fileHandle = nullptr;    ///< Win32 file handle
+    void* mappingHandle = nullptr; ///< Win32 file mapping handle
+#endif
+};
+
+} // namespace sentiment
+
+#endif // MAPPED_FILE_H
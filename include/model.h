@@ -1,6 +1,7 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include <limits>
 #include <vector>
 #include "utils.h"
 
@@ -26,11 +27,74 @@ public:
     virtual bool train(const std::vector<FeatureVector>& trainingData) = 0;
 
     /**
-     * @brief Predict sentiment label for a feature vector
+     * @brief Predict sentiment label for a sparse feature vector
+     * @param features Input feature vector (nonzero entries only)
+     * @return Predicted SentimentLabel
+     */
+    virtual SentimentLabel predict(const SparseVector& features) const = 0;
+
+    /**
+     * @brief Predict sentiment label for a dense feature vector
+     *
+     * Convenience overload that converts to the sparse representation.
+     *
      * @param features Input feature vector
      * @return Predicted SentimentLabel
      */
-    virtual SentimentLabel predict(const std::vector<double>& features) const = 0;
+    SentimentLabel predict(const std::vector<double>& features) const {
+        return predict(toSparse(features));
+    }
+
+    /**
+     * @brief Predict sentiment labels for a batch of feature vectors
+     *
+     * Results are written to caller-provided buffers. The default
+     * implementation calls predict() for each document and reports NaN
+     * scores; models with a vectorized scoring path override it.
+     *
+     * @param documents Pointer to count feature vectors
+     * @param count Number of documents
+     * @param labels Receives count predicted labels
+     * @param scores Optional; receives count scores of the predicted labels
+     */
+    virtual void predictBatch(
+        const SparseVector* documents,
+        size_t count,
+        SentimentLabel* labels,
+        double* scores = nullptr
+    ) const {
+        for (size_t i = 0; i < count; ++i) {
+            labels[i] = predict(documents[i]);
+            if (scores) {
+                scores[i] = std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+    }
+
+    /**
+     * @brief Predict sentiment labels for a batch of labelled examples
+     *
+     * Scores the features of each example in place, so labelled data can
+     * take the batch path without copying the vectors out first.
+     *
+     * @param examples Pointer to count examples
+     * @param count Number of examples
+     * @param labels Receives count predicted labels
+     * @param scores Optional; receives count scores of the predicted labels
+     */
+    virtual void predictBatch(
+        const FeatureVector* examples,
+        size_t count,
+        SentimentLabel* labels,
+        double* scores = nullptr
+    ) const {
+        for (size_t i = 0; i < count; ++i) {
+            labels[i] = predict(examples[i].features);
+            if (scores) {
+                scores[i] = std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+    }
 
     /**
      * @brief Check if the model is trained
@@ -0,0 +1,55 @@
+#ifndef MODEL_IO_H
+#define MODEL_IO_H
+
+#include <string>
+#include "feature_extractor.h"
+#include "mapped_file.h"
+#include "naive_bayes.h"
+
+namespace sentiment {
+
+/**
+ * @brief Write a trained pipeline to a binary model file
+ *
+ * The file starts with a fixed header (magic, format version and section
+ * offsets, n-gram range, feature hashing and TF-IDF options) followed by 64-byte aligned
+ * sections holding the vocabulary index, the document frequency table, the class labels and log-priors,
+ * and the feature-major log-likelihood matrix. Values are stored in native
+ * byte order so the sections can be used in place after mapping.
+ *
+ * @param filePath Path of the model file to write
+ * @param featureExtractor Feature extractor with a built vocabulary
+ * @param model Trained Naive Bayes model
+ * @param useStopWords Whether the preprocessor removed stop words
+ * @return true if the file was written, false otherwise
+ */
+bool saveModelFile(
+    const std::string& filePath,
+    const FeatureExtractor& featureExtractor,
+    const NaiveBayes& model,
+    bool useStopWords
+);
+
+/**
+ * @brief Load a binary model file written by saveModelFile
+ *
+ * The file is memory-mapped; the vocabulary, document frequency and
+ * model parameter tables are used in place and stay valid for as long as
+ * the extractor and model hold them.
+ *
+ * @param filePath Path of the model file
+ * @param featureExtractor Feature extractor to receive the vocabulary
+ * @param model Model to receive the trained parameters
+ * @param useStopWords Receives whether the model was trained with stop word removal
+ * @return true if the model was loaded, false otherwise
+ */
+bool loadModelFile(
+    const std::string& filePath,
+    FeatureExtractor& featureExtractor,
+    NaiveBayes& model,
+    bool& useStopWords
+);
+
+} // namespace sentiment
+
+#endif // MODEL_IO_H
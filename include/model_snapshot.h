@@ -0,0 +1,143 @@
+#ifndef MODEL_SNAPSHOT_H
+#define MODEL_SNAPSHOT_H
+
+#include <string>
+#include <string_view>
+#include "feature_extractor.h"
+#include "inference_context.h"
+#include "naive_bayes.h"
+#include "preprocessor.h"
+#include "thread_pool.h"
+
+namespace sentiment {
+
+/**
+ * @brief Frozen copy of a trained pipeline for concurrent prediction
+ *
+ * A snapshot owns its own preprocessor, feature extractor and model, and
+ * none of them change after construction, so any number of threads may
+ * predict against one snapshot without locking. The vocabulary and
+ * parameter tables are immutable ConstArrays shared with the source
+ * extractor and model (or with a mapped model file), so taking a snapshot
+ * copies no per-term or per-feature data. Training counts are not carried
+ * over. Each thread needs its own InferenceContext.
+ */
+class ModelSnapshot {
+public:
+    /**
+     * @brief Capture the inference state of a trained pipeline
+     *
+     * With TF-IDF features (and no L2 normalization) the IDF weights are
+     * folded into the snapshot's copy of the log-likelihood matrix, so
+     * extraction skips them and scores cost the same as bag-of-words.
+     *
+     * @param sourceExtractor Feature extractor with a built or loaded vocabulary
+     * @param sourceModel Trained model
+     * @param useStopWords Whether the preprocessor removes stop words
+     * @param precision Storage of the snapshot's parameters when the source
+     *        model keeps them as FLOAT64
+     */
+    ModelSnapshot(
+        const FeatureExtractor& sourceExtractor,
+        const NaiveBayes& sourceModel,
+        bool useStopWords,
+        NaiveBayes::Precision precision = NaiveBayes::Precision::FLOAT64
+    );
+
+    // The extractor refers to the preprocessor member
+    ModelSnapshot(const ModelSnapshot&) = delete;
+    ModelSnapshot& operator=(const ModelSnapshot&) = delete;
+
+    /**
+     * @brief Predict the sentiment of a text
+     * @param text Input text
+     * @param context Scratch storage owned by the calling thread
+     * @return Predicted label
+     */
+    SentimentLabel predict(std::string_view text, InferenceContext& context) const;
+
+    /**
+     * @brief Predict a text and report its per-class scores
+     * @param text Input text
+     * @param context Scratch storage owned by the calling thread
+     * @param logJointScores Optional; receives kClassStride log joint scores
+     * @param probabilities Optional; receives kClassStride posterior probabilities
+     * @return Predicted label
+     */
+    SentimentLabel predictScores(
+        std::string_view text,
+        InferenceContext& context,
+        double* logJointScores,
+        double* probabilities
+    ) const;
+
+    /**
+     * @brief Predict a batch of texts through the vectorized batch path
+     * @param texts Pointer to count input texts
+     * @param count Number of texts
+     * @param labels Receives count predicted labels
+     * @param scores Optional; receives count log joint probabilities of the predicted labels
+     * @param pool Optional pool to spread the batch over; if it is busy with
+     *             another loop the batch is scored on the calling thread
+     */
+    void predictBatch(
+        const std::string* texts,
+        size_t count,
+        SentimentLabel* labels,
+        double* scores,
+        ThreadPool* pool = nullptr
+    ) const;
+
+    /**
+     * @brief Predict a batch of borrowed texts through the vectorized batch path
+     *
+     * Lets callers score a subset of their texts without copying them.
+     *
+     * @param texts Pointer to count views of the input texts
+     * @param count Number of texts
+     * @param labels Receives count predicted labels
+     * @param scores Optional; receives count log joint probabilities of the predicted labels
+     * @param pool Optional pool to spread the batch over; if it is busy with
+     *             another loop the batch is scored on the calling thread
+     */
+    void predictBatch(
+        const std::string_view* texts,
+        size_t count,
+        SentimentLabel* labels,
+        double* scores,
+        ThreadPool* pool = nullptr
+    ) const;
+
+    /**
+     * @brief Get the frozen feature extractor
+     * @return Feature extractor of the snapshot
+     */
+    const FeatureExtractor& getFeatureExtractor() const;
+
+    /**
+     * @brief Get the frozen model
+     * @return Model of the snapshot
+     */
+    const NaiveBayes& getModel() const;
+
+private:
+    Preprocessor preprocessor;         ///< Preprocessor used by featureExtractor
+    FeatureExtractor featureExtractor; ///< Vocabulary and feature options
+    NaiveBayes model;                  ///< Trained parameters
+
+    /**
+     * @brief Extract and score a batch of texts chunk by chunk
+     * @param texts Pointer to count texts (std::string or std::string_view)
+     * @param count Number of texts
+     * @param labels Receives count predicted labels
+     * @param scores Optional; receives count log joint probabilities
+     * @param pool Optional pool to spread the batch over
+     */
+    template<typename Text>
+    void scoreBatch(const Text* texts, size_t count, SentimentLabel* labels, double* scores,
+                    ThreadPool* pool) const;
+};
+
+} // namespace sentiment
+
+#endif // MODEL_SNAPSHOT_H
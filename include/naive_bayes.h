@@ -1,9 +1,12 @@
 #ifndef NAIVE_BAYES_H
 #define NAIVE_BAYES_H
 
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
-#include <unordered_map>
 #include "model.h"
+#include "thread_pool.h"
 
 namespace sentiment {
 
@@ -12,9 +15,38 @@ namespace sentiment {
  *
  * Implements a Multinomial Naive Bayes classifier which is well-suited
  * for text classification, especially with bag-of-words features.
+ *
+ * Parameters are kept in one dense feature-major matrix: the row of a
+ * feature holds log(P(feature|class)) for every class side by side, padded
+ * to a multiple of kClassStride lanes. Scoring a document is a single pass
+ * over its nonzero features that updates all class scores at once.
+ *
+ * Classes are either SentimentLabel values (train()) or arbitrary class
+ * names (trainClasses()), which are mapped to dense class ids so both use
+ * the same scoring path.
  */
 class NaiveBayes : public Model {
 public:
+    /// Class lanes per SIMD block; rows hold a multiple of this many lanes
+    static constexpr size_t kClassStride = 4;
+
+    /// Returned by predictClass() when a document cannot be scored
+    static constexpr size_t kNoClass = static_cast<size_t>(-1);
+
+    /**
+     * @brief Storage format of the log-likelihood matrix
+     *
+     * The compact formats score into float lanes. The integer formats store
+     * each class lane as offset + scale * q, with the offset and scale
+     * chosen per class to span that class's log-likelihoods.
+     */
+    enum class Precision {
+        FLOAT64, ///< double; exact, and required for saving the model
+        FLOAT32, ///< float; half the memory of FLOAT64
+        INT16,   ///< 16-bit integers with a per-class scale and offset
+        INT8     ///< 8-bit integers with a per-class scale and offset
+    };
+
     /**
      * @brief Constructor
      * @param alpha Laplace smoothing parameter (default: 1.0)
@@ -32,16 +64,185 @@ public:
      */
     bool train(const std::vector<FeatureVector>& trainingData) override;
 
+    /**
+     * @brief Train the model on documents labeled with class names
+     *
+     * The distinct names are sorted and become class ids 0..n-1, which are
+     * also the class lanes of the parameter matrix. getClassLabels() maps
+     * names such as "positive" to their SentimentLabel and every other
+     * name to UNKNOWN; use predictClass() and getClassNames() for the
+     * names themselves. Models trained this way keep no counts for
+     * partialFit().
+     *
+     * @param documents Feature vectors (all of the same dimension)
+     * @param classNames Class name of each document
+     * @return true if training was successful, false otherwise
+     */
+    bool trainClasses(
+        const std::vector<SparseVector>& documents,
+        const std::vector<std::string>& classNames
+    );
+
+    /**
+     * @brief Discard the sufficient statistics accumulated so far
+     */
+    void resetCounts();
+
+    /**
+     * @brief Add a chunk of training examples to the sufficient statistics
+     *
+     * Naive Bayes only needs per-class feature sums and example counts, so
+     * a model can be trained on data that arrives in chunks. The first
+     * chunk after resetCounts() fixes the feature dimension.
+     *
+     * @param trainingData Chunk of training examples
+     * @return true if the chunk was counted, false on a dimension mismatch
+     */
+    bool accumulateCounts(const std::vector<FeatureVector>& trainingData);
+
+    /**
+     * @brief Compute the model parameters from the accumulated statistics
+     *
+     * Produces the same model as train() on all chunks counted since the
+     * last resetCounts(). The statistics are kept, so more chunks can be
+     * added and the model finalized again.
+     *
+     * @return true if at least one example was counted, false otherwise
+     */
+    bool finalizeCounts();
+
+    /**
+     * @brief Update a trained model with a batch of new examples
+     *
+     * Adds the batch to the counts kept since the last train() and
+     * recomputes the parameters from them, so the result is the same as
+     * retraining on all examples seen so far. The batch may have a larger
+     * feature dimension than earlier data (a grown vocabulary); features
+     * that did not exist before count as unseen in earlier examples.
+     *
+     * Models loaded with setParameters() have no counts and cannot be
+     * updated.
+     *
+     * @param batch New training examples
+     * @return true if the model was updated, false otherwise
+     */
+    bool partialFit(const std::vector<FeatureVector>& batch);
+
+    /**
+     * @brief Check whether the model keeps the counts partialFit() needs
+     * @return true if the model was trained (not loaded) in this process
+     */
+    bool hasTrainingCounts() const;
+
+    /**
+     * @brief Set the thread pool used for training
+     *
+     * Large batches are split into one contiguous range per thread. Each
+     * range sums its sparse feature values into its own class-by-feature
+     * buffer, the buffers are added up in range order, and the
+     * log-likelihoods are computed in parallel blocks of rows. Counts are
+     * exact for whole-number features such as bag-of-words; fractional
+     * sums (TF-IDF) can differ in the last bits between thread counts.
+     *
+     * @param pool Shared thread pool (nullptr to train on the calling thread)
+     */
+    void setThreadPool(std::shared_ptr<ThreadPool> pool);
+
+    using Model::predict;
+
     /**
      * @brief Predict sentiment for a feature vector
      *
      * Uses the Naive Bayes formula:
      * P(class|features) ∝ P(class) * ∏ P(feature_i|class)
      *
+     * Only the nonzero entries of the vector are visited.
+     *
+     * @param features Input feature vector
+     * @return Predicted sentiment label
+     */
+    SentimentLabel predict(const SparseVector& features) const override;
+
+    /**
+     * @brief Predict sentiment and per-class scores in a single scoring pass
+     *
+     * Probabilities are obtained from the log joint scores with the
+     * log-sum-exp trick, so they are calibrated Naive Bayes posteriors
+     * that sum to one and do not underflow for long documents. Both output
+     * arrays hold getClassCount() values indexed like getClassLabels().
+     *
      * @param features Input feature vector
+     * @param logJointScores Optional; receives log(P(class) * P(features|class))
+     * @param probabilities Optional; receives P(class|features)
      * @return Predicted sentiment label
      */
-    SentimentLabel predict(const std::vector<double>& features) const override;
+    SentimentLabel predictScores(
+        const SparseVector& features,
+        double* logJointScores,
+        double* probabilities
+    ) const;
+
+    /**
+     * @brief Predict sentiment for a batch of feature vectors
+     *
+     * Scores the batch as a sparse (documents x features) by dense
+     * (features x classes) matrix product. Each nonzero feature adds one
+     * matrix row to the document's class scores with a single 4-lane
+     * fused multiply-add when the CPU supports AVX2, and a portable scalar
+     * loop otherwise.
+     *
+     * @param documents Pointer to count feature vectors
+     * @param count Number of documents
+     * @param labels Receives count predicted labels
+     * @param scores Optional; receives the log joint probability of each predicted label
+     */
+    void predictBatch(
+        const SparseVector* documents,
+        size_t count,
+        SentimentLabel* labels,
+        double* scores = nullptr
+    ) const override;
+
+    /**
+     * @brief Predict sentiment for a batch of labelled examples
+     *
+     * Uses the same scoring path as the SparseVector overload.
+     *
+     * @param examples Pointer to count examples
+     * @param count Number of examples
+     * @param labels Receives count predicted labels
+     * @param scores Optional; receives the log joint probability of each predicted label
+     */
+    void predictBatch(
+        const FeatureVector* examples,
+        size_t count,
+        SentimentLabel* labels,
+        double* scores = nullptr
+    ) const override;
+
+    /**
+     * @brief Predict the class id of a feature vector
+     * @param features Input feature vector
+     * @return Index into getClassNames(), or kNoClass on error
+     */
+    size_t predictClass(const SparseVector& features) const;
+
+    /**
+     * @brief Predict the class ids of a batch of feature vectors
+     *
+     * Uses the same scoring path as predictBatch().
+     *
+     * @param documents Pointer to count feature vectors
+     * @param count Number of documents
+     * @param classes Receives count class ids (kNoClass on error)
+     * @param scores Optional; receives the log joint probability of each predicted class
+     */
+    void predictClassBatch(
+        const SparseVector* documents,
+        size_t count,
+        size_t* classes,
+        double* scores = nullptr
+    ) const;
 
     /**
      * @brief Check if the model is trained
@@ -55,19 +256,213 @@ public:
      */
     std::string getName() const override;
 
+    /**
+     * @brief Get the labels seen during training, sorted by enum value
+     *
+     * The position of a label in this vector is its class lane in the
+     * parameter matrix.
+     *
+     * @return Vector of class labels
+     */
+    const std::vector<SentimentLabel>& getClassLabels() const;
+
+    /**
+     * @brief Get the name of every class lane
+     *
+     * Models trained on SentimentLabel values name their classes with
+     * sentimentToString().
+     *
+     * @return Vector of class names in lane order
+     */
+    const std::vector<std::string>& getClassNames() const;
+
+    /**
+     * @brief Get the number of trained classes
+     * @return Class count
+     */
+    size_t getClassCount() const;
+
+    /**
+     * @brief Get the number of lanes in every matrix row
+     * @return getClassCount() rounded up to a multiple of kClassStride
+     */
+    size_t getClassStride() const;
+
+    /**
+     * @brief Get log(P(class)) for every class lane
+     * @return getClassStride() log-priors (padding lanes are -infinity)
+     */
+    const ConstArray<double>& getLogPriors() const;
+
+    /**
+     * @brief Get the feature-major log-likelihood matrix
+     *
+     * Entry [feature * getClassStride() + lane] holds log(P(feature|class)).
+     *
+     * @return Matrix of getFeatureCount() * getClassStride() values (empty
+     *         when the parameters are stored at a compact precision)
+     */
+    const ConstArray<double>& getLogLikelihoodMatrix() const;
+
+    /**
+     * @brief Choose how the log-likelihood matrix is stored
+     *
+     * Converts the current parameters and releases the double matrix, so
+     * getLogLikelihoodMatrix() is empty afterwards. The precision sticks:
+     * later training, partialFit() and setParameters() convert their
+     * result too. Once converted, a model cannot return to a different
+     * precision until it is retrained or its parameters are replaced.
+     *
+     * @param precision Storage format
+     * @return true if the parameters are stored at that precision, false otherwise
+     */
+    bool setPrecision(Precision precision);
+
+    /**
+     * @brief Get the storage format of the log-likelihood matrix
+     * @return Current precision
+     */
+    Precision getPrecision() const;
+
+    /**
+     * @brief Get the memory used by the log-likelihood matrix
+     * @return Size of the matrix in bytes at the current precision
+     */
+    size_t getParameterBytes() const;
+
+    /**
+     * @brief Share the parameters of another model without copying them
+     *
+     * Takes the labels, priors and likelihood tables (at whatever
+     * precision they are stored) of a trained model. Training counts are
+     * not shared, so the result cannot be updated with partialFit().
+     *
+     * @param source Model to share parameters with
+     */
+    void shareParameters(const NaiveBayes& source);
+
+    /**
+     * @brief Fold per-feature input weights into the log-likelihood rows
+     *
+     * Multiplies row f of the matrix by scales[f]. Scoring a vector then
+     * gives the same result as scoring it with every value multiplied by
+     * its feature's weight, so a weight such as the TF-IDF inverse
+     * document frequency is applied once here instead of once per
+     * document. Meant for a served copy of the model (see
+     * shareParameters): the training counts are dropped, and the
+     * parameters must still be stored as FLOAT64.
+     *
+     * @param scales Non-negative weight per feature (getFeatureCount() values)
+     * @return true if the weights were folded in, false otherwise
+     */
+    bool scaleFeatures(const ConstArray<double>& scales);
+
+    /**
+     * @brief Get the number of features the model was trained with
+     * @return Feature count
+     */
+    size_t getFeatureCount() const;
+
+    /**
+     * @brief Get the Laplace smoothing parameter
+     * @return Alpha
+     */
+    double getAlpha() const;
+
+    /**
+     * @brief Set the Laplace smoothing parameter used by later training
+     * and partialFit(), e.g. the alpha a saved model was trained with
+     * @param value Alpha (positive)
+     */
+    void setAlpha(double value);
+
+    /**
+     * @brief Replace the model parameters, e.g. with values from a saved model
+     *
+     * The arrays are used in place, so parameters borrowed from a
+     * memory-mapped file are not copied.
+     *
+     * @param labels Class labels in lane order (at most kClassStride)
+     * @param logPriors kClassStride log-priors
+     * @param likelihoods Feature-major log-likelihood matrix
+     * @param features Number of features
+     * @return true if the parameters are consistent, false otherwise
+     */
+    bool setParameters(
+        const std::vector<SentimentLabel>& labels,
+        ConstArray<double> logPriors,
+        ConstArray<double> likelihoods,
+        size_t features
+    );
+
 private:
     double alpha; ///< Laplace smoothing parameter
+    std::shared_ptr<ThreadPool> threadPool; ///< Optional pool for training
     bool trained = false; ///< Whether the model has been trained
     size_t featureCount = 0; ///< Number of features
 
-    // Priors: P(class)
-    std::unordered_map<SentimentLabel, double> classPriors;
+    size_t classStride = kClassStride;       ///< Lanes per matrix row
+    std::vector<SentimentLabel> classLabels; ///< Label of each class lane
+    std::vector<std::string> classNames;     ///< Name of each class lane
+    ConstArray<double> classLogPriors;       ///< log(P(class)) per lane
+    ConstArray<double> logLikelihoods;       ///< Feature-major log(P(feature|class))
+
+    // Compact storage of the log-likelihoods (see Precision)
+    Precision precision = Precision::FLOAT64;   ///< Format used for scoring
+    ConstArray<float> floatLikelihoods;         ///< FLOAT32 matrix
+    ConstArray<int16_t> int16Likelihoods;       ///< INT16 matrix
+    ConstArray<int8_t> int8Likelihoods;         ///< INT8 matrix
+    std::vector<double> laneOffsets;            ///< Value of q = 0 per lane
+    std::vector<double> laneScales;             ///< Value of one step of q per lane
+
+    /// Number of distinct SentimentLabel values (count lanes are indexed by label)
+    static constexpr size_t kLabelCount = 4;
+
+    // Sufficient statistics for chunked training
+    size_t countDimension = 0;                        ///< Feature count of the counts
+    size_t countedExamples = 0;                       ///< Examples counted so far
+    size_t countClasses = kLabelCount;                ///< Count lanes per feature
+    std::vector<std::string> countClassNames;         ///< Name of each count lane (empty for labels)
+    std::vector<double> featureCounts;                ///< Feature-major sums per class id
+    std::vector<double> classTotals;                  ///< Sum of all feature values per class id
+    std::vector<size_t> classExamples;                ///< Number of examples per class id
+
+    /**
+     * @brief Add a batch of examples to the counts, in parallel when worthwhile
+     * @param count Number of examples (their dimensions must match)
+     * @param example Returns the features and count lane of example i
+     */
+    template<typename Example>
+    void countBatch(size_t count, Example&& example);
+
+    /**
+     * @brief Compute the log joint probability of every class lane
+     * @param features Input feature vector (dimension must match)
+     * @param scores Receives getClassStride() scores
+     */
+    void scoreLanes(const SparseVector& features, double* scores) const;
 
-    // Likelihood: log(P(feature|class))
-    std::unordered_map<SentimentLabel, std::vector<double>> logLikelihoods;
+    /**
+     * @brief Score a batch and pass the winning lane of each document on
+     * @param document Returns the feature vector of a document index
+     * @param count Number of documents
+     * @param scores Optional; receives the log joint probability of each winning lane
+     * @param emit Called with (document index, lane), lane is kNoClass on error
+     */
+    template<typename Document, typename Emit>
+    void scoreBatch(Document&& document, size_t count, double* scores, Emit&& emit) const;
 
-    // Feature sum for each class
-    std::unordered_map<SentimentLabel, double> classTotals;
+    /**
+     * @brief Convert the double matrix to the configured precision
+     */
+    void applyPrecision();
+
+    /**
+     * @brief Get the lane with the highest score among the trained classes
+     * @param scores getClassStride() lane scores
+     * @return Index of the best lane (lowest lane wins ties)
+     */
+    size_t bestLane(const double* scores) const;
 };
 
 } // namespace sentiment
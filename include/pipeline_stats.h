@@ -0,0 +1,189 @@
+#ifndef PIPELINE_STATS_H
+#define PIPELINE_STATS_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sentiment {
+
+/**
+ * @brief Pipeline stages with their own latency statistics
+ */
+enum class Stage : size_t {
+    PREPROCESS,          ///< Preprocessor::tokenizeInto (cleaning and tokenizing)
+    FEATURE_EXTRACTION,  ///< FeatureExtractor::extractFeatures after tokenizing
+    SCORING,             ///< NaiveBayes prediction, per document
+    COUNT                ///< Number of stages
+};
+
+/// Number of stages tracked
+constexpr size_t kStageCount = static_cast<size_t>(Stage::COUNT);
+
+/**
+ * @brief Get the name of a stage as used in metric labels
+ * @param stage Stage
+ * @return Lowercase stage name
+ */
+const char* stageName(Stage stage);
+
+/**
+ * @brief Aggregated counters and latency histogram of one stage
+ *
+ * The histogram is log-linear (HDR style): values below 8 ns have their
+ * own buckets and every power-of-two range above is split into 8 equal
+ * buckets, so any recorded latency lands in a bucket at most 12.5% wide.
+ */
+struct StageStats {
+    /// Number of histogram buckets (covers the full 64-bit nanosecond range)
+    static constexpr size_t kBucketCount = 496;
+
+    uint64_t count = 0;            ///< Documents processed
+    uint64_t totalNanos = 0;       ///< Total time spent in the stage
+    std::vector<uint64_t> buckets; ///< Documents per latency bucket
+
+    /**
+     * @brief Get the bucket that a latency falls into
+     * @param nanos Latency in nanoseconds
+     * @return Bucket index
+     */
+    static size_t bucketIndex(uint64_t nanos);
+
+    /**
+     * @brief Get the largest latency that falls into a bucket
+     * @param bucket Bucket index
+     * @return Inclusive upper bound in nanoseconds
+     */
+    static uint64_t bucketUpperBound(size_t bucket);
+
+    /**
+     * @brief Get the mean latency per document
+     * @return Mean in nanoseconds (0 when nothing was recorded)
+     */
+    double meanNanos() const;
+
+    /**
+     * @brief Estimate a latency percentile from the histogram
+     * @param percentile Percentile in [0, 100]
+     * @return Upper bound of the bucket holding the percentile, in nanoseconds
+     */
+    uint64_t percentileNanos(double percentile) const;
+};
+
+/**
+ * @brief Point-in-time copy of the statistics of every stage
+ */
+struct StatsSnapshot {
+    std::array<StageStats, kStageCount> stages; ///< Indexed by Stage
+
+    /**
+     * @brief Get the statistics of one stage
+     * @param stage Stage
+     * @return Statistics of the stage
+     */
+    const StageStats& operator[](Stage stage) const;
+
+    /**
+     * @brief Format the snapshot in the Prometheus text exposition format
+     *
+     * Emits the histogram sentiment_stage_duration_seconds with a stage
+     * label and cumulative buckets from 100 ns to 10 s.
+     *
+     * @return Prometheus metrics text
+     */
+    std::string toPrometheus() const;
+};
+
+/**
+ * @brief Process-wide, per-thread latency statistics of the pipeline stages
+ *
+ * Each thread records into its own counter block, so recording takes no
+ * lock and touches no cache line shared with another thread; snapshot()
+ * sums the blocks of all threads. Blocks of finished threads are kept
+ * (and reused by new threads), so no samples are lost.
+ *
+ * Building with SENTIMENT_DISABLE_STATS defined compiles the timers out,
+ * leaving no clock reads or counter updates on the hot paths;
+ * snapshot() then returns empty statistics.
+ */
+class PipelineStats {
+public:
+#ifdef SENTIMENT_DISABLE_STATS
+    static constexpr bool kEnabled = false;
+#else
+    static constexpr bool kEnabled = true;
+#endif
+
+    /**
+     * @brief Record time spent in a stage
+     * @param stage Stage
+     * @param nanos Elapsed time in nanoseconds
+     * @param items Documents processed in that time (each is recorded
+     *        with the mean latency nanos / items)
+     */
+    static void record(Stage stage, uint64_t nanos, uint64_t items = 1);
+
+    /**
+     * @brief Sum the statistics of all threads
+     * @return Snapshot of every stage
+     */
+    static StatsSnapshot snapshot();
+
+    /**
+     * @brief Clear all statistics
+     *
+     * Samples recorded concurrently with the reset may survive it.
+     */
+    static void reset();
+};
+
+/**
+ * @brief Records the lifetime of a scope as time spent in a stage
+ */
+class StageTimer {
+public:
+    /**
+     * @brief Start timing
+     * @param stage Stage to record into
+     * @param items Documents processed in the scope
+     */
+    explicit StageTimer(Stage stage, uint64_t items = 1)
+        : stage(stage), items(items), start(std::chrono::steady_clock::now()) {
+    }
+
+    ~StageTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        PipelineStats::record(stage, static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()), items);
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    Stage stage;
+    uint64_t items;
+    std::chrono::steady_clock::time_point start;
+};
+
+} // namespace sentiment
+
+#define SENTIMENT_STATS_CONCAT_(a, b) a##b
+#define SENTIMENT_STATS_CONCAT(a, b) SENTIMENT_STATS_CONCAT_(a, b)
+
+#ifdef SENTIMENT_DISABLE_STATS
+#define SENTIMENT_TIME_STAGE(stage) ((void)0)
+#define SENTIMENT_TIME_STAGE_ITEMS(stage, items) ((void)0)
+#else
+/// Time the rest of the enclosing scope as one document in a stage
+#define SENTIMENT_TIME_STAGE(stage) \
+    ::sentiment::StageTimer SENTIMENT_STATS_CONCAT(stageTimer, __LINE__)(stage)
+/// Time the rest of the enclosing scope as items documents in a stage
+#define SENTIMENT_TIME_STAGE_ITEMS(stage, items) \
+    ::sentiment::StageTimer SENTIMENT_STATS_CONCAT(stageTimer, __LINE__)(stage, items)
+#endif
+
+#endif // PIPELINE_STATS_H
@@ -0,0 +1,142 @@
+#ifndef PREDICTION_CACHE_H
+#define PREDICTION_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "utils.h"
+
+namespace sentiment {
+
+/**
+ * @brief Counters of a PredictionCache
+ */
+struct PredictionCacheStats {
+    uint64_t hits = 0;       ///< Lookups that found a prediction
+    uint64_t misses = 0;     ///< Lookups that did not
+    uint64_t insertions = 0; ///< Predictions stored
+    uint64_t evictions = 0;  ///< Valid entries replaced to make room
+    size_t capacity = 0;     ///< Maximum number of entries (0 when disabled)
+
+    /**
+     * @brief Get the share of lookups that were hits
+     * @return Hit rate between 0 and 1 (0 before the first lookup)
+     */
+    double hitRate() const {
+        uint64_t lookups = hits + misses;
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+    }
+};
+
+/**
+ * @brief Bounded, thread-safe cache of predictions keyed by a text hash
+ *
+ * Entries live in fixed arrays allocated once. The cache is split into
+ * shards with a mutex each, so threads predicting different texts rarely
+ * contend. Within a shard a key maps to one set of kWays entries. A full
+ * set evicts with the CLOCK policy: every hit marks its entry as
+ * referenced, and the set's hand skips (and unmarks) referenced entries.
+ *
+ * invalidate() empties the cache in constant time by starting a new
+ * generation; entries of older generations are treated as free. Callers
+ * read generation() before they start a prediction and pass it to
+ * insert(), so a prediction made with a model that was replaced meanwhile
+ * is never served.
+ *
+ * Keys are 64-bit hashes, so two distinct texts collide with probability
+ * about n^2 / 2^64 for n cached texts.
+ */
+class PredictionCache {
+public:
+    /// Entries per set
+    static constexpr size_t kWays = 8;
+
+    /**
+     * @brief Constructor
+     * @param capacity Maximum number of entries (rounded up to whole sets)
+     * @param shards Number of independently locked shards
+     */
+    explicit PredictionCache(size_t capacity, size_t shards = 16);
+
+    /**
+     * @brief Look up a prediction
+     * @param key Hash of the text
+     * @param label Receives the cached label on a hit
+     * @param score Receives the cached log joint score on a hit
+     * @return true on a hit, false otherwise
+     */
+    bool lookup(uint64_t key, SentimentLabel& label, double& score);
+
+    /**
+     * @brief Store a prediction
+     * @param key Hash of the text
+     * @param generation Value of generation() read before the prediction started
+     * @param label Predicted label
+     * @param score Log joint score of the predicted label
+     */
+    void insert(uint64_t key, uint64_t generation, SentimentLabel label, double score);
+
+    /**
+     * @brief Get the current generation
+     * @return Generation that new entries must carry to be served
+     */
+    uint64_t generation() const;
+
+    /**
+     * @brief Drop every entry, e.g. after the model was replaced
+     */
+    void invalidate();
+
+    /**
+     * @brief Get the hit, miss and eviction counters
+     * @return Counters summed over all shards
+     */
+    PredictionCacheStats stats() const;
+
+    /**
+     * @brief Clear the counters (entries are kept)
+     */
+    void resetStats();
+
+    /**
+     * @brief Get the maximum number of entries
+     * @return Capacity after rounding to whole sets
+     */
+    size_t capacity() const;
+
+private:
+    struct Entry {
+        uint64_t key = 0;
+        uint64_t generation = 0; ///< 0 marks an entry that was never filled
+        double score = 0.0;
+        SentimentLabel label = SentimentLabel::UNKNOWN;
+        bool referenced = false; ///< Hit since the CLOCK hand last passed
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::vector<Entry> entries;  ///< setsPerShard * kWays entries
+        std::vector<uint8_t> hands;  ///< CLOCK hand of every set
+        PredictionCacheStats counters;
+    };
+
+    size_t setsPerShard = 1;
+    size_t shardCount = 1;
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<uint64_t> currentGeneration{1};
+
+    /**
+     * @brief Get the shard and first entry of the set a key maps to
+     * @param key Hash of the text
+     * @param set Receives the index of the set's first entry
+     * @return Shard holding the set
+     */
+    Shard& locate(uint64_t key, size_t& set) const;
+};
+
+} // namespace sentiment
+
+#endif // PREDICTION_CACHE_H
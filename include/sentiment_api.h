@@ -12,9 +12,16 @@
  */
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include "cross_validation.h"
+#include "evaluator.h"
+#include "feature_extractor.h"
+#include "naive_bayes.h"
+#include "pipeline_stats.h"
+#include "prediction_cache.h"
 #include "utils.h"
 
 namespace sentiment {
@@ -28,20 +35,43 @@ struct SentimentConfig {
     FeatureExtractor::Method featureMethod = FeatureExtractor::Method::BAG_OF_WORDS;
     int minWordFrequency = 2;
     size_t maxVocabularySize = 5000;
+    unsigned hashBits = 18;      // Feature space is 2^hashBits with Method::HASHING
+    bool signedHashing = false;  // Sign trick for hashed features
+    size_t ngramMin = 1;         // Shortest n-gram used as a feature
+    size_t ngramMax = 1;         // Longest n-gram used as a feature (at most 3)
+    bool sublinearTf = false;    // TF-IDF uses 1 + log(tf) instead of the raw count
+    bool l2Normalize = false;    // TF-IDF vectors are scaled to unit length
 
     // Model options
     double naiveBayesAlpha = 1.0;  // Laplace smoothing parameter
+    NaiveBayes::Precision modelPrecision = NaiveBayes::Precision::FLOAT64;  // Storage of the model used for prediction
 
     // Training options
     double trainRatio = 0.8;  // Train/validation split ratio
+    uint64_t splitSeed = 42;  // Seed of the stratified train/validation shuffle
+
+    // Performance options
+    size_t numThreads = 1;  // Threads for vocabulary building, feature extraction, training and batch prediction (0 = all cores)
+    size_t predictionCacheSize = 0;  // Predictions cached by cleaned text (0 disables the cache)
 };
 
+class ModelSnapshot;
+
 /**
  * @brief Primary interface for sentiment analysis functionality
  *
  * This class provides a simplified API for the entire sentiment analysis
  * pipeline, encapsulating the underlying components and providing
  * methods for common tasks.
+ *
+ * Thread safety: the const prediction methods read an immutable
+ * ModelSnapshot and may be called from any number of threads at once,
+ * including while one other thread trains, updates or loads a model.
+ * Training, partialFit and loadModel publish a new snapshot
+ * with an atomic pointer swap when they succeed; predictions already in
+ * flight finish on the snapshot they started with, which is freed when
+ * the last of them returns. The non-const methods, saveModel and the
+ * metric getters must be called from one thread at a time.
  */
 class SentimentAnalyzer {
 public:
@@ -78,6 +108,88 @@ public:
      */
     bool train();
 
+    /**
+     * @brief Train the model by streaming a CSV file in fixed-size chunks
+     *
+     * Reads the file twice: once to build the vocabulary and once to
+     * accumulate the Naive Bayes statistics. Only one chunk of documents
+     * is held in memory at a time, so peak memory does not depend on the
+     * size of the file. Every row is used for training; no validation
+     * split is made, so evaluate() has no data afterwards.
+     *
+     * @param filePath Path to the CSV file
+     * @param chunkSize Number of rows per chunk
+     * @param hasHeader Whether the CSV file has a header row
+     * @param textColumn Index of the column containing text data
+     * @param labelColumn Index of the column containing sentiment labels
+     * @return true if training was successful, false otherwise
+     */
+    bool trainFromFile(
+        const std::string& filePath,
+        size_t chunkSize = 4096,
+        bool hasHeader = true,
+        int textColumn = 0,
+        int labelColumn = 1
+    );
+
+    /**
+     * @brief Update the trained model with newly labeled examples
+     *
+     * Grows the vocabulary with frequent new words from the examples and
+     * folds them into the model counts, which costs time proportional to
+     * the batch and vocabulary size instead of a full retrain. Requires a
+     * model trained in this process; loaded models have no counts.
+     *
+     * @param examples Newly labeled examples
+     * @return true if the model was updated, false otherwise
+     */
+    bool partialFit(const std::vector<TextData>& examples);
+
+    /**
+     * @brief Evaluate the model on a labeled CSV file streamed in chunks
+     *
+     * Only one chunk of documents and their sparse features is held in
+     * memory at a time, so held-out sets of any size can be evaluated.
+     * Chunks are extracted and scored on the configured threads. The
+     * results are available from getMetrics() and getConfusionMatrix().
+     *
+     * @param filePath Path to the CSV file
+     * @param chunkSize Number of rows per chunk
+     * @param hasHeader Whether the CSV file has a header row
+     * @param textColumn Index of the column containing text data
+     * @param labelColumn Index of the column containing sentiment labels
+     * @return Evaluation metrics over all rows (zero if the file cannot be read)
+     */
+    EvaluationMetrics evaluateFile(
+        const std::string& filePath,
+        size_t chunkSize = 4096,
+        bool hasHeader = true,
+        int textColumn = 0,
+        int labelColumn = 1
+    );
+
+    /**
+     * @brief Cross-validate hyperparameters on all loaded data
+     *
+     * Runs k-fold cross-validation over every combination of the grid
+     * using every row loaded by loadTrainingData(), ignoring the
+     * train/validation split. Documents are tokenized and counted once;
+     * the folds and grid points are then scored from per-fold Naive Bayes
+     * counts on the configured threads. The trained model is not changed.
+     *
+     * @param folds Number of folds
+     * @param grid Values to try; an empty list uses the configured value
+     * @param seed Seed of the fold assignment
+     * @return One result per combination, best mean accuracy first
+     *         (empty if no data is loaded, the fold count is invalid or
+     *         l2Normalize is set with TF-IDF)
+     */
+    std::vector<CrossValidationResult> crossValidate(
+        size_t folds = 5,
+        const SearchGrid& grid = SearchGrid{},
+        uint64_t seed = 42
+    ) const;
+
     /**
      * @brief Evaluate model performance on validation data
      * @return Evaluation metrics structure
@@ -91,18 +203,102 @@ public:
      */
     SentimentLabel predict(const std::string& text) const;
 
+    /**
+     * @brief Predict sentiment reusing caller-owned scratch storage
+     *
+     * Same result as predict(text). Intermediate buffers live in the
+     * context, so a caller that keeps one context per thread makes no heap
+     * allocations per prediction once the buffers have grown to fit.
+     *
+     * @param text Input text to analyze
+     * @param context Scratch storage reused across calls (one per thread)
+     * @return Predicted sentiment label
+     */
+    SentimentLabel predict(std::string_view text, InferenceContext& context) const;
+
+    /**
+     * @brief Predict sentiment for a batch of texts
+     *
+     * Documents are scored together through the model's vectorized batch
+     * path, spread over the configured worker threads. Results are written
+     * to caller-provided buffers so repeated micro-batches can reuse them.
+     *
+     * @param texts Pointer to count input texts
+     * @param count Number of texts
+     * @param labels Receives count predicted labels
+     * @param scores Optional; receives count log joint probabilities of the predicted labels
+     */
+    void predictBatch(
+        const std::string* texts,
+        size_t count,
+        SentimentLabel* labels,
+        double* scores = nullptr
+    ) const;
+
     /**
      * @brief Predict sentiment with confidence scores
      *
+     * Confidence scores are the model's posterior probabilities
+     * P(label|text), computed in the same pass as the prediction. Labels
+     * that did not occur in the training data get 0.
+     *
      * @param text Input text to analyze
-     * @return Map of sentiment labels to confidence scores (0-1)
+     * @return Map of sentiment labels to confidence scores (0-1, summing to 1)
      */
     std::unordered_map<SentimentLabel, double> predictWithConfidence(
         const std::string& text
     ) const;
 
+    /**
+     * @brief Get the snapshot that predictions currently use
+     *
+     * Holding the returned pointer pins that version of the model, so a
+     * caller can run several predictions against one consistent model
+     * while newer versions are published.
+     *
+     * @return Current snapshot, or nullptr if no model is trained or loaded
+     */
+    std::shared_ptr<const ModelSnapshot> getSnapshot() const;
+
+    /**
+     * @brief Get per-stage latency statistics
+     *
+     * Counts and latency histograms of preprocessing, feature extraction
+     * and scoring, summed over all threads of the process (the counters
+     * are process-wide, so they include every analyzer). Use
+     * toPrometheus() on the result to export it. Empty when the library
+     * is built with SENTIMENT_DISABLE_STATS.
+     *
+     * @return Snapshot of the statistics
+     */
+    StatsSnapshot stats() const;
+
+    /**
+     * @brief Get the counters of the prediction cache
+     *
+     * With config.predictionCacheSize > 0, predict() and predictBatch()
+     * look texts up by the hash of their cleaned form (see
+     * Preprocessor::hashCleanText) before running the pipeline, so
+     * repeated texts that differ only in case, punctuation or spacing
+     * skip preprocessing, feature extraction and scoring. Every new
+     * model (train, partialFit, loadModel) empties the cache.
+     * predictWithConfidence() does not use it.
+     *
+     * @return Hits, misses and evictions (all zero when the cache is disabled)
+     */
+    PredictionCacheStats predictionCacheStats() const;
+
+    /**
+     * @brief Clear the per-stage latency statistics and the cache counters
+     */
+    void resetStats();
+
     /**
      * @brief Save the trained model to a file
+     *
+     * Writes a versioned binary file with the vocabulary, document
+     * frequencies, class priors and log-likelihoods.
+     *
      * @param filePath Path to save the model
      * @return true if saving was successful, false otherwise
      */
@@ -110,6 +306,13 @@ public:
 
     /**
      * @brief Load a pre-trained model from a file
+     *
+     * The file is memory-mapped and the vocabulary tables are used in place,
+     * so loading does not allocate per term and processes that load the same
+     * file share its page-cached copy. Texts are tokenized with the stop word
+     * setting stored in the file, which replaces config.useStopWords. Data
+     * loaded for training is dropped, so evaluate() needs new data.
+     *
      * @param filePath Path to the model file
      * @return true if loading was successful, false otherwise
      */
@@ -123,10 +326,9 @@ public:
 
     /**
      * @brief Get confusion matrix from the last evaluation
-     * @return Confusion matrix as nested map
+     * @return Confusion matrix indexed by true and predicted label
      */
-    const std::unordered_map<SentimentLabel,
-          std::unordered_map<SentimentLabel, int>>& getConfusionMatrix() const;
+    const ConfusionMatrix& getConfusionMatrix() const;
 
 private:
     class Impl;
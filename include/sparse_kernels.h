@@ -0,0 +1,75 @@
+#ifndef SPARSE_KERNELS_H
+#define SPARSE_KERNELS_H
+
+#include <cstddef>
+#include "utils.h"
+
+namespace sentiment {
+
+/// Lanes per SIMD block; matrix rows passed to the kernels hold a multiple of this
+constexpr size_t kKernelLanes = 4;
+
+/**
+ * @brief Add the rows of a feature-major matrix, weighted by a sparse vector
+ *
+ * For every nonzero entry k, adds values[k] * matrix[indices[k] * stride + lane]
+ * to scores[lane] for all stride lanes. This is the scoring pass of every
+ * linear model: each nonzero feature costs one broadcast and one fused
+ * multiply-add per block of kKernelLanes lanes when the CPU supports AVX2,
+ * and a portable scalar loop otherwise. The kernel is chosen once per
+ * process.
+ *
+ * @param features Sparse input vector (indices must be below the matrix row count)
+ * @param matrix Feature-major matrix with stride lanes per row
+ * @param stride Lanes per row (a multiple of kKernelLanes)
+ * @param clampNegative Treat negative values as zero (Naive Bayes counts)
+ * @param scores Receives the stride lane sums (added to the existing values)
+ */
+void accumulateSparseRows(
+    const SparseVector& features,
+    const double* matrix,
+    size_t stride,
+    bool clampNegative,
+    double* scores
+);
+
+/**
+ * @brief Turn the term counts of a sparse vector into TF-IDF values in place
+ *
+ * Every value becomes tf * idf[indices[k]], where tf is the count itself
+ * or, with sublinearTf, 1 + log(count). With l2Normalize the vector is
+ * then scaled to unit Euclidean length. The IDF gather, the sum of
+ * squares and the scaling run on blocks of four values when the CPU
+ * supports AVX2; 1 + log(count) comes from a table for small counts.
+ * Entries whose IDF is 0 are kept as zeros.
+ *
+ * @param features Sparse vector of positive term counts (indices below 2^31)
+ * @param idf Weight per feature index, or nullptr when the model applies it
+ * @param sublinearTf Dampen repeated terms with 1 + log(count)
+ * @param l2Normalize Scale the result to unit length
+ */
+void weightTermCounts(
+    SparseVector& features,
+    const double* idf,
+    bool sublinearTf,
+    bool l2Normalize
+);
+
+/**
+ * @brief Replace every value with its natural logarithm
+ *
+ * With AVX2 four values are done at a time: the exponent is split off
+ * with integer operations and the logarithm of the mantissa comes from a
+ * rational approximation (Cephes), accurate to about one unit in the last
+ * place. A value gets the same result wherever it sits in the array.
+ * Zero, negative, subnormal and non-finite values, and CPUs without AVX2,
+ * use std::log.
+ *
+ * @param values Values to transform in place
+ * @param count Number of values
+ */
+void logValues(double* values, size_t count);
+
+} // namespace sentiment
+
+#endif // SPARSE_KERNELS_H
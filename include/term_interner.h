@@ -0,0 +1,98 @@
+#ifndef TERM_INTERNER_H
+#define TERM_INTERNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace sentiment {
+
+/**
+ * @brief Growable string interning table mapping terms to dense ids
+ *
+ * Each distinct term gets the next id (0, 1, 2, ...) the first time it is
+ * interned. Terms are copied once into a character arena and found
+ * through an open-addressing table that stores the term hashes, so a
+ * lookup hashes the term once and compares characters only on a hash
+ * match. This replaces string-keyed maps while counting, where every
+ * token would otherwise be hashed and allocated repeatedly.
+ */
+class TermInterner {
+public:
+    /// Returned by find() for terms that were never interned
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    /**
+     * @brief Get the id of a term, adding the term if it is new
+     * @param term Term to intern
+     * @param hash hashBytes(term)
+     * @return Id of the term
+     */
+    uint32_t intern(std::string_view term, uint64_t hash);
+
+    /**
+     * @brief Get the id of a term, adding the term if it is new
+     * @param term Term to intern
+     * @return Id of the term
+     */
+    uint32_t intern(std::string_view term);
+
+    /**
+     * @brief Look up the id of a term without adding it
+     * @param term Term to find
+     * @return Id of the term, or npos if it was never interned
+     */
+    uint32_t find(std::string_view term) const;
+
+    /**
+     * @brief Get the characters of an interned term
+     *
+     * The view is invalidated by the next intern() of a new term.
+     *
+     * @param id Term id (must be less than size())
+     * @return View of the term
+     */
+    std::string_view term(uint32_t id) const;
+
+    /**
+     * @brief Get the stored hash of an interned term
+     * @param id Term id (must be less than size())
+     * @return hashBytes() of the term
+     */
+    uint64_t hash(uint32_t id) const;
+
+    /**
+     * @brief Get the number of distinct terms
+     * @return Number of interned terms
+     */
+    size_t size() const;
+
+    /**
+     * @brief Remove all terms and release their storage
+     */
+    void clear();
+
+private:
+    std::vector<char> strings;     ///< Concatenated term characters
+    std::vector<uint64_t> offsets; ///< Start of each term in strings, plus end sentinel
+    std::vector<uint64_t> hashes;  ///< Hash of each term
+    std::vector<uint32_t> slots;   ///< Open-addressing table of id + 1 (0 for empty)
+
+    /**
+     * @brief Find the slot holding a term or the empty slot where it belongs
+     * @param term Term to locate
+     * @param hash Hash of the term
+     * @return Slot index (slots must not be empty)
+     */
+    size_t locate(std::string_view term, uint64_t hash) const;
+
+    /**
+     * @brief Double the slot table and reinsert every term
+     */
+    void grow();
+};
+
+} // namespace sentiment
+
+#endif // TERM_INTERNER_H
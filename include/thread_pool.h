@@ -0,0 +1,118 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sentiment {
+
+/**
+ * @brief Fixed-size pool of worker threads for data-parallel loops
+ *
+ * Workers are started once and reused across calls. Work is handed out
+ * in chunks from a shared atomic counter, so faster threads pick up more
+ * chunks and uneven documents do not leave cores idle. The calling thread
+ * takes part in the loop as worker 0.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Loop body invoked for the half-open range [begin, end)
+     *
+     * The worker argument is a stable index in [0, size()) that can be used
+     * to address per-thread scratch state.
+     */
+    using RangeFunction = std::function<void(size_t begin, size_t end, size_t worker)>;
+
+    /**
+     * @brief Constructor
+     * @param threadCount Total number of threads including the caller
+     *                    (0 to use all hardware threads)
+     */
+    explicit ThreadPool(size_t threadCount = 0);
+
+    /**
+     * @brief Destructor; stops and joins all workers
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Get the number of threads participating in parallel loops
+     * @return Worker count including the calling thread
+     */
+    size_t size() const;
+
+    /**
+     * @brief Run body over [0, count) in parallel and wait for completion
+     *
+     * Calls are serialized; a call made from inside a loop body runs
+     * inline on the current thread. The first exception thrown by the
+     * body is rethrown to the caller after all workers have finished.
+     *
+     * @param count Number of items to process
+     * @param body Function invoked for each chunk
+     * @param grainSize Items per chunk (0 to choose automatically)
+     */
+    void parallelFor(size_t count, const RangeFunction& body, size_t grainSize = 0);
+
+    /**
+     * @brief Like parallelFor(), but give up instead of waiting for another call
+     *
+     * For latency-sensitive callers such as concurrent predictions, which
+     * are better off running their work inline than queueing behind a
+     * training loop or another caller's batch.
+     *
+     * @param count Number of items to process
+     * @param body Function invoked for each chunk
+     * @param grainSize Items per chunk (0 to choose automatically)
+     * @return true if the loop ran, false if the pool was busy and nothing was run
+     */
+    bool tryParallelFor(size_t count, const RangeFunction& body, size_t grainSize = 0);
+
+private:
+    std::vector<std::thread> workers; ///< Background threads (size() - 1 of them)
+
+    std::mutex submitMutex; ///< Serializes parallelFor calls
+    std::mutex mutex;       ///< Guards the job state below
+    std::condition_variable wakeCondition; ///< Signals workers about a new job
+    std::condition_variable doneCondition; ///< Signals the caller on completion
+
+    const RangeFunction* body = nullptr; ///< Body of the current job
+    size_t count = 0;                    ///< Item count of the current job
+    size_t grainSize = 1;                ///< Chunk size of the current job
+    std::atomic<size_t> nextIndex{0};    ///< Next unclaimed item
+    size_t activeWorkers = 0;            ///< Workers still running the job
+    unsigned long long generation = 0;   ///< Incremented for every job
+    bool stopping = false;               ///< Set when the pool shuts down
+    std::exception_ptr error;            ///< First exception thrown by the body
+
+    /**
+     * @brief Hand a job to the workers, take part in it and wait (submitMutex held)
+     */
+    void runJob(size_t count, const RangeFunction& body, size_t grainSize);
+
+    /**
+     * @brief Main loop of a background worker
+     * @param worker Index of the worker
+     */
+    void workerLoop(size_t worker);
+
+    /**
+     * @brief Claim and process chunks of the current job until none remain
+     * @param worker Index of the calling worker
+     */
+    void runChunks(size_t worker);
+};
+
+} // namespace sentiment
+
+#endif // THREAD_POOL_H
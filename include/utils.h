@@ -1,13 +1,18 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
 #include <algorithm>
 #include <random>
-#include <chrono>
+#include <cmath>
+#include <stdexcept>
 
 namespace sentiment {
 
@@ -35,6 +40,132 @@ SentimentLabel stringToSentiment(const std::string& sentiment);
  */
 std::string sentimentToString(SentimentLabel label);
 
+/**
+ * @brief Fast non-cryptographic hash of a byte string (64-bit FNV-1a)
+ * @param bytes Bytes to hash
+ * @return 64-bit hash value
+ */
+inline uint64_t hashBytes(std::string_view bytes) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : bytes) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Extend the hash of a token sequence by one more token
+ *
+ * Order-sensitive, so hashes of n-grams can be rolled forward token by
+ * token from the token hashes without building the n-gram string.
+ *
+ * @param prefix Hash of the sequence so far
+ * @param next Hash of the next token
+ * @return Hash of the extended sequence
+ */
+inline uint64_t combineHashes(uint64_t prefix, uint64_t next) {
+    uint64_t hash = prefix * 0x9E3779B97F4A7C15ULL + next;
+    hash ^= hash >> 29;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/**
+ * @brief Read-only array that either owns its elements or borrows them
+ *
+ * Borrowed arrays point into external storage such as a memory-mapped
+ * model file and keep that storage alive through a shared handle, so
+ * copies of the array (and of the objects holding it) remain valid.
+ * Copying never duplicates the elements.
+ */
+template<typename T>
+class ConstArray {
+public:
+    ConstArray() = default;
+
+    /**
+     * @brief Take ownership of a vector of values
+     * @param values Elements to own
+     */
+    explicit ConstArray(std::vector<T> values) {
+        auto holder = std::make_shared<const std::vector<T>>(std::move(values));
+        ptr = holder->data();
+        count = holder->size();
+        owner = std::move(holder);
+    }
+
+    /**
+     * @brief Borrow elements from external storage
+     * @param data Pointer to the first element
+     * @param size Number of elements
+     * @param storage Handle that keeps the storage alive
+     */
+    ConstArray(const T* data, size_t size, std::shared_ptr<const void> storage)
+        : owner(std::move(storage)), ptr(data), count(size) {
+    }
+
+    const T* data() const { return ptr; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+
+private:
+    std::shared_ptr<const void> owner; ///< Keeps the elements alive
+    const T* ptr = nullptr;            ///< First element
+    size_t count = 0;                  ///< Number of elements
+};
+
+/**
+ * @brief Non-owning view of a contiguous, immutable array
+ *
+ * Lets functions accept a whole vector or a range of one without copying
+ * it. The viewed storage must outlive the span.
+ */
+template<typename T>
+class ConstSpan {
+public:
+    ConstSpan() = default;
+
+    /**
+     * @brief View count elements starting at data
+     * @param data Pointer to the first element
+     * @param size Number of elements
+     */
+    ConstSpan(const T* data, size_t size) : ptr(data), count(size) {
+    }
+
+    /**
+     * @brief View every element of a vector
+     * @param values Vector to view
+     */
+    ConstSpan(const std::vector<T>& values) : ptr(values.data()), count(values.size()) {
+    }
+
+    /**
+     * @brief View a braced list, e.g. of a call argument
+     * @param values List to view (valid until the end of the full expression)
+     */
+    ConstSpan(std::initializer_list<T> values) {
+        ptr = values.begin();
+        count = values.size();
+    }
+
+    const T* data() const { return ptr; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+
+private:
+    const T* ptr = nullptr; ///< First element
+    size_t count = 0;       ///< Number of elements
+};
+
 /**
  * @brief Container for text data with sentiment label
  */
@@ -43,11 +174,44 @@ struct TextData {
     SentimentLabel label;
 };
 
+/**
+ * @brief Sparse feature vector stored as sorted (index, value) pairs
+ *
+ * Only nonzero entries are stored, so memory grows with the number of
+ * distinct tokens in a document rather than with the vocabulary size.
+ * Indices are kept in strictly increasing order.
+ */
+struct SparseVector {
+    std::vector<uint32_t> indices; ///< Sorted indices of nonzero features
+    std::vector<double> values;    ///< Feature values aligned with indices
+    size_t dimension = 0;          ///< Logical (dense) length of the vector
+
+    /**
+     * @brief Get the number of stored (nonzero) entries
+     * @return Number of nonzero features
+     */
+    size_t nonZeroCount() const { return indices.size(); }
+};
+
+/**
+ * @brief Convert a dense vector to its sparse representation
+ * @param dense Dense feature values
+ * @return SparseVector holding the nonzero entries of dense
+ */
+SparseVector toSparse(const std::vector<double>& dense);
+
+/**
+ * @brief Expand a sparse vector to a dense vector
+ * @param sparse Sparse feature vector
+ * @return Dense vector of length sparse.dimension
+ */
+std::vector<double> toDense(const SparseVector& sparse);
+
 /**
  * @brief Container for feature vector and label
  */
 struct FeatureVector {
-    std::vector<double> features;
+    SparseVector features;
     SentimentLabel label;
 };
 
@@ -62,37 +226,87 @@ struct EvaluationMetrics {
 };
 
 /**
- * @brief Split a vector into two parts based on ratio
- * @param data Input vector to split
+ * @brief Order rows for a stratified train/validation split
+ *
+ * Rows are shuffled with the seed and each label keeps round(trainRatio *
+ * its count) rows for training, so both parts have about the label
+ * distribution of the data. Only indices are shuffled; the rows are not
+ * touched. The same data and seed always give the same split.
+ *
+ * @param data Rows with a label member
  * @param trainRatio Ratio of data to use for training (between 0 and 1)
- * @return Pair of vectors (train_data, validation_data)
+ * @param seed Seed of the shuffle
+ * @param order Receives the row indices, training rows first, each part in shuffled order
+ * @return Number of training rows at the front of order
  */
 template<typename T>
-std::pair<std::vector<T>, std::vector<T>> trainValidationSplit(
+size_t trainValidationOrder(
     const std::vector<T>& data,
-    double trainRatio = 0.8
+    double trainRatio,
+    uint64_t seed,
+    std::vector<size_t>& order
 ) {
     if (trainRatio <= 0.0 || trainRatio >= 1.0) {
         throw std::invalid_argument("Train ratio must be between 0 and 1");
     }
 
-    std::vector<T> trainData;
-    std::vector<T> validationData;
-
-    size_t trainSize = static_cast<size_t>(data.size() * trainRatio);
+    std::vector<size_t> shuffled(data.size());
+    for (size_t i = 0; i < shuffled.size(); ++i) {
+        shuffled[i] = i;
+    }
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937_64(seed));
 
-    // Create a copy of the data
-    std::vector<T> dataCopy = data;
+    // Training quota of every label
+    std::unordered_map<int, std::pair<size_t, size_t>> quotas; // label -> (rows, quota)
+    for (const auto& row : data) {
+        quotas[static_cast<int>(row.label)].first++;
+    }
+    for (auto& entry : quotas) {
+        entry.second.second = static_cast<size_t>(
+            std::llround(static_cast<double>(entry.second.first) * trainRatio));
+    }
 
-    // Shuffle the data using a random engine
-    unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-    std::shuffle(dataCopy.begin(), dataCopy.end(), std::default_random_engine(seed));
+    // The first rows of each label in shuffled order train, the rest validate
+    order.clear();
+    order.reserve(data.size());
+    std::vector<size_t> validation;
+    for (size_t index : shuffled) {
+        size_t& quota = quotas[static_cast<int>(data[index].label)].second;
+        if (quota > 0) {
+            quota--;
+            order.push_back(index);
+        } else {
+            validation.push_back(index);
+        }
+    }
 
-    // Split the data
-    trainData.insert(trainData.end(), dataCopy.begin(), dataCopy.begin() + trainSize);
-    validationData.insert(validationData.end(), dataCopy.begin() + trainSize, dataCopy.end());
+    size_t trainSize = order.size();
+    order.insert(order.end(), validation.begin(), validation.end());
+    return trainSize;
+}
 
-    return {trainData, validationData};
+/**
+ * @brief Reorder a vector in place so that element i becomes data[order[i]]
+ *
+ * Follows the cycles of the permutation with swaps, so no element is
+ * copied and no second vector of elements is allocated.
+ *
+ * @param data Vector to reorder
+ * @param order Permutation of 0 .. data.size() - 1 (consumed)
+ */
+template<typename T>
+void permuteInPlace(std::vector<T>& data, std::vector<size_t>& order) {
+    for (size_t start = 0; start < order.size(); ++start) {
+        // order[i] == i marks positions that already hold their element
+        size_t position = start;
+        while (order[position] != start) {
+            size_t source = order[position];
+            std::swap(data[position], data[source]);
+            order[position] = position;
+            position = source;
+        }
+        order[position] = position;
+    }
 }
 
 } // namespace sentiment
@@ -0,0 +1,166 @@
+#ifndef VOCABULARY_INDEX_H
+#define VOCABULARY_INDEX_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "utils.h"
+
+namespace sentiment {
+
+/**
+ * @brief Immutable term-to-index lookup table with a flat memory layout
+ *
+ * Terms are stored back to back in one character arena, addressed by an
+ * offset array in index order. Lookups go through a minimal perfect hash:
+ * the term hash picks a bucket, the bucket's pilot value picks one of
+ * size() slots, and the slot holds the index of the only term that can
+ * match together with 32 bits of that term's hash. A lookup reads one
+ * pilot and one slot, and only touches the term characters when the hash
+ * tag matches, so misses (most n-gram candidates) never compare strings.
+ * All arrays are plain contiguous data, so the index can be built in
+ * memory or used in place from a memory-mapped model file without
+ * allocating per term.
+ *
+ * Terms may be n-grams of space-separated tokens. Their slot hash is
+ * rolled from the token hashes (see termHash()), so an n-gram can be
+ * looked up from the hashes of its tokens without joining them.
+ */
+class VocabularyIndex {
+public:
+    /// Returned by find() for terms that are not in the vocabulary
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    VocabularyIndex() = default;
+
+    /**
+     * @brief Build an index that owns its storage
+     *
+     * Finding the pilots takes a few dozen hash evaluations per term.
+     * A term whose 64-bit termHash() equals that of an earlier term cannot
+     * get a slot of its own; it is left out of the hash table and looked up
+     * as out of vocabulary.
+     *
+     * @param terms Distinct terms ordered by index (terms[i] gets index i)
+     */
+    explicit VocabularyIndex(const std::vector<std::string_view>& terms);
+
+    /**
+     * @brief Create an index over externally owned arrays
+     *
+     * Fails if the arrays are inconsistent (e.g. offsets or term indices
+     * out of range), so the index can be used safely on untrusted files.
+     *
+     * @param offsets termCount + 1 offsets into strings
+     * @param strings Concatenated term characters
+     * @param pilots Pilot of every hash bucket (bucketCount(termCount) entries)
+     * @param slots Hash tag (high 32 bits) and term index (low 32 bits) of every hashed term
+     * @param result Receives the index on success
+     * @return true if the arrays form a valid index, false otherwise
+     */
+    static bool fromArrays(
+        ConstArray<uint64_t> offsets,
+        ConstArray<char> strings,
+        ConstArray<uint32_t> pilots,
+        ConstArray<uint64_t> slots,
+        VocabularyIndex& result
+    );
+
+    /**
+     * @brief Look up the index of a term
+     * @param term Term to find
+     * @return Index of the term, or npos if it is not in the vocabulary
+     */
+    uint32_t find(std::string_view term) const;
+
+    /**
+     * @brief Look up a term by its precomputed termHash()
+     * @param hash Hash of the term
+     * @param equal Predicate called with candidate terms; returns true on a match
+     * @return Index of the matching term, or npos if there is none
+     */
+    template<typename Equal>
+    uint32_t findHashed(uint64_t hash, Equal&& equal) const {
+        if (slots.empty()) {
+            return npos;
+        }
+
+        uint64_t spread = spreadHash(hash);
+        uint32_t pilot = pilots[bucketOf(spread, pilots.size())];
+        uint64_t entry = slots[slotOf(spread, pilot, slots.size())];
+        if ((entry >> 32) != (spread >> 32)) {
+            return npos;
+        }
+
+        uint32_t index = static_cast<uint32_t>(entry);
+        return equal(term(index)) ? index : npos;
+    }
+
+    /**
+     * @brief Hash a term the way the perfect hash does
+     *
+     * A single token hashes to hashBytes(token); each further
+     * space-separated token is folded in with combineHashes().
+     *
+     * @param term Term to hash
+     * @return Slot hash of the term
+     */
+    static uint64_t termHash(std::string_view term);
+
+    /**
+     * @brief Get the term stored at an index
+     * @param index Term index (must be less than size())
+     * @return View of the term characters
+     */
+    std::string_view term(size_t index) const;
+
+    /**
+     * @brief Get the number of terms
+     * @return Vocabulary size
+     */
+    size_t size() const;
+
+    /**
+     * @brief Get the number of hash buckets, and so pilots, for a vocabulary
+     * @param termCount Number of terms
+     * @return Number of buckets (one per kBucketSize terms, rounded up)
+     */
+    static size_t bucketCount(size_t termCount);
+
+    const ConstArray<uint64_t>& getOffsets() const { return offsets; } ///< Term offsets
+    const ConstArray<char>& getStrings() const { return strings; }     ///< Term characters
+    const ConstArray<uint32_t>& getPilots() const { return pilots; }   ///< Bucket pilots
+    const ConstArray<uint64_t>& getSlots() const { return slots; }     ///< Tagged hash slots
+
+private:
+    /// Average number of terms per bucket; larger buckets need fewer pilots but longer searches
+    static constexpr size_t kBucketSize = 4;
+
+    ConstArray<uint64_t> offsets; ///< Start of each term in strings, plus end sentinel
+    ConstArray<char> strings;     ///< Concatenated term characters
+    ConstArray<uint32_t> pilots;  ///< Pilot of each bucket, chosen so no two terms share a slot
+    ConstArray<uint64_t> slots;   ///< Hash tag << 32 | term index, one per hashed term
+
+    // Mix a term hash so its bucket, slot and tag bits are independent
+    static uint64_t spreadHash(uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    static size_t bucketOf(uint64_t spread, size_t buckets) {
+        return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(spread)) * buckets) >> 32);
+    }
+
+    static size_t slotOf(uint64_t spread, uint32_t pilot, size_t slotCount) {
+        uint64_t mixed = spreadHash(spread ^ (pilot * 0x9E3779B97F4A7C15ULL));
+        return static_cast<size_t>(((mixed >> 32) * slotCount) >> 32);
+    }
+};
+
+} // namespace sentiment
+
+#endif // VOCABULARY_INDEX_H
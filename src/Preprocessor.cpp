@@ -1,11 +1,386 @@
 #include "preprocessor.h"
+#include "pipeline_stats.h"
+#include "utils.h"
 #include <algorithm>
-#include <cctype>
-#include <sstream>
-#include <regex>
+#include <array>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define SENTIMENT_HAVE_SSE2_SCAN 1
+#endif
 
 namespace sentiment {
 
+namespace {
+
+// Per-byte classification used by the single-pass tokenizer
+enum CharClass : unsigned char {
+    WORD,        ///< Part of a token
+    SPACE,       ///< Whitespace separator
+    PUNCTUATION  ///< ASCII punctuation, treated as a separator when cleaning
+};
+
+struct CharTable {
+    std::array<unsigned char, 256> lower{};
+    std::array<CharClass, 256> type{};
+};
+
+// Matches the behaviour of ::tolower, std::isspace and std::ispunct in the
+// "C" locale. Bytes >= 0x80 start UTF-8 sequences and are classified by
+// foldUtf8() instead.
+constexpr CharTable makeCharTable() {
+    CharTable table{};
+    for (int c = 0; c < 256; ++c) {
+        table.lower[c] = static_cast<unsigned char>(
+            (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c);
+
+        bool space = c == ' ' || (c >= '\t' && c <= '\r');
+        bool punct = (c >= '!' && c <= '/') || (c >= ':' && c <= '@') ||
+                     (c >= '[' && c <= '`') || (c >= '{' && c <= '~');
+        table.type[c] = space ? SPACE : (punct ? PUNCTUATION : WORD);
+    }
+    return table;
+}
+
+constexpr CharTable kCharTable = makeCharTable();
+
+// How the code points of a FoldRange are normalized
+enum FoldKind : unsigned char {
+    SHIFT,     ///< Every code point maps to code point + delta
+    PAIRS,     ///< Alternating upper/lower case pairs; even offsets map to code point + delta
+    SEPARATOR  ///< Punctuation or whitespace
+};
+
+struct FoldRange {
+    uint32_t first;
+    uint32_t last;
+    int32_t delta;
+    FoldKind kind;
+};
+
+// Simple case folding of the Latin, Greek, Cyrillic and Armenian letters,
+// fullwidth ASCII folded to ASCII, and the common non-ASCII punctuation and
+// spaces. Sorted and disjoint. Code points not listed are word characters
+// that stay as they are (CJK, emoji, letters of other scripts).
+constexpr FoldRange kFoldRanges[] = {
+    {0x0085, 0x0085, 0, SEPARATOR},      // Next line
+    {0x00A0, 0x00A9, 0, SEPARATOR},      // No-break space, inverted !, currency, section, (c)
+    {0x00AB, 0x00B1, 0, SEPARATOR},      // Guillemet, not, soft hyphen, (r), macron, degree, +-
+    {0x00B4, 0x00B4, 0, SEPARATOR},      // Acute accent
+    {0x00B5, 0x00B5, 0x03BC - 0x00B5, SHIFT}, // Micro sign -> Greek mu
+    {0x00B6, 0x00B8, 0, SEPARATOR},      // Pilcrow, middle dot, cedilla
+    {0x00BB, 0x00BB, 0, SEPARATOR},      // Guillemet
+    {0x00BF, 0x00BF, 0, SEPARATOR},      // Inverted question mark
+    {0x00C0, 0x00D6, 0x20, SHIFT},
+    {0x00D7, 0x00D7, 0, SEPARATOR},      // Multiplication sign
+    {0x00D8, 0x00DE, 0x20, SHIFT},
+    {0x00F7, 0x00F7, 0, SEPARATOR},      // Division sign
+    {0x0100, 0x012F, 1, PAIRS},
+    {0x0132, 0x0137, 1, PAIRS},
+    {0x0139, 0x0148, 1, PAIRS},
+    {0x014A, 0x0177, 1, PAIRS},
+    {0x0178, 0x0178, 0x00FF - 0x0178, SHIFT},
+    {0x0179, 0x017E, 1, PAIRS},
+    {0x017F, 0x017F, 's' - 0x017F, SHIFT}, // Long s
+    {0x01C4, 0x01C4, 2, SHIFT},          // DZ, Dz, LJ, Lj, NJ, Nj digraphs
+    {0x01C5, 0x01C5, 1, SHIFT},
+    {0x01C7, 0x01C7, 2, SHIFT},
+    {0x01C8, 0x01C8, 1, SHIFT},
+    {0x01CA, 0x01CA, 2, SHIFT},
+    {0x01CB, 0x01CB, 1, SHIFT},
+    {0x01CD, 0x01DC, 1, PAIRS},
+    {0x01DE, 0x01EF, 1, PAIRS},
+    {0x01F1, 0x01F1, 2, SHIFT},
+    {0x01F2, 0x01F2, 1, SHIFT},
+    {0x01F4, 0x01F4, 1, SHIFT},
+    {0x01F8, 0x021F, 1, PAIRS},
+    {0x0222, 0x0233, 1, PAIRS},
+    {0x0246, 0x024F, 1, PAIRS},
+    {0x037E, 0x037E, 0, SEPARATOR},      // Greek question mark
+    {0x0386, 0x0386, 0x26, SHIFT},
+    {0x0387, 0x0387, 0, SEPARATOR},      // Greek ano teleia
+    {0x0388, 0x038A, 0x25, SHIFT},
+    {0x038C, 0x038C, 0x40, SHIFT},
+    {0x038E, 0x038F, 0x3F, SHIFT},
+    {0x0391, 0x03A1, 0x20, SHIFT},
+    {0x03A3, 0x03AB, 0x20, SHIFT},
+    {0x03C2, 0x03C2, 1, SHIFT},          // Final sigma
+    {0x03D8, 0x03EF, 1, PAIRS},
+    {0x0400, 0x040F, 0x50, SHIFT},
+    {0x0410, 0x042F, 0x20, SHIFT},
+    {0x0460, 0x0481, 1, PAIRS},
+    {0x048A, 0x04BF, 1, PAIRS},
+    {0x04C0, 0x04C0, 0x0F, SHIFT},
+    {0x04C1, 0x04CE, 1, PAIRS},
+    {0x04D0, 0x052F, 1, PAIRS},
+    {0x0531, 0x0556, 0x30, SHIFT},
+    {0x055A, 0x055F, 0, SEPARATOR},      // Armenian punctuation
+    {0x0589, 0x058A, 0, SEPARATOR},
+    {0x05BE, 0x05BE, 0, SEPARATOR},      // Hebrew punctuation
+    {0x05C0, 0x05C0, 0, SEPARATOR},
+    {0x05C3, 0x05C3, 0, SEPARATOR},
+    {0x05C6, 0x05C6, 0, SEPARATOR},
+    {0x05F3, 0x05F4, 0, SEPARATOR},
+    {0x060C, 0x060C, 0, SEPARATOR},      // Arabic punctuation
+    {0x061B, 0x061B, 0, SEPARATOR},
+    {0x061F, 0x061F, 0, SEPARATOR},
+    {0x066A, 0x066D, 0, SEPARATOR},
+    {0x06D4, 0x06D4, 0, SEPARATOR},
+    {0x1E00, 0x1E95, 1, PAIRS},
+    {0x1E9E, 0x1E9E, 0x00DF - 0x1E9E, SHIFT}, // Capital sharp s
+    {0x1EA0, 0x1EFF, 1, PAIRS},
+    {0x2000, 0x200B, 0, SEPARATOR},      // Spaces, zero width space
+    {0x2010, 0x2029, 0, SEPARATOR},      // Dashes, quotes, bullets, line and paragraph separators
+    {0x202F, 0x205F, 0, SEPARATOR},      // Narrow no-break space, per mille ... medium math space
+    {0x20A0, 0x20C0, 0, SEPARATOR},      // Currency signs
+    {0x3000, 0x3003, 0, SEPARATOR},      // Ideographic space, comma, full stop
+    {0x3008, 0x3011, 0, SEPARATOR},      // CJK brackets
+    {0x3014, 0x301F, 0, SEPARATOR},
+    {0x30FB, 0x30FB, 0, SEPARATOR},      // Katakana middle dot
+    {0xFEFF, 0xFEFF, 0, SEPARATOR},      // Byte order mark
+    {0xFF01, 0xFF0F, 0, SEPARATOR},      // Fullwidth ASCII punctuation
+    {0xFF10, 0xFF19, '0' - 0xFF10, SHIFT},
+    {0xFF1A, 0xFF20, 0, SEPARATOR},
+    {0xFF21, 0xFF3A, 'a' - 0xFF21, SHIFT},
+    {0xFF3B, 0xFF40, 0, SEPARATOR},
+    {0xFF41, 0xFF5A, 'a' - 0xFF41, SHIFT},
+    {0xFF5B, 0xFF65, 0, SEPARATOR}
+};
+
+// Folded values that are not code points
+constexpr uint32_t kSeparator = 0xFFFFFFFFu; ///< Character ends a word
+constexpr uint32_t kUnchanged = 0xFFFFFFFEu; ///< Copy the input bytes as they are
+
+constexpr uint32_t applyFold(const FoldRange& range, uint32_t codePoint) {
+    switch (range.kind) {
+    case SHIFT:
+        return static_cast<uint32_t>(static_cast<int32_t>(codePoint) + range.delta);
+    case PAIRS:
+        return (codePoint - range.first) % 2 == 0
+            ? static_cast<uint32_t>(static_cast<int32_t>(codePoint) + range.delta)
+            : codePoint;
+    default:
+        return kSeparator;
+    }
+}
+
+constexpr size_t utf8Length(uint32_t codePoint) {
+    return codePoint < 0x80 ? 1 : (codePoint < 0x800 ? 2 : (codePoint < 0x10000 ? 3 : 4));
+}
+
+// The scanners write folded text in place of the input, so no character may
+// get longer; folding to ASCII must give a word character
+constexpr bool foldRangesAreValid() {
+    uint32_t previousLast = 0x7F;
+    for (const FoldRange& range : kFoldRanges) {
+        if (range.first <= previousLast || range.last < range.first || range.last > 0xFFFF) {
+            return false;
+        }
+        previousLast = range.last;
+
+        for (uint32_t codePoint = range.first; codePoint <= range.last; ++codePoint) {
+            uint32_t folded = applyFold(range, codePoint);
+            if (folded == kSeparator) {
+                continue;
+            }
+            if (utf8Length(folded) > utf8Length(codePoint) ||
+                (folded < 0x80 && kCharTable.type[folded] != WORD)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(foldRangesAreValid(), "kFoldRanges must be sorted, disjoint and never lengthen text");
+
+// Direct lookup of the folded value of every two-byte code point
+// (below U+0800); 0 marks separators
+constexpr std::array<uint16_t, 0x800> makeTwoByteFold() {
+    std::array<uint16_t, 0x800> table{};
+    for (uint32_t codePoint = 0; codePoint < table.size(); ++codePoint) {
+        table[codePoint] = static_cast<uint16_t>(codePoint);
+    }
+    for (const FoldRange& range : kFoldRanges) {
+        for (uint32_t codePoint = range.first; codePoint <= range.last && codePoint < 0x800; ++codePoint) {
+            uint32_t folded = applyFold(range, codePoint);
+            table[codePoint] = static_cast<uint16_t>(folded == kSeparator ? 0 : folded);
+        }
+    }
+    return table;
+}
+
+constexpr std::array<uint16_t, 0x800> kTwoByteFold = makeTwoByteFold();
+
+uint32_t foldWide(uint32_t codePoint) {
+    const FoldRange* range = std::lower_bound(
+        std::begin(kFoldRanges), std::end(kFoldRanges), codePoint,
+        [](const FoldRange& candidate, uint32_t value) { return candidate.last < value; });
+    if (range == std::end(kFoldRanges) || range->first > codePoint) {
+        return kUnchanged;
+    }
+
+    uint32_t folded = applyFold(*range, codePoint);
+    return folded == codePoint ? kUnchanged : folded;
+}
+
+// A non-ASCII character: its length in the input and its folded code point
+// (or kSeparator / kUnchanged)
+struct Utf8Char {
+    size_t length;
+    uint32_t folded;
+};
+
+inline bool isContinuation(unsigned char c) {
+    return (c & 0xC0) == 0x80;
+}
+
+// Decodes and folds the character starting with the byte p[0] >= 0x80.
+// Bytes that are not valid UTF-8 (stray continuation bytes, truncated,
+// overlong or surrogate sequences) are kept one at a time as word bytes.
+Utf8Char foldUtf8(const unsigned char* p, size_t available) {
+    unsigned char lead = p[0];
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        if (available >= 2 && isContinuation(p[1])) {
+            uint32_t codePoint = (static_cast<uint32_t>(lead & 0x1F) << 6) | (p[1] & 0x3F);
+            uint32_t folded = kTwoByteFold[codePoint];
+            return {2, folded == 0 ? kSeparator : (folded == codePoint ? kUnchanged : folded)};
+        }
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        if (available >= 3 && isContinuation(p[1]) && isContinuation(p[2])) {
+            uint32_t codePoint = (static_cast<uint32_t>(lead & 0x0F) << 12) |
+                                 (static_cast<uint32_t>(p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+            if (codePoint >= 0x800 && (codePoint < 0xD800 || codePoint > 0xDFFF)) {
+                return {3, foldWide(codePoint)};
+            }
+        }
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        if (available >= 4 && isContinuation(p[1]) && isContinuation(p[2]) && isContinuation(p[3])) {
+            uint32_t codePoint = (static_cast<uint32_t>(lead & 0x07) << 18) |
+                                 (static_cast<uint32_t>(p[1] & 0x3F) << 12) |
+                                 (static_cast<uint32_t>(p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+            if (codePoint >= 0x10000 && codePoint <= 0x10FFFF) {
+                return {4, kUnchanged};
+            }
+        }
+    }
+    return {1, kUnchanged};
+}
+
+// Writes the folded form of a word character to out and returns its length
+size_t writeFolded(const unsigned char* p, const Utf8Char& ch, char* out) {
+    if (ch.folded == kUnchanged) {
+        std::memcpy(out, p, ch.length);
+        return ch.length;
+    }
+
+    uint32_t codePoint = ch.folded;
+    if (codePoint < 0x80) {
+        out[0] = static_cast<char>(codePoint);
+        return 1;
+    }
+    if (codePoint < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (codePoint >> 6));
+        out[1] = static_cast<char>(0x80 | (codePoint & 0x3F));
+        return 2;
+    }
+    out[0] = static_cast<char>(0xE0 | (codePoint >> 12));
+    out[1] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+    out[2] = static_cast<char>(0x80 | (codePoint & 0x3F));
+    return 3;
+}
+
+#ifdef SENTIMENT_HAVE_SSE2_SCAN
+// Bytes in [low, high]; bytes >= 0x80 compare as negative and never match
+inline __m128i bytesInRange(__m128i bytes, char low, char high) {
+    return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(static_cast<char>(low - 1))),
+                         _mm_cmplt_epi8(bytes, _mm_set1_epi8(static_cast<char>(high + 1))));
+}
+#endif
+
+// Copies the lowercased ASCII word characters at the start of in to out
+// and returns their count. Writes at most n bytes, possibly past the count.
+size_t foldAsciiWord(const unsigned char* in, size_t n, char* out) {
+    size_t k = 0;
+#ifdef SENTIMENT_HAVE_SSE2_SCAN
+    // 16 bytes at a time: every byte is lowercased and stored, and the
+    // first separator or non-ASCII byte ends the run
+    for (; k + 16 <= n; k += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + k));
+        __m128i separators = _mm_or_si128(
+            _mm_or_si128(bytesInRange(bytes, '\t', '\r'), bytesInRange(bytes, ' ', '/')),
+            _mm_or_si128(_mm_or_si128(bytesInRange(bytes, ':', '@'), bytesInRange(bytes, '[', '`')),
+                         bytesInRange(bytes, '{', '~')));
+        __m128i upper = bytesInRange(bytes, 'A', 'Z');
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k),
+                         _mm_add_epi8(bytes, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+
+        unsigned stop = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(separators, bytes)));
+        if (stop != 0) {
+            return k + static_cast<size_t>(__builtin_ctz(stop));
+        }
+    }
+#endif
+    for (; k < n; ++k) {
+        unsigned char c = in[k];
+        if (c >= 0x80 || kCharTable.type[c] != WORD) {
+            break;
+        }
+        out[k] = static_cast<char>(kCharTable.lower[c]);
+    }
+    return k;
+}
+
+// Returns the position of the first word character at or after i
+size_t skipSeparators(const unsigned char* in, size_t size, size_t i) {
+    while (i < size) {
+        unsigned char c = in[i];
+        if (c < 0x80) {
+            if (kCharTable.type[c] == WORD) {
+                break;
+            }
+            ++i;
+            continue;
+        }
+
+        Utf8Char ch = foldUtf8(in + i, size - i);
+        if (ch.folded != kSeparator) {
+            break;
+        }
+        i += ch.length;
+    }
+    return i;
+}
+
+// Writes the folded word starting at i to out, advances i past it and
+// returns the number of bytes written (never more than the bytes read).
+// out must have room for size - i bytes.
+size_t foldWord(const unsigned char* in, size_t size, size_t& i, char* out) {
+    size_t written = 0;
+    while (i < size) {
+        if (in[i] < 0x80) {
+            size_t run = foldAsciiWord(in + i, size - i, out + written);
+            if (run == 0) {
+                break;
+            }
+            i += run;
+            written += run;
+            continue;
+        }
+
+        Utf8Char ch = foldUtf8(in + i, size - i);
+        if (ch.folded == kSeparator) {
+            break;
+        }
+        written += writeFolded(in + i, ch, out + written);
+        i += ch.length;
+    }
+    return written;
+}
+
+} // namespace
+
 Preprocessor::Preprocessor(bool useStopWords) : useStopWords(useStopWords) {
     if (useStopWords) {
         initializeStopWords();
@@ -13,56 +388,202 @@ Preprocessor::Preprocessor(bool useStopWords) : useStopWords(useStopWords) {
 }
 
 std::string Preprocessor::cleanText(const std::string& text) const {
-    // Convert to lowercase
-    std::string cleanedText = text;
-    std::transform(cleanedText.begin(), cleanedText.end(),
-                  cleanedText.begin(), ::tolower);
+    // Fold case, turn punctuation into spaces, collapse runs of whitespace
+    // and trim, all in a single pass. Folding never lengthens the text, so
+    // the words are written in place of the input size.
+    const auto* in = reinterpret_cast<const unsigned char*>(text.data());
+    std::string cleanedText(text.size(), '\0');
+    char* out = &cleanedText[0];
+    size_t written = 0;
 
-    // Replace punctuation with spaces
-    std::regex punctRegex("[\\!\\\"\\#\\$\\%\\&\\'\\(\\)\\*\\+\\,\\-\\.\\/\\:\\;\\<\\=\\>\\?\\@\\[\\\\\\]\\^_\\`\\{\\|\\}\\~]");
-    cleanedText = std::regex_replace(cleanedText, punctRegex, " ");
+    size_t i = skipSeparators(in, text.size(), 0);
+    while (i < text.size()) {
+        if (written > 0) {
+            out[written++] = ' ';
+        }
+        written += foldWord(in, text.size(), i, out + written);
+        i = skipSeparators(in, text.size(), i);
+    }
 
-    // Replace multiple spaces with a single space
-    std::regex multipleSpacesRegex("\\s+");
-    cleanedText = std::regex_replace(cleanedText, multipleSpacesRegex, " ");
+    cleanedText.resize(written);
+    return cleanedText;
+}
 
-    // Trim leading and trailing spaces
-    cleanedText = std::regex_replace(cleanedText, std::regex("^\\s+|\\s+$"), "");
+uint64_t Preprocessor::hashCleanText(std::string_view text) const {
+    // Same byte stream as cleanText(), fed straight into FNV-1a
+    const auto* in = reinterpret_cast<const unsigned char*>(text.data());
+    const size_t size = text.size();
+    auto feed = [](uint64_t hash, unsigned char byte) {
+        return (hash ^ byte) * 1099511628211ULL;
+    };
 
-    return cleanedText;
+    uint64_t hash = hashBytes({});
+    bool started = false;
+    size_t i = skipSeparators(in, size, 0);
+    while (i < size) {
+        if (started) {
+            hash = feed(hash, static_cast<unsigned char>(' '));
+        }
+        started = true;
+
+        while (i < size) {
+            unsigned char c = in[i];
+            if (c < 0x80) {
+                if (kCharTable.type[c] != WORD) {
+                    break;
+                }
+                hash = feed(hash, kCharTable.lower[c]);
+                ++i;
+                continue;
+            }
+
+            Utf8Char ch = foldUtf8(in + i, size - i);
+            if (ch.folded == kSeparator) {
+                break;
+            }
+            char folded[4];
+            size_t length = writeFolded(in + i, ch, folded);
+            for (size_t k = 0; k < length; ++k) {
+                hash = feed(hash, static_cast<unsigned char>(folded[k]));
+            }
+            i += ch.length;
+        }
+        i = skipSeparators(in, size, i);
+    }
+
+    return hash;
 }
 
 std::vector<std::string> Preprocessor::tokenize(const std::string& text) const {
     std::vector<std::string> tokens;
-    std::istringstream iss(text);
-    std::string token;
 
-    while (iss >> token) {
+    // Split on whitespace only; the text is expected to be cleaned already
+    size_t i = 0;
+    while (i < text.size()) {
+        while (i < text.size() &&
+               kCharTable.type[static_cast<unsigned char>(text[i])] == SPACE) {
+            ++i;
+        }
+
+        size_t start = i;
+        while (i < text.size() &&
+               kCharTable.type[static_cast<unsigned char>(text[i])] != SPACE) {
+            ++i;
+        }
+
+        if (i == start) {
+            break;
+        }
+
+        std::string_view token(text.data() + start, i - start);
+
         // Skip stop words if enabled
-        if (useStopWords && isStopWord(token)) {
+        if (useStopWords && isStopWordView(token)) {
             continue;
         }
 
-        tokens.push_back(token);
+        tokens.emplace_back(token);
     }
 
     return tokens;
 }
 
 std::vector<std::string> Preprocessor::preprocess(const std::string& text) const {
-    return tokenize(cleanText(text));
+    std::string buffer;
+    std::vector<std::string_view> views;
+    tokenizeInto(text, buffer, views);
+
+    return std::vector<std::string>(views.begin(), views.end());
+}
+
+void Preprocessor::tokenizeInto(
+    std::string_view text,
+    std::string& buffer,
+    std::vector<std::string_view>& tokens
+) const {
+    SENTIMENT_TIME_STAGE(Stage::PREPROCESS);
+    tokens.clear();
+
+    // Size the buffer once so that views into it stay valid while writing;
+    // folded words are never longer than the input they come from
+    const auto* in = reinterpret_cast<const unsigned char*>(text.data());
+    buffer.resize(text.size());
+    char* out = &buffer[0];
+    size_t written = 0;
+
+    size_t i = skipSeparators(in, text.size(), 0);
+    while (i < text.size()) {
+        size_t start = written;
+        written += foldWord(in, text.size(), i, out + written);
+        i = skipSeparators(in, text.size(), i);
+
+        std::string_view token(out + start, written - start);
+        if (useStopWords && isStopWordView(token)) {
+            // Reclaim the space used by the discarded token
+            written = start;
+            continue;
+        }
+
+        tokens.push_back(token);
+    }
+
+    buffer.resize(written);
 }
 
 void Preprocessor::addStopWords(const std::vector<std::string>& words) {
     for (const auto& word : words) {
         stopWords.insert(word);
     }
+
+    rebuildStopWordTable();
 }
 
 bool Preprocessor::isStopWord(const std::string& word) const {
     return stopWords.find(word) != stopWords.end();
 }
 
+bool Preprocessor::isStopWordView(std::string_view word) const {
+    if (word.size() > maxStopWordLength || stopWordSlots.empty()) {
+        return false;
+    }
+
+    size_t mask = stopWordSlots.size() - 1;
+    for (size_t slot = hashBytes(word) & mask; ; slot = (slot + 1) & mask) {
+        const std::string& candidate = stopWordSlots[slot];
+        if (candidate.empty()) {
+            return false;
+        }
+        if (candidate == word) {
+            return true;
+        }
+    }
+}
+
+void Preprocessor::rebuildStopWordTable() {
+    // Keep the load factor at or below 50% so probe sequences stay short
+    size_t slotCount = 16;
+    while (slotCount < stopWords.size() * 2) {
+        slotCount *= 2;
+    }
+
+    stopWordSlots.assign(slotCount, std::string());
+    maxStopWordLength = 0;
+
+    size_t mask = slotCount - 1;
+    for (const auto& word : stopWords) {
+        if (word.empty()) {
+            continue;
+        }
+
+        size_t slot = hashBytes(word) & mask;
+        while (!stopWordSlots[slot].empty()) {
+            slot = (slot + 1) & mask;
+        }
+        stopWordSlots[slot] = word;
+        maxStopWordLength = std::max(maxStopWordLength, word.size());
+    }
+}
+
 void Preprocessor::initializeStopWords() {
     // Common English stop words
     const std::vector<std::string> defaultStopWords = {
@@ -88,6 +609,7 @@ void Preprocessor::initializeStopWords() {
     };
 
     stopWords.insert(defaultStopWords.begin(), defaultStopWords.end());
+    rebuildStopWordTable();
 }
 
 } // namespace sentiment
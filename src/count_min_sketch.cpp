@@ -0,0 +1,62 @@
+#include "count_min_sketch.h"
+#include <algorithm>
+#include <limits>
+
+namespace sentiment {
+
+CountMinSketch::CountMinSketch(size_t width, size_t depth) {
+    if (width == 0 || depth == 0) {
+        return;
+    }
+
+    this->width = 1;
+    while (this->width < width) {
+        this->width *= 2;
+    }
+    this->depth = depth;
+    counters.assign(this->width * depth, 0);
+}
+
+uint32_t CountMinSketch::add(uint64_t key, uint32_t count) {
+    if (empty()) {
+        return 0;
+    }
+
+    // Conservative update: raise every counter to at most the new estimate
+    uint32_t current = estimate(key);
+    uint32_t target = current > std::numeric_limits<uint32_t>::max() - count
+        ? std::numeric_limits<uint32_t>::max()
+        : current + count;
+    for (size_t row = 0; row < depth; ++row) {
+        uint32_t& counter = counters[counterIndex(key, row)];
+        counter = std::max(counter, target);
+    }
+    return target;
+}
+
+uint32_t CountMinSketch::estimate(uint64_t key) const {
+    if (empty()) {
+        return 0;
+    }
+
+    uint32_t result = std::numeric_limits<uint32_t>::max();
+    for (size_t row = 0; row < depth; ++row) {
+        result = std::min(result, counters[counterIndex(key, row)]);
+    }
+    return result;
+}
+
+bool CountMinSketch::empty() const {
+    return counters.empty();
+}
+
+size_t CountMinSketch::counterIndex(uint64_t key, size_t row) const {
+    // Derive one independent-looking position per row from the key
+    uint64_t hash = key + (row + 1) * 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 31;
+    hash *= 0x94D049BB133111EBULL;
+    hash ^= hash >> 29;
+    return row * width + (hash & (width - 1));
+}
+
+} // namespace sentiment
@@ -0,0 +1,337 @@
+#include "cross_validation.h"
+#include "evaluator.h"
+#include "naive_bayes.h"
+#include "sparse_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+
+namespace sentiment {
+
+CrossValidator::CrossValidator(
+    const Preprocessor& preprocessor,
+    const FeatureExtractor& settings,
+    std::shared_ptr<ThreadPool> pool
+) : preprocessor(preprocessor),
+    method(settings.getMethod()),
+    hashBits(settings.getHashBits()),
+    signedHashing(settings.isSignedHashing()),
+    ngramMin(settings.getNgramMin()),
+    ngramMax(settings.getNgramMax()),
+    sublinearTf(settings.getMethod() == FeatureExtractor::Method::TF_IDF && settings.isSublinearTf()),
+    l2Normalize(settings.getMethod() == FeatureExtractor::Method::TF_IDF && settings.isL2Normalized()),
+    threadPool(std::move(pool)) {
+}
+
+bool CrossValidator::prepare(const std::vector<TextData>& data, size_t foldCount, uint64_t seed) {
+    if (foldCount < 2 || foldCount > data.size()) {
+        std::cerr << "Error: Cross-validation needs between 2 and " << data.size()
+                  << " folds, got " << foldCount << std::endl;
+        return false;
+    }
+
+    if (l2Normalize) {
+        std::cerr << "Error: Cross-validation does not support L2-normalized TF-IDF features" << std::endl;
+        return false;
+    }
+
+    // Count every term once; the cutoffs are applied per fold in search().
+    // TF-IDF weights depend on the training split, so raw counts are kept.
+    FeatureExtractor counter(
+        preprocessor,
+        method == FeatureExtractor::Method::HASHING ? method : FeatureExtractor::Method::BAG_OF_WORDS
+    );
+    counter.setHashing(hashBits, signedHashing);
+    counter.setNgramRange(ngramMin, ngramMax);
+    counter.setThreadPool(threadPool);
+    counter.buildVocabulary(data, 1, 0);
+    std::vector<FeatureVector> vectors = counter.batchTransform(data);
+    dimension = counter.getFeatureCount();
+
+    // Rank terms alphabetically once so vocabulary ties are cheap to break
+    termRanks.clear();
+    if (method != FeatureExtractor::Method::HASHING) {
+        const VocabularyIndex& terms = counter.getVocabularyIndex();
+        std::vector<uint32_t> order(dimension);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return terms.term(a) < terms.term(b);
+        });
+        termRanks.resize(dimension);
+        for (size_t rank = 0; rank < order.size(); ++rank) {
+            termRanks[order[rank]] = static_cast<uint32_t>(rank);
+        }
+    }
+
+    // Shuffle, then deal each label out in turn so the folds are stratified
+    std::vector<size_t> order(data.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(seed));
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return static_cast<int>(data[a].label) < static_cast<int>(data[b].label);
+    });
+
+    folds.assign(foldCount, Fold{});
+    foldAssignment.assign(data.size(), 0);
+    for (size_t position = 0; position < order.size(); ++position) {
+        size_t fold = position % foldCount;
+        foldAssignment[order[position]] = static_cast<uint32_t>(fold);
+        folds[fold].documents.push_back(std::move(vectors[order[position]]));
+    }
+
+    // Sum the term counts of each fold (clamped at zero like in NaiveBayes)
+    auto countFolds = [&](size_t begin, size_t end, size_t) {
+        for (size_t f = begin; f < end; ++f) {
+            Fold& fold = folds[f];
+            fold.termCounts.assign(dimension * kLabelCount, 0.0);
+            fold.occurrences.assign(dimension, 0.0);
+            fold.documentFrequencies.assign(dimension, 0);
+            for (auto& document : fold.documents) {
+                size_t label = static_cast<size_t>(document.label);
+                SparseVector& vector = document.features;
+                for (size_t k = 0; k < vector.nonZeroCount(); ++k) {
+                    fold.occurrences[vector.indices[k]] += std::max(vector.values[k], 0.0);
+                }
+
+                // Sublinear frequencies do not depend on the training split,
+                // but the vocabulary is still chosen by raw counts
+                if (sublinearTf) {
+                    weightTermCounts(vector, nullptr, true, false);
+                }
+
+                for (size_t k = 0; k < vector.nonZeroCount(); ++k) {
+                    double value = std::max(vector.values[k], 0.0);
+                    if (value > 0.0) {
+                        fold.termCounts[vector.indices[k] * kLabelCount + label] += value;
+                        fold.documentFrequencies[vector.indices[k]]++;
+                    }
+                }
+                fold.labelExamples[label]++;
+            }
+        }
+    };
+
+    if (threadPool) {
+        threadPool->parallelFor(foldCount, countFolds, 1);
+    } else {
+        countFolds(0, foldCount, 0);
+    }
+
+    totals = Fold{};
+    totals.termCounts.assign(dimension * kLabelCount, 0.0);
+    totals.occurrences.assign(dimension, 0.0);
+    totals.documentFrequencies.assign(dimension, 0);
+    for (const Fold& fold : folds) {
+        for (size_t i = 0; i < totals.termCounts.size(); ++i) {
+            totals.termCounts[i] += fold.termCounts[i];
+        }
+        for (size_t i = 0; i < dimension; ++i) {
+            totals.occurrences[i] += fold.occurrences[i];
+            totals.documentFrequencies[i] += fold.documentFrequencies[i];
+        }
+        for (size_t label = 0; label < kLabelCount; ++label) {
+            totals.labelExamples[label] += fold.labelExamples[label];
+        }
+    }
+
+    return true;
+}
+
+std::vector<CrossValidationResult> CrossValidator::search(const SearchGrid& grid) const {
+    if (folds.empty()) {
+        std::cerr << "Error: Cross-validation folds are not prepared" << std::endl;
+        return {};
+    }
+
+    // The hashed feature space has no vocabulary to cut
+    bool hashing = method == FeatureExtractor::Method::HASHING;
+    std::vector<int> minFrequencies = hashing ? std::vector<int>{0} : grid.minWordFrequencies;
+    std::vector<size_t> maxSizes = hashing ? std::vector<size_t>{0} : grid.maxVocabularySizes;
+    if (grid.alphas.empty() || minFrequencies.empty() || maxSizes.empty()) {
+        std::cerr << "Error: Every hyperparameter list of the search grid needs a value" << std::endl;
+        return {};
+    }
+
+    // One task per (vocabulary cutoff, fold); each evaluates every alpha
+    size_t vocabularies = minFrequencies.size() * maxSizes.size();
+    size_t alphaCount = grid.alphas.size();
+    size_t foldCount = folds.size();
+    std::vector<EvaluationMetrics> foldMetrics(vocabularies * foldCount * alphaCount);
+
+    auto evaluateTasks = [&](size_t begin, size_t end, size_t) {
+        for (size_t task = begin; task < end; ++task) {
+            size_t vocabulary = task / foldCount;
+            size_t fold = task % foldCount;
+            evaluateFold(fold,
+                         minFrequencies[vocabulary / maxSizes.size()],
+                         maxSizes[vocabulary % maxSizes.size()],
+                         grid.alphas,
+                         &foldMetrics[task * alphaCount]);
+        }
+    };
+
+    if (threadPool) {
+        threadPool->parallelFor(vocabularies * foldCount, evaluateTasks, 1);
+    } else {
+        evaluateTasks(0, vocabularies * foldCount, 0);
+    }
+
+    // Average over the folds of each combination
+    std::vector<CrossValidationResult> results;
+    results.reserve(vocabularies * alphaCount);
+    for (size_t vocabulary = 0; vocabulary < vocabularies; ++vocabulary) {
+        for (size_t a = 0; a < alphaCount; ++a) {
+            CrossValidationResult result;
+            result.alpha = grid.alphas[a];
+            result.minWordFrequency = minFrequencies[vocabulary / maxSizes.size()];
+            result.maxVocabularySize = maxSizes[vocabulary % maxSizes.size()];
+
+            double f1Sum = 0.0;
+            for (size_t fold = 0; fold < foldCount; ++fold) {
+                const EvaluationMetrics& metrics =
+                    foldMetrics[(vocabulary * foldCount + fold) * alphaCount + a];
+                result.foldAccuracies.push_back(metrics.accuracy);
+                f1Sum += metrics.f1Score;
+            }
+
+            double accuracySum = std::accumulate(result.foldAccuracies.begin(),
+                                                 result.foldAccuracies.end(), 0.0);
+            result.meanAccuracy = accuracySum / foldCount;
+            result.meanF1Score = f1Sum / foldCount;
+
+            double squaredDeviations = 0.0;
+            for (double accuracy : result.foldAccuracies) {
+                squaredDeviations += (accuracy - result.meanAccuracy) * (accuracy - result.meanAccuracy);
+            }
+            result.accuracyStdDev = std::sqrt(squaredDeviations / foldCount);
+            results.push_back(std::move(result));
+        }
+    }
+
+    // Best first; equal scores keep their grid order
+    std::stable_sort(results.begin(), results.end(), [](const auto& a, const auto& b) {
+        return a.meanAccuracy != b.meanAccuracy ? a.meanAccuracy > b.meanAccuracy
+                                                : a.meanF1Score > b.meanF1Score;
+    });
+    return results;
+}
+
+void CrossValidator::evaluateFold(
+    size_t foldIndex,
+    int minFrequency,
+    size_t maxVocabSize,
+    const std::vector<double>& alphas,
+    EvaluationMetrics* metrics
+) const {
+    const Fold& heldOut = folds[foldIndex];
+    bool hashing = method == FeatureExtractor::Method::HASHING;
+
+    // Training counts are the totals without the held-out fold
+    auto trainCount = [&](size_t term, size_t label) {
+        size_t slot = term * kLabelCount + label;
+        return totals.termCounts[slot] - heldOut.termCounts[slot];
+    };
+
+    std::array<size_t, kLabelCount> labelExamples{};
+    size_t trainExamples = 0;
+    for (size_t label = 0; label < kLabelCount; ++label) {
+        labelExamples[label] = totals.labelExamples[label] - heldOut.labelExamples[label];
+        trainExamples += labelExamples[label];
+    }
+
+    // Choose the vocabulary like FeatureExtractor::finalizeVocabulary:
+    // frequency cutoff, then the most frequent terms, ties alphabetical
+    std::vector<uint32_t> vocabulary;
+    std::vector<double> frequencies(hashing ? 0 : dimension, 0.0);
+    if (hashing) {
+        vocabulary.resize(dimension);
+        std::iota(vocabulary.begin(), vocabulary.end(), 0);
+    } else {
+        for (size_t term = 0; term < dimension; ++term) {
+            frequencies[term] = totals.occurrences[term] - heldOut.occurrences[term];
+            if (frequencies[term] > 0.0 && frequencies[term] >= static_cast<double>(minFrequency)) {
+                vocabulary.push_back(static_cast<uint32_t>(term));
+            }
+        }
+
+        if (maxVocabSize > 0 && vocabulary.size() > maxVocabSize) {
+            std::nth_element(vocabulary.begin(), vocabulary.begin() + maxVocabSize, vocabulary.end(),
+                             [&](uint32_t a, uint32_t b) {
+                                 return frequencies[a] != frequencies[b] ? frequencies[a] > frequencies[b]
+                                                                         : termRanks[a] < termRanks[b];
+                             });
+            vocabulary.resize(maxVocabSize);
+        }
+    }
+
+    // TF-IDF scales every count of a term by its IDF on the training split;
+    // the held-out documents keep raw counts, so the IDF goes into the matrix
+    std::vector<double> weights(vocabulary.size(), 1.0);
+    if (method == FeatureExtractor::Method::TF_IDF) {
+        for (size_t k = 0; k < vocabulary.size(); ++k) {
+            uint32_t term = vocabulary[k];
+            double documents = totals.documentFrequencies[term] - heldOut.documentFrequencies[term];
+            weights[k] = std::log(static_cast<double>(trainExamples) / documents);
+        }
+    }
+
+    // Class lanes and priors, as in NaiveBayes::finalizeCounts
+    std::vector<SentimentLabel> labels;
+    std::vector<double> priors(NaiveBayes::kClassStride, -std::numeric_limits<double>::infinity());
+    for (size_t label = 0; label < kLabelCount; ++label) {
+        if (labelExamples[label] > 0) {
+            priors[labels.size()] = std::log(static_cast<double>(labelExamples[label]) / trainExamples);
+            labels.push_back(static_cast<SentimentLabel>(label));
+        }
+    }
+
+    std::array<double, NaiveBayes::kClassStride> labelTotals{};
+    for (size_t k = 0; k < vocabulary.size(); ++k) {
+        for (size_t lane = 0; lane < labels.size(); ++lane) {
+            labelTotals[lane] += weights[k] * trainCount(vocabulary[k], static_cast<size_t>(labels[lane]));
+        }
+    }
+
+    ConstArray<double> logPriors(std::move(priors));
+    for (size_t a = 0; a < alphas.size(); ++a) {
+        double alpha = alphas[a];
+
+        // Terms outside the vocabulary keep zero rows, which is the same
+        // as dropping them from the held-out documents
+        std::vector<double> logs(vocabulary.size() * labels.size());
+        for (size_t k = 0; k < vocabulary.size(); ++k) {
+            for (size_t lane = 0; lane < labels.size(); ++lane) {
+                double count = weights[k] * trainCount(vocabulary[k], static_cast<size_t>(labels[lane]));
+                double denominator = labelTotals[lane] + alpha * static_cast<double>(vocabulary.size());
+                logs[k * labels.size() + lane] = (count + alpha) / denominator;
+            }
+        }
+        logValues(logs.data(), logs.size());
+
+        std::vector<double> matrix(dimension * NaiveBayes::kClassStride, 0.0);
+        for (size_t k = 0; k < vocabulary.size(); ++k) {
+            double* row = &matrix[vocabulary[k] * NaiveBayes::kClassStride];
+            for (size_t lane = 0; lane < labels.size(); ++lane) {
+                row[lane] = weights[k] * logs[k * labels.size() + lane];
+            }
+        }
+
+        NaiveBayes model(alpha);
+        model.setParameters(labels, logPriors, ConstArray<double>(std::move(matrix)), dimension);
+        Evaluator evaluator(model);
+        metrics[a] = evaluator.evaluate(heldOut.documents);
+    }
+}
+
+size_t CrossValidator::getFoldCount() const {
+    return folds.size();
+}
+
+const std::vector<uint32_t>& CrossValidator::getFoldAssignment() const {
+    return foldAssignment;
+}
+
+} // namespace sentiment
@@ -0,0 +1,162 @@
+#include "csv_parser.h"
+#include <algorithm>
+#include <cstring>
+
+namespace sentiment {
+
+CsvParser::CsvParser(std::string_view text)
+    : cursor(text.data()), end(text.data() + text.size()) {
+}
+
+bool CsvParser::next(std::vector<std::string_view>& fields) {
+    fields.clear();
+    scratchUsed = 0;
+
+    // Skip blank lines
+    while (cursor < end && (*cursor == '\n' || (*cursor == '\r' && cursor + 1 < end && cursor[1] == '\n'))) {
+        cursor += *cursor == '\r' ? 2 : 1;
+    }
+    if (cursor >= end) {
+        return false;
+    }
+
+    const char* recordStart = cursor;
+    for (;;) {
+        if (*cursor == '"') {
+            ++cursor;
+            fields.push_back(parseQuoted());
+
+            // Ignore anything between the closing quote and the delimiter
+            while (cursor < end && *cursor != ',' && *cursor != '\n') {
+                ++cursor;
+            }
+        } else {
+            const char* fieldStart = cursor;
+            while (cursor < end && *cursor != ',' && *cursor != '\n') {
+                ++cursor;
+            }
+
+            // A CR before the line break belongs to the terminator
+            const char* fieldEnd = cursor;
+            if (fieldEnd > fieldStart && fieldEnd[-1] == '\r' && (cursor == end || *cursor == '\n')) {
+                --fieldEnd;
+            }
+            fields.emplace_back(fieldStart, fieldEnd - fieldStart);
+        }
+
+        if (cursor < end && *cursor == ',') {
+            ++cursor;
+            if (cursor == end) {
+                fields.emplace_back();
+                break;
+            }
+            continue;
+        }
+        break;
+    }
+
+    const char* recordEnd = cursor;
+    if (cursor < end) {
+        ++cursor; // Line break
+    }
+    if (recordEnd > recordStart && recordEnd[-1] == '\r') {
+        --recordEnd;
+    }
+    lastRecord = std::string_view(recordStart, recordEnd - recordStart);
+    return true;
+}
+
+std::string_view CsvParser::record() const {
+    return lastRecord;
+}
+
+std::string_view CsvParser::remaining() const {
+    return std::string_view(cursor, end - cursor);
+}
+
+std::string_view CsvParser::parseQuoted() {
+    const char* start = cursor;
+    auto findQuote = [this](const char* from) {
+        return static_cast<const char*>(std::memchr(from, '"', end - from));
+    };
+
+    // Common case: no doubled quotes, so the field is a view into the text
+    const char* quote = findQuote(start);
+    if (!quote) {
+        cursor = end;
+        return std::string_view(start, end - start);
+    }
+    if (quote + 1 == end || quote[1] != '"') {
+        cursor = quote + 1;
+        return std::string_view(start, quote - start);
+    }
+
+    // Unescape doubled quotes into scratch storage
+    if (scratchUsed == scratch.size()) {
+        scratch.emplace_back();
+    }
+    std::string& buffer = scratch[scratchUsed++];
+    buffer.clear();
+
+    for (;;) {
+        buffer.append(start, quote + 1); // Keep one of the two quotes
+        start = quote + 2;
+        quote = findQuote(start);
+        if (!quote) {
+            buffer.append(start, end);
+            cursor = end;
+            return buffer;
+        }
+        if (quote + 1 == end || quote[1] != '"') {
+            buffer.append(start, quote);
+            cursor = quote + 1;
+            return buffer;
+        }
+    }
+}
+
+std::vector<size_t> CsvParser::splitRecords(std::string_view text, size_t parts, ThreadPool* pool) {
+    parts = std::max<size_t>(parts, 1);
+    std::vector<size_t> candidates(parts + 1);
+    for (size_t i = 0; i <= parts; ++i) {
+        candidates[i] = text.size() / parts * i + text.size() % parts * i / parts;
+    }
+
+    // Count the quotes between consecutive candidate cuts
+    std::vector<size_t> quoteCounts(parts, 0);
+    auto countRange = [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            quoteCounts[i] = std::count(text.begin() + candidates[i], text.begin() + candidates[i + 1], '"');
+        }
+    };
+    if (pool && parts > 1) {
+        pool->parallelFor(parts, countRange, 1);
+    } else {
+        countRange(0, parts, 0);
+    }
+
+    // Move every cut past the next line break outside quotes
+    std::vector<size_t> offsets(parts + 1);
+    offsets[0] = 0;
+    offsets[parts] = text.size();
+    size_t quotesBefore = 0;
+    for (size_t i = 1; i < parts; ++i) {
+        quotesBefore += quoteCounts[i - 1];
+        bool inQuotes = quotesBefore % 2 != 0;
+
+        size_t position = candidates[i];
+        while (position < text.size()) {
+            char c = text[position++];
+            if (c == '"') {
+                inQuotes = !inQuotes;
+            } else if (c == '\n' && !inQuotes) {
+                break;
+            }
+        }
+        offsets[i] = std::max(position, offsets[i - 1]);
+    }
+
+    return offsets;
+}
+
+} // namespace sentiment
@@ -1,83 +1,158 @@
 #include "data_loader.h"
-#include <fstream>
-#include <sstream>
+#include "csv_parser.h"
+#include "mapped_file.h"
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 
 namespace sentiment {
 
+namespace {
+
+// Map a CSV file and return its data rows (after the optional header)
+bool mapRows(const std::string& filePath, bool hasHeader, MappedFile& file, std::string_view& rows) {
+    if (!file.open(filePath)) {
+        std::cerr << "Error: Could not open file " << filePath << std::endl;
+        return false;
+    }
+    file.adviseSequential();
+
+    CsvParser parser(std::string_view(file.data(), file.size()));
+    if (hasHeader) {
+        // Header record is ignored
+        std::vector<std::string_view> header;
+        parser.next(header);
+    }
+
+    rows = parser.remaining();
+    return true;
+}
+
+} // namespace
+
 bool DataLoader::loadFromCSV(
     const std::string& filePath,
     bool hasHeader,
     int textColumn,
     int labelColumn
 ) {
-    std::ifstream file(filePath);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file " << filePath << std::endl;
-        return false;
-    }
-
     data.clear();
-    std::string line;
 
-    // Skip header if present
-    if (hasHeader && std::getline(file, line)) {
-        // Header line is ignored
+    MappedFile file;
+    std::string_view rows;
+    if (!mapRows(filePath, hasHeader, file, rows)) {
+        return false;
     }
 
-    // Process data rows
-    while (std::getline(file, line)) {
-        std::istringstream ss(line);
-        std::string token;
-        std::vector<std::string> tokens;
-
-        // Parse CSV line
-        while (std::getline(ss, token, ',')) {
-            // Handle quoted fields
-            if (!token.empty() && token.front() == '"') {
-                // Remove starting quote
-                token = token.substr(1);
-
-                // If the field doesn't end with a quote, read more tokens
-                if (token.empty() || token.back() != '"') {
-                    std::string more;
-                    while (std::getline(ss, more, ',')) {
-                        token += "," + more;
-                        if (!more.empty() && more.back() == '"') {
-                            break;
-                        }
-                    }
+    // Parse record-aligned parts of the file independently
+    size_t parts = threadPool ? threadPool->size() * 4 : 1;
+    std::vector<size_t> offsets = CsvParser::splitRecords(rows, parts, threadPool.get());
+    std::vector<std::vector<TextData>> partData(parts);
+    std::vector<std::vector<std::string>> partWarnings(parts);
+
+    auto parseParts = [&](size_t begin, size_t end, size_t) {
+        std::vector<std::string_view> fields;
+        TextData textData;
+        for (size_t part = begin; part < end; ++part) {
+            CsvParser parser(rows.substr(offsets[part], offsets[part + 1] - offsets[part]));
+            while (parser.next(fields)) {
+                if (!parseRecord(fields, textColumn, labelColumn, textData)) {
+                    partWarnings[part].emplace_back(parser.record());
+                    continue;
                 }
 
-                // Remove ending quote if present
-                if (!token.empty() && token.back() == '"') {
-                    token.pop_back();
+                // Only add data with valid labels
+                if (textData.label != SentimentLabel::UNKNOWN) {
+                    partData[part].push_back(std::move(textData));
                 }
             }
+        }
+    };
+
+    if (threadPool) {
+        threadPool->parallelFor(parts, parseParts, 1);
+    } else {
+        parseParts(0, parts, 0);
+    }
 
-            tokens.push_back(token);
+    // Concatenate the parts in file order
+    size_t total = 0;
+    for (const auto& rowsOfPart : partData) {
+        total += rowsOfPart.size();
+    }
+    data.reserve(total);
+
+    for (size_t part = 0; part < parts; ++part) {
+        for (const auto& record : partWarnings[part]) {
+            std::cerr << "Warning: Line doesn't have enough columns: " << record << std::endl;
         }
+        for (auto& row : partData[part]) {
+            data.push_back(std::move(row));
+        }
+    }
+
+    if (data.empty()) {
+        std::cerr << "Warning: No valid data loaded from file" << std::endl;
+        return false;
+    }
+
+    return true;
+}
 
-        // Ensure we have enough columns
-        if (static_cast<size_t>(std::max(textColumn, labelColumn) + 1) > tokens.size()) {
-            std::cerr << "Warning: Line doesn't have enough columns: " << line << std::endl;
+bool DataLoader::streamCSV(
+    const std::string& filePath,
+    size_t chunkSize,
+    const ChunkCallback& onChunk,
+    bool hasHeader,
+    int textColumn,
+    int labelColumn
+) {
+    if (chunkSize == 0) {
+        std::cerr << "Error: Chunk size must be positive" << std::endl;
+        return false;
+    }
+
+    MappedFile file;
+    std::string_view rows;
+    if (!mapRows(filePath, hasHeader, file, rows)) {
+        return false;
+    }
+
+    // Process data rows one chunk at a time
+    CsvParser parser(rows);
+    std::vector<std::string_view> fields;
+    std::vector<TextData> chunk;
+    chunk.reserve(chunkSize);
+    size_t validRows = 0;
+    TextData textData;
+
+    while (parser.next(fields)) {
+        if (!parseRecord(fields, textColumn, labelColumn, textData)) {
+            std::cerr << "Warning: Line doesn't have enough columns: " << parser.record() << std::endl;
             continue;
         }
 
-        TextData textData;
-        textData.text = tokens[textColumn];
-        textData.label = stringToSentiment(tokens[labelColumn]);
-
         // Only add data with valid labels
-        if (textData.label != SentimentLabel::UNKNOWN) {
-            data.push_back(textData);
+        if (textData.label == SentimentLabel::UNKNOWN) {
+            continue;
+        }
+
+        chunk.push_back(std::move(textData));
+        ++validRows;
+
+        if (chunk.size() == chunkSize) {
+            if (!onChunk(chunk)) {
+                return false;
+            }
+            chunk.clear();
         }
     }
 
-    file.close();
+    if (!chunk.empty() && !onChunk(chunk)) {
+        return false;
+    }
 
-    if (data.empty()) {
+    if (validRows == 0) {
         std::cerr << "Warning: No valid data loaded from file" << std::endl;
         return false;
     }
@@ -85,13 +160,40 @@ bool DataLoader::loadFromCSV(
     return true;
 }
 
+bool DataLoader::parseRecord(
+    const std::vector<std::string_view>& fields,
+    int textColumn,
+    int labelColumn,
+    TextData& row
+) {
+    // Ensure we have enough columns
+    if (textColumn < 0 || labelColumn < 0 ||
+        static_cast<size_t>(std::max(textColumn, labelColumn) + 1) > fields.size()) {
+        return false;
+    }
+
+    row.text.assign(fields[textColumn]);
+    row.label = stringToSentiment(std::string(fields[labelColumn]));
+    return true;
+}
+
+void DataLoader::setThreadPool(std::shared_ptr<ThreadPool> pool) {
+    threadPool = std::move(pool);
+}
+
 const std::vector<TextData>& DataLoader::getData() const {
     return data;
 }
 
-std::pair<std::vector<TextData>, std::vector<TextData>>
-DataLoader::splitTrainValidation(double trainRatio) const {
-    return trainValidationSplit(data, trainRatio);
+DataSplit DataLoader::splitTrainValidation(double trainRatio, uint64_t seed) {
+    std::vector<size_t> order;
+    size_t trainSize = trainValidationOrder(data, trainRatio, seed, order);
+    permuteInPlace(data, order);
+
+    return {
+        ConstSpan<TextData>(data.data(), trainSize),
+        ConstSpan<TextData>(data.data() + trainSize, data.size() - trainSize)
+    };
 }
 
 } // namespace sentiment
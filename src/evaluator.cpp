@@ -1,76 +1,170 @@
 #include "evaluator.h"
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <numeric>
 
 namespace sentiment {
 
-Evaluator::Evaluator(const Model& model) : model(model) {
+namespace {
+
+static_assert(static_cast<size_t>(SentimentLabel::UNKNOWN) + 1 == ConfusionMatrix::kLabelCount,
+              "Confusion matrix rows must cover every SentimentLabel value");
+
+// Documents scored per predictBatch call in accumulate()
+constexpr size_t kPredictBlockSize = 256;
+
+double computeF1(double precision, double recall) {
+    if (precision + recall > 0.0) {
+        return 2.0 * (precision * recall) / (precision + recall);
+    }
+
+    return 0.0;
 }
 
-EvaluationMetrics Evaluator::evaluate(const std::vector<FeatureVector>& validationData) {
-    if (validationData.empty()) {
-        std::cerr << "Error: Validation data is empty" << std::endl;
-        return {0.0, 0.0, 0.0, 0.0};
+} // namespace
+
+void ConfusionMatrix::merge(const ConfusionMatrix& other) {
+    for (size_t i = 0; i < counts.size(); ++i) {
+        counts[i] += other.counts[i];
     }
+}
 
-    // Clear previous results
-    confusionMatrix.clear();
+uint64_t ConfusionMatrix::actualCount(SentimentLabel label) const {
+    uint64_t count = 0;
+    for (size_t predicted = 0; predicted < kLabelCount; ++predicted) {
+        count += at(label, static_cast<SentimentLabel>(predicted));
+    }
+    return count;
+}
 
-    // Initialize confusion matrix
-    for (const auto& example : validationData) {
-        if (confusionMatrix.find(example.label) == confusionMatrix.end()) {
-            confusionMatrix[example.label] = {};
-        }
+uint64_t ConfusionMatrix::predictedCount(SentimentLabel label) const {
+    uint64_t count = 0;
+    for (size_t actual = 0; actual < kLabelCount; ++actual) {
+        count += at(static_cast<SentimentLabel>(actual), label);
     }
+    return count;
+}
 
-    // Evaluate model on validation data
-    for (const auto& example : validationData) {
-        SentimentLabel predicted = model.predict(example.features);
-        confusionMatrix[example.label][predicted]++;
+uint64_t ConfusionMatrix::total() const {
+    return std::accumulate(counts.begin(), counts.end(), uint64_t{0});
+}
+
+EvaluationMetrics ConfusionMatrix::metrics() const {
+    uint64_t examples = total();
+    if (examples == 0) {
+        return {0.0, 0.0, 0.0, 0.0};
     }
 
-    // Compute metrics
-    double accuracyVal = computeAccuracy();
+    uint64_t correct = 0;
     double precisionSum = 0.0;
     double recallSum = 0.0;
     int labelCount = 0;
 
-    // Calculate precision and recall for each label
-    for (const auto& [label, _] : confusionMatrix) {
-        double precision = computePrecision(label);
-        double recall = computeRecall(label);
+    // Average precision and recall over the labels that occur in the data
+    for (size_t index = 0; index < kLabelCount; ++index) {
+        SentimentLabel label = static_cast<SentimentLabel>(index);
+        uint64_t truePositives = at(label, label);
+        correct += truePositives;
 
-        if (!std::isnan(precision) && !std::isnan(recall)) {
-            precisionSum += precision;
-            recallSum += recall;
-            labelCount++;
+        uint64_t actual = actualCount(label);
+        if (actual == 0) {
+            continue;
         }
-    }
 
-    // Calculate macro-averaged precision and recall
-    double macroAvgPrecision = labelCount > 0 ? precisionSum / labelCount : 0.0;
-    double macroAvgRecall = labelCount > 0 ? recallSum / labelCount : 0.0;
+        uint64_t predicted = predictedCount(label);
+        precisionSum += predicted > 0 ? static_cast<double>(truePositives) / predicted : 0.0;
+        recallSum += static_cast<double>(truePositives) / actual;
+        labelCount++;
+    }
 
-    // Calculate macro-averaged F1 score
-    double f1ScoreVal = computeF1(macroAvgPrecision, macroAvgRecall);
+    double macroAvgPrecision = precisionSum / labelCount;
+    double macroAvgRecall = recallSum / labelCount;
 
-    // Store metrics
-    metrics = {
-        accuracyVal,
+    return {
+        static_cast<double>(correct) / examples,
         macroAvgPrecision,
         macroAvgRecall,
-        f1ScoreVal
+        computeF1(macroAvgPrecision, macroAvgRecall)
     };
+}
+
+Evaluator::Evaluator(const Model& model) : model(model) {
+}
+
+EvaluationMetrics Evaluator::evaluate(const std::vector<FeatureVector>& validationData) {
+    if (validationData.empty()) {
+        std::cerr << "Error: Validation data is empty" << std::endl;
+        return {0.0, 0.0, 0.0, 0.0};
+    }
+
+    reset();
+    accumulate(validationData);
+    return finish();
+}
+
+void Evaluator::reset() {
+    confusionMatrix = ConfusionMatrix{};
+    metrics = EvaluationMetrics{};
+}
+
+template<typename CountRange>
+void Evaluator::countParallel(size_t count, CountRange&& countRange) {
+    if (!threadPool || count <= kPredictBlockSize) {
+        countRange(0, count, confusionMatrix);
+        return;
+    }
+
+    // Each worker counts into its own matrix; merging them is exact
+    workerMatrices.assign(threadPool->size(), ConfusionMatrix{});
+    threadPool->parallelFor(count, [&](size_t begin, size_t end, size_t worker) {
+        countRange(begin, end, workerMatrices[worker]);
+    }, kPredictBlockSize);
+
+    for (const ConfusionMatrix& partial : workerMatrices) {
+        confusionMatrix.merge(partial);
+    }
+}
+
+void Evaluator::accumulate(const std::vector<FeatureVector>& batch) {
+    countParallel(batch.size(), [&](size_t begin, size_t end, ConfusionMatrix& matrix) {
+        SentimentLabel predicted[kPredictBlockSize];
+        for (size_t block = begin; block < end; block += kPredictBlockSize) {
+            size_t size = std::min(kPredictBlockSize, end - block);
+            model.predictBatch(batch.data() + block, size, predicted);
+            for (size_t i = 0; i < size; ++i) {
+                matrix.add(batch[block + i].label, predicted[i]);
+            }
+        }
+    });
+}
 
+void Evaluator::accumulate(const SparseVector* documents, const SentimentLabel* labels, size_t count) {
+    countParallel(count, [&](size_t begin, size_t end, ConfusionMatrix& matrix) {
+        SentimentLabel predicted[kPredictBlockSize];
+        for (size_t block = begin; block < end; block += kPredictBlockSize) {
+            size_t size = std::min(kPredictBlockSize, end - block);
+            model.predictBatch(documents + block, size, predicted);
+            for (size_t i = 0; i < size; ++i) {
+                matrix.add(labels[block + i], predicted[i]);
+            }
+        }
+    });
+}
+
+EvaluationMetrics Evaluator::finish() {
+    metrics = confusionMatrix.metrics();
     return metrics;
 }
 
-const std::unordered_map<SentimentLabel,
-      std::unordered_map<SentimentLabel, int>>& Evaluator::getConfusionMatrix() const {
+const ConfusionMatrix& Evaluator::getConfusionMatrix() const {
     return confusionMatrix;
 }
 
+void Evaluator::setThreadPool(std::shared_ptr<ThreadPool> pool) {
+    threadPool = std::move(pool);
+}
+
 void Evaluator::printResults() const {
     std::cout << "\n--- Evaluation Results for " << model.getName() << " ---\n";
     std::cout << "Accuracy:  " << std::fixed << std::setprecision(4) << metrics.accuracy * 100 << "%\n";
@@ -83,17 +177,15 @@ void Evaluator::printResults() const {
     std::cout << "-----------------\n";
     std::cout << std::setw(10) << "Actual\\Pred";
 
-    // Get all sentiment labels
+    // Labels that occur in the data, in enum order
     std::vector<SentimentLabel> labels;
-    for (const auto& [label, _] : confusionMatrix) {
-        labels.push_back(label);
+    for (size_t index = 0; index < ConfusionMatrix::kLabelCount; ++index) {
+        SentimentLabel label = static_cast<SentimentLabel>(index);
+        if (confusionMatrix.actualCount(label) > 0) {
+            labels.push_back(label);
+        }
     }
 
-    // Sort labels for consistent output
-    std::sort(labels.begin(), labels.end(), [](SentimentLabel a, SentimentLabel b) {
-        return static_cast<int>(a) < static_cast<int>(b);
-    });
-
     // Print column headers
     for (const auto& label : labels) {
         std::cout << std::setw(10) << sentimentToString(label);
@@ -105,12 +197,7 @@ void Evaluator::printResults() const {
         std::cout << std::setw(10) << sentimentToString(trueLabel);
 
         for (const auto& predLabel : labels) {
-            int count = 0;
-            if (confusionMatrix.count(trueLabel) > 0 &&
-                confusionMatrix.at(trueLabel).count(predLabel) > 0) {
-                count = confusionMatrix.at(trueLabel).at(predLabel);
-            }
-            std::cout << std::setw(10) << count;
+            std::cout << std::setw(10) << confusionMatrix.at(trueLabel, predLabel);
         }
         std::cout << "\n";
     }
@@ -118,83 +205,4 @@ void Evaluator::printResults() const {
     std::cout << std::endl;
 }
 
-double Evaluator::computePrecision(SentimentLabel label) const {
-    int truePositives = 0;
-    int falsePositives = 0;
-
-    // Count true positives and false positives
-    for (const auto& [trueLabel, predictions] : confusionMatrix) {
-        for (const auto& [predLabel, count] : predictions) {
-            if (predLabel == label) {
-                if (trueLabel == label) {
-                    truePositives += count;
-                } else {
-                    falsePositives += count;
-                }
-            }
-        }
-    }
-
-    // Calculate precision
-    if (truePositives + falsePositives > 0) {
-        return static_cast<double>(truePositives) / (truePositives + falsePositives);
-    }
-
-    return 0.0;
-}
-
-double Evaluator::computeRecall(SentimentLabel label) const {
-    int truePositives = 0;
-    int falseNegatives = 0;
-
-    // Count true positives
-    if (confusionMatrix.count(label) > 0) {
-        const auto& predictions = confusionMatrix.at(label);
-        for (const auto& [predLabel, count] : predictions) {
-            if (predLabel == label) {
-                truePositives += count;
-            } else {
-                falseNegatives += count;
-            }
-        }
-    }
-
-    // Calculate recall
-    if (truePositives + falseNegatives > 0) {
-        return static_cast<double>(truePositives) / (truePositives + falseNegatives);
-    }
-
-    return 0.0;
-}
-
-double Evaluator::computeF1(double precision, double recall) const {
-    if (precision + recall > 0.0) {
-        return 2.0 * (precision * recall) / (precision + recall);
-    }
-
-    return 0.0;
-}
-
-double Evaluator::computeAccuracy() const {
-    int correct = 0;
-    int total = 0;
-
-    // Count correct predictions and total predictions
-    for (const auto& [trueLabel, predictions] : confusionMatrix) {
-        for (const auto& [predLabel, count] : predictions) {
-            if (trueLabel == predLabel) {
-                correct += count;
-            }
-            total += count;
-        }
-    }
-
-    // Calculate accuracy
-    if (total > 0) {
-        return static_cast<double>(correct) / total;
-    }
-
-    return 0.0;
-}
-
 } // namespace sentiment
@@ -1,4 +1,6 @@
 #include "feature_extractor.h"
+#include "pipeline_stats.h"
+#include "sparse_kernels.h"
 #include <cmath>
 #include <algorithm>
 #include <unordered_map>
@@ -7,6 +9,52 @@
 
 namespace sentiment {
 
+namespace {
+
+// Documents tokenized per parallel block while counting
+constexpr size_t kCountBlockSize = 4096;
+
+// Count-min sketch shape and candidate table size used for n-gram counting
+constexpr size_t kSketchWidth = size_t{1} << 18;
+constexpr size_t kSketchDepth = 4;
+constexpr size_t kNgramCapacity = size_t{1} << 16;
+
+// Calls visit(hash, start, length) for every n-gram with a length in
+// [minLength, maxLength], rolling the hash forward from the token hashes
+template<typename Visit>
+void forEachNgram(const std::vector<uint64_t>& hashes, size_t minLength, size_t maxLength, Visit&& visit) {
+    for (size_t start = 0; start < hashes.size(); ++start) {
+        uint64_t hash = hashes[start];
+        for (size_t length = 1; length <= maxLength && start + length <= hashes.size(); ++length) {
+            if (length > 1) {
+                hash = combineHashes(hash, hashes[start + length - 1]);
+            }
+            if (length >= minLength) {
+                visit(hash, start, length);
+            }
+        }
+    }
+}
+
+// Check whether a vocabulary term is the given tokens joined by spaces
+bool matchesTokens(std::string_view term, const std::string_view* tokens, size_t length) {
+    for (size_t k = 0; k < length; ++k) {
+        if (k > 0) {
+            if (term.empty() || term.front() != ' ') {
+                return false;
+            }
+            term.remove_prefix(1);
+        }
+        if (term.substr(0, tokens[k].size()) != tokens[k]) {
+            return false;
+        }
+        term.remove_prefix(tokens[k].size());
+    }
+    return term.empty();
+}
+
+} // namespace
+
 FeatureExtractor::FeatureExtractor(
     const Preprocessor& preprocessor,
     Method method
@@ -14,145 +62,618 @@ FeatureExtractor::FeatureExtractor(
 }
 
 void FeatureExtractor::buildVocabulary(
-    const std::vector<TextData>& textData,
+    ConstSpan<TextData> textData,
     int minFrequency,
     size_t maxVocabSize
 ) {
-    // Count word frequencies across all documents
-    std::unordered_map<std::string, int> wordFrequencies;
-    std::unordered_map<std::string, int> documentOccurrences;
+    resetVocabularyCounts();
+    countVocabulary(textData);
+    finalizeVocabulary(minFrequency, maxVocabSize);
+}
 
-    documentCount = textData.size();
+void FeatureExtractor::resetVocabularyCounts() {
+    pendingWords.clear();
+    pendingWordCounts = std::vector<size_t>();
+    pendingWordDocuments = std::vector<size_t>();
+    pendingDocumentCount = 0;
+    pendingNgrams.clear();
+    ngramFrequencies = CountMinSketch();
+    ngramDocumentOccurrences = CountMinSketch();
+    ngramAdmissionCount = 0;
+}
 
-    // First pass: count word frequencies and document occurrences
-    for (const auto& data : textData) {
-        // Get tokens for this document
-        std::vector<std::string> tokens = preprocessor.preprocess(data.text);
+void FeatureExtractor::countVocabulary(ConstSpan<TextData> textData) {
+    pendingDocumentCount += textData.size();
 
-        // Keep track of words seen in this document
-        std::unordered_set<std::string> uniqueWordsInDoc;
+    // Hashed features need no vocabulary
+    if (method == Method::HASHING) {
+        return;
+    }
+
+    bool needUnigrams = ngramMin == 1;
+    bool needNgrams = ngramMax > 1;
+    if (needNgrams && ngramFrequencies.empty()) {
+        ngramFrequencies = CountMinSketch(kSketchWidth, kSketchDepth);
+        ngramDocumentOccurrences = CountMinSketch(kSketchWidth, kSketchDepth);
+    }
 
-        // Count token frequencies
-        for (const auto& token : tokens) {
-            wordFrequencies[token]++;
-            uniqueWordsInDoc.insert(token);
+    // Each worker interns tokens into its own table and counts by term id,
+    // so every token is hashed once and never copied into a string
+    struct WorkerCounts {
+        TermInterner words;
+        std::vector<size_t> frequencies;
+        std::vector<size_t> occurrences;
+        std::vector<size_t> lastDocument; ///< Last document (index + 1) that counted a word
+        std::string buffer;
+        std::vector<std::string_view> tokens;
+    };
+    size_t workerCount = threadPool ? threadPool->size() : 1;
+    std::vector<WorkerCounts> workers(workerCount);
+
+    // Token ids of each document in a block, and the worker that interned them
+    std::vector<std::vector<uint32_t>> blockTokens;
+    std::vector<size_t> blockWorkers;
+
+    // Tokenize and count one block of documents at a time
+    for (size_t blockBegin = 0; blockBegin < textData.size(); blockBegin += kCountBlockSize) {
+        size_t blockSize = std::min(kCountBlockSize, textData.size() - blockBegin);
+        if (needNgrams) {
+            blockTokens.assign(blockSize, {});
+            blockWorkers.assign(blockSize, 0);
         }
 
-        // Update document occurrences
-        for (const auto& word : uniqueWordsInDoc) {
-            documentOccurrences[word]++;
+        // Count word frequencies and document occurrences
+        auto countRange = [&](size_t begin, size_t end, size_t worker) {
+            WorkerCounts& counts = workers[worker];
+
+            for (size_t i = begin; i < end; ++i) {
+                size_t document = blockBegin + i + 1;
+                preprocessor.tokenizeInto(textData[blockBegin + i].text, counts.buffer, counts.tokens);
+
+                for (const auto& token : counts.tokens) {
+                    uint32_t id = counts.words.intern(token);
+                    if (id == counts.frequencies.size()) {
+                        counts.frequencies.push_back(0);
+                        counts.occurrences.push_back(0);
+                        counts.lastDocument.push_back(0);
+                    }
+
+                    if (needUnigrams) {
+                        counts.frequencies[id]++;
+                        if (counts.lastDocument[id] != document) {
+                            counts.lastDocument[id] = document;
+                            counts.occurrences[id]++;
+                        }
+                    }
+                    if (needNgrams) {
+                        blockTokens[i].push_back(id);
+                    }
+                }
+                if (needNgrams) {
+                    blockWorkers[i] = worker;
+                }
+            }
+        };
+
+        if (threadPool) {
+            threadPool->parallelFor(blockSize, countRange);
+        } else {
+            countRange(0, blockSize, 0);
+        }
+
+        // N-grams go through the sketches in document order, so the
+        // candidates do not depend on the thread count
+        std::vector<std::string_view> tokens;
+        std::vector<uint64_t> hashes;
+        for (size_t i = 0; i < blockTokens.size(); ++i) {
+            const TermInterner& words = workers[blockWorkers[i]].words;
+            tokens.clear();
+            hashes.clear();
+            for (uint32_t id : blockTokens[i]) {
+                tokens.push_back(words.term(id));
+                hashes.push_back(words.hash(id));
+            }
+            countNgrams(tokens, hashes);
+        }
+        blockTokens.clear();
+    }
+
+    // Merge the per-worker counts into the running totals
+    if (!needUnigrams) {
+        return;
+    }
+    for (WorkerCounts& counts : workers) {
+        for (uint32_t id = 0; id < counts.words.size(); ++id) {
+            uint32_t word = pendingWords.intern(counts.words.term(id), counts.words.hash(id));
+            if (word == pendingWordCounts.size()) {
+                pendingWordCounts.push_back(0);
+                pendingWordDocuments.push_back(0);
+            }
+            pendingWordCounts[word] += counts.frequencies[id];
+            pendingWordDocuments[word] += counts.occurrences[id];
         }
+        counts.words.clear();
     }
+}
 
-    // Filter words by minimum frequency
-    std::vector<std::pair<std::string, int>> filteredWords;
-    for (const auto& [word, count] : wordFrequencies) {
-        if (count >= minFrequency) {
-            filteredWords.push_back({word, count});
+void FeatureExtractor::countNgrams(
+    const std::vector<std::string_view>& tokens,
+    const std::vector<uint64_t>& hashes
+) {
+    std::vector<uint64_t> documentNgrams;
+    forEachNgram(hashes, std::max<size_t>(ngramMin, 2), ngramMax,
+                 [&](uint64_t hash, size_t start, size_t length) {
+        uint32_t estimate = ngramFrequencies.add(hash);
+        documentNgrams.push_back(hash);
+
+        // Only frequent n-grams keep their text; the rest live in the sketch
+        if (estimate >= ngramAdmissionCount && pendingNgrams.find(hash) == pendingNgrams.end()) {
+            std::string term(tokens[start]);
+            for (size_t k = 1; k < length; ++k) {
+                term += ' ';
+                term += tokens[start + k];
+            }
+            pendingNgrams.emplace(hash, std::move(term));
+
+            if (pendingNgrams.size() > kNgramCapacity) {
+                pruneNgrams();
+            }
         }
+    });
+
+    // Count each n-gram once per document
+    std::sort(documentNgrams.begin(), documentNgrams.end());
+    documentNgrams.erase(std::unique(documentNgrams.begin(), documentNgrams.end()), documentNgrams.end());
+    for (uint64_t hash : documentNgrams) {
+        ngramDocumentOccurrences.add(hash);
+    }
+}
+
+void FeatureExtractor::pruneNgrams() {
+    // Keep the most frequent half of the candidates (ties broken by hash)
+    std::vector<std::pair<uint32_t, uint64_t>> ranked;
+    ranked.reserve(pendingNgrams.size());
+    for (const auto& [hash, _] : pendingNgrams) {
+        ranked.push_back({ngramFrequencies.estimate(hash), hash});
     }
 
-    // Sort by frequency (descending)
+    size_t keep = kNgramCapacity / 2;
+    std::nth_element(ranked.begin(), ranked.begin() + keep, ranked.end(),
+                     [](const auto& a, const auto& b) {
+                         return a.first != b.first ? a.first > b.first : a.second < b.second;
+                     });
+
+    // New candidates must now be more frequent than anything evicted
+    uint32_t evictedCount = 0;
+    for (size_t i = keep; i < ranked.size(); ++i) {
+        evictedCount = std::max(evictedCount, ranked[i].first);
+        pendingNgrams.erase(ranked[i].second);
+    }
+    ngramAdmissionCount = std::max(ngramAdmissionCount, evictedCount + 1);
+}
+
+void FeatureExtractor::forEachCountedTerm(
+    const std::function<void(std::string_view term, size_t count, size_t documents)>& visit
+) const {
+    for (uint32_t id = 0; id < pendingWords.size(); ++id) {
+        visit(pendingWords.term(id), pendingWordCounts[id], pendingWordDocuments[id]);
+    }
+    for (const auto& [hash, term] : pendingNgrams) {
+        visit(term, ngramFrequencies.estimate(hash), ngramDocumentOccurrences.estimate(hash));
+    }
+}
+
+void FeatureExtractor::finalizeVocabulary(int minFrequency, size_t maxVocabSize) {
+    documentCount = pendingDocumentCount;
+
+    if (method == Method::HASHING) {
+        vocabularyIndex = VocabularyIndex(std::vector<std::string_view>{});
+        documentFrequencies = ConstArray<double>();
+        updateIdfWeights();
+        resetVocabularyCounts();
+
+        std::cout << "Feature hashing into " << getFeatureCount()
+                  << " dimensions; no vocabulary needed" << std::endl;
+        return;
+    }
+
+    // Filter words and n-grams by minimum frequency; the views stay valid
+    // until the counts are reset
+    std::vector<std::pair<std::string_view, size_t>> filteredWords;
+    forEachCountedTerm([&](std::string_view term, size_t count, size_t) {
+        if (static_cast<long long>(count) >= minFrequency) {
+            filteredWords.push_back({term, count});
+        }
+    });
+
+    // Sort by frequency (descending), alphabetically for equal frequencies
     std::sort(filteredWords.begin(), filteredWords.end(),
-              [](const auto& a, const auto& b) { return a.second > b.second; });
+              [](const auto& a, const auto& b) {
+                  return a.second != b.second ? a.second > b.second : a.first < b.first;
+              });
 
     // Limit vocabulary size if needed
     if (maxVocabSize > 0 && filteredWords.size() > maxVocabSize) {
         filteredWords.resize(maxVocabSize);
     }
 
-    // Build vocabulary mapping
-    vocabulary.clear();
-    size_t index = 0;
+    // Freeze the terms into the flat arena and perfect hash
+    std::vector<std::string_view> terms;
+    terms.reserve(filteredWords.size());
     for (const auto& [word, _] : filteredWords) {
-        vocabulary[word] = index++;
+        terms.push_back(word);
     }
+    vocabularyIndex = VocabularyIndex(terms);
 
     // If using TF-IDF, prepare document frequencies
+    documentFrequencies = ConstArray<double>();
     if (method == Method::TF_IDF) {
-        documentFrequencies.resize(vocabulary.size(), 0.0);
+        std::vector<double> frequencies(vocabularyIndex.size(), 0.0);
 
-        for (const auto& [word, index] : vocabulary) {
-            if (documentOccurrences.find(word) != documentOccurrences.end()) {
-                documentFrequencies[index] = documentOccurrences[word];
+        forEachCountedTerm([&](std::string_view term, size_t, size_t documents) {
+            uint32_t termIndex = vocabularyIndex.find(term);
+            if (termIndex != VocabularyIndex::npos) {
+                frequencies[termIndex] = static_cast<double>(documents);
             }
+        });
+
+        documentFrequencies = ConstArray<double>(std::move(frequencies));
+    }
+    updateIdfWeights();
+
+    // The counts are no longer needed once the vocabulary is fixed
+    resetVocabularyCounts();
+
+    std::cout << "Vocabulary built with " << vocabularyIndex.size() << " words" << std::endl;
+}
+
+size_t FeatureExtractor::extendVocabulary(
+    ConstSpan<TextData> textData,
+    int minFrequency,
+    size_t maxVocabSize
+) {
+    // The hashed feature space is fixed
+    if (method == Method::HASHING) {
+        return 0;
+    }
+
+    resetVocabularyCounts();
+    countVocabulary(textData);
+    documentCount += textData.size();
+
+    // Existing terms keep their indices; new words are ranked like in buildVocabulary
+    std::vector<std::pair<std::string_view, size_t>> newWords;
+    forEachCountedTerm([&](std::string_view term, size_t count, size_t) {
+        if (static_cast<long long>(count) >= minFrequency &&
+            vocabularyIndex.find(term) == VocabularyIndex::npos) {
+            newWords.push_back({term, count});
         }
+    });
+
+    std::sort(newWords.begin(), newWords.end(),
+              [](const auto& a, const auto& b) {
+                  return a.second != b.second ? a.second > b.second : a.first < b.first;
+              });
+
+    size_t oldSize = vocabularyIndex.size();
+    if (maxVocabSize > 0) {
+        newWords.resize(std::min(newWords.size(), maxVocabSize > oldSize ? maxVocabSize - oldSize : 0));
+    }
+
+    std::vector<std::string_view> terms;
+    terms.reserve(oldSize + newWords.size());
+    for (size_t i = 0; i < oldSize; ++i) {
+        terms.push_back(vocabularyIndex.term(i));
+    }
+    for (const auto& [word, _] : newWords) {
+        terms.push_back(word);
+    }
+    VocabularyIndex grown(terms);
+
+    // Add the batch to the document frequencies of old and new terms
+    if (method == Method::TF_IDF) {
+        std::vector<double> frequencies(grown.size(), 0.0);
+        std::copy(documentFrequencies.begin(), documentFrequencies.end(), frequencies.begin());
+        forEachCountedTerm([&](std::string_view term, size_t, size_t documents) {
+            uint32_t index = grown.find(term);
+            if (index != VocabularyIndex::npos) {
+                frequencies[index] += static_cast<double>(documents);
+            }
+        });
+        documentFrequencies = ConstArray<double>(std::move(frequencies));
+    }
+
+    vocabularyIndex = std::move(grown);
+    updateIdfWeights();
+    resetVocabularyCounts();
+
+    std::cout << "Vocabulary extended with " << newWords.size() << " words to "
+              << vocabularyIndex.size() << " words" << std::endl;
+    return newWords.size();
+}
+
+void FeatureExtractor::extractTermIds(std::string_view text, std::vector<uint32_t>& ids) const {
+    InferenceContext context;
+    preprocessor.tokenizeInto(text, context.buffer, context.tokens);
+    lookupTermIds(context);
+    ids = std::move(context.ids);
+}
+
+void FeatureExtractor::lookupTermIds(InferenceContext& context) const {
+    const std::vector<std::string_view>& tokens = context.tokens;
+    context.hashes.clear();
+    for (const auto& token : tokens) {
+        context.hashes.push_back(hashBytes(token));
     }
 
-    std::cout << "Vocabulary built with " << vocabulary.size() << " words" << std::endl;
+    // Map tokens and n-grams to vocabulary indices by their rolled hashes
+    context.ids.clear();
+    forEachNgram(context.hashes, ngramMin, ngramMax, [&](uint64_t hash, size_t start, size_t length) {
+        uint32_t index = vocabularyIndex.findHashed(hash, [&](std::string_view term) {
+            return matchesTokens(term, &tokens[start], length);
+        });
+        if (index != VocabularyIndex::npos) {
+            context.ids.push_back(index);
+        }
+    });
+}
+
+SparseVector FeatureExtractor::extractFeatures(const std::string& text) const {
+    InferenceContext context;
+    extractFeatures(text, context);
+    return std::move(context.features);
 }
 
-std::vector<double> FeatureExtractor::extractFeatures(const std::string& text) const {
+const SparseVector& FeatureExtractor::extractFeatures(
+    std::string_view text,
+    InferenceContext& context
+) const {
     // Preprocess the text
-    std::vector<std::string> tokens = preprocessor.preprocess(text);
+    preprocessor.tokenizeInto(text, context.buffer, context.tokens);
 
-    // Initialize feature vector with zeros
-    std::vector<double> features(vocabulary.size(), 0.0);
+    SENTIMENT_TIME_STAGE(Stage::FEATURE_EXTRACTION);
+    SparseVector& features = context.features;
+    features.indices.clear();
+    features.values.clear();
 
-    // Count token frequencies
-    for (const auto& token : tokens) {
-        auto it = vocabulary.find(token);
-        if (it != vocabulary.end()) {
-            features[it->second] += 1.0;
+    if (method == Method::HASHING) {
+        hashFeatures(context);
+        return features;
+    }
+
+    lookupTermIds(context);
+
+    // Sort indices so that repeated words form runs, then count each run
+    std::vector<uint32_t>& hits = context.ids;
+    std::sort(hits.begin(), hits.end());
+
+    features.dimension = vocabularyIndex.size();
+    for (size_t i = 0; i < hits.size();) {
+        size_t j = i;
+        while (j < hits.size() && hits[j] == hits[i]) {
+            ++j;
         }
+
+        features.indices.push_back(hits[i]);
+        features.values.push_back(static_cast<double>(j - i));
+        i = j;
     }
 
-    // If using TF-IDF, apply the transformation
     if (method == Method::TF_IDF) {
-        for (size_t i = 0; i < features.size(); ++i) {
-            if (features[i] > 0) {
-                features[i] = calculateTfIdf(features[i], i);
+        const double* idf = idfFolded ? nullptr : idfWeights.data();
+        weightTermCounts(features, idf, sublinearTf, l2Normalize);
+
+        // Terms that occur in every training document carry no weight
+        if (idf) {
+            size_t kept = 0;
+            for (size_t k = 0; k < features.nonZeroCount(); ++k) {
+                if (features.values[k] != 0.0) {
+                    features.indices[kept] = features.indices[k];
+                    features.values[kept] = features.values[k];
+                    ++kept;
+                }
             }
+            features.indices.resize(kept);
+            features.values.resize(kept);
         }
     }
 
     return features;
 }
 
+void FeatureExtractor::hashFeatures(InferenceContext& context) const {
+    context.hashes.clear();
+    for (const auto& token : context.tokens) {
+        context.hashes.push_back(hashBytes(token));
+    }
+
+    // Low bits select the feature, the top bit the sign
+    uint64_t mask = (uint64_t{1} << hashBits) - 1;
+    std::vector<uint64_t>& keys = context.keys;
+    keys.clear();
+    forEachNgram(context.hashes, ngramMin, ngramMax, [&](uint64_t hash, size_t, size_t) {
+        keys.push_back(((hash & mask) << 1) | (signedHashing ? hash >> 63 : 0));
+    });
+
+    // Sorting groups the tokens of each feature; sum their signs
+    std::sort(keys.begin(), keys.end());
+
+    SparseVector& features = context.features;
+    features.dimension = getFeatureCount();
+    for (size_t i = 0; i < keys.size();) {
+        uint32_t index = static_cast<uint32_t>(keys[i] >> 1);
+        double value = 0.0;
+        for (; i < keys.size() && (keys[i] >> 1) == index; ++i) {
+            value += (keys[i] & 1) ? -1.0 : 1.0;
+        }
+
+        // Colliding tokens of opposite sign can cancel out
+        if (value != 0.0) {
+            features.indices.push_back(index);
+            features.values.push_back(value);
+        }
+    }
+}
+
+bool FeatureExtractor::setNgramRange(size_t minLength, size_t maxLength) {
+    if (minLength < 1 || minLength > maxLength || maxLength > kMaxNgramLength) {
+        std::cerr << "Error: N-gram range must satisfy 1 <= min <= max <= " << kMaxNgramLength
+                  << ", got " << minLength << ".." << maxLength << std::endl;
+        return false;
+    }
+
+    ngramMin = minLength;
+    ngramMax = maxLength;
+    return true;
+}
+
+size_t FeatureExtractor::getNgramMin() const {
+    return ngramMin;
+}
+
+size_t FeatureExtractor::getNgramMax() const {
+    return ngramMax;
+}
+
 FeatureVector FeatureExtractor::transform(const TextData& textData) const {
     return {extractFeatures(textData.text), textData.label};
 }
 
 std::vector<FeatureVector> FeatureExtractor::batchTransform(
-    const std::vector<TextData>& textDataBatch
+    ConstSpan<TextData> textDataBatch
 ) const {
-    std::vector<FeatureVector> featureVectors;
-    featureVectors.reserve(textDataBatch.size());
+    std::vector<FeatureVector> featureVectors(textDataBatch.size());
 
-    for (const auto& data : textDataBatch) {
-        featureVectors.push_back(transform(data));
+    // Every document is independent, so each worker fills its own slots
+    auto transformRange = [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            featureVectors[i] = transform(textDataBatch[i]);
+        }
+    };
+
+    if (threadPool) {
+        threadPool->parallelFor(textDataBatch.size(), transformRange);
+    } else {
+        transformRange(0, textDataBatch.size(), 0);
     }
 
     return featureVectors;
 }
 
 size_t FeatureExtractor::getVocabularySize() const {
-    return vocabulary.size();
-}
-
-const std::unordered_map<std::string, size_t>& FeatureExtractor::getVocabulary() const {
-    return vocabulary;
+    return vocabularyIndex.size();
 }
 
 FeatureExtractor::Method FeatureExtractor::getMethod() const {
     return method;
 }
 
-double FeatureExtractor::calculateTfIdf(double termFrequency, size_t wordIndex) const {
-    if (documentCount == 0 || wordIndex >= documentFrequencies.size()) {
-        return 0.0;
+size_t FeatureExtractor::getFeatureCount() const {
+    return method == Method::HASHING ? size_t{1} << hashBits : vocabularyIndex.size();
+}
+
+bool FeatureExtractor::setHashing(unsigned bits, bool useSign) {
+    if (bits < 1 || bits > kMaxHashBits) {
+        std::cerr << "Error: Hash bits must be between 1 and " << kMaxHashBits
+                  << ", got " << bits << std::endl;
+        return false;
+    }
+
+    hashBits = bits;
+    signedHashing = useSign;
+    return true;
+}
+
+unsigned FeatureExtractor::getHashBits() const {
+    return hashBits;
+}
+
+bool FeatureExtractor::isSignedHashing() const {
+    return signedHashing;
+}
+
+const VocabularyIndex& FeatureExtractor::getVocabularyIndex() const {
+    return vocabularyIndex;
+}
+
+const ConstArray<double>& FeatureExtractor::getDocumentFrequencies() const {
+    return documentFrequencies;
+}
+
+size_t FeatureExtractor::getDocumentCount() const {
+    return documentCount;
+}
+
+bool FeatureExtractor::setVocabulary(
+    VocabularyIndex index,
+    ConstArray<double> frequencies,
+    size_t documents,
+    Method featureMethod
+) {
+    if (featureMethod == Method::TF_IDF && frequencies.size() != index.size()) {
+        std::cerr << "Error: Document frequency table size " << frequencies.size()
+                  << " does not match vocabulary size " << index.size() << std::endl;
+        return false;
     }
 
-    double docFreq = documentFrequencies[wordIndex];
-    if (docFreq == 0.0) {
-        return 0.0;
+    vocabularyIndex = std::move(index);
+    documentFrequencies = std::move(frequencies);
+    documentCount = documents;
+    method = featureMethod;
+    updateIdfWeights();
+    return true;
+}
+
+void FeatureExtractor::setThreadPool(std::shared_ptr<ThreadPool> pool) {
+    threadPool = std::move(pool);
+}
+
+const ConstArray<double>& FeatureExtractor::getIdfWeights() const {
+    return idfWeights;
+}
+
+void FeatureExtractor::setTfIdfOptions(bool sublinear, bool normalize) {
+    sublinearTf = sublinear;
+    l2Normalize = normalize;
+    idfFolded = idfFolded && !normalize;
+}
+
+bool FeatureExtractor::isSublinearTf() const {
+    return sublinearTf;
+}
+
+bool FeatureExtractor::isL2Normalized() const {
+    return l2Normalize;
+}
+
+bool FeatureExtractor::setIdfFolded(bool folded) {
+    if (folded && (method != Method::TF_IDF || l2Normalize)) {
+        return false;
     }
 
-    // Calculate TF-IDF: tf * log(N/df)
-    double tf = termFrequency;
-    double idf = std::log(static_cast<double>(documentCount) / docFreq);
+    idfFolded = folded;
+    return true;
+}
+
+bool FeatureExtractor::isIdfFolded() const {
+    return idfFolded;
+}
 
-    return tf * idf;
+void FeatureExtractor::updateIdfWeights() {
+    idfWeights = ConstArray<double>();
+    if (method != Method::TF_IDF) {
+        return;
+    }
+
+    // idf = log(N / df); terms without documents get no weight
+    std::vector<double> weights(documentFrequencies.size(), 0.0);
+    for (size_t i = 0; i < weights.size(); ++i) {
+        double docFreq = documentFrequencies[i];
+        if (documentCount > 0 && docFreq > 0.0) {
+            weights[i] = std::log(static_cast<double>(documentCount) / docFreq);
+        }
+    }
+    idfWeights = ConstArray<double>(std::move(weights));
 }
 
 } // namespace sentiment
@@ -0,0 +1,192 @@
+#include "file_predictor.h"
+#include "concurrent_queue.h"
+#include "inference_context.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace sentiment {
+
+namespace {
+
+// Lines of the input and their formatted predictions
+struct Batch {
+    uint64_t sequence = 0;                ///< Position of the batch in the input
+    std::vector<std::string_view> lines;  ///< Views into the mapped input
+    std::string output;                   ///< One "label,score" line per input line
+};
+
+// Buffers a worker reuses for every batch, so scoring stops allocating
+// once they have grown to the batch size
+struct WorkerScratch {
+    InferenceContext context;
+    std::vector<SparseVector> features;
+    std::vector<SentimentLabel> labels;
+    std::vector<double> scores;
+};
+
+void scoreBatch(const ModelSnapshot& snapshot, Batch& batch, WorkerScratch& scratch) {
+    const size_t count = batch.lines.size();
+    if (scratch.features.size() < count) {
+        scratch.features.resize(count);
+    }
+    scratch.labels.resize(count);
+    scratch.scores.resize(count);
+
+    // Copy-assignment keeps each vector's capacity
+    const FeatureExtractor& extractor = snapshot.getFeatureExtractor();
+    for (size_t i = 0; i < count; ++i) {
+        scratch.features[i] = extractor.extractFeatures(batch.lines[i], scratch.context);
+    }
+    snapshot.getModel().predictBatch(scratch.features.data(), count,
+                                     scratch.labels.data(), scratch.scores.data());
+
+    batch.output.clear();
+    char score[32];
+    for (size_t i = 0; i < count; ++i) {
+        batch.output += sentimentToString(scratch.labels[i]);
+        batch.output += ',';
+        int length = std::snprintf(score, sizeof(score), "%.17g", scratch.scores[i]);
+        batch.output.append(score, static_cast<size_t>(length));
+        batch.output += '\n';
+    }
+}
+
+bool isEmptyFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return file.is_open() && file.peek() == std::ifstream::traits_type::eof();
+}
+
+} // namespace
+
+FilePredictor::FilePredictor(
+    std::shared_ptr<const ModelSnapshot> snapshot,
+    const FilePredictionConfig& config
+) : snapshot(std::move(snapshot)), config(config) {
+}
+
+bool FilePredictor::run(const std::string& inputPath, const std::string& outputPath) {
+    auto startTime = std::chrono::steady_clock::now();
+    stats = FilePredictionStats{};
+
+    MappedFile input;
+    bool mapped = input.open(inputPath);
+    if (!mapped && !isEmptyFile(inputPath)) {
+        std::cerr << "Error: Could not open input file " << inputPath << std::endl;
+        return false;
+    }
+    input.adviseSequential();
+
+    std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+        std::cerr << "Error: Could not open output file " << outputPath << std::endl;
+        return false;
+    }
+
+    size_t workerCount = config.workerThreads > 0
+        ? config.workerThreads
+        : std::max<size_t>(1, std::thread::hardware_concurrency());
+    const size_t batchLines = std::max<size_t>(1, config.batchLines);
+    const size_t inFlight = config.batchesInFlight > 0 ? config.batchesInFlight : 4 * workerCount;
+
+    // Every batch buffer is in exactly one place: free (reader), ready
+    // (workers), done (writer) or being processed, so no queue overflows
+    std::vector<Batch> batches(inFlight);
+    SpscQueue<Batch*> freeBatches(inFlight);
+    MpmcQueue<Batch*> readyBatches(inFlight);
+    MpmcQueue<Batch*> doneBatches(inFlight);
+    for (Batch& batch : batches) {
+        pushWait(freeBatches, &batch);
+    }
+
+    std::atomic<bool> writeFailed{false};
+    std::thread writer([&] {
+        // At most inFlight batches are outstanding, so their sequence
+        // numbers map to distinct slots
+        std::vector<Batch*> pending(inFlight, nullptr);
+        uint64_t next = 0;
+        while (Batch* batch = popWait<Batch*>(doneBatches)) {
+            pending[batch->sequence % inFlight] = batch;
+            while (Batch* ready = pending[next % inFlight]) {
+                pending[next % inFlight] = nullptr;
+                if (!writeFailed.load(std::memory_order_relaxed) &&
+                    !output.write(ready->output.data(), static_cast<std::streamsize>(ready->output.size()))) {
+                    writeFailed.store(true, std::memory_order_relaxed);
+                }
+                next++;
+                pushWait(freeBatches, ready);
+            }
+        }
+    });
+
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < workerCount; ++w) {
+        workers.emplace_back([&] {
+            WorkerScratch scratch;
+            while (Batch* batch = popWait<Batch*>(readyBatches)) {
+                scoreBatch(*snapshot, *batch, scratch);
+                pushWait(doneBatches, batch);
+            }
+        });
+    }
+
+    // Read on the calling thread; scanning for line breaks faults the
+    // mapped pages in ahead of the workers
+    const char* data = mapped ? input.data() : nullptr;
+    const size_t size = mapped ? input.size() : 0;
+    size_t position = 0;
+    uint64_t sequence = 0;
+    while (position < size && !writeFailed.load(std::memory_order_relaxed)) {
+        Batch* batch = popWait<Batch*>(freeBatches);
+        batch->sequence = sequence++;
+        batch->lines.clear();
+        while (batch->lines.size() < batchLines && position < size) {
+            const void* newline = std::memchr(data + position, '\n', size - position);
+            size_t end = newline ? static_cast<size_t>(static_cast<const char*>(newline) - data) : size;
+            size_t length = end - position;
+            if (length > 0 && data[position + length - 1] == '\r') {
+                length--;
+            }
+            batch->lines.emplace_back(data + position, length);
+            position = newline ? end + 1 : size;
+        }
+        stats.lines += batch->lines.size();
+        pushWait(readyBatches, batch);
+    }
+
+    // Each worker exits on its own end marker; the writer's comes last, after
+    // every batch has been queued for it
+    for (size_t w = 0; w < workerCount; ++w) {
+        pushWait(readyBatches, static_cast<Batch*>(nullptr));
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    pushWait(doneBatches, static_cast<Batch*>(nullptr));
+    writer.join();
+
+    output.close();
+    bool success = !writeFailed.load() && !output.fail();
+    if (!success) {
+        std::cerr << "Error: Failed to write predictions to " << outputPath << std::endl;
+    }
+
+    stats.batches = sequence;
+    stats.bytesRead = size;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    return success;
+}
+
+const FilePredictionStats& FilePredictor::getStats() const {
+    return stats;
+}
+
+} // namespace sentiment
@@ -0,0 +1,580 @@
+#include "inference_server.h"
+#include "pipeline_stats.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace sentiment {
+
+namespace {
+
+constexpr size_t kMaxHeaderBytes = 16 * 1024; // Request line plus headers
+constexpr int kPollSliceMs = 100;             // How often blocked threads notice stop()
+
+std::string makeResponse(
+    int status,
+    const char* reason,
+    const std::string& body,
+    bool keepAlive,
+    const char* contentType = "text/plain",
+    const char* extraHeaders = ""
+) {
+    std::string response = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n";
+    response += "Content-Type: ";
+    response += contentType;
+    response += "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n";
+    response += keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    response += extraHeaders;
+    response += "\r\n";
+    response += body;
+    return response;
+}
+
+#ifndef _WIN32
+std::string toLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+}
+
+bool sendAll(int socket, const std::string& data) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL; // A closed peer must not raise SIGPIPE
+#else
+    const int flags = 0;
+#endif
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t written = ::send(socket, data.data() + sent, data.size() - sent, flags);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Wait for readable data and append it to buffer; false on close, error or timeout
+bool receiveMore(int socket, std::string& buffer, int timeoutMs, const std::atomic<bool>& running) {
+    char chunk[16 * 1024];
+    for (int waited = 0; waited < timeoutMs; waited += kPollSliceMs) {
+        if (!running) {
+            return false;
+        }
+
+        pollfd descriptor{socket, POLLIN, 0};
+        int ready = ::poll(&descriptor, 1, kPollSliceMs);
+        if (ready < 0 && errno != EINTR) {
+            return false;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+
+        ssize_t received = ::recv(socket, chunk, sizeof(chunk), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        buffer.append(chunk, static_cast<size_t>(received));
+        return true;
+    }
+    return false;
+}
+#endif
+
+} // anonymous namespace
+
+InferenceServer::InferenceServer(
+    std::shared_ptr<const ModelSnapshot> snapshot,
+    const ServerConfig& config
+) : config(config), snapshot(std::move(snapshot)) {
+    this->config.connectionThreads = std::max<size_t>(this->config.connectionThreads, 1);
+    this->config.maxBatchSize = std::max<size_t>(this->config.maxBatchSize, 1);
+    if (this->config.predictionThreads != 1) {
+        predictionPool = std::make_unique<ThreadPool>(this->config.predictionThreads);
+    }
+}
+
+InferenceServer::~InferenceServer() {
+    stop();
+}
+
+bool InferenceServer::start() {
+#ifdef _WIN32
+    std::cerr << "Error: The inference server requires POSIX sockets" << std::endl;
+    return false;
+#else
+    if (running) {
+        return true;
+    }
+    if (!std::atomic_load(&snapshot)) {
+        std::cerr << "Error: No model to serve" << std::endl;
+        return false;
+    }
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config.port);
+    if (::inet_pton(AF_INET, config.host.c_str(), &address.sin_addr) != 1) {
+        std::cerr << "Error: Invalid listen address " << config.host << std::endl;
+        return false;
+    }
+
+    listenSocket = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSocket < 0) {
+        std::cerr << "Error: Could not create a socket" << std::endl;
+        return false;
+    }
+
+    int enable = 1;
+    ::setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    socklen_t length = sizeof(address);
+    if (::bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listenSocket, static_cast<int>(std::max<size_t>(config.maxQueuedConnections, 1))) != 0 ||
+        ::getsockname(listenSocket, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        std::cerr << "Error: Could not listen on " << config.host << ":" << config.port << std::endl;
+        ::close(listenSocket);
+        listenSocket = -1;
+        return false;
+    }
+    boundPort = ntohs(address.sin_port);
+
+    // Workers returning an idle connection wake the poll thread through the pipe
+    if (::pipe(wakePipe) != 0) {
+        std::cerr << "Error: Could not create a pipe" << std::endl;
+        ::close(listenSocket);
+        listenSocket = -1;
+        return false;
+    }
+    for (int end : wakePipe) {
+        ::fcntl(end, F_SETFL, ::fcntl(end, F_GETFL) | O_NONBLOCK);
+    }
+
+    running = true;
+    batchThread = std::thread(&InferenceServer::batchLoop, this);
+    for (size_t i = 0; i < config.connectionThreads; ++i) {
+        connectionWorkers.emplace_back(&InferenceServer::connectionLoop, this);
+    }
+    pollThread = std::thread(&InferenceServer::pollLoop, this);
+    return true;
+#endif
+}
+
+void InferenceServer::stop() {
+    {
+        // Waiters check the flag under these mutexes, so none can miss the change
+        std::scoped_lock lock(connectionMutex, jobMutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+
+#ifndef _WIN32
+    pollThread.join();
+    connectionCondition.notify_all();
+    for (auto& worker : connectionWorkers) {
+        worker.join();
+    }
+    connectionWorkers.clear();
+
+    // Workers are gone, so no job can be submitted any more
+    jobCondition.notify_all();
+    batchThread.join();
+
+    for (const Connection& connection : queuedConnections) {
+        ::close(connection.socket);
+    }
+    queuedConnections.clear();
+    for (const Connection& connection : returnedConnections) {
+        ::close(connection.socket);
+    }
+    returnedConnections.clear();
+    ::close(listenSocket);
+    listenSocket = -1;
+    for (int& end : wakePipe) {
+        ::close(end);
+        end = -1;
+    }
+#endif
+}
+
+uint16_t InferenceServer::getPort() const {
+    return boundPort;
+}
+
+void InferenceServer::setSnapshot(std::shared_ptr<const ModelSnapshot> next) {
+    if (next) {
+        std::atomic_store(&snapshot, std::move(next));
+    }
+}
+
+#ifndef _WIN32
+void InferenceServer::pollLoop() {
+    std::vector<Connection> idle;
+    std::vector<pollfd> descriptors;
+    const auto idleTimeout = std::chrono::milliseconds(config.keepAliveTimeoutMs);
+
+    while (running) {
+        {
+            std::lock_guard<std::mutex> lock(connectionMutex);
+            std::move(returnedConnections.begin(), returnedConnections.end(), std::back_inserter(idle));
+            returnedConnections.clear();
+        }
+
+        // Close connections that stayed idle for too long
+        auto now = std::chrono::steady_clock::now();
+        idle.erase(std::remove_if(idle.begin(), idle.end(), [&](const Connection& connection) {
+            if (now - connection.idleSince < idleTimeout) {
+                return false;
+            }
+            ::close(connection.socket);
+            return true;
+        }), idle.end());
+
+        descriptors.clear();
+        descriptors.push_back({listenSocket, POLLIN, 0});
+        descriptors.push_back({wakePipe[0], POLLIN, 0});
+        for (const Connection& connection : idle) {
+            descriptors.push_back({connection.socket, POLLIN, 0});
+        }
+        if (::poll(descriptors.data(), descriptors.size(), kPollSliceMs) <= 0) {
+            continue;
+        }
+
+        if (descriptors[1].revents != 0) {
+            char drain[64];
+            while (::read(wakePipe[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+
+        // A readable connection has a new request (or was closed by the peer)
+        size_t kept = 0;
+        for (size_t i = 0; i < idle.size(); ++i) {
+            if (descriptors[i + 2].revents != 0) {
+                dispatch(std::move(idle[i]));
+            } else if (kept != i) {
+                idle[kept++] = std::move(idle[i]);
+            } else {
+                kept++;
+            }
+        }
+        idle.resize(kept);
+
+        if (descriptors[0].revents == 0) {
+            continue;
+        }
+        int socket = ::accept(listenSocket, nullptr, nullptr);
+        if (socket < 0) {
+            continue;
+        }
+
+        int enable = 1;
+        ::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        if (idle.size() >= config.maxIdleConnections) {
+            // Shed load instead of holding connections without bound
+            sendAll(socket, makeResponse(503, "Service Unavailable", "Server busy\n", false,
+                                         "text/plain", "Retry-After: 1\r\n"));
+            ::close(socket);
+            continue;
+        }
+        idle.push_back(Connection{socket, std::string(), now});
+    }
+
+    for (const Connection& connection : idle) {
+        ::close(connection.socket);
+    }
+}
+
+void InferenceServer::dispatch(Connection connection) {
+    std::unique_lock<std::mutex> lock(connectionMutex);
+    if (queuedConnections.size() >= config.maxQueuedConnections) {
+        // Shed load instead of queueing without bound
+        lock.unlock();
+        sendAll(connection.socket, makeResponse(503, "Service Unavailable", "Server busy\n", false,
+                                                "text/plain", "Retry-After: 1\r\n"));
+        ::close(connection.socket);
+        return;
+    }
+    queuedConnections.push_back(std::move(connection));
+    lock.unlock();
+    connectionCondition.notify_one();
+}
+
+void InferenceServer::connectionLoop() {
+    for (;;) {
+        Connection connection;
+        {
+            std::unique_lock<std::mutex> lock(connectionMutex);
+            connectionCondition.wait(lock, [this] { return !queuedConnections.empty() || !running; });
+            if (!running) {
+                return;
+            }
+            connection = std::move(queuedConnections.front());
+            queuedConnections.pop_front();
+        }
+
+        // Answer the pipelined requests that already arrived, then give the
+        // connection back to the poll set until the client sends more
+        bool open;
+        do {
+            open = serveRequest(connection);
+        } while (open && !connection.buffer.empty());
+
+        if (!open) {
+            ::close(connection.socket);
+            continue;
+        }
+
+        connection.idleSince = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(connectionMutex);
+            returnedConnections.push_back(std::move(connection));
+        }
+        char wake = 0;
+        ssize_t written = ::write(wakePipe[1], &wake, 1); // A full pipe has a wakeup pending already
+        (void)written;
+    }
+}
+
+bool InferenceServer::serveRequest(Connection& connection) {
+    const int socket = connection.socket;
+    std::string& buffer = connection.buffer;
+
+    // Read the request line and headers
+    size_t headerEnd;
+    while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+        if (buffer.size() > kMaxHeaderBytes) {
+            sendAll(socket, makeResponse(431, "Request Header Fields Too Large", "", false));
+            return false;
+        }
+        if (!receiveMore(socket, buffer, config.keepAliveTimeoutMs, running)) {
+            return false;
+        }
+    }
+
+    std::vector<std::string> lines;
+    for (size_t start = 0; start < headerEnd;) {
+        size_t end = std::min(buffer.find("\r\n", start), headerEnd);
+        lines.push_back(buffer.substr(start, end - start));
+        start = end + 2;
+    }
+
+    size_t firstSpace = lines[0].find(' ');
+    size_t lastSpace = lines[0].rfind(' ');
+    if (firstSpace == std::string::npos || lastSpace == firstSpace) {
+        sendAll(socket, makeResponse(400, "Bad Request", "Malformed request line\n", false));
+        return false;
+    }
+    std::string method = lines[0].substr(0, firstSpace);
+    std::string path = lines[0].substr(firstSpace + 1, lastSpace - firstSpace - 1);
+    std::string version = lines[0].substr(lastSpace + 1);
+
+    // HTTP/1.1 connections stay open unless the client asks otherwise
+    bool keepAlive = version == "HTTP/1.1";
+    size_t contentLength = 0;
+    bool expectContinue = false;
+    bool chunked = false;
+    for (size_t i = 1; i < lines.size(); ++i) {
+        size_t colon = lines[i].find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string name = toLower(lines[i].substr(0, colon));
+        std::string value = toLower(trim(lines[i].substr(colon + 1)));
+        if (name == "content-length") {
+            contentLength = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (name == "connection") {
+            keepAlive = value == "close" ? false : (value == "keep-alive" ? true : keepAlive);
+        } else if (name == "expect") {
+            expectContinue = value == "100-continue";
+        } else if (name == "transfer-encoding") {
+            chunked = value != "identity";
+        }
+    }
+
+    if (chunked) {
+        sendAll(socket, makeResponse(411, "Length Required", "Send a Content-Length body\n", false));
+        return false;
+    }
+    if (contentLength > config.maxRequestBytes) {
+        sendAll(socket, makeResponse(413, "Payload Too Large", "Request body too large\n", false));
+        return false;
+    }
+    if (expectContinue && !sendAll(socket, "HTTP/1.1 100 Continue\r\n\r\n")) {
+        return false;
+    }
+
+    // Read the body; bytes after it belong to the next pipelined request
+    size_t requestEnd = headerEnd + 4 + contentLength;
+    while (buffer.size() < requestEnd) {
+        if (!receiveMore(socket, buffer, config.keepAliveTimeoutMs, running)) {
+            return false;
+        }
+    }
+    std::string body = buffer.substr(headerEnd + 4, contentLength);
+    buffer.erase(0, requestEnd);
+
+    keepAlive = keepAlive && running;
+    return sendAll(socket, handleRequest(method, path, body, keepAlive)) && keepAlive;
+}
+#endif
+
+void InferenceServer::batchLoop() {
+    std::vector<PredictionJob*> batch;
+    std::vector<std::string> texts;
+    std::vector<SentimentLabel> labels;
+    std::vector<double> scores;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobCondition.wait(lock, [this] { return !queuedJobs.empty() || !running; });
+            if (queuedJobs.empty()) {
+                return;
+            }
+
+            // Coalesce every job that arrived while the last batch was scored
+            batch.clear();
+            size_t batchTexts = 0;
+            while (!queuedJobs.empty() &&
+                   (batch.empty() || batchTexts + queuedJobs.front()->texts.size() <= config.maxBatchSize)) {
+                batch.push_back(queuedJobs.front());
+                batchTexts += queuedJobs.front()->texts.size();
+                queuedJobs.pop_front();
+            }
+            queuedTexts -= batchTexts;
+        }
+
+        texts.clear();
+        for (PredictionJob* job : batch) {
+            std::move(job->texts.begin(), job->texts.end(), std::back_inserter(texts));
+        }
+        labels.resize(texts.size());
+        scores.resize(texts.size());
+
+        std::shared_ptr<const ModelSnapshot> model = std::atomic_load(&snapshot);
+        model->predictBatch(texts.data(), texts.size(), labels.data(), scores.data(), predictionPool.get());
+
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            size_t offset = 0;
+            for (PredictionJob* job : batch) {
+                size_t count = job->texts.size();
+                job->labels.assign(labels.begin() + offset, labels.begin() + offset + count);
+                job->scores.assign(scores.begin() + offset, scores.begin() + offset + count);
+                job->done = true;
+                offset += count;
+            }
+        }
+        doneCondition.notify_all();
+    }
+}
+
+bool InferenceServer::submit(PredictionJob& job) {
+    std::unique_lock<std::mutex> lock(jobMutex);
+    if (!running || queuedTexts + job.texts.size() > config.maxQueuedTexts) {
+        return false;
+    }
+
+    queuedJobs.push_back(&job);
+    queuedTexts += job.texts.size();
+    jobCondition.notify_one();
+    doneCondition.wait(lock, [&job] { return job.done; });
+    return true;
+}
+
+std::string InferenceServer::handleRequest(
+    const std::string& method,
+    const std::string& path,
+    const std::string& body,
+    bool keepAlive
+) {
+    if (path == "/health") {
+        if (method != "GET") {
+            return makeResponse(405, "Method Not Allowed", "", keepAlive, "text/plain", "Allow: GET\r\n");
+        }
+        return makeResponse(200, "OK", "ok\n", keepAlive);
+    }
+
+    if (path == "/metrics") {
+        if (method != "GET") {
+            return makeResponse(405, "Method Not Allowed", "", keepAlive, "text/plain", "Allow: GET\r\n");
+        }
+        return makeResponse(200, "OK", PipelineStats::snapshot().toPrometheus(), keepAlive,
+                            "text/plain; version=0.0.4");
+    }
+
+    if (path != "/predict") {
+        return makeResponse(404, "Not Found", "Unknown path\n", keepAlive);
+    }
+    if (method != "POST") {
+        return makeResponse(405, "Method Not Allowed", "", keepAlive, "text/plain", "Allow: POST\r\n");
+    }
+
+    // One text per line; a trailing line break does not add an empty text
+    PredictionJob job;
+    for (size_t start = 0; start < body.size();) {
+        size_t end = std::min(body.find('\n', start), body.size());
+        size_t textEnd = end > start && body[end - 1] == '\r' ? end - 1 : end;
+        job.texts.push_back(body.substr(start, textEnd - start));
+        start = end + 1;
+    }
+
+    if (job.texts.empty()) {
+        return makeResponse(400, "Bad Request", "Send one text per line\n", keepAlive);
+    }
+    if (job.texts.size() > config.maxQueuedTexts) {
+        return makeResponse(413, "Payload Too Large", "Too many texts in one request\n", keepAlive);
+    }
+    if (!submit(job)) {
+        return makeResponse(503, "Service Unavailable", "Server busy\n", keepAlive,
+                            "text/plain", "Retry-After: 1\r\n");
+    }
+
+    std::string json = "{\"predictions\":[";
+    char score[32];
+    for (size_t i = 0; i < job.labels.size(); ++i) {
+        if (std::isfinite(job.scores[i])) {
+            std::snprintf(score, sizeof(score), "%.17g", job.scores[i]);
+        } else {
+            std::snprintf(score, sizeof(score), "null");
+        }
+        json += i > 0 ? "," : "";
+        json += "{\"label\":\"" + sentimentToString(job.labels[i]) + "\",\"score\":" + score + "}";
+    }
+    json += "]}\n";
+
+    return makeResponse(200, "OK", json, keepAlive, "application/json");
+}
+
+} // namespace sentiment
@@ -0,0 +1,340 @@
+#include "linear_model.h"
+#include "pipeline_stats.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+
+namespace sentiment {
+
+namespace {
+
+static_assert(static_cast<size_t>(SentimentLabel::UNKNOWN) + 1 <= LinearModel::kClassStride,
+              "Every SentimentLabel value needs a class lane");
+constexpr size_t kStride = LinearModel::kClassStride;
+
+// Mini-batches handed to a worker at a time
+constexpr size_t kBatchesPerChunk = 8;
+
+// Weights shared by the SGD workers. Relaxed loads and stores compile to
+// plain moves; lost updates between workers are accepted (Hogwild).
+class SharedWeights {
+public:
+    explicit SharedWeights(size_t size) : values(new std::atomic<double>[size]), count(size) {
+        for (size_t i = 0; i < size; ++i) {
+            values[i].store(0.0, std::memory_order_relaxed);
+        }
+    }
+
+    double load(size_t i) const {
+        return values[i].load(std::memory_order_relaxed);
+    }
+
+    void store(size_t i, double value) {
+        values[i].store(value, std::memory_order_relaxed);
+    }
+
+    std::vector<double> copy() const {
+        std::vector<double> result(count);
+        for (size_t i = 0; i < count; ++i) {
+            result[i] = load(i);
+        }
+        return result;
+    }
+
+private:
+    std::unique_ptr<std::atomic<double>[]> values;
+    size_t count;
+};
+
+} // namespace
+
+LinearModel::LinearModel(const SgdOptions& options) : options(options) {
+}
+
+bool LinearModel::train(const std::vector<FeatureVector>& trainingData) {
+    if (trainingData.empty()) {
+        std::cerr << "Error: Training data is empty" << std::endl;
+        return false;
+    }
+    if (options.epochs == 0 || options.batchSize == 0 || !(options.learningRate > 0.0)) {
+        std::cerr << "Error: SGD needs at least one epoch, a batch size and a positive learning rate"
+                  << std::endl;
+        return false;
+    }
+
+    size_t features = trainingData[0].features.dimension;
+    std::array<bool, kStride> seen{};
+    for (const auto& example : trainingData) {
+        if (example.features.dimension != features) {
+            std::cerr << "Error: Inconsistent feature dimension in training data. Expected "
+                      << features << ", got " << example.features.dimension << std::endl;
+            return false;
+        }
+        seen[static_cast<size_t>(example.label)] = true;
+    }
+
+    // Assign class lanes in label order
+    std::vector<SentimentLabel> labels;
+    std::array<size_t, kStride> laneOf{};
+    for (size_t label = 0; label < kStride; ++label) {
+        if (seen[label]) {
+            laneOf[label] = labels.size();
+            labels.push_back(static_cast<SentimentLabel>(label));
+        }
+    }
+    const size_t classes = labels.size();
+
+    SharedWeights sharedWeights(features * kStride);
+    SharedWeights sharedBiases(kStride);
+    std::vector<uint32_t> order(trainingData.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::mt19937_64 random(options.seed);
+    size_t workers = threadPool ? threadPool->size() : 1;
+    std::vector<double> workerLoss(workers);
+
+    for (size_t epoch = 0; epoch < options.epochs; ++epoch) {
+        std::shuffle(order.begin(), order.end(), random);
+        std::fill(workerLoss.begin(), workerLoss.end(), 0.0);
+        const double rate = options.learningRate / (1.0 + static_cast<double>(epoch));
+
+        auto trainRange = [&](size_t begin, size_t end, size_t worker) {
+            std::vector<double> gradients(options.batchSize * kStride);
+            alignas(32) double scores[kStride];
+            for (size_t batch = begin; batch < end; batch += options.batchSize) {
+                size_t size = std::min(options.batchSize, end - batch);
+
+                // Gradients of the whole mini-batch come from the same weights
+                for (size_t i = 0; i < size; ++i) {
+                    const FeatureVector& example = trainingData[order[batch + i]];
+                    const SparseVector& vector = example.features;
+                    for (size_t lane = 0; lane < classes; ++lane) {
+                        scores[lane] = sharedBiases.load(lane);
+                    }
+                    for (size_t k = 0; k < vector.nonZeroCount(); ++k) {
+                        size_t row = static_cast<size_t>(vector.indices[k]) * kStride;
+                        for (size_t lane = 0; lane < classes; ++lane) {
+                            scores[lane] += vector.values[k] * sharedWeights.load(row + lane);
+                        }
+                    }
+                    workerLoss[worker] += lossGradient(scores, classes,
+                                                       laneOf[static_cast<size_t>(example.label)],
+                                                       &gradients[i * kStride]);
+                }
+
+                // Write back the rows the mini-batch touches
+                const double step = rate / static_cast<double>(size);
+                for (size_t i = 0; i < size; ++i) {
+                    const SparseVector& vector = trainingData[order[batch + i]].features;
+                    const double* gradient = &gradients[i * kStride];
+                    for (size_t k = 0; k < vector.nonZeroCount(); ++k) {
+                        size_t row = static_cast<size_t>(vector.indices[k]) * kStride;
+                        for (size_t lane = 0; lane < classes; ++lane) {
+                            double weight = sharedWeights.load(row + lane);
+                            weight -= step * (gradient[lane] * vector.values[k] + options.l2 * weight);
+                            sharedWeights.store(row + lane, weight);
+                        }
+                    }
+                    for (size_t lane = 0; lane < classes; ++lane) {
+                        sharedBiases.store(lane, sharedBiases.load(lane) - step * gradient[lane]);
+                    }
+                }
+            }
+        };
+
+        // Chunks are whole mini-batches, so batch boundaries do not depend on the thread count
+        if (threadPool) {
+            threadPool->parallelFor(order.size(), trainRange, options.batchSize * kBatchesPerChunk);
+        } else {
+            trainRange(0, order.size(), 0);
+        }
+    }
+
+    featureCount = features;
+    classLabels = std::move(labels);
+    weights = ConstArray<double>(sharedWeights.copy());
+    biases = ConstArray<double>(sharedBiases.copy());
+    trainingLoss = std::accumulate(workerLoss.begin(), workerLoss.end(), 0.0) / order.size();
+    trained = true;
+
+    std::cout << "Trained " << getName() << " with " << order.size() << " examples, "
+              << featureCount << " features and " << options.epochs << " epochs (loss "
+              << trainingLoss << ")" << std::endl;
+    return true;
+}
+
+SentimentLabel LinearModel::predict(const SparseVector& features) const {
+    if (!trained) {
+        std::cerr << "Error: Model not trained" << std::endl;
+        return SentimentLabel::UNKNOWN;
+    }
+
+    if (features.dimension != featureCount) {
+        std::cerr << "Error: Feature vector size mismatch. Expected "
+                  << featureCount << ", got " << features.dimension << std::endl;
+        return SentimentLabel::UNKNOWN;
+    }
+
+    SENTIMENT_TIME_STAGE(Stage::SCORING);
+    alignas(32) double scores[kStride];
+    return classLabels[scoreLanes(features, scores)];
+}
+
+void LinearModel::predictBatch(
+    const SparseVector* documents,
+    size_t count,
+    SentimentLabel* labels,
+    double* scores
+) const {
+    scoreBatch([documents](size_t i) -> const SparseVector& { return documents[i]; },
+               count, labels, scores);
+}
+
+void LinearModel::predictBatch(
+    const FeatureVector* examples,
+    size_t count,
+    SentimentLabel* labels,
+    double* scores
+) const {
+    scoreBatch([examples](size_t i) -> const SparseVector& { return examples[i].features; },
+               count, labels, scores);
+}
+
+template<typename Document>
+void LinearModel::scoreBatch(Document&& document, size_t count, SentimentLabel* labels, double* scores) const {
+    if (!trained) {
+        std::cerr << "Error: Model not trained" << std::endl;
+        std::fill(labels, labels + count, SentimentLabel::UNKNOWN);
+        return;
+    }
+
+    SENTIMENT_TIME_STAGE_ITEMS(Stage::SCORING, count);
+    alignas(32) double laneScores[kStride];
+    for (size_t i = 0; i < count; ++i) {
+        const SparseVector& features = document(i);
+        if (features.dimension != featureCount) {
+            std::cerr << "Error: Feature vector size mismatch. Expected "
+                      << featureCount << ", got " << features.dimension << std::endl;
+            labels[i] = SentimentLabel::UNKNOWN;
+            if (scores) {
+                scores[i] = -std::numeric_limits<double>::infinity();
+            }
+            continue;
+        }
+
+        size_t lane = scoreLanes(features, laneScores);
+        labels[i] = classLabels[lane];
+        if (scores) {
+            scores[i] = laneScores[lane];
+        }
+    }
+}
+
+size_t LinearModel::scoreLanes(const SparseVector& features, double* scores) const {
+    std::copy(biases.begin(), biases.end(), scores);
+    accumulateSparseRows(features, weights.data(), kStride, false, scores);
+
+    size_t best = 0;
+    for (size_t lane = 1; lane < classLabels.size(); ++lane) {
+        if (scores[lane] > scores[best]) {
+            best = lane;
+        }
+    }
+    return best;
+}
+
+bool LinearModel::isTrained() const {
+    return trained;
+}
+
+const std::vector<SentimentLabel>& LinearModel::getClassLabels() const {
+    return classLabels;
+}
+
+const ConstArray<double>& LinearModel::getWeights() const {
+    return weights;
+}
+
+const ConstArray<double>& LinearModel::getBiases() const {
+    return biases;
+}
+
+size_t LinearModel::getFeatureCount() const {
+    return featureCount;
+}
+
+const SgdOptions& LinearModel::getOptions() const {
+    return options;
+}
+
+double LinearModel::getTrainingLoss() const {
+    return trainingLoss;
+}
+
+void LinearModel::setThreadPool(std::shared_ptr<ThreadPool> pool) {
+    threadPool = std::move(pool);
+}
+
+std::string LogisticRegression::getName() const {
+    return "Logistic Regression";
+}
+
+double LogisticRegression::lossGradient(
+    const double* scores,
+    size_t classes,
+    size_t target,
+    double* gradient
+) const {
+    // Softmax around the maximum keeps every exponent <= 0
+    double maxScore = *std::max_element(scores, scores + classes);
+    double sum = 0.0;
+    for (size_t lane = 0; lane < classes; ++lane) {
+        gradient[lane] = std::exp(scores[lane] - maxScore);
+        sum += gradient[lane];
+    }
+    for (size_t lane = 0; lane < classes; ++lane) {
+        gradient[lane] /= sum;
+    }
+
+    double loss = -std::log(std::max(gradient[target], std::numeric_limits<double>::min()));
+    gradient[target] -= 1.0;
+    return loss;
+}
+
+std::string LinearSVM::getName() const {
+    return "Linear SVM";
+}
+
+double LinearSVM::lossGradient(
+    const double* scores,
+    size_t classes,
+    size_t target,
+    double* gradient
+) const {
+    // The true class must beat the best other class by a margin of one
+    std::fill(gradient, gradient + classes, 0.0);
+    size_t rival = target;
+    for (size_t lane = 0; lane < classes; ++lane) {
+        if (lane != target && (rival == target || scores[lane] > scores[rival])) {
+            rival = lane;
+        }
+    }
+    if (rival == target) {
+        return 0.0;
+    }
+
+    double loss = 1.0 + scores[rival] - scores[target];
+    if (loss <= 0.0) {
+        return 0.0;
+    }
+    gradient[target] = -1.0;
+    gradient[rival] = 1.0;
+    return loss;
+}
+
+} // namespace sentiment
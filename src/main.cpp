@@ -4,12 +4,23 @@
 #include <chrono>
 #include <iomanip>
 #include <fstream>
+#include <memory>
+#include <sstream>
+#include <csignal>
+#include <thread>
 
+#include "cross_validation.h"
 #include "data_loader.h"
 #include "preprocessor.h"
 #include "feature_extractor.h"
+#include "file_predictor.h"
 #include "naive_bayes.h"
 #include "evaluator.h"
+#include "inference_server.h"
+#include "linear_model.h"
+#include "model_io.h"
+#include "model_snapshot.h"
+#include "thread_pool.h"
 #include "utils.h"
 
 using namespace sentiment;
@@ -27,6 +38,19 @@ void printUsage(const std::string& programName) {
     std::cout << "Options:\n";
     std::cout << "  --file FILE      Path to training data CSV file\n";
     std::cout << "  --interactive    Enable interactive mode for inference\n";
+    std::cout << "  --threads N      Worker threads for feature extraction (0 = all cores)\n";
+    std::cout << "  --save-model F   Save the trained model to file F\n";
+    std::cout << "  --model F        Load a saved model from file F instead of training\n";
+    std::cout << "  --hash-bits K    Hash features into 2^K dimensions instead of building a vocabulary\n";
+    std::cout << "  --serve PORT     Serve predictions over HTTP on PORT (POST /predict, one text per line)\n";
+    std::cout << "  --predict-file F Score every line of F with the --model and write label,score lines to --out\n";
+    std::cout << "  --out F          Output file of --predict-file\n";
+    std::cout << "  --precision P    Store the served model as f64, f32, i16 or i8 and report its accuracy\n";
+    std::cout << "  --classifier C   Evaluate nb (default), logreg or svm; --save-model and --serve use nb\n";
+    std::cout << "  --cv K           Run K-fold cross-validation over the grid below instead of training\n";
+    std::cout << "  --alphas LIST    Comma-separated smoothing values to cross-validate (default 1.0)\n";
+    std::cout << "  --min-freqs LIST Comma-separated vocabulary frequency cutoffs (default 2)\n";
+    std::cout << "  --max-vocabs LIST Comma-separated vocabulary size limits, 0 = unlimited (default 5000)\n";
     std::cout << "  --help           Display this help message\n";
 }
 
@@ -43,6 +67,32 @@ std::unordered_map<std::string, std::string> parseArgs(int argc, char* argv[]) {
             args["interactive"] = "true";
         } else if (arg == "--file" && i + 1 < argc) {
             args["file"] = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            args["threads"] = argv[++i];
+        } else if (arg == "--save-model" && i + 1 < argc) {
+            args["save-model"] = argv[++i];
+        } else if (arg == "--model" && i + 1 < argc) {
+            args["model"] = argv[++i];
+        } else if (arg == "--hash-bits" && i + 1 < argc) {
+            args["hash-bits"] = argv[++i];
+        } else if (arg == "--serve" && i + 1 < argc) {
+            args["serve"] = argv[++i];
+        } else if (arg == "--predict-file" && i + 1 < argc) {
+            args["predict-file"] = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            args["out"] = argv[++i];
+        } else if (arg == "--precision" && i + 1 < argc) {
+            args["precision"] = argv[++i];
+        } else if (arg == "--classifier" && i + 1 < argc) {
+            args["classifier"] = argv[++i];
+        } else if (arg == "--cv" && i + 1 < argc) {
+            args["cv"] = argv[++i];
+        } else if (arg == "--alphas" && i + 1 < argc) {
+            args["alphas"] = argv[++i];
+        } else if (arg == "--min-freqs" && i + 1 < argc) {
+            args["min-freqs"] = argv[++i];
+        } else if (arg == "--max-vocabs" && i + 1 < argc) {
+            args["max-vocabs"] = argv[++i];
         } else if (arg.substr(0, 2) == "--") {
             std::cerr << "Unknown option: " << arg << std::endl;
         }
@@ -53,7 +103,6 @@ std::unordered_map<std::string, std::string> parseArgs(int argc, char* argv[]) {
 
 // Function for interactive mode
 void runInteractiveMode(
-    const Preprocessor& preprocessor,
     const FeatureExtractor& featureExtractor,
     const Model& model
 ) {
@@ -61,6 +110,7 @@ void runInteractiveMode(
     std::cout << "Enter text to analyze sentiment (type 'exit' to quit):\n";
 
     std::string input;
+    InferenceContext context;
     while (true) {
         std::cout << "\n> ";
         std::getline(std::cin, input);
@@ -75,15 +125,214 @@ void runInteractiveMode(
             continue;
         }
 
-        // Extract features and predict
-        std::vector<double> features = featureExtractor.extractFeatures(input);
-        SentimentLabel prediction = model.predict(features);
+        // Extract features and predict, reusing the scratch buffers
+        SentimentLabel prediction = model.predict(featureExtractor.extractFeatures(input, context));
 
         // Print prediction
         std::cout << "Sentiment: " << sentimentToString(prediction) << std::endl;
     }
 }
 
+// Map a --precision value to a NaiveBayes storage format
+bool parsePrecision(const std::string& name, NaiveBayes::Precision& precision) {
+    if (name == "f64") {
+        precision = NaiveBayes::Precision::FLOAT64;
+    } else if (name == "f32") {
+        precision = NaiveBayes::Precision::FLOAT32;
+    } else if (name == "i16") {
+        precision = NaiveBayes::Precision::INT16;
+    } else if (name == "i8") {
+        precision = NaiveBayes::Precision::INT8;
+    } else {
+        std::cerr << "Error: Unknown precision " << name << " (expected f64, f32, i16 or i8)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Compare a compressed model with its double baseline on the validation set
+void printPrecisionReport(
+    const NaiveBayes& baseline,
+    const NaiveBayes& compressed,
+    const std::string& name,
+    const std::vector<FeatureVector>& validFeatures
+) {
+    Evaluator baselineEvaluator(baseline);
+    Evaluator compressedEvaluator(compressed);
+    EvaluationMetrics baselineMetrics = baselineEvaluator.evaluate(validFeatures);
+    EvaluationMetrics compressedMetrics = compressedEvaluator.evaluate(validFeatures);
+
+    size_t agreements = 0;
+    for (const auto& example : validFeatures) {
+        agreements += baseline.predict(example.features) == compressed.predict(example.features);
+    }
+
+    std::cout << "\n--- Precision Report (" << name << ") ---\n";
+    std::cout << std::fixed << std::setprecision(4);
+    std::cout << "Accuracy:   " << compressedMetrics.accuracy * 100 << "% (f64: "
+              << baselineMetrics.accuracy * 100 << "%)\n";
+    std::cout << "F1 Score:   " << compressedMetrics.f1Score * 100 << "% (f64: "
+              << baselineMetrics.f1Score * 100 << "%)\n";
+    if (!validFeatures.empty()) {
+        std::cout << "Agreement:  " << 100.0 * agreements / validFeatures.size() << "% of predictions\n";
+    }
+    std::cout << "Parameters: " << compressed.getParameterBytes() << " bytes (f64: "
+              << baseline.getParameterBytes() << " bytes)" << std::endl;
+}
+
+// Map a --classifier value to a linear model (nullptr for Naive Bayes or an unknown name)
+std::unique_ptr<LinearModel> makeLinearModel(const std::string& name) {
+    if (name == "logreg") {
+        return std::make_unique<LogisticRegression>();
+    }
+    if (name == "svm") {
+        return std::make_unique<LinearSVM>();
+    }
+    if (name != "nb") {
+        std::cerr << "Error: Unknown classifier " << name << " (expected nb, logreg or svm)" << std::endl;
+    }
+    return nullptr;
+}
+
+// Split a comma-separated option value and convert every item
+template<typename T, typename Convert>
+std::vector<T> parseList(const std::string& value, Convert convert) {
+    std::vector<T> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(static_cast<T>(convert(item)));
+        }
+    }
+    return items;
+}
+
+// Function for cross-validation mode
+int runCrossValidation(
+    const std::vector<TextData>& data,
+    const Preprocessor& preprocessor,
+    const FeatureExtractor& featureExtractor,
+    size_t threadCount,
+    std::unordered_map<std::string, std::string>& args
+) {
+    SearchGrid grid;
+    grid.alphas = args.count("alphas") > 0
+        ? parseList<double>(args["alphas"], [](const std::string& v) { return std::stod(v); })
+        : std::vector<double>{1.0};
+    grid.minWordFrequencies = args.count("min-freqs") > 0
+        ? parseList<int>(args["min-freqs"], [](const std::string& v) { return std::stoi(v); })
+        : std::vector<int>{2};
+    grid.maxVocabularySizes = args.count("max-vocabs") > 0
+        ? parseList<size_t>(args["max-vocabs"], [](const std::string& v) { return std::stoul(v); })
+        : std::vector<size_t>{5000};
+
+    std::shared_ptr<ThreadPool> pool;
+    if (threadCount != 1) {
+        pool = std::make_shared<ThreadPool>(threadCount);
+    }
+
+    size_t folds = std::stoul(args["cv"]);
+    std::cout << "\n--- Cross-Validation (" << folds << " folds) ---\n";
+    CrossValidator validator(preprocessor, featureExtractor, pool);
+    if (!validator.prepare(data, folds)) {
+        return 1;
+    }
+    std::vector<CrossValidationResult> results = validator.search(grid);
+    if (results.empty()) {
+        return 1;
+    }
+
+    std::cout << std::setw(10) << "Alpha" << std::setw(10) << "MinFreq" << std::setw(10) << "MaxVocab"
+              << std::setw(12) << "Accuracy" << std::setw(10) << "StdDev" << std::setw(10) << "F1" << "\n";
+    std::cout << std::fixed << std::setprecision(4);
+    for (const auto& result : results) {
+        std::cout << std::setw(10) << result.alpha
+                  << std::setw(10) << result.minWordFrequency
+                  << std::setw(10) << result.maxVocabularySize
+                  << std::setw(12) << result.meanAccuracy * 100
+                  << std::setw(10) << result.accuracyStdDev * 100
+                  << std::setw(10) << result.meanF1Score * 100 << "\n";
+    }
+
+    const CrossValidationResult& best = results.front();
+    std::cout << "Best: alpha " << best.alpha << ", min frequency " << best.minWordFrequency
+              << ", max vocabulary " << best.maxVocabularySize << std::endl;
+    return 0;
+}
+
+// Set by SIGINT/SIGTERM to shut the server down
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+// Function for HTTP server mode
+int runServerMode(
+    const FeatureExtractor& featureExtractor,
+    const NaiveBayes& model,
+    bool useStopWords,
+    const std::string& port,
+    size_t threadCount
+) {
+    ServerConfig config;
+    config.port = static_cast<uint16_t>(std::stoul(port));
+    config.predictionThreads = threadCount;
+
+    InferenceServer server(
+        std::make_shared<const ModelSnapshot>(featureExtractor, model, useStopWords),
+        config
+    );
+    if (!server.start()) {
+        return 1;
+    }
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::cout << "\n--- Server Mode ---\n";
+    std::cout << "Listening on " << config.host << ":" << server.getPort()
+              << " (POST /predict, GET /health); press Ctrl+C to stop" << std::endl;
+    while (!stopRequested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    server.stop();
+    std::cout << "Server stopped" << std::endl;
+    return 0;
+}
+
+// Function for batch scoring a file
+int runPredictFileMode(
+    const FeatureExtractor& featureExtractor,
+    const NaiveBayes& model,
+    bool useStopWords,
+    const std::string& inputPath,
+    const std::string& outputPath,
+    size_t threadCount
+) {
+    FilePredictionConfig config;
+    config.workerThreads = threadCount;
+
+    std::cout << "\n--- Predict File Mode ---\n";
+    FilePredictor predictor(
+        std::make_shared<const ModelSnapshot>(featureExtractor, model, useStopWords),
+        config
+    );
+    if (!predictor.run(inputPath, outputPath)) {
+        return 1;
+    }
+
+    const FilePredictionStats& stats = predictor.getStats();
+    std::cout << "Scored " << stats.lines << " lines of " << inputPath << " in "
+              << std::fixed << std::setprecision(3) << stats.seconds << " s ("
+              << std::setprecision(0) << (stats.seconds > 0.0 ? stats.lines / stats.seconds : 0.0)
+              << " lines/s, " << std::setprecision(1)
+              << (stats.seconds > 0.0 ? stats.bytesRead / stats.seconds / 1e6 : 0.0)
+              << " MB/s); predictions written to " << outputPath << std::endl;
+    return 0;
+}
+
 // Function to create sample data file if not provided
 std::string createSampleDataFile() {
     std::string filePath = "data/sample_data.csv";
@@ -137,6 +386,57 @@ int main(int argc, char* argv[]) {
     // Timer for measuring performance
     auto startTime = std::chrono::high_resolution_clock::now();
 
+    // Serve a saved model without retraining
+    if (args.count("model") > 0) {
+        // Only used to read the file; every mode below scores through a
+        // ModelSnapshot built with the file's stop word setting
+        Preprocessor preprocessor(true);
+        FeatureExtractor featureExtractor(preprocessor);
+        NaiveBayes model;
+        bool useStopWords = true;
+        if (!loadModelFile(args["model"], featureExtractor, model, useStopWords)) {
+            std::cerr << "Error: Failed to load model from " << args["model"] << std::endl;
+            return 1;
+        }
+
+        NaiveBayes::Precision precision = NaiveBayes::Precision::FLOAT64;
+        if (args.count("precision") > 0 &&
+            (!parsePrecision(args["precision"], precision) || !model.setPrecision(precision))) {
+            return 1;
+        }
+
+        auto loadTime = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now() - startTime).count();
+        std::cout << "Loaded model with " << featureExtractor.getFeatureCount()
+                  << " features from " << args["model"] << " in "
+                  << loadTime / 1000.0 << " ms (" << model.getParameterBytes()
+                  << " parameter bytes)\n";
+
+        if (args.count("predict-file") > 0) {
+            if (args.count("out") == 0) {
+                std::cerr << "Error: --predict-file needs an output file (--out)" << std::endl;
+                return 1;
+            }
+            size_t threadCount = args.count("threads") > 0 ? std::stoul(args["threads"]) : 0;
+            return runPredictFileMode(featureExtractor, model, useStopWords,
+                                      args["predict-file"], args["out"], threadCount);
+        }
+
+        if (args.count("serve") > 0) {
+            size_t threadCount = args.count("threads") > 0 ? std::stoul(args["threads"]) : 1;
+            return runServerMode(featureExtractor, model, useStopWords, args["serve"], threadCount);
+        }
+
+        ModelSnapshot snapshot(featureExtractor, model, useStopWords);
+        runInteractiveMode(snapshot.getFeatureExtractor(), snapshot.getModel());
+        return 0;
+    }
+
+    if (args.count("predict-file") > 0) {
+        std::cerr << "Error: --predict-file scores with a saved model (--model)" << std::endl;
+        return 1;
+    }
+
     // Initialize file path
     std::string filePath = args.count("file") > 0 ? args["file"] : "data/sample_data.csv";
 
@@ -162,6 +462,21 @@ int main(int argc, char* argv[]) {
     std::cout << "Loaded " << dataLoader.getData().size() << " examples from "
               << filePath << std::endl;
 
+    // Cross-validation uses every row and replaces the train/evaluate steps
+    if (args.count("cv") > 0) {
+        Preprocessor preprocessor(true);
+        FeatureExtractor featureExtractor(
+            preprocessor,
+            args.count("hash-bits") > 0 ? FeatureExtractor::Method::HASHING : FeatureExtractor::Method::BAG_OF_WORDS
+        );
+        if (args.count("hash-bits") > 0 &&
+            !featureExtractor.setHashing(static_cast<unsigned>(std::stoul(args["hash-bits"])))) {
+            return 1;
+        }
+        size_t threadCount = args.count("threads") > 0 ? std::stoul(args["threads"]) : 1;
+        return runCrossValidation(dataLoader.getData(), preprocessor, featureExtractor, threadCount, args);
+    }
+
     // Split data into training and validation sets
     auto [trainData, validData] = dataLoader.splitTrainValidation(0.8);
     std::cout << "Split data into " << trainData.size() << " training examples and "
@@ -170,10 +485,22 @@ int main(int argc, char* argv[]) {
     // 2. Preprocessing and Feature Extraction
     std::cout << "\n--- Step 2: Preprocessing and Feature Extraction ---\n";
     Preprocessor preprocessor(true); // Use stop word removal
+    bool hashing = args.count("hash-bits") > 0;
     FeatureExtractor featureExtractor(
         preprocessor,
-        FeatureExtractor::Method::BAG_OF_WORDS
+        hashing ? FeatureExtractor::Method::HASHING : FeatureExtractor::Method::BAG_OF_WORDS
     );
+    if (hashing && !featureExtractor.setHashing(static_cast<unsigned>(std::stoul(args["hash-bits"])))) {
+        return 1;
+    }
+
+    // Share a thread pool for vocabulary building and feature extraction
+    size_t threadCount = args.count("threads") > 0 ? std::stoul(args["threads"]) : 1;
+    std::shared_ptr<ThreadPool> threadPool;
+    if (threadCount != 1) {
+        threadPool = std::make_shared<ThreadPool>(threadCount);
+        featureExtractor.setThreadPool(threadPool);
+    }
 
     // Build vocabulary from training data
     featureExtractor.buildVocabulary(trainData, 2, 5000);
@@ -182,33 +509,77 @@ int main(int argc, char* argv[]) {
     std::vector<FeatureVector> trainFeatures = featureExtractor.batchTransform(trainData);
     std::vector<FeatureVector> validFeatures = featureExtractor.batchTransform(validData);
 
-    std::cout << "Extracted features with vocabulary size: "
-              << featureExtractor.getVocabularySize() << std::endl;
+    if (hashing) {
+        std::cout << "Extracted hashed features with "
+                  << featureExtractor.getFeatureCount() << " dimensions" << std::endl;
+    } else {
+        std::cout << "Extracted features with vocabulary size: "
+                  << featureExtractor.getVocabularySize() << std::endl;
+    }
 
     // 3. Model Training
     std::cout << "\n--- Step 3: Model Training ---\n";
     NaiveBayes model(1.0); // Alpha = 1.0 (Laplace smoothing)
+    model.setThreadPool(threadPool);
     bool trainSuccess = model.train(trainFeatures);
     if (!trainSuccess) {
         std::cerr << "Error: Failed to train model" << std::endl;
         return 1;
     }
 
+    // Train a discriminative model on the same features if requested
+    std::string classifier = args.count("classifier") > 0 ? args["classifier"] : "nb";
+    std::unique_ptr<LinearModel> linearModel = makeLinearModel(classifier);
+    if (classifier != "nb") {
+        if (!linearModel) {
+            return 1;
+        }
+        linearModel->setThreadPool(threadPool);
+        if (!linearModel->train(trainFeatures)) {
+            std::cerr << "Error: Failed to train " << linearModel->getName() << std::endl;
+            return 1;
+        }
+    }
+    const Model& evaluatedModel = linearModel ? static_cast<const Model&>(*linearModel) : model;
+
     // 4. Evaluation
     std::cout << "\n--- Step 4: Evaluation ---\n";
-    Evaluator evaluator(model);
+    Evaluator evaluator(evaluatedModel);
     EvaluationMetrics metrics = evaluator.evaluate(validFeatures);
     evaluator.printResults();
 
+    // Save the trained model if requested
+    if (args.count("save-model") > 0) {
+        if (!saveModelFile(args["save-model"], featureExtractor, model, true)) {
+            std::cerr << "Error: Failed to save model to " << args["save-model"] << std::endl;
+            return 1;
+        }
+        std::cout << "Saved model to " << args["save-model"] << std::endl;
+    }
+
+    // Serve a compressed copy if requested; the saved model keeps double parameters
+    NaiveBayes servedModel(model.getAlpha());
+    servedModel.shareParameters(model);
+    if (args.count("precision") > 0) {
+        NaiveBayes::Precision precision;
+        if (!parsePrecision(args["precision"], precision) || !servedModel.setPrecision(precision)) {
+            return 1;
+        }
+        printPrecisionReport(model, servedModel, args["precision"], validFeatures);
+    }
+
     // Print execution time
     auto endTime = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
         endTime - startTime).count();
     std::cout << "Total execution time: " << duration / 1000.0 << " seconds\n";
 
-    // 5. Interactive mode (if requested)
-    if (args.count("interactive") > 0) {
-        runInteractiveMode(preprocessor, featureExtractor, model);
+    // 5. Server or interactive mode (if requested)
+    if (args.count("serve") > 0) {
+        return runServerMode(featureExtractor, servedModel, true, args["serve"], threadCount);
+    } else if (args.count("interactive") > 0) {
+        const Model& interactiveModel = linearModel ? static_cast<const Model&>(*linearModel) : servedModel;
+        runInteractiveMode(featureExtractor, interactiveModel);
     } else {
         std::cout << "\nRun with --interactive flag to test the model with custom input\n";
     }
@@ -0,0 +1,300 @@
+#include "model_io.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+namespace sentiment {
+
+namespace {
+
+constexpr char kModelMagic[8] = {'S', 'N', 'T', 'M', 'O', 'D', 'E', 'L'};
+constexpr uint32_t kModelVersion = 5;
+constexpr uint32_t kByteOrderMark = 0x01020304;
+constexpr uint64_t kSectionAlignment = 64;
+
+// Bits of ModelFileHeader::tfIdfOptions
+constexpr uint32_t kSublinearTf = 1;
+constexpr uint32_t kL2Normalize = 2;
+
+// Location of one array inside the model file
+struct Section {
+    uint64_t offset; ///< Byte offset from the start of the file
+    uint64_t count;  ///< Number of elements
+};
+
+// Fixed-size header at the start of every model file
+struct ModelFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrderMark;
+    uint32_t featureMethod;
+    uint32_t useStopWords;
+    uint64_t documentCount;
+    uint64_t featureCount;
+    uint32_t classStride;
+    uint32_t hashBits;
+    uint32_t signedHashing;
+    uint32_t ngramMin;
+    uint32_t ngramMax;
+    uint32_t tfIdfOptions;       ///< kSublinearTf | kL2Normalize (0 in files without them)
+    double alpha;
+    Section termOffsets;         ///< uint64_t[vocabulary size + 1]
+    Section termStrings;         ///< char[]
+    Section termPilots;          ///< uint32_t[hash bucket count]
+    Section termSlots;           ///< uint64_t[hashed terms], tag << 32 | term index
+    Section documentFrequencies; ///< double[vocabulary size] (TF-IDF only)
+    Section classLabels;         ///< uint32_t[class count]
+    Section classPriors;         ///< double[class stride] log-priors
+    Section logLikelihoods;      ///< double[feature count * class stride], feature-major
+};
+
+uint64_t alignUp(uint64_t value) {
+    return (value + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment;
+}
+
+// Appends aligned sections to a stream while recording their layout
+class SectionWriter {
+public:
+    explicit SectionWriter(std::ofstream& out) : out(out), position(sizeof(ModelFileHeader)) {
+    }
+
+    template<typename T>
+    Section write(const T* values, size_t count) {
+        pad();
+        Section section{position, count};
+        out.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+        position += count * sizeof(T);
+        return section;
+    }
+
+private:
+    std::ofstream& out;
+    uint64_t position;
+
+    void pad() {
+        static const char zeros[kSectionAlignment] = {};
+        uint64_t aligned = alignUp(position);
+        out.write(zeros, aligned - position);
+        position = aligned;
+    }
+};
+
+// Borrow a section of the mapping as a typed array
+template<typename T>
+bool mapSection(
+    const std::shared_ptr<const MappedFile>& file,
+    const Section& section,
+    ConstArray<T>& result
+) {
+    if (section.offset % alignof(T) != 0 || section.offset > file->size() ||
+        section.count > (file->size() - section.offset) / sizeof(T)) {
+        return false;
+    }
+
+    result = ConstArray<T>(reinterpret_cast<const T*>(file->data() + section.offset),
+                           section.count, file);
+    return true;
+}
+
+} // namespace
+
+bool saveModelFile(
+    const std::string& filePath,
+    const FeatureExtractor& featureExtractor,
+    const NaiveBayes& model,
+    bool useStopWords
+) {
+    const VocabularyIndex& vocabulary = featureExtractor.getVocabularyIndex();
+    if (model.getFeatureCount() != featureExtractor.getFeatureCount()) {
+        std::cerr << "Error: Model feature count " << model.getFeatureCount()
+                  << " does not match extractor feature count "
+                  << featureExtractor.getFeatureCount() << std::endl;
+        return false;
+    }
+
+    if (model.getPrecision() != NaiveBayes::Precision::FLOAT64) {
+        std::cerr << "Error: Only models with double parameters can be saved; "
+                  << "save before changing the precision" << std::endl;
+        return false;
+    }
+
+    if (featureExtractor.isIdfFolded()) {
+        std::cerr << "Error: The model has the IDF weights folded into its parameters; "
+                  << "save the training pipeline instead" << std::endl;
+        return false;
+    }
+
+    // The file stores classes as SentimentLabel values in rows of kClassStride lanes
+    bool sentimentClasses = model.getClassStride() == NaiveBayes::kClassStride;
+    for (size_t lane = 0; sentimentClasses && lane < model.getClassCount(); ++lane) {
+        sentimentClasses = model.getClassNames()[lane] == sentimentToString(model.getClassLabels()[lane]);
+    }
+    if (!sentimentClasses) {
+        std::cerr << "Error: Only models whose classes are sentiment labels can be saved" << std::endl;
+        return false;
+    }
+
+    std::ofstream out(filePath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not open file " << filePath << " for writing" << std::endl;
+        return false;
+    }
+
+    std::vector<uint32_t> labelValues;
+    for (SentimentLabel label : model.getClassLabels()) {
+        labelValues.push_back(static_cast<uint32_t>(label));
+    }
+
+    ModelFileHeader header{};
+    std::memcpy(header.magic, kModelMagic, sizeof(kModelMagic));
+    header.version = kModelVersion;
+    header.byteOrderMark = kByteOrderMark;
+    header.featureMethod = static_cast<uint32_t>(featureExtractor.getMethod());
+    header.useStopWords = useStopWords ? 1 : 0;
+    header.documentCount = featureExtractor.getDocumentCount();
+    header.featureCount = model.getFeatureCount();
+    header.classStride = NaiveBayes::kClassStride;
+    header.hashBits = featureExtractor.getHashBits();
+    header.signedHashing = featureExtractor.isSignedHashing() ? 1 : 0;
+    header.ngramMin = static_cast<uint32_t>(featureExtractor.getNgramMin());
+    header.ngramMax = static_cast<uint32_t>(featureExtractor.getNgramMax());
+    header.tfIdfOptions = (featureExtractor.isSublinearTf() ? kSublinearTf : 0) |
+                          (featureExtractor.isL2Normalized() ? kL2Normalize : 0);
+    header.alpha = model.getAlpha();
+
+    // Reserve space for the header; it is rewritten once the layout is known
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    SectionWriter writer(out);
+    const ConstArray<double>& frequencies = featureExtractor.getDocumentFrequencies();
+    header.termOffsets = writer.write(vocabulary.getOffsets().data(), vocabulary.getOffsets().size());
+    header.termStrings = writer.write(vocabulary.getStrings().data(), vocabulary.getStrings().size());
+    header.termPilots = writer.write(vocabulary.getPilots().data(), vocabulary.getPilots().size());
+    header.termSlots = writer.write(vocabulary.getSlots().data(), vocabulary.getSlots().size());
+    header.documentFrequencies = writer.write(frequencies.data(), frequencies.size());
+    header.classLabels = writer.write(labelValues.data(), labelValues.size());
+    header.classPriors = writer.write(model.getLogPriors().data(), model.getLogPriors().size());
+    header.logLikelihoods = writer.write(model.getLogLikelihoodMatrix().data(),
+                                         model.getLogLikelihoodMatrix().size());
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+
+    if (!out) {
+        std::cerr << "Error: Failed to write model file " << filePath << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool loadModelFile(
+    const std::string& filePath,
+    FeatureExtractor& featureExtractor,
+    NaiveBayes& model,
+    bool& useStopWords
+) {
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(filePath)) {
+        std::cerr << "Error: Could not open model file " << filePath << std::endl;
+        return false;
+    }
+
+    ModelFileHeader header;
+    if (file->size() < sizeof(header)) {
+        std::cerr << "Error: Model file " << filePath << " is truncated" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    if (std::memcmp(header.magic, kModelMagic, sizeof(kModelMagic)) != 0) {
+        std::cerr << "Error: " << filePath << " is not a sentiment model file" << std::endl;
+        return false;
+    }
+    if (header.byteOrderMark != kByteOrderMark) {
+        std::cerr << "Error: Model file " << filePath
+                  << " was written on a machine with a different byte order" << std::endl;
+        return false;
+    }
+    if (header.version != kModelVersion) {
+        std::cerr << "Error: Unsupported model file version " << header.version
+                  << " (expected " << kModelVersion << ")" << std::endl;
+        return false;
+    }
+
+    std::shared_ptr<const MappedFile> mapping = file;
+    ConstArray<uint64_t> termOffsets;
+    ConstArray<char> termStrings;
+    ConstArray<uint32_t> termPilots;
+    ConstArray<uint64_t> termSlots;
+    ConstArray<double> frequencies;
+    ConstArray<uint32_t> labelValues;
+    ConstArray<double> priors;
+    ConstArray<double> likelihoods;
+    VocabularyIndex vocabulary;
+
+    if (!mapSection(mapping, header.termOffsets, termOffsets) ||
+        !mapSection(mapping, header.termStrings, termStrings) ||
+        !mapSection(mapping, header.termPilots, termPilots) ||
+        !mapSection(mapping, header.termSlots, termSlots) ||
+        !mapSection(mapping, header.documentFrequencies, frequencies) ||
+        !mapSection(mapping, header.classLabels, labelValues) ||
+        !mapSection(mapping, header.classPriors, priors) ||
+        !mapSection(mapping, header.logLikelihoods, likelihoods) ||
+        !VocabularyIndex::fromArrays(termOffsets, termStrings, termPilots, termSlots, vocabulary) ||
+        header.classStride != NaiveBayes::kClassStride ||
+        header.featureMethod > static_cast<uint32_t>(FeatureExtractor::Method::HASHING) ||
+        header.hashBits < 1 || header.hashBits > FeatureExtractor::kMaxHashBits ||
+        (header.tfIdfOptions & ~(kSublinearTf | kL2Normalize)) != 0) {
+        std::cerr << "Error: Model file " << filePath << " is corrupt" << std::endl;
+        return false;
+    }
+
+    std::vector<SentimentLabel> labels;
+    for (uint32_t value : labelValues) {
+        if (value > static_cast<uint32_t>(SentimentLabel::UNKNOWN)) {
+            std::cerr << "Error: Model file " << filePath << " has an invalid class label" << std::endl;
+            return false;
+        }
+        labels.push_back(static_cast<SentimentLabel>(value));
+    }
+    if (labels.empty()) {
+        std::cerr << "Error: Model file " << filePath << " contains no classes" << std::endl;
+        return false;
+    }
+
+    auto method = static_cast<FeatureExtractor::Method>(header.featureMethod);
+    size_t expectedFeatures = method == FeatureExtractor::Method::HASHING
+        ? size_t{1} << header.hashBits
+        : vocabulary.size();
+    if (header.featureCount != expectedFeatures ||
+        (method == FeatureExtractor::Method::TF_IDF && frequencies.size() != vocabulary.size()) ||
+        header.ngramMin < 1 || header.ngramMin > header.ngramMax ||
+        header.ngramMax > FeatureExtractor::kMaxNgramLength ||
+        !(header.alpha > 0.0) || !std::isfinite(header.alpha)) {
+        std::cerr << "Error: Model file " << filePath << " is corrupt" << std::endl;
+        return false;
+    }
+
+    // setParameters() checks the tables before changing the model, and the
+    // extractor settings were validated above, so a failure leaves both intact
+    if (!model.setParameters(labels, priors, likelihoods, header.featureCount)) {
+        return false;
+    }
+    model.setAlpha(header.alpha);
+
+    featureExtractor.setHashing(header.hashBits, header.signedHashing != 0);
+    featureExtractor.setNgramRange(header.ngramMin, header.ngramMax);
+    featureExtractor.setVocabulary(vocabulary, frequencies, header.documentCount, method);
+    featureExtractor.setIdfFolded(false);
+    featureExtractor.setTfIdfOptions((header.tfIdfOptions & kSublinearTf) != 0,
+                                     (header.tfIdfOptions & kL2Normalize) != 0);
+    useStopWords = header.useStopWords != 0;
+    return true;
+}
+
+} // namespace sentiment
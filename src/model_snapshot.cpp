@@ -0,0 +1,114 @@
+#include "model_snapshot.h"
+#include <vector>
+
+namespace sentiment {
+
+ModelSnapshot::ModelSnapshot(
+    const FeatureExtractor& sourceExtractor,
+    const NaiveBayes& sourceModel,
+    bool useStopWords,
+    NaiveBayes::Precision precision
+)
+    : preprocessor(useStopWords),
+      featureExtractor(preprocessor, sourceExtractor.getMethod()),
+      model(sourceModel.getAlpha()) {
+    // Share the immutable tables instead of copying them
+    featureExtractor.setHashing(sourceExtractor.getHashBits(), sourceExtractor.isSignedHashing());
+    featureExtractor.setNgramRange(sourceExtractor.getNgramMin(), sourceExtractor.getNgramMax());
+    featureExtractor.setTfIdfOptions(sourceExtractor.isSublinearTf(), sourceExtractor.isL2Normalized());
+    featureExtractor.setVocabulary(
+        sourceExtractor.getVocabularyIndex(),
+        sourceExtractor.getDocumentFrequencies(),
+        sourceExtractor.getDocumentCount(),
+        sourceExtractor.getMethod()
+    );
+
+    // A source model that already applies the IDF weights keeps doing so
+    featureExtractor.setIdfFolded(sourceExtractor.isIdfFolded());
+    if (!sourceModel.isTrained()) {
+        return;
+    }
+
+    model.shareParameters(sourceModel);
+    if (model.getPrecision() != NaiveBayes::Precision::FLOAT64) {
+        return;
+    }
+
+    // Fold the IDF weights into the rows before they are compressed
+    if (featureExtractor.getMethod() == FeatureExtractor::Method::TF_IDF &&
+        !featureExtractor.isIdfFolded() && !featureExtractor.isL2Normalized() &&
+        model.scaleFeatures(featureExtractor.getIdfWeights())) {
+        featureExtractor.setIdfFolded(true);
+    }
+    model.setPrecision(precision);
+}
+
+SentimentLabel ModelSnapshot::predict(std::string_view text, InferenceContext& context) const {
+    return model.predict(featureExtractor.extractFeatures(text, context));
+}
+
+SentimentLabel ModelSnapshot::predictScores(
+    std::string_view text,
+    InferenceContext& context,
+    double* logJointScores,
+    double* probabilities
+) const {
+    return model.predictScores(featureExtractor.extractFeatures(text, context),
+                               logJointScores, probabilities);
+}
+
+void ModelSnapshot::predictBatch(
+    const std::string* texts,
+    size_t count,
+    SentimentLabel* labels,
+    double* scores,
+    ThreadPool* pool
+) const {
+    scoreBatch(texts, count, labels, scores, pool);
+}
+
+void ModelSnapshot::predictBatch(
+    const std::string_view* texts,
+    size_t count,
+    SentimentLabel* labels,
+    double* scores,
+    ThreadPool* pool
+) const {
+    scoreBatch(texts, count, labels, scores, pool);
+}
+
+template<typename Text>
+void ModelSnapshot::scoreBatch(
+    const Text* texts,
+    size_t count,
+    SentimentLabel* labels,
+    double* scores,
+    ThreadPool* pool
+) const {
+    // Each chunk extracts its documents and scores them as one sparse batch
+    auto scoreRange = [&](size_t begin, size_t end, size_t) {
+        InferenceContext context;
+        std::vector<SparseVector> features(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            features[i - begin] = featureExtractor.extractFeatures(std::string_view(texts[i]), context);
+        }
+
+        model.predictBatch(features.data(), features.size(), labels + begin,
+                           scores ? scores + begin : nullptr);
+    };
+
+    // A busy pool would serialize concurrent callers; score inline instead
+    if (!pool || !pool->tryParallelFor(count, scoreRange)) {
+        scoreRange(0, count, 0);
+    }
+}
+
+const FeatureExtractor& ModelSnapshot::getFeatureExtractor() const {
+    return featureExtractor;
+}
+
+const NaiveBayes& ModelSnapshot::getModel() const {
+    return model;
+}
+
+} // namespace sentiment
@@ -1,11 +1,213 @@
 #include "naive_bayes.h"
+#include "pipeline_stats.h"
+#include "sparse_kernels.h"
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
 #include <iostream>
+#include <utility>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SENTIMENT_HAVE_AVX2_KERNEL 1
+#endif
 
 namespace sentiment {
 
+namespace {
+
+static_assert(static_cast<size_t>(SentimentLabel::UNKNOWN) + 1 == 4,
+              "Count lanes must cover every SentimentLabel value");
+constexpr size_t kStride = NaiveBayes::kClassStride;
+static_assert(kStride == kKernelLanes, "Matrix rows are scored by the shared sparse kernels");
+
+// Models with up to this many class lanes score without a heap allocation
+constexpr size_t kStackLanes = 64;
+
+// Smaller batches are counted on the calling thread
+constexpr size_t kParallelCountMinimum = 1024;
+
+// Memory the per-range count buffers of a parallel count may use
+constexpr size_t kCountBufferBytes = size_t{256} << 20;
+
+// Matrix cells per chunk when adding count buffers and taking logs
+constexpr size_t kCellGrain = 16384;
+
+// Per-document lane scores, on the stack unless the model has many classes
+template<typename T>
+class LaneBuffer {
+public:
+    explicit LaneBuffer(size_t lanes) {
+        if (lanes > kStackLanes) {
+            heap.resize(lanes);
+        }
+    }
+
+    T* data() {
+        return heap.empty() ? stack : heap.data();
+    }
+
+private:
+    alignas(32) T stack[kStackLanes];
+    std::vector<T> heap;
+};
+
+// Compact matrices: adds value * row to float lane sums for every nonzero
+// entry. The caller applies the per-class scale and offset.
+template<typename T>
+using CompactKernel = void (*)(const uint32_t* indices, const double* values, size_t count,
+                               const T* matrix, size_t stride, float* sums);
+
+template<typename T>
+void accumulateCompactScalar(const uint32_t* indices, const double* values, size_t count,
+                             const T* matrix, size_t stride, float* sums) {
+    for (size_t k = 0; k < count; ++k) {
+        float value = static_cast<float>(std::max(values[k], 0.0));
+        const T* row = matrix + static_cast<size_t>(indices[k]) * stride;
+        for (size_t lane = 0; lane < stride; ++lane) {
+            sums[lane] += value * static_cast<float>(row[lane]);
+        }
+    }
+}
+
+#ifdef SENTIMENT_HAVE_AVX2_KERNEL
+// Widen one block of four lanes to a 128-bit float register
+__attribute__((target("avx2,fma")))
+inline __m128 loadLanes(const float* row) {
+    return _mm_loadu_ps(row);
+}
+
+__attribute__((target("avx2,fma")))
+inline __m128 loadLanes(const int16_t* row) {
+    __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row));
+    return _mm_cvtepi32_ps(_mm_cvtepi16_epi32(packed));
+}
+
+__attribute__((target("avx2,fma")))
+inline __m128 loadLanes(const int8_t* row) {
+    int32_t packed;
+    std::memcpy(&packed, row, sizeof(packed));
+    return _mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_cvtsi32_si128(packed)));
+}
+
+template<typename T>
+__attribute__((target("avx2,fma")))
+void accumulateCompactAvx2(const uint32_t* indices, const double* values, size_t count,
+                           const T* matrix, size_t stride, float* sums) {
+    const __m128 zero = _mm_setzero_ps();
+    for (size_t block = 0; block < stride; block += kStride) {
+        const T* lanes = matrix + block;
+        __m128 sum0 = _mm_loadu_ps(sums + block);
+        __m128 sum1 = _mm_setzero_ps();
+
+        size_t k = 0;
+        for (; k + 2 <= count; k += 2) {
+            __m128 value0 = _mm_max_ps(_mm_set1_ps(static_cast<float>(values[k])), zero);
+            __m128 value1 = _mm_max_ps(_mm_set1_ps(static_cast<float>(values[k + 1])), zero);
+            __m128 row0 = loadLanes(lanes + static_cast<size_t>(indices[k]) * stride);
+            __m128 row1 = loadLanes(lanes + static_cast<size_t>(indices[k + 1]) * stride);
+            sum0 = _mm_fmadd_ps(value0, row0, sum0);
+            sum1 = _mm_fmadd_ps(value1, row1, sum1);
+        }
+        if (k < count) {
+            __m128 value = _mm_max_ps(_mm_set1_ps(static_cast<float>(values[k])), zero);
+            __m128 row = loadLanes(lanes + static_cast<size_t>(indices[k]) * stride);
+            sum0 = _mm_fmadd_ps(value, row, sum0);
+        }
+
+        _mm_storeu_ps(sums + block, _mm_add_ps(sum0, sum1));
+    }
+}
+#endif
+
+template<typename T>
+CompactKernel<T> compactKernel() {
+    static const CompactKernel<T> kernel = [] {
+#ifdef SENTIMENT_HAVE_AVX2_KERNEL
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return static_cast<CompactKernel<T>>(accumulateCompactAvx2<T>);
+        }
+#endif
+        return static_cast<CompactKernel<T>>(accumulateCompactScalar<T>);
+    }();
+    return kernel;
+}
+
+// Adds the compact-matrix part of the log joint scores to scores
+template<typename T>
+void addCompactScores(const SparseVector& features, const T* matrix, size_t stride,
+                      const double* offsets, const double* scales, double* scores) {
+    LaneBuffer<float> buffer(stride);
+    float* sums = buffer.data();
+    std::fill(sums, sums + stride, 0.0f);
+    compactKernel<T>()(features.indices.data(), features.values.data(), features.nonZeroCount(),
+                       matrix, stride, sums);
+
+    // Every lane value is offset + scale * q, so the offsets scale with the total count
+    double valueSum = 0.0;
+    for (double value : features.values) {
+        valueSum += std::max(value, 0.0);
+    }
+    for (size_t lane = 0; lane < stride; ++lane) {
+        scores[lane] += offsets[lane] * valueSum + scales[lane] * static_cast<double>(sums[lane]);
+    }
+}
+
+// Quantize a feature-major matrix to integers with a scale and offset per lane
+template<typename T>
+std::vector<T> quantizeLanes(const ConstArray<double>& matrix, size_t lanes, size_t stride,
+                             double* offsets, double* scales) {
+    const double limit = static_cast<double>(std::numeric_limits<T>::max());
+    size_t rows = matrix.size() / stride;
+    std::vector<T> quantized(matrix.size(), 0);
+
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        double low = std::numeric_limits<double>::infinity();
+        double high = -std::numeric_limits<double>::infinity();
+        for (size_t row = 0; row < rows; ++row) {
+            double value = matrix[row * stride + lane];
+            if (std::isfinite(value)) {
+                low = std::min(low, value);
+                high = std::max(high, value);
+            }
+        }
+        if (low > high) {
+            low = high = 0.0;
+        }
+
+        // Map [low, high] symmetrically onto [-limit, limit]
+        offsets[lane] = (low + high) / 2.0;
+        scales[lane] = high > low ? (high - low) / (2.0 * limit) : 1.0;
+        for (size_t row = 0; row < rows; ++row) {
+            double steps = (matrix[row * stride + lane] - offsets[lane]) / scales[lane];
+            quantized[row * stride + lane] = static_cast<T>(std::clamp(std::round(steps), -limit, limit));
+        }
+    }
+    return quantized;
+}
+
+// Smallest multiple of kStride that holds every class lane
+size_t strideFor(size_t classes) {
+    return std::max<size_t>(1, (classes + kStride - 1) / kStride) * kStride;
+}
+
+// Sum the feature values of one example into class-interleaved counts
+// (nonzero entries only; negative values are clamped to zero like in the
+// scoring kernels)
+void addExample(const SparseVector& features, size_t classId, size_t classes,
+                double* counts, double* totals) {
+    for (size_t k = 0; k < features.nonZeroCount(); ++k) {
+        double value = std::max(features.values[k], 0.0);
+        counts[features.indices[k] * classes + classId] += value;
+        totals[classId] += value;
+    }
+}
+
+} // namespace
+
 NaiveBayes::NaiveBayes(double alpha) : alpha(alpha) {
+    resetCounts();
 }
 
 bool NaiveBayes::train(const std::vector<FeatureVector>& trainingData) {
@@ -14,94 +216,518 @@ bool NaiveBayes::train(const std::vector<FeatureVector>& trainingData) {
         return false;
     }
 
-    // Initialize class counts
-    std::unordered_map<SentimentLabel, int> classCounts;
+    resetCounts();
+    return accumulateCounts(trainingData) && finalizeCounts();
+}
 
-    // Determine feature count from first example
-    featureCount = trainingData[0].features.size();
+bool NaiveBayes::trainClasses(
+    const std::vector<SparseVector>& documents,
+    const std::vector<std::string>& names
+) {
+    if (documents.empty() || documents.size() != names.size()) {
+        std::cerr << "Error: Training data is empty or the class names do not match the documents"
+                  << std::endl;
+        return false;
+    }
 
-    // Initialize likelihood structures
-    logLikelihoods.clear();
-    classTotals.clear();
+    // Sorted distinct names are the dense class ids
+    std::vector<std::string> distinct(names);
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
 
-    // Count class occurrences
-    for (const auto& example : trainingData) {
-        classCounts[example.label]++;
+    resetCounts();
+    countDimension = documents[0].dimension;
+    countClasses = distinct.size();
+    featureCounts.assign(countDimension * countClasses, 0.0);
+    classTotals.assign(countClasses, 0.0);
+    classExamples.assign(countClasses, 0);
+
+    std::vector<size_t> classIds(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        if (documents[i].dimension != countDimension) {
+            std::cerr << "Error: Inconsistent feature dimension in training data. Expected "
+                      << countDimension << ", got " << documents[i].dimension << std::endl;
+            resetCounts();
+            return false;
+        }
+        classIds[i] = std::lower_bound(distinct.begin(), distinct.end(), names[i]) - distinct.begin();
+    }
+    countBatch(documents.size(), [&](size_t i) {
+        return std::pair<const SparseVector&, size_t>(documents[i], classIds[i]);
+    });
+    countedExamples = documents.size();
+    countClassNames = std::move(distinct);
+
+    bool finalized = finalizeCounts();
+
+    // The counts are keyed by name, which the SentimentLabel entry points cannot extend
+    resetCounts();
+    return finalized;
+}
+
+void NaiveBayes::resetCounts() {
+    countDimension = 0;
+    countedExamples = 0;
+    countClasses = kLabelCount;
+    countClassNames.clear();
+    featureCounts.clear();
+    classTotals.assign(kLabelCount, 0.0);
+    classExamples.assign(kLabelCount, 0);
+}
+
+template<typename Example>
+void NaiveBayes::countBatch(size_t count, Example&& example) {
+    const size_t cells = countDimension * countClasses;
+    size_t ranges = 1;
+    if (threadPool && count >= kParallelCountMinimum) {
+        size_t affordable = kCountBufferBytes / std::max<size_t>(1, cells * sizeof(double));
+        ranges = std::min({threadPool->size(), affordable, count});
+    }
 
-        // Initialize class-specific data structures if not already done
-        if (logLikelihoods.find(example.label) == logLikelihoods.end()) {
-            logLikelihoods[example.label] = std::vector<double>(featureCount, 0.0);
-            classTotals[example.label] = 0.0;
+    if (ranges <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            auto [features, classId] = example(i);
+            addExample(features, classId, countClasses, featureCounts.data(), classTotals.data());
+            classExamples[classId]++;
         }
+        return;
+    }
 
-        // Sum feature values for each class
-        for (size_t i = 0; i < example.features.size(); ++i) {
-            logLikelihoods[example.label][i] += example.features[i];
-            classTotals[example.label] += example.features[i];
+    // Each contiguous range counts into its own buffer. Adding the buffers
+    // in range order keeps the sums independent of thread scheduling.
+    std::vector<std::vector<double>> rangeCounts(ranges);
+    std::vector<std::vector<double>> rangeTotals(ranges, std::vector<double>(countClasses, 0.0));
+    std::vector<std::vector<size_t>> rangeExamples(ranges, std::vector<size_t>(countClasses, 0));
+    threadPool->parallelFor(ranges, [&](size_t begin, size_t end, size_t) {
+        for (size_t range = begin; range < end; ++range) {
+            rangeCounts[range].assign(cells, 0.0);
+            for (size_t i = count * range / ranges; i < count * (range + 1) / ranges; ++i) {
+                auto [features, classId] = example(i);
+                addExample(features, classId, countClasses, rangeCounts[range].data(),
+                           rangeTotals[range].data());
+                rangeExamples[range][classId]++;
+            }
+        }
+    }, 1);
+
+    threadPool->parallelFor(cells, [&](size_t begin, size_t end, size_t) {
+        for (const std::vector<double>& partial : rangeCounts) {
+            for (size_t cell = begin; cell < end; ++cell) {
+                featureCounts[cell] += partial[cell];
+            }
+        }
+    }, kCellGrain);
+
+    for (size_t range = 0; range < ranges; ++range) {
+        for (size_t id = 0; id < countClasses; ++id) {
+            classTotals[id] += rangeTotals[range][id];
+            classExamples[id] += rangeExamples[range][id];
         }
     }
+}
 
-    // Calculate class priors
-    int totalExamples = trainingData.size();
-    for (const auto& [label, count] : classCounts) {
-        classPriors[label] = static_cast<double>(count) / totalExamples;
+bool NaiveBayes::accumulateCounts(const std::vector<FeatureVector>& trainingData) {
+    if (trainingData.empty()) {
+        return true;
+    }
+
+    // The first chunk fixes the feature count
+    if (countedExamples == 0) {
+        countDimension = trainingData[0].features.dimension;
+        featureCounts.assign(countDimension * countClasses, 0.0);
+    }
+
+    for (const auto& example : trainingData) {
+        if (example.features.dimension != countDimension) {
+            std::cerr << "Error: Inconsistent feature dimension in training data. Expected "
+                      << countDimension << ", got " << example.features.dimension << std::endl;
+            return false;
+        }
+    }
+
+    countBatch(trainingData.size(), [&](size_t i) {
+        return std::pair<const SparseVector&, size_t>(trainingData[i].features,
+                                                      static_cast<size_t>(trainingData[i].label));
+    });
+
+    countedExamples += trainingData.size();
+    return true;
+}
+
+bool NaiveBayes::finalizeCounts() {
+    if (countedExamples == 0) {
+        std::cerr << "Error: Training data is empty" << std::endl;
+        return false;
+    }
+
+    size_t features = countDimension;
+
+    // Assign class lanes to the counted classes in id order
+    std::vector<size_t> classIds;
+    std::vector<SentimentLabel> labels;
+    std::vector<std::string> names;
+    for (size_t id = 0; id < countClasses; ++id) {
+        if (classExamples[id] == 0) {
+            continue;
+        }
+        classIds.push_back(id);
+        if (countClassNames.empty()) {
+            labels.push_back(static_cast<SentimentLabel>(id));
+            names.push_back(sentimentToString(labels.back()));
+        } else {
+            labels.push_back(stringToSentiment(countClassNames[id]));
+            names.push_back(countClassNames[id]);
+        }
+    }
+    size_t stride = strideFor(classIds.size());
+
+    // Calculate class priors (padding lanes can never win)
+    std::vector<double> priors(stride, -std::numeric_limits<double>::infinity());
+    for (size_t lane = 0; lane < classIds.size(); ++lane) {
+        size_t count = classExamples[classIds[lane]];
+        priors[lane] = std::log(static_cast<double>(count) / countedExamples);
     }
 
     // Calculate log likelihoods with Laplace smoothing
-    for (auto& [label, likelihoods] : logLikelihoods) {
-        for (size_t i = 0; i < featureCount; ++i) {
-            // Apply Laplace smoothing
-            double smoothedProb = (likelihoods[i] + alpha) /
-                                (classTotals[label] + alpha * featureCount);
+    std::vector<double> denominators(classIds.size());
+    for (size_t lane = 0; lane < classIds.size(); ++lane) {
+        denominators[lane] = classTotals[classIds[lane]] + alpha * features;
+    }
 
-            // Store log probability for numerical stability
-            likelihoods[i] = std::log(smoothedProb);
+    // Store log probabilities for numerical stability. Each block of rows
+    // gets its ratios first and then one vectorized log; padding lanes
+    // hold 1 so that they become 0.
+    std::vector<double> matrix(features * stride, 1.0);
+    auto logRows = [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            const double* counts = &featureCounts[i * countClasses];
+            double* row = &matrix[i * stride];
+            for (size_t lane = 0; lane < classIds.size(); ++lane) {
+                row[lane] = (counts[classIds[lane]] + alpha) / denominators[lane];
+            }
         }
+        logValues(matrix.data() + begin * stride, (end - begin) * stride);
+    };
+
+    if (threadPool && matrix.size() >= kCellGrain) {
+        threadPool->parallelFor(features, logRows, kCellGrain / stride);
+    } else {
+        logRows(0, features, 0);
     }
 
+    featureCount = features;
+    classStride = stride;
+    classLabels = std::move(labels);
+    classNames = std::move(names);
+    classLogPriors = ConstArray<double>(std::move(priors));
+    logLikelihoods = ConstArray<double>(std::move(matrix));
+    applyPrecision();
+
     std::cout << "Trained Naive Bayes with "
-              << trainingData.size() << " examples and "
+              << countedExamples << " examples and "
               << featureCount << " features" << std::endl;
 
     trained = true;
     return true;
 }
 
-SentimentLabel NaiveBayes::predict(const std::vector<double>& features) const {
+bool NaiveBayes::hasTrainingCounts() const {
+    return countedExamples > 0;
+}
+
+void NaiveBayes::setThreadPool(std::shared_ptr<ThreadPool> pool) {
+    threadPool = std::move(pool);
+}
+
+bool NaiveBayes::partialFit(const std::vector<FeatureVector>& batch) {
+    if (trained && !hasTrainingCounts()) {
+        std::cerr << "Error: Model has no training counts to update (was it loaded from a file?)"
+                  << std::endl;
+        return false;
+    }
+    if (batch.empty()) {
+        return trained;
+    }
+
+    // A grown vocabulary appends feature rows; existing rows keep their counts
+    size_t features = batch[0].features.dimension;
+    if (countedExamples > 0) {
+        if (features < countDimension) {
+            std::cerr << "Error: Feature dimension cannot shrink. Expected at least "
+                      << countDimension << ", got " << features << std::endl;
+            return false;
+        }
+        countDimension = features;
+        featureCounts.resize(features * countClasses, 0.0);
+    }
+
+    return accumulateCounts(batch) && finalizeCounts();
+}
+
+SentimentLabel NaiveBayes::predict(const SparseVector& features) const {
     if (!trained) {
         std::cerr << "Error: Model not trained" << std::endl;
         return SentimentLabel::UNKNOWN;
     }
 
-    if (features.size() != featureCount) {
+    if (features.dimension != featureCount) {
         std::cerr << "Error: Feature vector size mismatch. Expected "
-                  << featureCount << ", got " << features.size() << std::endl;
+                  << featureCount << ", got " << features.dimension << std::endl;
         return SentimentLabel::UNKNOWN;
     }
 
-    // Calculate log probabilities for each class
-    double maxLogProb = -std::numeric_limits<double>::infinity();
-    SentimentLabel bestLabel = SentimentLabel::UNKNOWN;
+    SENTIMENT_TIME_STAGE(Stage::SCORING);
+    LaneBuffer<double> buffer(classStride);
+    scoreLanes(features, buffer.data());
+    return classLabels[bestLane(buffer.data())];
+}
+
+size_t NaiveBayes::predictClass(const SparseVector& features) const {
+    size_t best = kNoClass;
+    predictClassBatch(&features, 1, &best);
+    return best;
+}
+
+SentimentLabel NaiveBayes::predictScores(
+    const SparseVector& features,
+    double* logJointScores,
+    double* probabilities
+) const {
+    if (!trained || features.dimension != featureCount) {
+        SentimentLabel label = predict(features); // Reports the error
+        for (size_t lane = 0; lane < classLabels.size(); ++lane) {
+            if (logJointScores) {
+                logJointScores[lane] = -std::numeric_limits<double>::infinity();
+            }
+            if (probabilities) {
+                probabilities[lane] = 0.0;
+            }
+        }
+        return label;
+    }
+
+    SENTIMENT_TIME_STAGE(Stage::SCORING);
+    LaneBuffer<double> buffer(classStride);
+    double* scores = buffer.data();
+    scoreLanes(features, scores);
+    size_t best = bestLane(scores);
+
+    if (logJointScores) {
+        std::copy(scores, scores + classLabels.size(), logJointScores);
+    }
+
+    if (probabilities) {
+        // log-sum-exp around the maximum keeps every exponent <= 0
+        double maxScore = scores[best];
+        double sum = 0.0;
+        for (size_t lane = 0; lane < classLabels.size(); ++lane) {
+            probabilities[lane] = std::exp(scores[lane] - maxScore);
+            sum += probabilities[lane];
+        }
+        for (size_t lane = 0; lane < classLabels.size(); ++lane) {
+            probabilities[lane] /= sum;
+        }
+    }
+
+    return classLabels[best];
+}
+
+void NaiveBayes::predictBatch(
+    const SparseVector* documents,
+    size_t count,
+    SentimentLabel* labels,
+    double* scores
+) const {
+    auto document = [documents](size_t i) -> const SparseVector& { return documents[i]; };
+    scoreBatch(document, count, scores, [&](size_t i, size_t lane) {
+        labels[i] = lane == kNoClass ? SentimentLabel::UNKNOWN : classLabels[lane];
+    });
+}
+
+void NaiveBayes::predictBatch(
+    const FeatureVector* examples,
+    size_t count,
+    SentimentLabel* labels,
+    double* scores
+) const {
+    auto document = [examples](size_t i) -> const SparseVector& { return examples[i].features; };
+    scoreBatch(document, count, scores, [&](size_t i, size_t lane) {
+        labels[i] = lane == kNoClass ? SentimentLabel::UNKNOWN : classLabels[lane];
+    });
+}
 
-    for (const auto& [label, prior] : classPriors) {
-        // Start with log of prior probability
-        double logProb = std::log(prior);
+void NaiveBayes::predictClassBatch(
+    const SparseVector* documents,
+    size_t count,
+    size_t* classes,
+    double* scores
+) const {
+    auto document = [documents](size_t i) -> const SparseVector& { return documents[i]; };
+    scoreBatch(document, count, scores, [&](size_t i, size_t lane) {
+        classes[i] = lane;
+    });
+}
+
+template<typename Document, typename Emit>
+void NaiveBayes::scoreBatch(Document&& document, size_t count, double* scores, Emit&& emit) const {
+    if (!trained) {
+        std::cerr << "Error: Model not trained" << std::endl;
+        for (size_t i = 0; i < count; ++i) {
+            emit(i, kNoClass);
+        }
+        return;
+    }
 
-        // Add log likelihoods for each feature
-        for (size_t i = 0; i < features.size(); ++i) {
-            if (features[i] > 0) {
-                logProb += features[i] * logLikelihoods.at(label)[i];
+    SENTIMENT_TIME_STAGE_ITEMS(Stage::SCORING, count);
+    LaneBuffer<double> buffer(classStride);
+    double* laneScores = buffer.data();
+    for (size_t i = 0; i < count; ++i) {
+        const SparseVector& features = document(i);
+        if (features.dimension != featureCount) {
+            std::cerr << "Error: Feature vector size mismatch. Expected "
+                      << featureCount << ", got " << features.dimension << std::endl;
+            emit(i, kNoClass);
+            if (scores) {
+                scores[i] = -std::numeric_limits<double>::infinity();
             }
+            continue;
         }
 
-        // Keep track of the most probable class
-        if (logProb > maxLogProb) {
-            maxLogProb = logProb;
-            bestLabel = label;
+        scoreLanes(features, laneScores);
+        size_t lane = bestLane(laneScores);
+        emit(i, lane);
+        if (scores) {
+            scores[i] = laneScores[lane];
         }
     }
+}
 
-    return bestLabel;
+void NaiveBayes::scoreLanes(const SparseVector& features, double* scores) const {
+    // Start every class lane with its log prior, then make one pass over the
+    // nonzero features that updates all classes at once
+    std::copy(classLogPriors.begin(), classLogPriors.end(), scores);
+    switch (precision) {
+        case Precision::FLOAT64:
+            // Non-positive values are skipped (clamped to zero) as NB expects counts
+            accumulateSparseRows(features, logLikelihoods.data(), classStride, true, scores);
+            break;
+        case Precision::FLOAT32:
+            addCompactScores(features, floatLikelihoods.data(), classStride,
+                             laneOffsets.data(), laneScales.data(), scores);
+            break;
+        case Precision::INT16:
+            addCompactScores(features, int16Likelihoods.data(), classStride,
+                             laneOffsets.data(), laneScales.data(), scores);
+            break;
+        case Precision::INT8:
+            addCompactScores(features, int8Likelihoods.data(), classStride,
+                             laneOffsets.data(), laneScales.data(), scores);
+            break;
+    }
+}
+
+bool NaiveBayes::setPrecision(Precision target) {
+    if (target == precision) {
+        return true;
+    }
+
+    // The double matrix is released by a conversion
+    if (trained && precision != Precision::FLOAT64) {
+        std::cerr << "Error: Model parameters are already compressed; "
+                  << "retrain or reload the model to change their precision" << std::endl;
+        return false;
+    }
+
+    precision = target;
+    if (trained) {
+        applyPrecision();
+    }
+    return true;
+}
+
+void NaiveBayes::applyPrecision() {
+    floatLikelihoods = ConstArray<float>();
+    int16Likelihoods = ConstArray<int16_t>();
+    int8Likelihoods = ConstArray<int8_t>();
+    laneOffsets.assign(classStride, 0.0);
+    laneScales.assign(classStride, 0.0);
+    if (precision == Precision::FLOAT64) {
+        return;
+    }
+
+    size_t lanes = classNames.size();
+    if (precision == Precision::FLOAT32) {
+        floatLikelihoods = ConstArray<float>(std::vector<float>(logLikelihoods.begin(), logLikelihoods.end()));
+        std::fill(laneScales.begin(), laneScales.begin() + lanes, 1.0);
+    } else if (precision == Precision::INT16) {
+        int16Likelihoods = ConstArray<int16_t>(
+            quantizeLanes<int16_t>(logLikelihoods, lanes, classStride, laneOffsets.data(), laneScales.data()));
+    } else {
+        int8Likelihoods = ConstArray<int8_t>(
+            quantizeLanes<int8_t>(logLikelihoods, lanes, classStride, laneOffsets.data(), laneScales.data()));
+    }
+    logLikelihoods = ConstArray<double>();
+}
+
+NaiveBayes::Precision NaiveBayes::getPrecision() const {
+    return precision;
+}
+
+size_t NaiveBayes::getParameterBytes() const {
+    switch (precision) {
+        case Precision::FLOAT32: return floatLikelihoods.size() * sizeof(float);
+        case Precision::INT16: return int16Likelihoods.size() * sizeof(int16_t);
+        case Precision::INT8: return int8Likelihoods.size() * sizeof(int8_t);
+        default: return logLikelihoods.size() * sizeof(double);
+    }
+}
+
+void NaiveBayes::shareParameters(const NaiveBayes& source) {
+    trained = source.trained;
+    featureCount = source.featureCount;
+    classStride = source.classStride;
+    classLabels = source.classLabels;
+    classNames = source.classNames;
+    classLogPriors = source.classLogPriors;
+    logLikelihoods = source.logLikelihoods;
+    precision = source.precision;
+    floatLikelihoods = source.floatLikelihoods;
+    int16Likelihoods = source.int16Likelihoods;
+    int8Likelihoods = source.int8Likelihoods;
+    laneOffsets = source.laneOffsets;
+    laneScales = source.laneScales;
+    resetCounts();
+}
+
+bool NaiveBayes::scaleFeatures(const ConstArray<double>& scales) {
+    if (!trained || precision != Precision::FLOAT64 || scales.size() != featureCount) {
+        std::cerr << "Error: Feature weights can only be folded into a trained FLOAT64 model "
+                  << "with one weight per feature" << std::endl;
+        return false;
+    }
+
+    // Padding lanes keep their values
+    std::vector<double> scaled(logLikelihoods.begin(), logLikelihoods.end());
+    for (size_t feature = 0; feature < featureCount; ++feature) {
+        double* row = &scaled[feature * classStride];
+        for (size_t lane = 0; lane < classNames.size(); ++lane) {
+            row[lane] *= scales[feature];
+        }
+    }
+    logLikelihoods = ConstArray<double>(std::move(scaled));
+    resetCounts(); // The counts no longer match the parameters
+    return true;
+}
+
+size_t NaiveBayes::bestLane(const double* scores) const {
+    // Keep track of the most probable class (lowest label wins ties)
+    size_t best = 0;
+    for (size_t lane = 1; lane < classNames.size(); ++lane) {
+        if (scores[lane] > scores[best]) {
+            best = lane;
+        }
+    }
+    return best;
 }
 
 bool NaiveBayes::isTrained() const {
@@ -112,4 +738,72 @@ std::string NaiveBayes::getName() const {
     return "Naive Bayes";
 }
 
+const std::vector<SentimentLabel>& NaiveBayes::getClassLabels() const {
+    return classLabels;
+}
+
+const std::vector<std::string>& NaiveBayes::getClassNames() const {
+    return classNames;
+}
+
+size_t NaiveBayes::getClassCount() const {
+    return classNames.size();
+}
+
+size_t NaiveBayes::getClassStride() const {
+    return classStride;
+}
+
+const ConstArray<double>& NaiveBayes::getLogPriors() const {
+    return classLogPriors;
+}
+
+const ConstArray<double>& NaiveBayes::getLogLikelihoodMatrix() const {
+    return logLikelihoods;
+}
+
+size_t NaiveBayes::getFeatureCount() const {
+    return featureCount;
+}
+
+double NaiveBayes::getAlpha() const {
+    return alpha;
+}
+
+void NaiveBayes::setAlpha(double value) {
+    alpha = value;
+}
+
+bool NaiveBayes::setParameters(
+    const std::vector<SentimentLabel>& labels,
+    ConstArray<double> logPriors,
+    ConstArray<double> likelihoods,
+    size_t features
+) {
+    if (labels.empty() || labels.size() > kClassStride) {
+        std::cerr << "Error: Model parameters must contain between 1 and "
+                  << kClassStride << " classes" << std::endl;
+        return false;
+    }
+
+    if (logPriors.size() != kClassStride || likelihoods.size() != features * kClassStride) {
+        std::cerr << "Error: Model parameter tables do not match the feature count" << std::endl;
+        return false;
+    }
+
+    classStride = kClassStride;
+    classLabels = labels;
+    classNames.clear();
+    for (SentimentLabel label : labels) {
+        classNames.push_back(sentimentToString(label));
+    }
+    classLogPriors = std::move(logPriors);
+    logLikelihoods = std::move(likelihoods);
+    featureCount = features;
+    resetCounts(); // The counts behind the new parameters are unknown
+    applyPrecision();
+    trained = true;
+    return true;
+}
+
 } // namespace sentiment
@@ -0,0 +1,228 @@
+#include "pipeline_stats.h"
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+namespace sentiment {
+
+namespace {
+
+// Counters of one stage, written only by the thread that owns the block
+struct StageCounters {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> totalNanos;
+    std::array<std::atomic<uint64_t>, StageStats::kBucketCount> buckets;
+};
+
+struct ThreadCounters {
+    std::array<StageCounters, kStageCount> stages;
+    bool inUse = false; ///< Owned by a live thread (guarded by the registry mutex)
+};
+
+// Single-writer increment: no read-modify-write instruction is needed
+inline void add(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+class Registry {
+public:
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    ThreadCounters* acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& block : blocks) {
+            if (!block->inUse) {
+                block->inUse = true;
+                return block.get();
+            }
+        }
+        blocks.push_back(std::make_unique<ThreadCounters>()); // Value-initialized to zero
+        blocks.back()->inUse = true;
+        return blocks.back().get();
+    }
+
+    void release(ThreadCounters* block) {
+        std::lock_guard<std::mutex> lock(mutex);
+        block->inUse = false;
+    }
+
+    template<typename Visit>
+    void forEach(Visit&& visit) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& block : blocks) {
+            visit(*block);
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadCounters>> blocks; ///< Never freed, so samples survive their thread
+};
+
+// Hands the calling thread's block back to the registry when the thread exits
+class ThreadSlot {
+public:
+    ThreadSlot() : block(Registry::instance().acquire()) {}
+    ~ThreadSlot() { Registry::instance().release(block); }
+    ThreadCounters* block;
+};
+
+ThreadCounters& localCounters() {
+    thread_local ThreadSlot slot;
+    return *slot.block;
+}
+
+} // anonymous namespace
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+        case Stage::PREPROCESS: return "preprocess";
+        case Stage::FEATURE_EXTRACTION: return "feature_extraction";
+        case Stage::SCORING: return "scoring";
+        default: return "unknown";
+    }
+}
+
+size_t StageStats::bucketIndex(uint64_t nanos) {
+    if (nanos < 8) {
+        return static_cast<size_t>(nanos);
+    }
+
+    // Position of the highest set bit, then the next three bits
+    unsigned exponent = 0;
+#if defined(__GNUC__) || defined(__clang__)
+    exponent = 63u - static_cast<unsigned>(__builtin_clzll(nanos));
+#else
+    for (uint64_t rest = nanos; rest > 1; rest >>= 1) {
+        ++exponent;
+    }
+#endif
+    size_t subBucket = static_cast<size_t>((nanos >> (exponent - 3)) & 7);
+    return (exponent - 2) * 8 + subBucket;
+}
+
+uint64_t StageStats::bucketUpperBound(size_t bucket) {
+    if (bucket < 8) {
+        return bucket;
+    }
+
+    unsigned exponent = static_cast<unsigned>(bucket / 8 + 2);
+    uint64_t lower = (uint64_t{8} + bucket % 8) << (exponent - 3);
+    return lower + ((uint64_t{1} << (exponent - 3)) - 1);
+}
+
+double StageStats::meanNanos() const {
+    return count == 0 ? 0.0 : static_cast<double>(totalNanos) / static_cast<double>(count);
+}
+
+uint64_t StageStats::percentileNanos(double percentile) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    // Smallest bucket whose cumulative count reaches the rank
+    double rank = percentile / 100.0 * static_cast<double>(count);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+        seen += buckets[bucket];
+        if (seen > 0 && static_cast<double>(seen) >= rank) {
+            return bucketUpperBound(bucket);
+        }
+    }
+    return bucketUpperBound(buckets.size() - 1);
+}
+
+const StageStats& StatsSnapshot::operator[](Stage stage) const {
+    return stages[static_cast<size_t>(stage)];
+}
+
+std::string StatsSnapshot::toPrometheus() const {
+    static const double boundaries[] = {
+        1e-7, 2.5e-7, 5e-7, 1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4,
+        1e-3, 2.5e-3, 5e-3, 1e-2, 2.5e-2, 5e-2, 1e-1, 2.5e-1, 5e-1, 1.0, 2.5, 5.0, 10.0
+    };
+
+    std::string text =
+        "# HELP sentiment_stage_duration_seconds Time spent per document in each pipeline stage\n"
+        "# TYPE sentiment_stage_duration_seconds histogram\n";
+    char line[512];
+    for (size_t s = 0; s < kStageCount; ++s) {
+        const StageStats& stage = stages[s];
+        const char* name = stageName(static_cast<Stage>(s));
+
+        // A histogram bucket counts toward a boundary once it lies entirely below it
+        size_t bucket = 0;
+        uint64_t cumulative = 0;
+        for (double boundary : boundaries) {
+            uint64_t limit = static_cast<uint64_t>(boundary * 1e9);
+            while (bucket < stage.buckets.size() && StageStats::bucketUpperBound(bucket) <= limit) {
+                cumulative += stage.buckets[bucket++];
+            }
+            std::snprintf(line, sizeof(line),
+                          "sentiment_stage_duration_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n",
+                          name, boundary, static_cast<unsigned long long>(cumulative));
+            text += line;
+        }
+        std::snprintf(line, sizeof(line),
+                      "sentiment_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n"
+                      "sentiment_stage_duration_seconds_sum{stage=\"%s\"} %.9f\n"
+                      "sentiment_stage_duration_seconds_count{stage=\"%s\"} %llu\n",
+                      name, static_cast<unsigned long long>(stage.count),
+                      name, static_cast<double>(stage.totalNanos) * 1e-9,
+                      name, static_cast<unsigned long long>(stage.count));
+        text += line;
+    }
+    return text;
+}
+
+void PipelineStats::record(Stage stage, uint64_t nanos, uint64_t items) {
+    if (!kEnabled || items == 0) {
+        return;
+    }
+
+    StageCounters& counters = localCounters().stages[static_cast<size_t>(stage)];
+    add(counters.count, items);
+    add(counters.totalNanos, nanos);
+    add(counters.buckets[StageStats::bucketIndex(nanos / items)], items);
+}
+
+StatsSnapshot PipelineStats::snapshot() {
+    StatsSnapshot result;
+    for (auto& stage : result.stages) {
+        stage.buckets.assign(StageStats::kBucketCount, 0);
+    }
+    if (!kEnabled) {
+        return result;
+    }
+
+    Registry::instance().forEach([&](const ThreadCounters& block) {
+        for (size_t s = 0; s < kStageCount; ++s) {
+            const StageCounters& counters = block.stages[s];
+            StageStats& stage = result.stages[s];
+            stage.count += counters.count.load(std::memory_order_relaxed);
+            stage.totalNanos += counters.totalNanos.load(std::memory_order_relaxed);
+            for (size_t b = 0; b < StageStats::kBucketCount; ++b) {
+                stage.buckets[b] += counters.buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+    });
+    return result;
+}
+
+void PipelineStats::reset() {
+    Registry::instance().forEach([](ThreadCounters& block) {
+        for (auto& counters : block.stages) {
+            counters.count.store(0, std::memory_order_relaxed);
+            counters.totalNanos.store(0, std::memory_order_relaxed);
+            for (auto& bucket : counters.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+    });
+}
+
+} // namespace sentiment
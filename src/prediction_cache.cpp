@@ -0,0 +1,129 @@
+#include "prediction_cache.h"
+#include <algorithm>
+
+namespace sentiment {
+
+namespace {
+
+// Spread the key bits so shard and set indices are independent
+uint64_t mixKey(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    return key;
+}
+
+} // namespace
+
+PredictionCache::PredictionCache(size_t capacity, size_t shards) {
+    // Every shard holds at least one full set
+    size_t sets = std::max<size_t>(1, (capacity + kWays - 1) / kWays);
+    shardCount = std::max<size_t>(1, std::min(shards, sets));
+    setsPerShard = (sets + shardCount - 1) / shardCount;
+
+    this->shards = std::make_unique<Shard[]>(shardCount);
+    for (size_t s = 0; s < shardCount; ++s) {
+        this->shards[s].entries.resize(setsPerShard * kWays);
+        this->shards[s].hands.assign(setsPerShard, 0);
+    }
+}
+
+PredictionCache::Shard& PredictionCache::locate(uint64_t key, size_t& set) const {
+    uint64_t mixed = mixKey(key);
+    Shard& shard = shards[mixed % shardCount];
+    set = static_cast<size_t>((mixed / shardCount) % setsPerShard) * kWays;
+    return shard;
+}
+
+bool PredictionCache::lookup(uint64_t key, SentimentLabel& label, double& score) {
+    size_t set;
+    Shard& shard = locate(key, set);
+    uint64_t current = currentGeneration.load();
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (size_t way = 0; way < kWays; ++way) {
+        Entry& entry = shard.entries[set + way];
+        if (entry.generation == current && entry.key == key) {
+            entry.referenced = true;
+            label = entry.label;
+            score = entry.score;
+            shard.counters.hits++;
+            return true;
+        }
+    }
+    shard.counters.misses++;
+    return false;
+}
+
+void PredictionCache::insert(uint64_t key, uint64_t generation, SentimentLabel label, double score) {
+    size_t set;
+    Shard& shard = locate(key, set);
+    uint64_t current = currentGeneration.load();
+    if (generation != current) {
+        return; // Predicted with a model that has been replaced
+    }
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Entry* target = nullptr;
+    for (size_t way = 0; way < kWays && !target; ++way) {
+        Entry& entry = shard.entries[set + way];
+        if (entry.generation != current || entry.key == key) {
+            target = &entry;
+        }
+    }
+
+    if (!target) {
+        // CLOCK: give referenced entries a second chance
+        uint8_t& hand = shard.hands[set / kWays];
+        while (shard.entries[set + hand].referenced) {
+            shard.entries[set + hand].referenced = false;
+            hand = static_cast<uint8_t>((hand + 1) % kWays);
+        }
+        target = &shard.entries[set + hand];
+        hand = static_cast<uint8_t>((hand + 1) % kWays);
+        shard.counters.evictions++;
+    }
+
+    // If invalidate() ran since the check above, the old generation makes
+    // the entry unusable, so it is never served
+    target->key = key;
+    target->generation = generation;
+    target->label = label;
+    target->score = score;
+    target->referenced = false;
+    shard.counters.insertions++;
+}
+
+uint64_t PredictionCache::generation() const {
+    return currentGeneration.load();
+}
+
+void PredictionCache::invalidate() {
+    currentGeneration.fetch_add(1);
+}
+
+PredictionCacheStats PredictionCache::stats() const {
+    PredictionCacheStats total;
+    for (size_t s = 0; s < shardCount; ++s) {
+        std::lock_guard<std::mutex> lock(shards[s].mutex);
+        total.hits += shards[s].counters.hits;
+        total.misses += shards[s].counters.misses;
+        total.insertions += shards[s].counters.insertions;
+        total.evictions += shards[s].counters.evictions;
+    }
+    total.capacity = capacity();
+    return total;
+}
+
+void PredictionCache::resetStats() {
+    for (size_t s = 0; s < shardCount; ++s) {
+        std::lock_guard<std::mutex> lock(shards[s].mutex);
+        shards[s].counters = PredictionCacheStats{};
+    }
+}
+
+size_t PredictionCache::capacity() const {
+    return shardCount * setsPerShard * kWays;
+}
+
+} // namespace sentiment
@@ -1,9 +1,16 @@
 #include "sentiment_api.h"
+#include "cross_validation.h"
 #include "data_loader.h"
 #include "preprocessor.h"
 #include "feature_extractor.h"
 #include "naive_bayes.h"
 #include "evaluator.h"
+#include "model_io.h"
+#include "model_snapshot.h"
+#include "prediction_cache.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <cmath>
@@ -18,14 +25,20 @@ public:
     Preprocessor preprocessor;
     FeatureExtractor featureExtractor;
     NaiveBayes model;
-    Evaluator* evaluator = nullptr;
+    std::unique_ptr<Evaluator> evaluator;
+    std::shared_ptr<ThreadPool> threadPool;
+    std::unique_ptr<PredictionCache> predictionCache; ///< Null when disabled
 
-    std::vector<TextData> trainData;
-    std::vector<TextData> validData;
+    // Frozen copy of the trained pipeline read by the prediction methods;
+    // only accessed through std::atomic_load and std::atomic_store
+    std::shared_ptr<const ModelSnapshot> snapshot;
+
+    ConstSpan<TextData> trainData;   ///< Training rows of dataLoader
+    ConstSpan<TextData> validData;   ///< Validation rows of dataLoader
     std::vector<FeatureVector> trainFeatures;
     std::vector<FeatureVector> validFeatures;
 
-    EvaluationMetrics metrics;
+    EvaluationMetrics metrics{};
     bool isTrained = false;
 
     Impl(const SentimentConfig& conf)
@@ -33,10 +46,46 @@ public:
           preprocessor(conf.useStopWords),
           featureExtractor(preprocessor, conf.featureMethod),
           model(conf.naiveBayesAlpha) {
+        featureExtractor.setHashing(conf.hashBits, conf.signedHashing);
+        featureExtractor.setNgramRange(conf.ngramMin, conf.ngramMax);
+        featureExtractor.setTfIdfOptions(conf.sublinearTf, conf.l2Normalize);
+        if (conf.numThreads != 1) {
+            threadPool = std::make_shared<ThreadPool>(conf.numThreads);
+            dataLoader.setThreadPool(threadPool);
+            featureExtractor.setThreadPool(threadPool);
+            model.setThreadPool(threadPool);
+        }
+        if (conf.predictionCacheSize > 0) {
+            predictionCache = std::make_unique<PredictionCache>(conf.predictionCacheSize);
+        }
+    }
+
+    // Replace the snapshot seen by predictions with the current pipeline.
+    // Only the snapshot is compressed (and has the IDF folded in); the
+    // model keeps double parameters for saving and further training.
+    void publish() {
+        auto next = std::make_shared<const ModelSnapshot>(featureExtractor, model, config.useStopWords,
+                                                          config.modelPrecision);
+        std::atomic_store(&snapshot, std::shared_ptr<const ModelSnapshot>(std::move(next)));
+
+        // After the swap: a prediction that read the old generation may
+        // still use the old snapshot, and its entry is discarded
+        if (predictionCache) {
+            predictionCache->invalidate();
+        }
     }
 
-    ~Impl() {
-        delete evaluator;
+    std::shared_ptr<const ModelSnapshot> currentSnapshot() const {
+        return std::atomic_load(&snapshot);
+    }
+
+    // Created on first use; predicts with the shared pool
+    Evaluator& getEvaluator() {
+        if (!evaluator) {
+            evaluator = std::make_unique<Evaluator>(model);
+            evaluator->setThreadPool(threadPool);
+        }
+        return *evaluator;
     }
 };
 
@@ -52,13 +101,17 @@ bool SentimentAnalyzer::loadTrainingData(
     int textColumn,
     int labelColumn
 ) {
+    // The views of the previous split do not survive reloading
+    pImpl->trainData = {};
+    pImpl->validData = {};
     bool success = pImpl->dataLoader.loadFromCSV(filePath, hasHeader, textColumn, labelColumn);
 
     if (success) {
         // Split data into training and validation sets
-        auto [train, valid] = pImpl->dataLoader.splitTrainValidation(pImpl->config.trainRatio);
-        pImpl->trainData = std::move(train);
-        pImpl->validData = std::move(valid);
+        DataSplit split = pImpl->dataLoader.splitTrainValidation(
+            pImpl->config.trainRatio, pImpl->config.splitSeed);
+        pImpl->trainData = split.train;
+        pImpl->validData = split.validation;
 
         std::cout << "Loaded " << pImpl->dataLoader.getData().size() << " examples" << std::endl;
         std::cout << "Split into " << pImpl->trainData.size() << " training and "
@@ -90,84 +143,346 @@ bool SentimentAnalyzer::train() {
     // Train the model
     bool success = pImpl->model.train(pImpl->trainFeatures);
     pImpl->isTrained = success;
+    if (success) {
+        pImpl->publish();
+    }
 
     return success;
 }
 
+bool SentimentAnalyzer::trainFromFile(
+    const std::string& filePath,
+    size_t chunkSize,
+    bool hasHeader,
+    int textColumn,
+    int labelColumn
+) {
+    FeatureExtractor& extractor = pImpl->featureExtractor;
+    NaiveBayes& model = pImpl->model;
+
+    // First pass: count words (hashed features need no vocabulary)
+    extractor.resetVocabularyCounts();
+    if (extractor.getMethod() != FeatureExtractor::Method::HASHING) {
+        bool counted = DataLoader::streamCSV(filePath, chunkSize, [&](const std::vector<TextData>& chunk) {
+            extractor.countVocabulary(chunk);
+            return true;
+        }, hasHeader, textColumn, labelColumn);
+
+        if (!counted) {
+            extractor.resetVocabularyCounts();
+            return false;
+        }
+    }
+
+    extractor.finalizeVocabulary(pImpl->config.minWordFrequency, pImpl->config.maxVocabularySize);
+
+    // Second pass: accumulate model statistics
+    model.resetCounts();
+    bool success = DataLoader::streamCSV(filePath, chunkSize, [&](const std::vector<TextData>& chunk) {
+        return model.accumulateCounts(extractor.batchTransform(chunk));
+    }, hasHeader, textColumn, labelColumn);
+
+    success = success && model.finalizeCounts();
+
+    // The in-memory datasets no longer match the model
+    pImpl->trainData = {};
+    pImpl->validData = {};
+    pImpl->trainFeatures.clear();
+    pImpl->validFeatures.clear();
+    pImpl->isTrained = success;
+    if (success) {
+        pImpl->publish();
+    }
+
+    return success;
+}
+
+bool SentimentAnalyzer::partialFit(const std::vector<TextData>& examples) {
+    if (!pImpl->isTrained) {
+        std::cerr << "Error: Model not trained" << std::endl;
+        return false;
+    }
+
+    if (!pImpl->model.hasTrainingCounts()) {
+        std::cerr << "Error: A loaded model cannot be updated; train it from data first" << std::endl;
+        return false;
+    }
+
+    size_t added = pImpl->featureExtractor.extendVocabulary(
+        examples,
+        pImpl->config.minWordFrequency,
+        pImpl->config.maxVocabularySize
+    );
+
+    if (!pImpl->model.partialFit(pImpl->featureExtractor.batchTransform(examples))) {
+        return false;
+    }
+
+    // Validation features must match the grown vocabulary
+    if (added > 0) {
+        pImpl->validFeatures = pImpl->featureExtractor.batchTransform(pImpl->validData);
+    }
+    pImpl->publish();
+    return true;
+}
+
+std::vector<CrossValidationResult> SentimentAnalyzer::crossValidate(
+    size_t folds,
+    const SearchGrid& grid,
+    uint64_t seed
+) const {
+    const std::vector<TextData>& data = pImpl->dataLoader.getData();
+    if (data.empty()) {
+        std::cerr << "Error: No training data loaded" << std::endl;
+        return {};
+    }
+
+    // Unset lists search only the configured value
+    SearchGrid values = grid;
+    if (values.alphas.empty()) {
+        values.alphas = {pImpl->config.naiveBayesAlpha};
+    }
+    if (values.minWordFrequencies.empty()) {
+        values.minWordFrequencies = {pImpl->config.minWordFrequency};
+    }
+    if (values.maxVocabularySizes.empty()) {
+        values.maxVocabularySizes = {pImpl->config.maxVocabularySize};
+    }
+
+    CrossValidator validator(pImpl->preprocessor, pImpl->featureExtractor, pImpl->threadPool);
+    if (!validator.prepare(data, folds, seed)) {
+        return {};
+    }
+    return validator.search(values);
+}
+
 EvaluationMetrics SentimentAnalyzer::evaluate() {
     if (!pImpl->isTrained) {
         std::cerr << "Error: Model not trained" << std::endl;
         return EvaluationMetrics{};
     }
 
-    // Initialize evaluator if not already done
-    if (!pImpl->evaluator) {
-        pImpl->evaluator = new Evaluator(pImpl->model);
+    // Evaluate on validation data
+    pImpl->metrics = pImpl->getEvaluator().evaluate(pImpl->validFeatures);
+
+    return pImpl->metrics;
+}
+
+EvaluationMetrics SentimentAnalyzer::evaluateFile(
+    const std::string& filePath,
+    size_t chunkSize,
+    bool hasHeader,
+    int textColumn,
+    int labelColumn
+) {
+    if (!pImpl->isTrained) {
+        std::cerr << "Error: Model not trained" << std::endl;
+        return EvaluationMetrics{};
     }
 
-    // Evaluate on validation data
-    pImpl->metrics = pImpl->evaluator->evaluate(pImpl->validFeatures);
+    // Count chunk by chunk; only the confusion matrix outlives a chunk
+    Evaluator& evaluator = pImpl->getEvaluator();
+    evaluator.reset();
+    bool success = DataLoader::streamCSV(filePath, chunkSize, [&](const std::vector<TextData>& chunk) {
+        evaluator.accumulate(pImpl->featureExtractor.batchTransform(chunk));
+        return true;
+    }, hasHeader, textColumn, labelColumn);
+
+    if (!success) {
+        evaluator.reset();
+        pImpl->metrics = EvaluationMetrics{};
+        return pImpl->metrics;
+    }
 
+    pImpl->metrics = evaluator.finish();
     return pImpl->metrics;
 }
 
 SentimentLabel SentimentAnalyzer::predict(const std::string& text) const {
-    if (!pImpl->isTrained) {
+    InferenceContext context;
+    return predict(text, context);
+}
+
+SentimentLabel SentimentAnalyzer::predict(std::string_view text, InferenceContext& context) const {
+    // The cache generation is read before the snapshot (see Impl::publish)
+    PredictionCache* cache = pImpl->predictionCache.get();
+    uint64_t generation = cache ? cache->generation() : 0;
+    std::shared_ptr<const ModelSnapshot> snapshot = pImpl->currentSnapshot();
+    if (!snapshot) {
         std::cerr << "Error: Model not trained" << std::endl;
         return SentimentLabel::UNKNOWN;
     }
 
-    // Extract features from text
-    std::vector<double> features = pImpl->featureExtractor.extractFeatures(text);
+    if (!cache) {
+        return snapshot->predict(text, context);
+    }
+
+    uint64_t key = pImpl->preprocessor.hashCleanText(text);
+    SentimentLabel label;
+    double score;
+    if (cache->lookup(key, label, score)) {
+        return label;
+    }
+
+    // Keep the winning log joint score so batch lookups can report it
+    double logJointScores[NaiveBayes::kClassStride];
+    label = snapshot->predictScores(text, context, logJointScores, nullptr);
+    const std::vector<SentimentLabel>& labels = snapshot->getModel().getClassLabels();
+    size_t lane = std::find(labels.begin(), labels.end(), label) - labels.begin();
+    if (lane < labels.size()) {
+        cache->insert(key, generation, label, logJointScores[lane]);
+    }
+    return label;
+}
+
+void SentimentAnalyzer::predictBatch(
+    const std::string* texts,
+    size_t count,
+    SentimentLabel* labels,
+    double* scores
+) const {
+    PredictionCache* cache = pImpl->predictionCache.get();
+    uint64_t generation = cache ? cache->generation() : 0;
+    std::shared_ptr<const ModelSnapshot> snapshot = pImpl->currentSnapshot();
+    if (!snapshot) {
+        std::cerr << "Error: Model not trained" << std::endl;
+        std::fill(labels, labels + count, SentimentLabel::UNKNOWN);
+        return;
+    }
+
+    if (!cache) {
+        snapshot->predictBatch(texts, count, labels, scores, pImpl->threadPool.get());
+        return;
+    }
 
-    // Predict sentiment
-    return pImpl->model.predict(features);
+    // Serve repeated texts from the cache and run the pipeline on the rest
+    std::vector<uint64_t> keys(count);
+    std::vector<size_t> misses;
+    for (size_t i = 0; i < count; ++i) {
+        keys[i] = pImpl->preprocessor.hashCleanText(texts[i]);
+        double score;
+        if (cache->lookup(keys[i], labels[i], score)) {
+            if (scores) {
+                scores[i] = score;
+            }
+        } else {
+            misses.push_back(i);
+        }
+    }
+    if (misses.empty()) {
+        return;
+    }
+
+    std::vector<std::string_view> missTexts;
+    missTexts.reserve(misses.size());
+    for (size_t i : misses) {
+        missTexts.emplace_back(texts[i]);
+    }
+    std::vector<SentimentLabel> missLabels(misses.size());
+    std::vector<double> missScores(misses.size());
+    snapshot->predictBatch(missTexts.data(), missTexts.size(), missLabels.data(), missScores.data(),
+                           pImpl->threadPool.get());
+
+    for (size_t m = 0; m < misses.size(); ++m) {
+        labels[misses[m]] = missLabels[m];
+        if (scores) {
+            scores[misses[m]] = missScores[m];
+        }
+        if (missLabels[m] != SentimentLabel::UNKNOWN || std::isfinite(missScores[m])) {
+            cache->insert(keys[misses[m]], generation, missLabels[m], missScores[m]);
+        }
+    }
 }
 
 std::unordered_map<SentimentLabel, double> SentimentAnalyzer::predictWithConfidence(
     const std::string& text
 ) const {
-    // This is a simplified implementation that could be extended
-    // in the future with actual confidence scores from model internals
-
     std::unordered_map<SentimentLabel, double> confidences;
+    confidences[SentimentLabel::POSITIVE] = 0.0;
+    confidences[SentimentLabel::NEGATIVE] = 0.0;
+    confidences[SentimentLabel::NEUTRAL] = 0.0;
 
-    // For now, assign 1.0 to the predicted label and 0.0 to others
-    SentimentLabel predictedLabel = predict(text);
+    std::shared_ptr<const ModelSnapshot> snapshot = pImpl->currentSnapshot();
+    if (!snapshot) {
+        std::cerr << "Error: Model not trained" << std::endl;
+        return confidences;
+    }
 
-    confidences[SentimentLabel::POSITIVE] = (predictedLabel == SentimentLabel::POSITIVE) ? 1.0 : 0.0;
-    confidences[SentimentLabel::NEGATIVE] = (predictedLabel == SentimentLabel::NEGATIVE) ? 1.0 : 0.0;
-    confidences[SentimentLabel::NEUTRAL] = (predictedLabel == SentimentLabel::NEUTRAL) ? 1.0 : 0.0;
+    // Posterior probabilities come from the same pass as the prediction
+    InferenceContext context;
+    double probabilities[NaiveBayes::kClassStride];
+    snapshot->predictScores(text, context, nullptr, probabilities);
+
+    const std::vector<SentimentLabel>& labels = snapshot->getModel().getClassLabels();
+    for (size_t lane = 0; lane < labels.size(); ++lane) {
+        confidences[labels[lane]] = probabilities[lane];
+    }
 
     return confidences;
 }
 
+std::shared_ptr<const ModelSnapshot> SentimentAnalyzer::getSnapshot() const {
+    return pImpl->currentSnapshot();
+}
+
+StatsSnapshot SentimentAnalyzer::stats() const {
+    return PipelineStats::snapshot();
+}
+
+PredictionCacheStats SentimentAnalyzer::predictionCacheStats() const {
+    return pImpl->predictionCache ? pImpl->predictionCache->stats() : PredictionCacheStats{};
+}
+
+void SentimentAnalyzer::resetStats() {
+    PipelineStats::reset();
+    if (pImpl->predictionCache) {
+        pImpl->predictionCache->resetStats();
+    }
+}
+
 bool SentimentAnalyzer::saveModel(const std::string& filePath) const {
     if (!pImpl->isTrained) {
         std::cerr << "Error: Cannot save untrained model" << std::endl;
         return false;
     }
 
-    // TODO: Implement model serialization
-    std::cerr << "Model saving not yet implemented" << std::endl;
-    return false;
+    return saveModelFile(filePath, pImpl->featureExtractor, pImpl->model,
+                         pImpl->config.useStopWords);
 }
 
 bool SentimentAnalyzer::loadModel(const std::string& filePath) {
-    // TODO: Implement model deserialization
-    std::cerr << "Model loading not yet implemented" << std::endl;
-    return false;
+    bool modelUsesStopWords = pImpl->config.useStopWords;
+    if (!loadModelFile(filePath, pImpl->featureExtractor, pImpl->model, modelUsesStopWords)) {
+        return false;
+    }
+
+    // Tokenize like the model was trained; the extractor keeps referring
+    // to pImpl->preprocessor, so it picks up the replacement
+    if (modelUsesStopWords != pImpl->config.useStopWords) {
+        pImpl->config.useStopWords = modelUsesStopWords;
+        pImpl->preprocessor = Preprocessor(modelUsesStopWords);
+    }
+
+    // The in-memory datasets were extracted for the previous vocabulary,
+    // and the last metrics describe the previous model
+    pImpl->trainData = {};
+    pImpl->validData = {};
+    pImpl->trainFeatures.clear();
+    pImpl->validFeatures.clear();
+    pImpl->evaluator.reset();
+    pImpl->metrics = EvaluationMetrics{};
+    pImpl->isTrained = true;
+    pImpl->publish();
+    return true;
 }
 
 const EvaluationMetrics& SentimentAnalyzer::getMetrics() const {
     return pImpl->metrics;
 }
 
-const std::unordered_map<SentimentLabel,
-      std::unordered_map<SentimentLabel, int>>& SentimentAnalyzer::getConfusionMatrix() const {
+const ConfusionMatrix& SentimentAnalyzer::getConfusionMatrix() const {
     if (!pImpl->evaluator) {
-        static std::unordered_map<SentimentLabel,
-               std::unordered_map<SentimentLabel, int>> emptyMatrix;
+        static const ConfusionMatrix emptyMatrix;
         return emptyMatrix;
     }
 
@@ -0,0 +1,297 @@
+#include "sparse_kernels.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SENTIMENT_HAVE_AVX2_KERNEL 1
+#endif
+
+namespace sentiment {
+
+namespace {
+
+using AccumulateKernel = void (*)(const uint32_t* indices, const double* values, size_t count,
+                                  const double* matrix, size_t stride, double* scores);
+using WeightKernel = double (*)(const uint32_t* indices, double* values, size_t count, const double* idf);
+using ScaleKernel = void (*)(double* values, size_t count, double factor);
+using LogKernel = void (*)(double* values, size_t count);
+
+// Term counts below this get 1 + log(count) from a table
+constexpr size_t kSublinearTableSize = 64;
+
+template<bool Clamp>
+void accumulateScalar(const uint32_t* indices, const double* values, size_t count,
+                      const double* matrix, size_t stride, double* scores) {
+    for (size_t k = 0; k < count; ++k) {
+        double value = Clamp ? std::max(values[k], 0.0) : values[k];
+        const double* row = matrix + static_cast<size_t>(indices[k]) * stride;
+        for (size_t lane = 0; lane < stride; ++lane) {
+            scores[lane] += value * row[lane];
+        }
+    }
+}
+
+// Applies the IDF weights and returns the sum of squares of the result
+double weightScalar(const uint32_t* indices, double* values, size_t count, const double* idf) {
+    double sumOfSquares = 0.0;
+    for (size_t k = 0; k < count; ++k) {
+        if (idf) {
+            values[k] *= idf[indices[k]];
+        }
+        sumOfSquares += values[k] * values[k];
+    }
+    return sumOfSquares;
+}
+
+void scaleScalar(double* values, size_t count, double factor) {
+    for (size_t k = 0; k < count; ++k) {
+        values[k] *= factor;
+    }
+}
+
+void logScalar(double* values, size_t count) {
+    for (size_t k = 0; k < count; ++k) {
+        values[k] = std::log(values[k]);
+    }
+}
+
+#ifdef SENTIMENT_HAVE_AVX2_KERNEL
+static_assert(kKernelLanes == 4, "AVX2 kernel assumes one 256-bit register per block of lanes");
+
+template<bool Clamp>
+__attribute__((target("avx2,fma")))
+inline __m256d broadcastValue(double value) {
+    __m256d broadcast = _mm256_set1_pd(value);
+    return Clamp ? _mm256_max_pd(broadcast, _mm256_setzero_pd()) : broadcast;
+}
+
+// A block of four lanes is exactly one 256-bit register, so each nonzero
+// feature is a single broadcast + fused multiply-add per block. Wider rows
+// are scored one block at a time. Two accumulators hide FMA latency.
+template<bool Clamp>
+__attribute__((target("avx2,fma")))
+void accumulateAvx2(const uint32_t* indices, const double* values, size_t count,
+                    const double* matrix, size_t stride, double* scores) {
+    for (size_t block = 0; block < stride; block += kKernelLanes) {
+        const double* lanes = matrix + block;
+        __m256d sum0 = _mm256_loadu_pd(scores + block);
+        __m256d sum1 = _mm256_setzero_pd();
+
+        size_t k = 0;
+        for (; k + 2 <= count; k += 2) {
+            __m256d value0 = broadcastValue<Clamp>(values[k]);
+            __m256d value1 = broadcastValue<Clamp>(values[k + 1]);
+            __m256d row0 = _mm256_loadu_pd(lanes + static_cast<size_t>(indices[k]) * stride);
+            __m256d row1 = _mm256_loadu_pd(lanes + static_cast<size_t>(indices[k + 1]) * stride);
+            sum0 = _mm256_fmadd_pd(value0, row0, sum0);
+            sum1 = _mm256_fmadd_pd(value1, row1, sum1);
+        }
+        if (k < count) {
+            __m256d value = broadcastValue<Clamp>(values[k]);
+            __m256d row = _mm256_loadu_pd(lanes + static_cast<size_t>(indices[k]) * stride);
+            sum0 = _mm256_fmadd_pd(value, row, sum0);
+        }
+
+        _mm256_storeu_pd(scores + block, _mm256_add_pd(sum0, sum1));
+    }
+}
+
+// Gathers four IDF weights per block; the sum of squares stays in one register
+__attribute__((target("avx2,fma")))
+double weightAvx2(const uint32_t* indices, double* values, size_t count, const double* idf) {
+    const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    __m256d sum = _mm256_setzero_pd();
+    size_t k = 0;
+    for (; k + 4 <= count; k += 4) {
+        __m256d block = _mm256_loadu_pd(values + k);
+        if (idf) {
+            __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + k));
+            __m256d weights = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), idf, index, all, sizeof(double));
+            block = _mm256_mul_pd(block, weights);
+            _mm256_storeu_pd(values + k, block);
+        }
+        sum = _mm256_fmadd_pd(block, block, sum);
+    }
+
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, sum);
+    double sumOfSquares = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    return sumOfSquares + weightScalar(indices + k, values + k, count - k, idf);
+}
+
+__attribute__((target("avx2,fma")))
+void scaleAvx2(double* values, size_t count, double factor) {
+    __m256d broadcast = _mm256_set1_pd(factor);
+    size_t k = 0;
+    for (; k + 4 <= count; k += 4) {
+        _mm256_storeu_pd(values + k, _mm256_mul_pd(_mm256_loadu_pd(values + k), broadcast));
+    }
+    scaleScalar(values + k, count - k, factor);
+}
+
+// log(x) for x = m * 2^e with m in [sqrt(1/2), sqrt(2)): with f = m - 1,
+// log(m) = f - f^2 / 2 + f^3 * P(f) / Q(f) (Cephes log.c coefficients), and
+// e * log(2) is added in two parts so the sum keeps full precision. Lanes
+// that are not positive normal numbers are fixed up with std::log.
+__attribute__((target("avx2,fma")))
+void logBlockAvx2(double* block) {
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256i mantissaMask = _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL);
+    const __m256i halfExponent = _mm256_set1_epi64x(0x3FE0000000000000LL);
+    const __m256i twoTo52Bits = _mm256_set1_epi64x(0x4330000000000000LL);
+
+    __m256d x = _mm256_loadu_pd(block);
+    __m256d normal = _mm256_and_pd(
+        _mm256_cmp_pd(x, _mm256_set1_pd(std::numeric_limits<double>::min()), _CMP_GE_OQ),
+        _mm256_cmp_pd(x, _mm256_set1_pd(std::numeric_limits<double>::max()), _CMP_LE_OQ));
+    int normalLanes = _mm256_movemask_pd(normal);
+
+    // x = m * 2^e with m in [0.5, 1); the biased exponent becomes a double
+    // by placing it in the mantissa of 2^52
+    __m256i bits = _mm256_castpd_si256(x);
+    __m256d biased = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52), twoTo52Bits));
+    __m256d e = _mm256_sub_pd(_mm256_sub_pd(biased, _mm256_set1_pd(4503599627370496.0)),
+                              _mm256_set1_pd(1022.0));
+    __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, mantissaMask), halfExponent));
+
+    // Move m below sqrt(1/2) up an octave so f = m - 1 stays small
+    __m256d low = _mm256_cmp_pd(m, _mm256_set1_pd(0.70710678118654752440), _CMP_LT_OQ);
+    e = _mm256_sub_pd(e, _mm256_and_pd(low, one));
+    __m256d f = _mm256_sub_pd(_mm256_add_pd(m, _mm256_and_pd(low, m)), one);
+
+    __m256d p = _mm256_set1_pd(1.01875663804580931796e-4);
+    p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(4.97494994976747001425e-1));
+    p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(4.70579119878881725854e0));
+    p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(1.44989225341610930846e1));
+    p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(1.79368678507819816313e1));
+    p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(7.70838733755885391666e0));
+    __m256d q = _mm256_add_pd(f, _mm256_set1_pd(1.12873587189167450590e1));
+    q = _mm256_fmadd_pd(q, f, _mm256_set1_pd(4.52279145837532221105e1));
+    q = _mm256_fmadd_pd(q, f, _mm256_set1_pd(8.29875266912776603211e1));
+    q = _mm256_fmadd_pd(q, f, _mm256_set1_pd(7.11544750618563894466e1));
+    q = _mm256_fmadd_pd(q, f, _mm256_set1_pd(2.31251620126765340583e1));
+
+    __m256d z = _mm256_mul_pd(f, f);
+    __m256d y = _mm256_mul_pd(_mm256_mul_pd(f, z), _mm256_div_pd(p, q));
+    y = _mm256_fmadd_pd(e, _mm256_set1_pd(-2.121944400546905827679e-4), y);
+    y = _mm256_fnmadd_pd(half, z, y);
+    __m256d result = _mm256_fmadd_pd(e, _mm256_set1_pd(0.693359375), _mm256_add_pd(f, y));
+
+    alignas(32) double input[4];
+    _mm256_store_pd(input, x);
+    _mm256_storeu_pd(block, result);
+    for (int lane = 0; normalLanes != 0xF && lane < 4; ++lane) {
+        if (!(normalLanes & (1 << lane))) {
+            block[lane] = std::log(input[lane]);
+        }
+    }
+}
+
+// The tail is padded to a full block, so every value gets the same
+// result wherever it sits in the array
+__attribute__((target("avx2,fma")))
+void logAvx2(double* values, size_t count) {
+    size_t k = 0;
+    for (; k + 4 <= count; k += 4) {
+        logBlockAvx2(values + k);
+    }
+    if (k < count) {
+        double tail[4] = {1.0, 1.0, 1.0, 1.0};
+        std::copy(values + k, values + count, tail);
+        logBlockAvx2(tail);
+        std::copy(tail, tail + (count - k), values + k);
+    }
+}
+
+// Checked once per process
+bool haveAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+}
+#endif
+
+template<bool Clamp>
+AccumulateKernel selectKernel() {
+    // Chosen once per process from the CPU features
+    static const AccumulateKernel kernel = [] {
+#ifdef SENTIMENT_HAVE_AVX2_KERNEL
+        if (haveAvx2()) {
+            return static_cast<AccumulateKernel>(accumulateAvx2<Clamp>);
+        }
+#endif
+        return static_cast<AccumulateKernel>(accumulateScalar<Clamp>);
+    }();
+    return kernel;
+}
+
+} // namespace
+
+void accumulateSparseRows(
+    const SparseVector& features,
+    const double* matrix,
+    size_t stride,
+    bool clampNegative,
+    double* scores
+) {
+    AccumulateKernel kernel = clampNegative ? selectKernel<true>() : selectKernel<false>();
+    kernel(features.indices.data(), features.values.data(), features.nonZeroCount(),
+           matrix, stride, scores);
+}
+
+void weightTermCounts(
+    SparseVector& features,
+    const double* idf,
+    bool sublinearTf,
+    bool l2Normalize
+) {
+    double* values = features.values.data();
+    size_t count = features.nonZeroCount();
+    if (sublinearTf) {
+        // Counts are small integers; look the common ones up instead of calling log
+        static const std::array<double, kSublinearTableSize> table = [] {
+            std::array<double, kSublinearTableSize> values{};
+            for (size_t n = 1; n < kSublinearTableSize; ++n) {
+                values[n] = 1.0 + std::log(static_cast<double>(n));
+            }
+            return values;
+        }();
+        for (size_t k = 0; k < count; ++k) {
+            size_t n = static_cast<size_t>(values[k]);
+            values[k] = n < kSublinearTableSize && static_cast<double>(n) == values[k]
+                ? table[n]
+                : 1.0 + std::log(values[k]);
+        }
+    }
+    if (!idf && !l2Normalize) {
+        return;
+    }
+
+#ifdef SENTIMENT_HAVE_AVX2_KERNEL
+    const bool avx2 = haveAvx2();
+    WeightKernel weight = avx2 ? weightAvx2 : weightScalar;
+    ScaleKernel scale = avx2 ? scaleAvx2 : scaleScalar;
+#else
+    WeightKernel weight = weightScalar;
+    ScaleKernel scale = scaleScalar;
+#endif
+    double sumOfSquares = weight(features.indices.data(), values, count, idf);
+    if (l2Normalize && sumOfSquares > 0.0) {
+        scale(values, count, 1.0 / std::sqrt(sumOfSquares));
+    }
+}
+
+void logValues(double* values, size_t count) {
+#ifdef SENTIMENT_HAVE_AVX2_KERNEL
+    LogKernel kernel = haveAvx2() ? logAvx2 : logScalar;
+#else
+    LogKernel kernel = logScalar;
+#endif
+    kernel(values, count);
+}
+
+} // namespace sentiment
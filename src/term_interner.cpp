@@ -0,0 +1,83 @@
+#include "term_interner.h"
+#include "utils.h"
+
+namespace sentiment {
+
+uint32_t TermInterner::intern(std::string_view term, uint64_t hash) {
+    // Keep the load factor at or below 50% so probe sequences stay short
+    if ((size() + 1) * 2 > slots.size()) {
+        grow();
+    }
+
+    size_t slot = locate(term, hash);
+    if (slots[slot] != 0) {
+        return slots[slot] - 1;
+    }
+
+    if (offsets.empty()) {
+        offsets.push_back(0);
+    }
+    uint32_t id = static_cast<uint32_t>(hashes.size());
+    strings.insert(strings.end(), term.begin(), term.end());
+    offsets.push_back(strings.size());
+    hashes.push_back(hash);
+    slots[slot] = id + 1;
+    return id;
+}
+
+uint32_t TermInterner::intern(std::string_view term) {
+    return intern(term, hashBytes(term));
+}
+
+uint32_t TermInterner::find(std::string_view term) const {
+    if (slots.empty()) {
+        return npos;
+    }
+
+    uint32_t entry = slots[locate(term, hashBytes(term))];
+    return entry == 0 ? npos : entry - 1;
+}
+
+std::string_view TermInterner::term(uint32_t id) const {
+    return std::string_view(strings.data() + offsets[id], offsets[id + 1] - offsets[id]);
+}
+
+uint64_t TermInterner::hash(uint32_t id) const {
+    return hashes[id];
+}
+
+size_t TermInterner::size() const {
+    return hashes.size();
+}
+
+void TermInterner::clear() {
+    strings = std::vector<char>();
+    offsets = std::vector<uint64_t>();
+    hashes = std::vector<uint64_t>();
+    slots = std::vector<uint32_t>();
+}
+
+size_t TermInterner::locate(std::string_view term, uint64_t hash) const {
+    size_t mask = slots.size() - 1;
+    for (size_t slot = hash & mask; ; slot = (slot + 1) & mask) {
+        uint32_t entry = slots[slot];
+        if (entry == 0 || (hashes[entry - 1] == hash && this->term(entry - 1) == term)) {
+            return slot;
+        }
+    }
+}
+
+void TermInterner::grow() {
+    std::vector<uint32_t> grown(slots.empty() ? 16 : slots.size() * 2, 0);
+    size_t mask = grown.size() - 1;
+    for (size_t id = 0; id < hashes.size(); ++id) {
+        size_t slot = hashes[id] & mask;
+        while (grown[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        grown[slot] = static_cast<uint32_t>(id + 1);
+    }
+    slots = std::move(grown);
+}
+
+} // namespace sentiment
@@ -0,0 +1,151 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace sentiment {
+
+namespace {
+
+// Pool whose loop body is running on the current thread, if any
+thread_local const ThreadPool* currentPool = nullptr;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    workers.reserve(threadCount - 1);
+    for (size_t worker = 1; worker < threadCount; ++worker) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, worker);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::size() const {
+    return workers.size() + 1;
+}
+
+void ThreadPool::parallelFor(size_t itemCount, const RangeFunction& rangeBody, size_t grain) {
+    if (itemCount == 0) {
+        return;
+    }
+
+    // Run inline when there is nothing to share or when called re-entrantly
+    if (workers.empty() || itemCount == 1 || currentPool == this) {
+        rangeBody(0, itemCount, 0);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    runJob(itemCount, rangeBody, grain);
+}
+
+bool ThreadPool::tryParallelFor(size_t itemCount, const RangeFunction& rangeBody, size_t grain) {
+    if (itemCount == 0) {
+        return true;
+    }
+
+    if (workers.empty() || itemCount == 1 || currentPool == this) {
+        rangeBody(0, itemCount, 0);
+        return true;
+    }
+
+    std::unique_lock<std::mutex> submitLock(submitMutex, std::try_to_lock);
+    if (!submitLock.owns_lock()) {
+        return false;
+    }
+    runJob(itemCount, rangeBody, grain);
+    return true;
+}
+
+void ThreadPool::runJob(size_t itemCount, const RangeFunction& rangeBody, size_t grain) {
+    if (grain == 0) {
+        // Several chunks per thread keep the load balanced
+        grain = std::max<size_t>(1, itemCount / (size() * 8));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        body = &rangeBody;
+        count = itemCount;
+        grainSize = grain;
+        nextIndex.store(0, std::memory_order_relaxed);
+        activeWorkers = workers.size();
+        error = nullptr;
+        ++generation;
+    }
+    wakeCondition.notify_all();
+
+    runChunks(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this] { return activeWorkers == 0; });
+    body = nullptr;
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::workerLoop(size_t worker) {
+    unsigned long long seenGeneration = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&] {
+                return stopping || generation != seenGeneration;
+            });
+
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        runChunks(worker);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--activeWorkers == 0) {
+            doneCondition.notify_one();
+        }
+    }
+}
+
+void ThreadPool::runChunks(size_t worker) {
+    const ThreadPool* previousPool = currentPool;
+    currentPool = this;
+
+    while (true) {
+        size_t begin = nextIndex.fetch_add(grainSize, std::memory_order_relaxed);
+        if (begin >= count) {
+            break;
+        }
+
+        size_t end = std::min(begin + grainSize, count);
+        try {
+            (*body)(begin, end, worker);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    currentPool = previousPool;
+}
+
+} // namespace sentiment
@@ -35,4 +35,28 @@ std::string sentimentToString(SentimentLabel label) {
     }
 }
 
+SparseVector toSparse(const std::vector<double>& dense) {
+    SparseVector sparse;
+    sparse.dimension = dense.size();
+
+    for (size_t i = 0; i < dense.size(); ++i) {
+        if (dense[i] != 0.0) {
+            sparse.indices.push_back(static_cast<uint32_t>(i));
+            sparse.values.push_back(dense[i]);
+        }
+    }
+
+    return sparse;
+}
+
+std::vector<double> toDense(const SparseVector& sparse) {
+    std::vector<double> dense(sparse.dimension, 0.0);
+
+    for (size_t k = 0; k < sparse.nonZeroCount(); ++k) {
+        dense[sparse.indices[k]] = sparse.values[k];
+    }
+
+    return dense;
+}
+
 } // namespace sentiment
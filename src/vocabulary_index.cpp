@@ -0,0 +1,163 @@
+#include "vocabulary_index.h"
+#include <algorithm>
+#include <numeric>
+
+namespace sentiment {
+
+VocabularyIndex::VocabularyIndex(const std::vector<std::string_view>& terms) {
+    std::vector<uint64_t> termOffsets;
+    termOffsets.reserve(terms.size() + 1);
+
+    std::vector<char> termStrings;
+    for (const auto& term : terms) {
+        termOffsets.push_back(termStrings.size());
+        termStrings.insert(termStrings.end(), term.begin(), term.end());
+    }
+    termOffsets.push_back(termStrings.size());
+
+    // Group the terms by bucket, in index order within each bucket
+    size_t buckets = bucketCount(terms.size());
+    std::vector<uint64_t> spreads(terms.size());
+    std::vector<uint32_t> bucketStarts(buckets + 1, 0);
+    for (size_t i = 0; i < terms.size(); ++i) {
+        spreads[i] = spreadHash(termHash(terms[i]));
+        bucketStarts[bucketOf(spreads[i], buckets) + 1]++;
+    }
+    std::partial_sum(bucketStarts.begin(), bucketStarts.end(), bucketStarts.begin());
+
+    std::vector<uint32_t> members(terms.size());
+    std::vector<uint32_t> fill(bucketStarts.begin(), bucketStarts.end() - 1);
+    for (size_t i = 0; i < terms.size(); ++i) {
+        members[fill[bucketOf(spreads[i], buckets)]++] = static_cast<uint32_t>(i);
+    }
+
+    // No pilot can separate terms with the same hash; keep the first of them
+    size_t slotCount = 0;
+    for (size_t bucket = 0; bucket < buckets; ++bucket) {
+        uint32_t end = bucketStarts[bucket];
+        for (uint32_t k = bucketStarts[bucket]; k < bucketStarts[bucket + 1]; ++k) {
+            bool duplicate = std::any_of(members.begin() + bucketStarts[bucket], members.begin() + end,
+                                         [&](uint32_t other) { return spreads[other] == spreads[members[k]]; });
+            if (!duplicate) {
+                members[end++] = members[k];
+            }
+        }
+        fill[bucket] = end; // End of the distinct members
+        slotCount += end - bucketStarts[bucket];
+    }
+
+    // Place the largest buckets first, while most slots are still free;
+    // each takes the first pilot that sends its terms to distinct free slots
+    std::vector<uint32_t> order(buckets);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        uint32_t sizeA = fill[a] - bucketStarts[a];
+        uint32_t sizeB = fill[b] - bucketStarts[b];
+        return sizeA != sizeB ? sizeA > sizeB : a < b;
+    });
+
+    std::vector<uint32_t> bucketPilots(buckets, 0);
+    std::vector<uint64_t> termSlots(slotCount, 0);
+    std::vector<bool> taken(slotCount, false);
+    std::vector<size_t> candidates;
+    for (uint32_t bucket : order) {
+        size_t size = fill[bucket] - bucketStarts[bucket];
+        if (size == 0) {
+            break;
+        }
+
+        const uint32_t* bucketMembers = members.data() + bucketStarts[bucket];
+        for (uint32_t pilot = 0; candidates.size() < size; ++pilot) {
+            candidates.clear();
+            for (size_t k = 0; k < size; ++k) {
+                size_t slot = slotOf(spreads[bucketMembers[k]], pilot, slotCount);
+                if (taken[slot] || std::find(candidates.begin(), candidates.end(), slot) != candidates.end()) {
+                    break;
+                }
+                candidates.push_back(slot);
+            }
+            bucketPilots[bucket] = pilot;
+        }
+
+        for (size_t k = 0; k < size; ++k) {
+            uint32_t term = bucketMembers[k];
+            taken[candidates[k]] = true;
+            termSlots[candidates[k]] = (spreads[term] >> 32 << 32) | term;
+        }
+        candidates.clear();
+    }
+
+    offsets = ConstArray<uint64_t>(std::move(termOffsets));
+    strings = ConstArray<char>(std::move(termStrings));
+    pilots = ConstArray<uint32_t>(std::move(bucketPilots));
+    slots = ConstArray<uint64_t>(std::move(termSlots));
+}
+
+bool VocabularyIndex::fromArrays(
+    ConstArray<uint64_t> termOffsets,
+    ConstArray<char> termStrings,
+    ConstArray<uint32_t> termPilots,
+    ConstArray<uint64_t> termSlots,
+    VocabularyIndex& result
+) {
+    if (termOffsets.empty() || termOffsets[0] != 0 ||
+        termOffsets[termOffsets.size() - 1] != termStrings.size()) {
+        return false;
+    }
+
+    for (size_t i = 1; i < termOffsets.size(); ++i) {
+        if (termOffsets[i] < termOffsets[i - 1]) {
+            return false;
+        }
+    }
+
+    // Every term has at most one slot, and every bucket of terms a pilot
+    size_t termCount = termOffsets.size() - 1;
+    if (termSlots.size() > termCount || termPilots.size() != bucketCount(termCount)) {
+        return false;
+    }
+
+    for (uint64_t slot : termSlots) {
+        if (static_cast<uint32_t>(slot) >= termCount) {
+            return false;
+        }
+    }
+
+    result.offsets = std::move(termOffsets);
+    result.strings = std::move(termStrings);
+    result.pilots = std::move(termPilots);
+    result.slots = std::move(termSlots);
+    return true;
+}
+
+uint32_t VocabularyIndex::find(std::string_view term) const {
+    return findHashed(termHash(term), [term](std::string_view candidate) {
+        return candidate == term;
+    });
+}
+
+size_t VocabularyIndex::bucketCount(size_t termCount) {
+    return (termCount + kBucketSize - 1) / kBucketSize;
+}
+
+uint64_t VocabularyIndex::termHash(std::string_view term) {
+    size_t space = term.find(' ');
+    uint64_t hash = hashBytes(term.substr(0, space));
+    while (space != std::string_view::npos) {
+        term.remove_prefix(space + 1);
+        space = term.find(' ');
+        hash = combineHashes(hash, hashBytes(term.substr(0, space)));
+    }
+    return hash;
+}
+
+std::string_view VocabularyIndex::term(size_t index) const {
+    return std::string_view(strings.data() + offsets[index],
+                            offsets[index + 1] - offsets[index]);
+}
+
+size_t VocabularyIndex::size() const {
+    return offsets.empty() ? 0 : offsets.size() - 1;
+}
+
+} // namespace sentiment
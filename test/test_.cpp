@@ -1,10 +1,109 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <regex>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include "concurrent_queue.h"
+#include "count_min_sketch.h"
+#include "cross_validation.h"
+#include "csv_parser.h"
+#include "data_loader.h"
+#include "evaluator.h"
+#include "file_predictor.h"
+#include "inference_server.h"
+#include "linear_model.h"
 #include "preprocessor.h"
+#include "term_interner.h"
+#include "feature_extractor.h"
+#include "model_io.h"
+#include "model_snapshot.h"
+#include "prediction_cache.h"
+#include "sparse_kernels.h"
+#include "naive_bayes.h"
+#include "pipeline_stats.h"
+#include "sentiment_api.h"
 
 using namespace sentiment;
 
+// Count heap allocations so tests can check allocation-free paths
+static std::atomic<size_t> allocationCount{0};
+
+namespace {
+
+void* countedAllocate(std::size_t size) noexcept {
+    ++allocationCount;
+    return std::malloc(size ? size : 1);
+}
+
+// Not inlined, so callers of delete never see a free() on memory from new
+[[gnu::noinline]] void countedFree(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+} // namespace
+
+// Every replaceable form is replaced so each allocation is released by its
+// own counterpart, also under sanitizers that check the pairing
+void* operator new(std::size_t size) {
+    if (void* pointer = countedAllocate(size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    if (void* pointer = countedAllocate(size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    countedFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    countedFree(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    countedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    countedFree(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    countedFree(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    countedFree(pointer);
+}
+
 // Test fixture for Preprocessor tests
 class PreprocessorTest : public ::testing::Test {
 protected:
@@ -84,6 +183,1897 @@ TEST_F(PreprocessorTest, Preprocess) {
     EXPECT_NE(std::find(tokens.begin(), tokens.end(), "punctuation"), tokens.end());
 }
 
+// Test that the single-pass tokenizer matches the regex-based reference pipeline
+TEST_F(PreprocessorTest, TokenizeIntoMatchesRegexPipeline) {
+    auto reference = [](std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+        text = std::regex_replace(text, std::regex("[[:punct:]]"), " ");
+        std::istringstream iss(text);
+        std::vector<std::string> tokens;
+        std::string token;
+        while (iss >> token) {
+            tokens.push_back(token);
+        }
+        return tokens;
+    };
+
+    const std::vector<std::string> inputs = {
+        "", "   ", "!!!", "Hello, World!", "  Leading and trailing  ",
+        "It's the BEST\tday\n\never...", "snake_case-and/slashes|pipes~",
+        "Don't stop; can't stop (won't stop)", "a1b2 C3D4 #hashtag @user 100%"
+    };
+
+    std::string buffer;
+    std::vector<std::string_view> views;
+    for (const Preprocessor* preprocessor :
+         {preprocessorWithStopWords, preprocessorWithoutStopWords}) {
+        for (const auto& input : inputs) {
+            std::vector<std::string> expected;
+            for (const auto& token : reference(input)) {
+                if (!preprocessor->isStopWord(token)) {
+                    expected.push_back(token);
+                }
+            }
+
+            preprocessor->tokenizeInto(input, buffer, views);
+            EXPECT_EQ(std::vector<std::string>(views.begin(), views.end()), expected)
+                << "input: " << input;
+            EXPECT_EQ(preprocessor->preprocess(input), expected) << "input: " << input;
+        }
+    }
+}
+
+// Test UTF-8 case folding and punctuation, and the block scan of long ASCII runs
+TEST_F(PreprocessorTest, FoldsUtf8Text) {
+    const std::vector<std::pair<std::string, std::string>> cases = {
+        {"Ünïcödé ÇAFÉ", "ünïcödé çafé"},
+        {"ΚΑΛΗΜΕΡΑ λόγος Ά", "καλημερα λόγοσ ά"},
+        {"ПРИВЕТ, Мир! ЁЛКА", "привет мир ёлка"},
+        {"«Bonjour» — ça va?", "bonjour ça va"},
+        {"“quoted”… ¿Sí?", "quoted sí"},
+        {"日本語、テスト。", "日本語 テスト"},
+        {"ＡＢＣ１２３！ｘ", "abc123 x"},
+        {"STRAẞE Łódź", "straße łódź"},
+        {"a\u00A0b\u3000c\u2009d", "a b c d"},
+        {"good 😀 day", "good 😀 day"},
+        {"ab\x80" "cd caf\xC3", "ab\x80" "cd caf\xC3"},
+        {"\xC0\xAF \xED\xA0\x80 \xF4\x90\x80\x80", "\xC0\xAF \xED\xA0\x80 \xF4\x90\x80\x80"},
+        {"ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 Supercalifragilistic,EXPIALIDOCIOUS",
+         "abcdefghijklmnopqrstuvwxyz0123456789 supercalifragilistic expialidocious"},
+        {"AAAAAAAAAAAAAAAAAAÉÉ BBBBBBBBBBBBBBB—CCCCCCCCCCCCCCCC",
+         "aaaaaaaaaaaaaaaaaaéé bbbbbbbbbbbbbbb cccccccccccccccc"}
+    };
+
+    // Random ASCII covers every position of a separator within a block
+    auto reference = [](const std::string& text) {
+        std::string cleaned;
+        bool pendingSpace = false;
+        for (char ch : text) {
+            unsigned char c = static_cast<unsigned char>(ch);
+            if (std::ispunct(c) || std::isspace(c)) {
+                pendingSpace = !cleaned.empty();
+                continue;
+            }
+            if (pendingSpace) {
+                cleaned.push_back(' ');
+                pendingSpace = false;
+            }
+            cleaned.push_back(static_cast<char>(std::tolower(c)));
+        }
+        return cleaned;
+    };
+    std::vector<std::pair<std::string, std::string>> inputs = cases;
+    uint64_t state = 12345;
+    for (size_t length = 1; length <= 80; ++length) {
+        std::string text;
+        for (size_t k = 0; k < length; ++k) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            size_t draw = (state >> 33) % 8;
+            text.push_back(draw == 0 ? " ,.!-\t_~"[(state >> 40) % 8]
+                                     : "aZ09kQxM"[(state >> 43) % 8]);
+        }
+        inputs.emplace_back(text, reference(text));
+    }
+
+    std::string buffer;
+    std::vector<std::string_view> views;
+    for (const auto& [input, expected] : inputs) {
+        std::string cleaned = preprocessorWithoutStopWords->cleanText(input);
+        EXPECT_EQ(cleaned, expected) << "input: " << input;
+        EXPECT_EQ(preprocessorWithoutStopWords->cleanText(cleaned), cleaned) << "input: " << input;
+        EXPECT_EQ(preprocessorWithoutStopWords->hashCleanText(input), hashBytes(cleaned))
+            << "input: " << input;
+
+        std::vector<std::string> words;
+        std::istringstream iss(expected);
+        for (std::string word; iss >> word;) {
+            words.push_back(word);
+        }
+        preprocessorWithoutStopWords->tokenizeInto(input, buffer, views);
+        EXPECT_EQ(std::vector<std::string>(views.begin(), views.end()), words) << "input: " << input;
+    }
+
+    // Stop words match after folding
+    EXPECT_EQ(preprocessorWithStopWords->preprocess("THE Café, ＴＨＥ END"),
+              (std::vector<std::string>{"café", "end"}));
+}
+
+// Test that feature vectors only store the words present in the text
+TEST(FeatureExtractorTest, ExtractsSparseFeatures) {
+    Preprocessor preprocessor(false);
+    FeatureExtractor extractor(preprocessor);
+    extractor.buildVocabulary({
+        {"good good movie", SentimentLabel::POSITIVE},
+        {"bad movie", SentimentLabel::NEGATIVE},
+        {"good plot bad acting", SentimentLabel::NEUTRAL}
+    }, 1, 0);
+
+    SparseVector features = extractor.extractFeatures("good good unknown movie");
+
+    EXPECT_EQ(features.dimension, extractor.getVocabularySize());
+    ASSERT_EQ(features.nonZeroCount(), 2u);
+    EXPECT_TRUE(std::is_sorted(features.indices.begin(), features.indices.end()));
+
+    std::vector<double> dense = toDense(features);
+    EXPECT_EQ(dense[extractor.getVocabularyIndex().find("good")], 2.0);
+    EXPECT_EQ(dense[extractor.getVocabularyIndex().find("movie")], 1.0);
+    EXPECT_EQ(dense[extractor.getVocabularyIndex().find("bad")], 0.0);
+
+    SparseVector roundTrip = toSparse(dense);
+    EXPECT_EQ(roundTrip.indices, features.indices);
+    EXPECT_EQ(roundTrip.values, features.values);
+}
+
+// Test the precomputed IDF table, the TF-IDF options and IDF folding in snapshots
+TEST(FeatureExtractorTest, PrecomputesAndFoldsIdf) {
+    std::vector<TextData> corpus = {
+        {"good good movie", SentimentLabel::POSITIVE},
+        {"good acting great music", SentimentLabel::POSITIVE},
+        {"bad movie", SentimentLabel::NEGATIVE},
+        {"bad plot bad acting", SentimentLabel::NEGATIVE},
+        {"a movie", SentimentLabel::NEUTRAL}
+    };
+    Preprocessor preprocessor(false);
+    FeatureExtractor extractor(preprocessor, FeatureExtractor::Method::TF_IDF);
+    extractor.buildVocabulary(corpus, 1, 0);
+
+    const ConstArray<double>& idf = extractor.getIdfWeights();
+    ASSERT_EQ(idf.size(), extractor.getVocabularySize());
+    size_t good = extractor.getVocabularyIndex().find("good");
+    size_t movie = extractor.getVocabularyIndex().find("movie");
+    EXPECT_DOUBLE_EQ(idf[good], std::log(5.0 / 2.0));
+    EXPECT_DOUBLE_EQ(idf[movie], std::log(5.0 / 3.0));
+
+    std::vector<double> dense = toDense(extractor.extractFeatures("good good good movie"));
+    EXPECT_DOUBLE_EQ(dense[good], 3.0 * idf[good]);
+    EXPECT_DOUBLE_EQ(dense[movie], idf[movie]);
+
+    // Sublinear counts, then unit length
+    FeatureExtractor normalized(preprocessor, FeatureExtractor::Method::TF_IDF);
+    normalized.setTfIdfOptions(true, true);
+    normalized.buildVocabulary(corpus, 1, 0);
+    SparseVector unit = normalized.extractFeatures("good good good movie great great bad music");
+    double norm = 0.0;
+    for (double value : unit.values) {
+        norm += value * value;
+    }
+    EXPECT_NEAR(norm, 1.0, 1e-12);
+    dense = toDense(unit);
+    EXPECT_NEAR(dense[good] / dense[movie], (1.0 + std::log(3.0)) * idf[good] / idf[movie], 1e-12);
+    EXPECT_FALSE(normalized.setIdfFolded(true));
+
+    // A snapshot folds the IDF into its model and scores exactly the same way
+    NaiveBayes model;
+    ASSERT_TRUE(model.train(extractor.batchTransform(corpus)));
+    ModelSnapshot snapshot(extractor, model, false);
+    EXPECT_TRUE(snapshot.getFeatureExtractor().isIdfFolded());
+    EXPECT_FALSE(extractor.isIdfFolded());
+    InferenceContext context;
+    for (const std::string text : {"good movie", "bad bad acting", "great music", "unseen"}) {
+        double expected[NaiveBayes::kClassStride];
+        double actual[NaiveBayes::kClassStride];
+        SentimentLabel label = model.predictScores(extractor.extractFeatures(text), expected, nullptr);
+        EXPECT_EQ(snapshot.predictScores(text, context, actual, nullptr), label) << text;
+        for (size_t lane = 0; lane < model.getClassCount(); ++lane) {
+            EXPECT_NEAR(actual[lane], expected[lane], 1e-9) << text;
+        }
+    }
+    EXPECT_FALSE(saveModelFile(::testing::TempDir() + "sentiment_folded.model",
+                               snapshot.getFeatureExtractor(), snapshot.getModel(), false));
+
+    // Compact snapshots fold before quantizing; L2 normalization keeps the IDF in the features
+    ModelSnapshot compact(extractor, model, false, NaiveBayes::Precision::INT8);
+    EXPECT_TRUE(compact.getFeatureExtractor().isIdfFolded());
+    EXPECT_EQ(compact.getModel().getPrecision(), NaiveBayes::Precision::INT8);
+    NaiveBayes normalizedModel;
+    ASSERT_TRUE(normalizedModel.train(normalized.batchTransform(corpus)));
+    EXPECT_FALSE(ModelSnapshot(normalized, normalizedModel, false).getFeatureExtractor().isIdfFolded());
+
+    // The options survive a round trip through a model file
+    std::string path = ::testing::TempDir() + "sentiment_tfidf_options.model";
+    ASSERT_TRUE(saveModelFile(path, normalized, normalizedModel, false));
+    FeatureExtractor loaded(preprocessor);
+    NaiveBayes loadedModel;
+    bool useStopWords = true;
+    ASSERT_TRUE(loadModelFile(path, loaded, loadedModel, useStopWords));
+    EXPECT_TRUE(loaded.isSublinearTf());
+    EXPECT_TRUE(loaded.isL2Normalized());
+    EXPECT_EQ(loaded.extractFeatures("good good movie").values,
+              normalized.extractFeatures("good good movie").values);
+}
+
+// Test that extraction and prediction with a warm inference context do not allocate
+TEST(FeatureExtractorTest, ReusedContextDoesNotAllocate) {
+    std::vector<TextData> corpus = {
+        {"good good movie", SentimentLabel::POSITIVE},
+        {"bad movie", SentimentLabel::NEGATIVE},
+        {"good plot bad acting", SentimentLabel::NEGATIVE},
+        {"good movie great cast", SentimentLabel::POSITIVE}
+    };
+    const std::vector<std::string> texts = {
+        "good movie with a good cast and bad acting overall",
+        "bad movie",
+        "",
+        "Good MOVIE, great cast!"
+    };
+
+    Preprocessor preprocessor(false);
+    for (auto method : {FeatureExtractor::Method::TF_IDF, FeatureExtractor::Method::HASHING}) {
+        FeatureExtractor extractor(preprocessor, method);
+        extractor.setHashing(8, true);
+        extractor.setNgramRange(1, 2);
+        extractor.buildVocabulary(corpus, 1, 0);
+
+        NaiveBayes model(1.0);
+        ASSERT_TRUE(model.train(extractor.batchTransform(corpus)));
+
+        // The first pass grows the buffers to fit the longest text
+        InferenceContext context;
+        for (const auto& text : texts) {
+            const SparseVector& features = extractor.extractFeatures(text, context);
+            SparseVector expected = extractor.extractFeatures(text);
+            EXPECT_EQ(features.indices, expected.indices);
+            EXPECT_EQ(features.values, expected.values);
+            EXPECT_EQ(features.dimension, expected.dimension);
+        }
+
+        size_t before = allocationCount;
+        size_t positives = 0;
+        for (const auto& text : texts) {
+            positives += model.predict(extractor.extractFeatures(text, context)) == SentimentLabel::POSITIVE;
+        }
+        EXPECT_EQ(allocationCount - before, 0u);
+        EXPECT_GT(positives, 0u);
+    }
+}
+
+// Test that the parallel path produces the same vocabulary and features as the serial one
+TEST(FeatureExtractorTest, ParallelMatchesSerial) {
+    std::vector<TextData> corpus;
+    const std::vector<std::string> words = {"great", "awful", "fine", "plot", "cast", "music"};
+    for (size_t i = 0; i < 500; ++i) {
+        std::string text;
+        for (size_t j = 0; j <= i % 7; ++j) {
+            text += words[(i * 31 + j * 17) % words.size()] + " ";
+        }
+        corpus.push_back({text, SentimentLabel::POSITIVE});
+    }
+
+    Preprocessor preprocessor(true);
+    FeatureExtractor serial(preprocessor, FeatureExtractor::Method::TF_IDF);
+    FeatureExtractor parallel(preprocessor, FeatureExtractor::Method::TF_IDF);
+    parallel.setThreadPool(std::make_shared<ThreadPool>(4));
+
+    serial.buildVocabulary(corpus, 1, 4);
+    parallel.buildVocabulary(corpus, 1, 4);
+    ASSERT_EQ(serial.getVocabularySize(), parallel.getVocabularySize());
+    for (size_t i = 0; i < serial.getVocabularySize(); ++i) {
+        EXPECT_EQ(serial.getVocabularyIndex().term(i), parallel.getVocabularyIndex().term(i));
+    }
+
+    std::vector<FeatureVector> serialFeatures = serial.batchTransform(corpus);
+    std::vector<FeatureVector> parallelFeatures = parallel.batchTransform(corpus);
+    ASSERT_EQ(serialFeatures.size(), parallelFeatures.size());
+    for (size_t i = 0; i < serialFeatures.size(); ++i) {
+        EXPECT_EQ(serialFeatures[i].features.indices, parallelFeatures[i].features.indices);
+        EXPECT_EQ(serialFeatures[i].features.values, parallelFeatures[i].features.values);
+    }
+}
+
+// Test the smoothed parameters and predictions of the Naive Bayes matrix
+TEST(NaiveBayesTest, TrainsFeatureMajorMatrix) {
+    auto example = [](std::vector<double> dense, SentimentLabel label) {
+        return FeatureVector{toSparse(dense), label};
+    };
+    std::vector<FeatureVector> data = {
+        example({3, 0, 1}, SentimentLabel::POSITIVE),
+        example({0, 2, 0}, SentimentLabel::NEGATIVE),
+        example({1, 1, 0}, SentimentLabel::POSITIVE)
+    };
+
+    NaiveBayes model(1.0);
+    ASSERT_TRUE(model.train(data));
+    ASSERT_EQ(model.getClassLabels(),
+              (std::vector<SentimentLabel>{SentimentLabel::POSITIVE, SentimentLabel::NEGATIVE}));
+
+    // Positive is lane 0 with counts {4, 1, 1} (total 6), negative lane 1 with {0, 2, 0}
+    const ConstArray<double>& matrix = model.getLogLikelihoodMatrix();
+    const size_t stride = NaiveBayes::kClassStride;
+    EXPECT_DOUBLE_EQ(matrix[0 * stride + 0], std::log(5.0 / 9.0));
+    EXPECT_DOUBLE_EQ(matrix[1 * stride + 1], std::log(3.0 / 5.0));
+    EXPECT_DOUBLE_EQ(model.getLogPriors()[0], std::log(2.0 / 3.0));
+
+    EXPECT_EQ(model.predict(std::vector<double>{2, 0, 0}), SentimentLabel::POSITIVE);
+    EXPECT_EQ(model.predict(std::vector<double>{0, 3, 0}), SentimentLabel::NEGATIVE);
+
+    // The batch path agrees with single predictions and reports the winning log joint
+    std::vector<SparseVector> batch = {
+        toSparse({2, 0, 0}), toSparse({0, 3, 0}), toSparse({1, 1, 1}), toSparse({0, 0, 0})
+    };
+    std::vector<SentimentLabel> labels(batch.size());
+    std::vector<double> scores(batch.size());
+    model.predictBatch(batch.data(), batch.size(), labels.data(), scores.data());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        EXPECT_EQ(labels[i], model.predict(batch[i]));
+    }
+    EXPECT_NEAR(scores[0], std::log(2.0 / 3.0) + 2 * std::log(5.0 / 9.0), 1e-12);
+
+    // Posteriors are the normalized exponentials of the log joint scores
+    double logJoint[NaiveBayes::kClassStride];
+    double probabilities[NaiveBayes::kClassStride];
+    SparseVector document = toSparse({2, 1, 0});
+    EXPECT_EQ(model.predictScores(document, logJoint, probabilities), model.predict(document));
+    double evidence = std::exp(logJoint[0]) + std::exp(logJoint[1]);
+    EXPECT_NEAR(probabilities[0], std::exp(logJoint[0]) / evidence, 1e-12);
+    EXPECT_NEAR(probabilities[0] + probabilities[1], 1.0, 1e-12);
+    EXPECT_GT(probabilities[0], probabilities[1]);
+}
+
+// Test that incremental updates, including a grown vocabulary, match a full retrain
+TEST(NaiveBayesTest, PartialFitMatchesRetrain) {
+    auto example = [](std::vector<double> dense, SentimentLabel label) {
+        return FeatureVector{toSparse(dense), label};
+    };
+    std::vector<FeatureVector> first = {
+        example({3, 0, 1}, SentimentLabel::POSITIVE),
+        example({0, 2, 0}, SentimentLabel::NEGATIVE)
+    };
+    std::vector<FeatureVector> second = {
+        example({1, 0, 0, 2}, SentimentLabel::NEUTRAL),
+        example({0, 1, 0, 1}, SentimentLabel::NEGATIVE)
+    };
+
+    NaiveBayes updated;
+    ASSERT_TRUE(updated.train(first));
+    ASSERT_TRUE(updated.partialFit(second));
+
+    std::vector<FeatureVector> all = {
+        example({3, 0, 1, 0}, SentimentLabel::POSITIVE),
+        example({0, 2, 0, 0}, SentimentLabel::NEGATIVE)
+    };
+    all.insert(all.end(), second.begin(), second.end());
+    NaiveBayes retrained;
+    ASSERT_TRUE(retrained.train(all));
+
+    EXPECT_EQ(updated.getFeatureCount(), 4u);
+    EXPECT_EQ(updated.getClassLabels(), retrained.getClassLabels());
+    const ConstArray<double>& expected = retrained.getLogLikelihoodMatrix();
+    ASSERT_EQ(updated.getLogLikelihoodMatrix().size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_DOUBLE_EQ(updated.getLogLikelihoodMatrix()[i], expected[i]);
+    }
+    for (size_t lane = 0; lane < NaiveBayes::kClassStride; ++lane) {
+        EXPECT_DOUBLE_EQ(updated.getLogPriors()[lane], retrained.getLogPriors()[lane]);
+    }
+
+    // Feature vectors cannot lose dimensions
+    EXPECT_FALSE(updated.partialFit({example({1, 0}, SentimentLabel::POSITIVE)}));
+
+    // Loaded parameters carry no counts to update
+    NaiveBayes loaded;
+    ASSERT_TRUE(loaded.setParameters(retrained.getClassLabels(), retrained.getLogPriors(),
+                                     retrained.getLogLikelihoodMatrix(), retrained.getFeatureCount()));
+    EXPECT_FALSE(loaded.hasTrainingCounts());
+    EXPECT_FALSE(loaded.partialFit(second));
+}
+
+// Test that compact parameter storage tracks the double scores within its rounding error
+TEST(NaiveBayesTest, CompactPrecisionsTrackDoubleScores) {
+    const size_t features = 300;
+    std::vector<FeatureVector> data;
+    for (size_t i = 0; i < 120; ++i) {
+        std::vector<double> dense(features, 0.0);
+        for (size_t k = 0; k < 12; ++k) {
+            dense[(i * 31 + k * k * 7 + (i % 3) * 50) % features] += 1.0 + k % 3;
+        }
+        data.push_back({toSparse(dense), static_cast<SentimentLabel>(i % 3)});
+    }
+    NaiveBayes baseline(0.5);
+    ASSERT_TRUE(baseline.train(data));
+    const ConstArray<double>& matrix = baseline.getLogLikelihoodMatrix();
+    const size_t stride = NaiveBayes::kClassStride;
+
+    // Widest per-class range of log-likelihoods bounds the quantization step
+    double range = 0.0;
+    for (size_t lane = 0; lane < baseline.getClassLabels().size(); ++lane) {
+        double low = 0.0, high = -1e300;
+        for (size_t row = 0; row < features; ++row) {
+            low = std::min(low, matrix[row * stride + lane]);
+            high = std::max(high, matrix[row * stride + lane]);
+        }
+        range = std::max(range, high - low);
+    }
+
+    struct Case { NaiveBayes::Precision precision; double step; size_t bytes; };
+    for (const Case& test : {Case{NaiveBayes::Precision::FLOAT32, 0.0, 4},
+                             Case{NaiveBayes::Precision::INT16, range / 65534.0, 2},
+                             Case{NaiveBayes::Precision::INT8, range / 254.0, 1}}) {
+        NaiveBayes compact;
+        compact.shareParameters(baseline);
+        ASSERT_TRUE(compact.setPrecision(test.precision));
+        EXPECT_EQ(compact.getPrecision(), test.precision);
+        EXPECT_EQ(compact.getParameterBytes(), features * stride * test.bytes);
+        EXPECT_EQ(compact.getLogLikelihoodMatrix().size(), 0u);
+        EXPECT_EQ(baseline.getLogLikelihoodMatrix().size(), features * stride);
+
+        size_t agreements = 0;
+        for (const auto& example : data) {
+            double expected[NaiveBayes::kClassStride];
+            double actual[NaiveBayes::kClassStride];
+            baseline.predictScores(example.features, expected, nullptr);
+            SentimentLabel label = compact.predictScores(example.features, actual, nullptr);
+            double total = 0.0;
+            for (double value : example.features.values) {
+                total += value;
+            }
+
+            // Each count is off by at most half a step, plus float rounding
+            for (size_t lane = 0; lane < baseline.getClassLabels().size(); ++lane) {
+                EXPECT_NEAR(actual[lane], expected[lane], total * test.step / 2.0 + 1e-3);
+            }
+            agreements += label == baseline.predict(example.features);
+        }
+        EXPECT_GE(agreements, data.size() * 95 / 100);
+
+        // The batch path scores with the same compact matrix
+        std::vector<SparseVector> batch;
+        for (const auto& example : data) {
+            batch.push_back(example.features);
+        }
+        std::vector<SentimentLabel> labels(batch.size());
+        compact.predictBatch(batch.data(), batch.size(), labels.data());
+        for (size_t i = 0; i < batch.size(); ++i) {
+            EXPECT_EQ(labels[i], compact.predict(batch[i]));
+        }
+
+        // A compressed model cannot go back to double parameters
+        EXPECT_FALSE(compact.setPrecision(NaiveBayes::Precision::FLOAT64));
+    }
+
+    // The precision sticks across retraining on the counts
+    NaiveBayes updated(0.5);
+    ASSERT_TRUE(updated.train(data));
+    ASSERT_TRUE(updated.setPrecision(NaiveBayes::Precision::INT8));
+    ASSERT_TRUE(updated.partialFit({data[0], data[1]}));
+    EXPECT_EQ(updated.getPrecision(), NaiveBayes::Precision::INT8);
+    EXPECT_EQ(updated.getParameterBytes(), features * stride);
+}
+
+// Test that class names map to dense lanes scored by the same matrix path
+TEST(NaiveBayesTest, NamedClassesUseDenseLanes) {
+    const size_t features = 40;
+    const std::vector<std::string> taxonomy = {
+        "billing", "delivery", "quality", "refund", "support", "account"
+    };
+    std::vector<SparseVector> documents;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < 90; ++i) {
+        std::vector<double> dense(features, 0.0);
+        size_t topic = i % taxonomy.size();
+        for (size_t k = 0; k < 6; ++k) {
+            dense[(topic * 6 + k * (i % 4 + 1)) % features] += 1.0 + k % 2;
+        }
+        documents.push_back(toSparse(dense));
+        names.push_back(taxonomy[topic]);
+    }
+
+    NaiveBayes model(1.0);
+    ASSERT_TRUE(model.trainClasses(documents, names));
+    std::vector<std::string> sorted = taxonomy;
+    std::sort(sorted.begin(), sorted.end());
+    ASSERT_EQ(model.getClassNames(), sorted);
+    EXPECT_EQ(model.getClassStride(), 2 * NaiveBayes::kClassStride);
+    EXPECT_EQ(model.getClassLabels(), std::vector<SentimentLabel>(6, SentimentLabel::UNKNOWN));
+    EXPECT_FALSE(model.hasTrainingCounts());
+
+    // Every lane scores log P(class) + sum of count * log P(feature|class)
+    std::vector<double> classCounts(features * 6, 0.0);
+    std::vector<double> classTotals(6, 0.0);
+    std::vector<size_t> classDocuments(6, 0);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        size_t id = std::find(sorted.begin(), sorted.end(), names[i]) - sorted.begin();
+        for (size_t k = 0; k < documents[i].nonZeroCount(); ++k) {
+            classCounts[documents[i].indices[k] * 6 + id] += documents[i].values[k];
+            classTotals[id] += documents[i].values[k];
+        }
+        classDocuments[id]++;
+    }
+    std::vector<size_t> classes(documents.size());
+    std::vector<double> scores(documents.size());
+    model.predictClassBatch(documents.data(), documents.size(), classes.data(), scores.data());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        std::vector<double> expected(6);
+        for (size_t id = 0; id < 6; ++id) {
+            expected[id] = std::log(classDocuments[id] / 90.0);
+            for (size_t k = 0; k < documents[i].nonZeroCount(); ++k) {
+                double count = classCounts[documents[i].indices[k] * 6 + id];
+                expected[id] += documents[i].values[k] * std::log((count + 1.0) / (classTotals[id] + features));
+            }
+        }
+
+        size_t best = std::max_element(expected.begin(), expected.end()) - expected.begin();
+        EXPECT_EQ(classes[i], best);
+        EXPECT_EQ(model.predictClass(documents[i]), best);
+        EXPECT_NEAR(scores[i], expected[best], 1e-9);
+    }
+
+    // Wide rows also work at compact precisions
+    NaiveBayes compact;
+    compact.shareParameters(model);
+    ASSERT_TRUE(compact.setPrecision(NaiveBayes::Precision::INT8));
+    EXPECT_EQ(compact.getParameterBytes(), features * 8);
+    size_t agreements = 0;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        agreements += compact.predictClass(documents[i]) == classes[i];
+    }
+    EXPECT_GE(agreements, documents.size() * 95 / 100);
+    EXPECT_EQ(model.predictClass(SparseVector{{}, {}, features + 1}), NaiveBayes::kNoClass);
+
+    // Sentiment names give the same model as SentimentLabel training (lanes in name order)
+    std::vector<FeatureVector> labeled;
+    std::vector<std::string> sentimentNames;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        SentimentLabel label = i % 2 ? SentimentLabel::NEGATIVE : SentimentLabel::POSITIVE;
+        labeled.push_back({documents[i], label});
+        sentimentNames.push_back(sentimentToString(label));
+    }
+    NaiveBayes byLabel(1.0);
+    NaiveBayes byName(1.0);
+    ASSERT_TRUE(byLabel.train(labeled));
+    ASSERT_TRUE(byName.trainClasses(documents, sentimentNames));
+    EXPECT_EQ(byName.getClassLabels(),
+              (std::vector<SentimentLabel>{SentimentLabel::NEGATIVE, SentimentLabel::POSITIVE}));
+    std::vector<SentimentLabel> nameLabels(documents.size()), labelLabels(documents.size());
+    std::vector<double> nameScores(documents.size()), labelScores(documents.size());
+    byName.predictBatch(documents.data(), documents.size(), nameLabels.data(), nameScores.data());
+    byLabel.predictBatch(documents.data(), documents.size(), labelLabels.data(), labelScores.data());
+    EXPECT_EQ(nameLabels, labelLabels);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        EXPECT_DOUBLE_EQ(nameScores[i], labelScores[i]);
+    }
+}
+
+// Test that parallel sparse counting and the vectorized log train the serial model
+TEST(NaiveBayesTest, ParallelTrainingMatchesSerial) {
+    // The vectorized log stays within one unit in the last place of std::log
+    std::vector<double> inputs = {1.0, 0.5, 0.70710678118654752440, 1e-300, 1e300, 3.0, 0.0, -1.0};
+    for (int i = 1; i < 2000; ++i) {
+        inputs.push_back(i / 1999.0);
+        inputs.push_back(1.0 + i * 1e-12);
+    }
+    std::vector<double> logs = inputs;
+    logValues(logs.data(), logs.size());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        double expected = std::log(inputs[i]);
+        if (std::isnan(expected)) {
+            EXPECT_TRUE(std::isnan(logs[i])) << inputs[i];
+        } else if (std::isinf(expected)) {
+            EXPECT_EQ(logs[i], expected) << inputs[i];
+        } else {
+            EXPECT_NEAR(logs[i], expected, std::abs(expected) * 2.3e-16 + 1e-300) << inputs[i];
+        }
+    }
+
+    const size_t features = 500;
+    std::vector<FeatureVector> data;
+    std::vector<SparseVector> documents;
+    std::vector<std::string> names;
+    const char* classNames[] = {"sports", "politics", "music", "film", "science"};
+    for (size_t i = 0; i < 3000; ++i) {
+        std::vector<double> dense(features, 0.0);
+        for (size_t k = 0; k < 20; ++k) {
+            dense[(i * 31 + k * k * 17) % features] += 1.0 + (i + k) % 3;
+        }
+        data.push_back({toSparse(dense), static_cast<SentimentLabel>(i % 3)});
+        documents.push_back(data.back().features);
+        names.push_back(classNames[(i * 7) % 5]);
+    }
+
+    auto values = [](const ConstArray<double>& array) {
+        return std::vector<double>(array.begin(), array.end());
+    };
+    NaiveBayes serial;
+    NaiveBayes parallel;
+    parallel.setThreadPool(std::make_shared<ThreadPool>(4));
+    ASSERT_TRUE(serial.train(data));
+    ASSERT_TRUE(parallel.train(data));
+    EXPECT_EQ(values(parallel.getLogPriors()), values(serial.getLogPriors()));
+    EXPECT_EQ(values(parallel.getLogLikelihoodMatrix()), values(serial.getLogLikelihoodMatrix()));
+
+    // Chunked updates reuse the same counting path
+    ASSERT_TRUE(parallel.partialFit(data));
+    ASSERT_TRUE(serial.partialFit(data));
+    EXPECT_EQ(values(parallel.getLogLikelihoodMatrix()), values(serial.getLogLikelihoodMatrix()));
+
+    ASSERT_TRUE(serial.trainClasses(documents, names));
+    ASSERT_TRUE(parallel.trainClasses(documents, names));
+    EXPECT_EQ(parallel.getClassCount(), 5u);
+    EXPECT_EQ(values(parallel.getLogLikelihoodMatrix()), values(serial.getLogLikelihoodMatrix()));
+}
+
+// Test that both SGD losses learn signed sparse features, serially and with Hogwild workers
+TEST(LinearModelTest, SgdLearnsSignedFeaturesInParallel) {
+    const size_t features = 64;
+    std::vector<FeatureVector> data;
+    for (size_t i = 0; i < 600; ++i) {
+        SentimentLabel label = static_cast<SentimentLabel>(i % 3);
+        std::vector<double> dense(features, 0.0);
+        // Two words per class plus noise; feature 63 is negative for the negative class
+        dense[static_cast<size_t>(label) * 4 + i % 2] = 1.0 + i % 3;
+        dense[12 + (i * 7) % 40] += 1.0;
+        dense[63] = label == SentimentLabel::NEGATIVE ? -1.0 : 0.5;
+        data.push_back({toSparse(dense), label});
+    }
+
+    auto pool = std::make_shared<ThreadPool>(4);
+    std::vector<std::unique_ptr<LinearModel>> models;
+    for (auto threads : {std::shared_ptr<ThreadPool>(), pool}) {
+        models.push_back(std::make_unique<LogisticRegression>());
+        models.push_back(std::make_unique<LinearSVM>());
+        models[models.size() - 2]->setThreadPool(threads);
+        models.back()->setThreadPool(threads);
+    }
+
+    for (const auto& model : models) {
+        ASSERT_TRUE(model->train(data)) << model->getName();
+        EXPECT_EQ(model->getClassLabels().size(), 3u);
+        EXPECT_EQ(model->getWeights().size(), features * LinearModel::kClassStride);
+
+        Evaluator evaluator(*model);
+        EXPECT_GE(evaluator.evaluate(data).accuracy, 0.98) << model->getName();
+
+        // The batch kernel agrees with single predictions and scores bias + w . x
+        std::vector<SparseVector> batch;
+        for (size_t i = 0; i < 30; ++i) {
+            batch.push_back(data[i].features);
+        }
+        std::vector<SentimentLabel> labels(batch.size());
+        std::vector<double> scores(batch.size());
+        model->predictBatch(batch.data(), batch.size(), labels.data(), scores.data());
+        for (size_t i = 0; i < batch.size(); ++i) {
+            EXPECT_EQ(labels[i], model->predict(batch[i]));
+            size_t lane = std::find(model->getClassLabels().begin(), model->getClassLabels().end(), labels[i]) -
+                          model->getClassLabels().begin();
+            double expected = model->getBiases()[lane];
+            for (size_t k = 0; k < batch[i].nonZeroCount(); ++k) {
+                expected += batch[i].values[k] *
+                            model->getWeights()[batch[i].indices[k] * LinearModel::kClassStride + lane];
+            }
+            EXPECT_NEAR(scores[i], expected, 1e-9);
+        }
+
+        // Labelled examples are scored in place with the same results
+        std::vector<SentimentLabel> exampleLabels(batch.size());
+        std::vector<double> exampleScores(batch.size());
+        model->predictBatch(data.data(), batch.size(), exampleLabels.data(), exampleScores.data());
+        EXPECT_EQ(exampleLabels, labels);
+        EXPECT_EQ(exampleScores, scores);
+    }
+
+    // Negative values are used as they are, unlike the clamped Naive Bayes counts
+    const LinearModel& serial = *models[0];
+    size_t negativeLane = std::find(serial.getClassLabels().begin(), serial.getClassLabels().end(),
+                                    SentimentLabel::NEGATIVE) - serial.getClassLabels().begin();
+    EXPECT_LT(serial.getWeights()[63 * LinearModel::kClassStride + negativeLane], 0.0);
+
+    // One thread gives the same weights every time
+    LogisticRegression again;
+    ASSERT_TRUE(again.train(data));
+    for (size_t i = 0; i < again.getWeights().size(); ++i) {
+        EXPECT_EQ(again.getWeights()[i], serial.getWeights()[i]);
+    }
+}
+
+// Test that hashed features need no vocabulary and respect the sign option
+TEST(FeatureExtractorTest, HashesIntoFixedFeatureSpace) {
+    Preprocessor preprocessor(false);
+    FeatureExtractor extractor(preprocessor, FeatureExtractor::Method::HASHING);
+    ASSERT_TRUE(extractor.setHashing(10));
+    EXPECT_FALSE(extractor.setHashing(FeatureExtractor::kMaxHashBits + 1));
+    extractor.buildVocabulary({{"ignored text", SentimentLabel::POSITIVE}});
+    EXPECT_EQ(extractor.getVocabularySize(), 0u);
+    EXPECT_EQ(extractor.getFeatureCount(), 1024u);
+
+    SparseVector features = extractor.extractFeatures("good good movie, never seen before");
+    EXPECT_EQ(features.dimension, 1024u);
+    EXPECT_TRUE(std::is_sorted(features.indices.begin(), features.indices.end()));
+    size_t goodIndex = hashBytes("good") & 1023;
+    auto it = std::find(features.indices.begin(), features.indices.end(), goodIndex);
+    ASSERT_NE(it, features.indices.end());
+    EXPECT_GE(features.values[it - features.indices.begin()], 2.0);
+
+    // With the sign trick every token contributes +1 or -1
+    ASSERT_TRUE(extractor.setHashing(10, true));
+    SparseVector signedFeatures = extractor.extractFeatures("good");
+    ASSERT_EQ(signedFeatures.nonZeroCount(), 1u);
+    EXPECT_EQ(signedFeatures.values[0], (hashBytes("good") >> 63) ? -1.0 : 1.0);
+}
+
+// Test that bigrams become features and are found without joining strings
+TEST(FeatureExtractorTest, BuildsNgramFeatures) {
+    std::vector<TextData> corpus = {
+        {"not good at all", SentimentLabel::NEGATIVE},
+        {"really not good", SentimentLabel::NEGATIVE},
+        {"good and fun", SentimentLabel::POSITIVE}
+    };
+
+    Preprocessor preprocessor(false);
+    FeatureExtractor extractor(preprocessor, FeatureExtractor::Method::TF_IDF);
+    EXPECT_FALSE(extractor.setNgramRange(2, 1));
+    ASSERT_TRUE(extractor.setNgramRange(1, 2));
+    extractor.buildVocabulary(corpus, 2, 0);
+
+    const VocabularyIndex& index = extractor.getVocabularyIndex();
+    uint32_t notGood = index.find("not good");
+    ASSERT_NE(notGood, VocabularyIndex::npos);
+    EXPECT_NE(index.find("good"), VocabularyIndex::npos);
+    EXPECT_EQ(index.find("good at"), VocabularyIndex::npos); // Seen once
+    EXPECT_DOUBLE_EQ(extractor.getDocumentFrequencies()[notGood], 2.0);
+
+    SparseVector features = extractor.extractFeatures("This is not good!");
+    EXPECT_NE(std::find(features.indices.begin(), features.indices.end(), notGood),
+              features.indices.end());
+
+    // Term ids come out in text order, n-grams after the word they start at
+    std::vector<uint32_t> ids;
+    extractor.extractTermIds("not good", ids);
+    EXPECT_EQ(ids, (std::vector<uint32_t>{index.find("not"), notGood, index.find("good")}));
+
+    // The vocabulary does not depend on the thread count
+    FeatureExtractor parallel(preprocessor, FeatureExtractor::Method::TF_IDF);
+    parallel.setNgramRange(1, 2);
+    parallel.setThreadPool(std::make_shared<ThreadPool>(3));
+    parallel.buildVocabulary(corpus, 2, 0);
+    ASSERT_EQ(parallel.getVocabularySize(), extractor.getVocabularySize());
+    for (size_t i = 0; i < extractor.getVocabularySize(); ++i) {
+        EXPECT_EQ(parallel.getVocabularyIndex().term(i), index.term(i));
+    }
+}
+
+// Test that tryParallelFor backs off instead of waiting for a busy pool
+TEST(ThreadPoolTest, TryParallelForSkipsBusyPool) {
+    ThreadPool pool(2);
+    std::atomic<bool> started{false};
+    std::atomic<bool> release{false};
+    std::thread busy([&] {
+        pool.parallelFor(2, [&](size_t, size_t, size_t) {
+            started = true;
+            while (!release) {
+                std::this_thread::yield();
+            }
+        }, 1);
+    });
+    while (!started) {
+        std::this_thread::yield();
+    }
+
+    bool ran = false;
+    EXPECT_FALSE(pool.tryParallelFor(8, [&](size_t, size_t, size_t) { ran = true; }));
+    EXPECT_FALSE(ran);
+    release = true;
+    busy.join();
+
+    std::atomic<size_t> items{0};
+    EXPECT_TRUE(pool.tryParallelFor(8, [&](size_t begin, size_t end, size_t) { items += end - begin; }));
+    EXPECT_EQ(items.load(), 8u);
+}
+
+// Test that interning assigns dense ids and survives table growth
+TEST(TermInternerTest, AssignsStableDenseIds) {
+    TermInterner interner;
+    EXPECT_EQ(interner.find("missing"), TermInterner::npos);
+
+    std::vector<std::string> terms;
+    for (int i = 0; i < 1000; ++i) {
+        terms.push_back("term" + std::to_string(i));
+        EXPECT_EQ(interner.intern(terms.back()), static_cast<uint32_t>(i));
+    }
+    EXPECT_EQ(interner.intern("term7"), 7u);
+    EXPECT_EQ(interner.size(), terms.size());
+    for (size_t i = 0; i < terms.size(); ++i) {
+        EXPECT_EQ(interner.find(terms[i]), i);
+        EXPECT_EQ(interner.term(static_cast<uint32_t>(i)), terms[i]);
+        EXPECT_EQ(interner.hash(static_cast<uint32_t>(i)), hashBytes(terms[i]));
+    }
+
+    interner.clear();
+    EXPECT_EQ(interner.size(), 0u);
+    EXPECT_EQ(interner.find("term7"), TermInterner::npos);
+}
+
+// Test that the perfect hash finds every term and rejects inconsistent arrays
+TEST(VocabularyIndexTest, FindsEveryTermThroughPerfectHash) {
+    std::vector<std::string> words;
+    for (int i = 0; i < 5000; ++i) {
+        words.push_back(i % 3 == 0 ? "word" + std::to_string(i) + " next" : "word" + std::to_string(i));
+    }
+    std::vector<std::string_view> terms(words.begin(), words.end());
+    VocabularyIndex index(terms);
+
+    ASSERT_EQ(index.size(), terms.size());
+    EXPECT_EQ(index.getSlots().size(), terms.size()); // Minimal: one slot per term
+    EXPECT_EQ(index.getPilots().size(), VocabularyIndex::bucketCount(terms.size()));
+    for (size_t i = 0; i < terms.size(); ++i) {
+        EXPECT_EQ(index.find(terms[i]), i);
+        EXPECT_EQ(index.term(i), terms[i]);
+    }
+    EXPECT_EQ(index.find("word5000"), VocabularyIndex::npos);
+    EXPECT_EQ(index.find("word1 next"), VocabularyIndex::npos);
+    EXPECT_EQ(index.find(""), VocabularyIndex::npos);
+    EXPECT_EQ(VocabularyIndex(std::vector<std::string_view>{}).find("word0"), VocabularyIndex::npos);
+
+    // The arrays can be borrowed as they are, as from a mapped model file
+    VocabularyIndex borrowed;
+    ASSERT_TRUE(VocabularyIndex::fromArrays(index.getOffsets(), index.getStrings(),
+                                            index.getPilots(), index.getSlots(), borrowed));
+    EXPECT_EQ(borrowed.find("word43"), 43u);
+    EXPECT_EQ(borrowed.find("word42 next"), 42u);
+
+    std::vector<uint64_t> badSlots(index.getSlots().begin(), index.getSlots().end());
+    badSlots[0] |= terms.size(); // Term index out of range
+    EXPECT_FALSE(VocabularyIndex::fromArrays(index.getOffsets(), index.getStrings(), index.getPilots(),
+                                             ConstArray<uint64_t>(std::move(badSlots)), borrowed));
+    EXPECT_FALSE(VocabularyIndex::fromArrays(index.getOffsets(), index.getStrings(),
+                                             ConstArray<uint32_t>(), index.getSlots(), borrowed));
+}
+
+// Test that sketch estimates never undercount
+TEST(CountMinSketchTest, EstimatesUpperBounds) {
+    CountMinSketch sketch(64, 4);
+    std::vector<uint32_t> counts(500);
+    for (uint64_t key = 0; key < counts.size(); ++key) {
+        counts[key] = static_cast<uint32_t>(key % 7 + 1);
+        sketch.add(hashBytes(std::to_string(key)), counts[key]);
+    }
+    for (uint64_t key = 0; key < counts.size(); ++key) {
+        EXPECT_GE(sketch.estimate(hashBytes(std::to_string(key))), counts[key]);
+    }
+
+    CountMinSketch exact(1 << 12, 4);
+    EXPECT_EQ(exact.add(42, 3), 3u);
+    EXPECT_EQ(exact.add(42), 4u);
+    EXPECT_EQ(exact.estimate(7), 0u);
+    EXPECT_TRUE(CountMinSketch().empty());
+}
+
+// Test that growing the vocabulary keeps existing feature indices
+TEST(FeatureExtractorTest, ExtendVocabularyAppendsNewWords) {
+    Preprocessor preprocessor(false);
+    FeatureExtractor extractor(preprocessor, FeatureExtractor::Method::TF_IDF);
+    extractor.buildVocabulary({{"good movie", SentimentLabel::POSITIVE},
+                               {"bad movie", SentimentLabel::NEGATIVE}}, 1, 0);
+    std::vector<std::string> before;
+    for (size_t i = 0; i < extractor.getVocabularySize(); ++i) {
+        before.emplace_back(extractor.getVocabularyIndex().term(i));
+    }
+
+    EXPECT_EQ(extractor.extendVocabulary({{"great movie", SentimentLabel::POSITIVE},
+                                          {"great fun", SentimentLabel::POSITIVE}}, 2, 0), 1u);
+    ASSERT_EQ(extractor.getVocabularySize(), before.size() + 1);
+    for (size_t i = 0; i < before.size(); ++i) {
+        EXPECT_EQ(extractor.getVocabularyIndex().term(i), before[i]);
+    }
+    EXPECT_EQ(extractor.getVocabularyIndex().term(before.size()), "great");
+    EXPECT_EQ(extractor.getDocumentCount(), 4u);
+
+    uint32_t movie = extractor.getVocabularyIndex().find("movie");
+    ASSERT_NE(movie, VocabularyIndex::npos);
+    EXPECT_DOUBLE_EQ(extractor.getDocumentFrequencies()[movie], 3.0);
+    EXPECT_DOUBLE_EQ(extractor.getDocumentFrequencies()[before.size()], 2.0);
+}
+
+// Test that a saved model predicts exactly like the model it was saved from
+TEST(ModelIOTest, SaveAndLoadRoundTrip) {
+    std::vector<TextData> corpus = {
+        {"great movie, loved the cast", SentimentLabel::POSITIVE},
+        {"great music and a great plot", SentimentLabel::POSITIVE},
+        {"awful movie, hated the plot", SentimentLabel::NEGATIVE},
+        {"awful cast and awful music", SentimentLabel::NEGATIVE},
+        {"the movie was fine", SentimentLabel::NEUTRAL},
+        {"fine plot, fine cast", SentimentLabel::NEUTRAL}
+    };
+
+    Preprocessor preprocessor(true);
+    FeatureExtractor extractor(preprocessor, FeatureExtractor::Method::TF_IDF);
+    extractor.buildVocabulary(corpus, 1, 0);
+    NaiveBayes model(0.5);
+    ASSERT_TRUE(model.train(extractor.batchTransform(corpus)));
+
+    std::string path = ::testing::TempDir() + "sentiment_roundtrip.model";
+    ASSERT_TRUE(saveModelFile(path, extractor, model, true));
+
+    FeatureExtractor loadedExtractor(preprocessor);
+    NaiveBayes loadedModel;
+    bool useStopWords = false;
+    ASSERT_TRUE(loadModelFile(path, loadedExtractor, loadedModel, useStopWords));
+    EXPECT_TRUE(useStopWords);
+    EXPECT_DOUBLE_EQ(loadedModel.getAlpha(), 0.5);
+    EXPECT_EQ(loadedExtractor.getMethod(), FeatureExtractor::Method::TF_IDF);
+    EXPECT_EQ(loadedExtractor.getVocabularySize(), extractor.getVocabularySize());
+
+    for (const std::string text : {"great cast", "awful plot", "fine movie", "unseen words"}) {
+        SparseVector expected = extractor.extractFeatures(text);
+        SparseVector actual = loadedExtractor.extractFeatures(text);
+        EXPECT_EQ(actual.indices, expected.indices);
+        EXPECT_EQ(actual.values, expected.values);
+        EXPECT_EQ(loadedModel.predict(actual), model.predict(expected)) << text;
+    }
+
+    // Hashed models round-trip without a vocabulary
+    FeatureExtractor hashingExtractor(preprocessor, FeatureExtractor::Method::HASHING);
+    ASSERT_TRUE(hashingExtractor.setHashing(8, true));
+    hashingExtractor.buildVocabulary(corpus);
+    NaiveBayes hashingModel;
+    ASSERT_TRUE(hashingModel.train(hashingExtractor.batchTransform(corpus)));
+    ASSERT_TRUE(saveModelFile(path, hashingExtractor, hashingModel, true));
+
+    FeatureExtractor loadedHashing(preprocessor);
+    ASSERT_TRUE(loadModelFile(path, loadedHashing, loadedModel, useStopWords));
+    EXPECT_EQ(loadedHashing.getMethod(), FeatureExtractor::Method::HASHING);
+    EXPECT_EQ(loadedHashing.getHashBits(), 8u);
+    EXPECT_TRUE(loadedHashing.isSignedHashing());
+    for (const std::string text : {"great cast", "awful plot", "fine movie"}) {
+        EXPECT_EQ(loadedModel.predict(loadedHashing.extractFeatures(text)),
+                  hashingModel.predict(hashingExtractor.extractFeatures(text))) << text;
+    }
+
+    // Corrupt files are rejected and leave the loaded pipeline in place
+    std::ofstream(path, std::ios::binary) << "not a model";
+    EXPECT_FALSE(loadModelFile(path, loadedHashing, loadedModel, useStopWords));
+    EXPECT_EQ(loadedHashing.getMethod(), FeatureExtractor::Method::HASHING);
+    EXPECT_EQ(loadedModel.getFeatureCount(), hashingModel.getFeatureCount());
+}
+
+// Test RFC 4180 quoting and record-aligned splitting
+TEST(CsvParserTest, ParsesQuotedFieldsAndSplitsOnRecords) {
+    std::string text = "plain,\"with, comma\"\r\n"
+                       "\"say \"\"hi\"\"\",\"two\nlines\"\n"
+                       "\n"
+                       "last,\n";
+
+    CsvParser parser(text);
+    std::vector<std::string_view> fields;
+    ASSERT_TRUE(parser.next(fields));
+    EXPECT_EQ(fields, (std::vector<std::string_view>{"plain", "with, comma"}));
+    EXPECT_EQ(parser.record(), "plain,\"with, comma\"");
+    ASSERT_TRUE(parser.next(fields));
+    EXPECT_EQ(fields, (std::vector<std::string_view>{"say \"hi\"", "two\nlines"}));
+    ASSERT_TRUE(parser.next(fields));
+    EXPECT_EQ(fields, (std::vector<std::string_view>{"last", ""}));
+    EXPECT_FALSE(parser.next(fields));
+
+    // Unescaped fields point into the parsed text
+    CsvParser viewParser(text);
+    ASSERT_TRUE(viewParser.next(fields));
+    EXPECT_EQ(fields[0].data(), text.data());
+
+    // Every split yields the same records as one sequential pass
+    auto collect = [](std::string_view block) {
+        std::vector<std::string> records;
+        CsvParser blockParser(block);
+        std::vector<std::string_view> blockFields;
+        while (blockParser.next(blockFields)) {
+            records.emplace_back(blockParser.record());
+        }
+        return records;
+    };
+    std::vector<std::string> expected = collect(text);
+    for (size_t parts = 1; parts <= text.size(); ++parts) {
+        std::vector<size_t> offsets = CsvParser::splitRecords(text, parts);
+        ASSERT_EQ(offsets.size(), parts + 1);
+        std::vector<std::string> actual;
+        for (size_t i = 0; i < parts; ++i) {
+            EXPECT_LE(offsets[i], offsets[i + 1]);
+            auto records = collect(std::string_view(text).substr(offsets[i], offsets[i + 1] - offsets[i]));
+            actual.insert(actual.end(), records.begin(), records.end());
+        }
+        EXPECT_EQ(actual, expected) << parts << " parts";
+    }
+}
+
+// Test that the train/validation split is seeded, stratified and views the loaded rows
+TEST(DataLoaderTest, SplitsReproduciblyWithoutCopies) {
+    std::string path = ::testing::TempDir() + "sentiment_split.csv";
+    {
+        std::ofstream out(path);
+        out << "text,label\n";
+        for (int i = 0; i < 40; ++i) {
+            out << "row " << i << "," << (i % 4 == 0 ? "negative" : "positive") << "\n";
+        }
+    }
+
+    DataLoader loader;
+    ASSERT_TRUE(loader.loadFromCSV(path));
+    DataSplit split = loader.splitTrainValidation(0.75, 7);
+
+    // Both parts view the reordered rows, training rows first
+    const std::vector<TextData>& rows = loader.getData();
+    ASSERT_EQ(rows.size(), 40u);
+    EXPECT_EQ(split.train.data(), rows.data());
+    EXPECT_EQ(split.validation.data(), rows.data() + split.train.size());
+    EXPECT_EQ(split.train.size() + split.validation.size(), rows.size());
+
+    // Every label is split in the ratio (30 positive, 10 negative rows)
+    size_t negatives = std::count_if(split.train.begin(), split.train.end(), [](const TextData& row) {
+        return row.label == SentimentLabel::NEGATIVE;
+    });
+    EXPECT_EQ(split.train.size(), 23u + 8u);
+    EXPECT_EQ(negatives, 8u);
+
+    // No row is lost or duplicated
+    std::vector<std::string> texts;
+    for (const auto& row : rows) {
+        texts.push_back(row.text);
+    }
+    std::sort(texts.begin(), texts.end());
+    EXPECT_EQ(std::unique(texts.begin(), texts.end()), texts.end());
+    EXPECT_EQ(texts.size(), 40u);
+
+    // The same seed gives the same split, another seed a different one
+    std::vector<std::string> order;
+    for (const auto& row : rows) {
+        order.push_back(row.text);
+    }
+    auto splitOrder = [&](uint64_t seed) {
+        DataLoader other;
+        other.loadFromCSV(path);
+        other.splitTrainValidation(0.75, seed);
+        std::vector<std::string> result;
+        for (const auto& row : other.getData()) {
+            result.push_back(row.text);
+        }
+        return result;
+    };
+    EXPECT_EQ(splitOrder(7), order);
+    EXPECT_NE(splitOrder(8), order);
+
+    // Views work wherever the extractor took vectors
+    Preprocessor preprocessor(false);
+    FeatureExtractor extractor(preprocessor);
+    extractor.buildVocabulary(split.train, 1, 0);
+    EXPECT_EQ(extractor.batchTransform(split.validation).size(), split.validation.size());
+    EXPECT_THROW(loader.splitTrainValidation(1.0), std::invalid_argument);
+}
+
+// Test that chunked ingestion trains the same model as loading everything at once
+TEST(DataLoaderTest, StreamedTrainingMatchesInMemory) {
+    std::string path = ::testing::TempDir() + "sentiment_stream.csv";
+    std::ofstream(path) << "text,label\n"
+                        << "\"great movie, loved it\",positive\n"
+                        << "awful plot,negative\n"
+                        << "the cast was fine,neutral\n"
+                        << "unlabeled row,whatever\n"
+                        << "great cast and great music,positive\n"
+                        << "awful awful movie,negative\n";
+
+    DataLoader loader;
+    ASSERT_TRUE(loader.loadFromCSV(path));
+    const std::vector<TextData>& rows = loader.getData();
+    ASSERT_EQ(rows.size(), 5u);
+
+    // Parallel loading keeps the rows in file order
+    DataLoader parallelLoader;
+    parallelLoader.setThreadPool(std::make_shared<ThreadPool>(3));
+    ASSERT_TRUE(parallelLoader.loadFromCSV(path));
+    ASSERT_EQ(parallelLoader.getData().size(), rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        EXPECT_EQ(parallelLoader.getData()[i].text, rows[i].text);
+    }
+
+    Preprocessor preprocessor(true);
+    FeatureExtractor extractor(preprocessor, FeatureExtractor::Method::TF_IDF);
+    extractor.buildVocabulary(rows, 1, 0);
+    NaiveBayes model;
+    ASSERT_TRUE(model.train(extractor.batchTransform(rows)));
+
+    size_t chunks = 0;
+    FeatureExtractor streamedExtractor(preprocessor, FeatureExtractor::Method::TF_IDF);
+    streamedExtractor.resetVocabularyCounts();
+    ASSERT_TRUE(DataLoader::streamCSV(path, 2, [&](const std::vector<TextData>& chunk) {
+        EXPECT_LE(chunk.size(), 2u);
+        streamedExtractor.countVocabulary(chunk);
+        ++chunks;
+        return true;
+    }));
+    streamedExtractor.finalizeVocabulary(1, 0);
+    EXPECT_EQ(chunks, 3u);
+
+    NaiveBayes streamedModel;
+    streamedModel.resetCounts();
+    ASSERT_TRUE(DataLoader::streamCSV(path, 2, [&](const std::vector<TextData>& chunk) {
+        return streamedModel.accumulateCounts(streamedExtractor.batchTransform(chunk));
+    }));
+    ASSERT_TRUE(streamedModel.finalizeCounts());
+
+    EXPECT_EQ(streamedExtractor.getDocumentCount(), extractor.getDocumentCount());
+    ASSERT_EQ(streamedExtractor.getVocabularySize(), extractor.getVocabularySize());
+    for (size_t i = 0; i < extractor.getVocabularySize(); ++i) {
+        EXPECT_EQ(streamedExtractor.getVocabularyIndex().term(i), extractor.getVocabularyIndex().term(i));
+    }
+
+    const ConstArray<double>& expected = model.getLogLikelihoodMatrix();
+    const ConstArray<double>& actual = streamedModel.getLogLikelihoodMatrix();
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_DOUBLE_EQ(actual[i], expected[i]);
+    }
+    EXPECT_EQ(streamedModel.getClassLabels(), model.getClassLabels());
+
+    // Returning false from the callback stops reading and fails the stream,
+    // also for the last, partial chunk
+    chunks = 0;
+    EXPECT_FALSE(DataLoader::streamCSV(path, 1, [&](const std::vector<TextData>&) { return ++chunks < 2; }));
+    EXPECT_EQ(chunks, 2u);
+    chunks = 0;
+    EXPECT_FALSE(DataLoader::streamCSV(path, rows.size() + 1, [&](const std::vector<TextData>&) {
+        return ++chunks > 1;
+    }));
+    EXPECT_EQ(chunks, 1u);
+}
+
+// Test that streamed, parallel evaluation counts the same matrix as a single call
+TEST(EvaluatorTest, StreamedParallelMatchesSingleCall) {
+    ConfusionMatrix matrix;
+    matrix.add(SentimentLabel::POSITIVE, SentimentLabel::POSITIVE, 3);
+    matrix.add(SentimentLabel::POSITIVE, SentimentLabel::NEGATIVE, 1);
+    matrix.add(SentimentLabel::NEGATIVE, SentimentLabel::NEGATIVE, 2);
+    matrix.add(SentimentLabel::NEGATIVE, SentimentLabel::POSITIVE, 2);
+    EXPECT_EQ(matrix.total(), 8u);
+    EXPECT_EQ(matrix.predictedCount(SentimentLabel::POSITIVE), 5u);
+
+    // Precision is averaged over the true labels: (3/5 + 2/3) / 2, recall (3/4 + 2/4) / 2
+    EvaluationMetrics metrics = matrix.metrics();
+    EXPECT_DOUBLE_EQ(metrics.accuracy, 5.0 / 8.0);
+    EXPECT_DOUBLE_EQ(metrics.precision, (3.0 / 5.0 + 2.0 / 3.0) / 2.0);
+    EXPECT_DOUBLE_EQ(metrics.recall, 0.625);
+
+    std::vector<FeatureVector> training = {
+        {toSparse({3, 0, 1}), SentimentLabel::POSITIVE},
+        {toSparse({0, 2, 0}), SentimentLabel::NEGATIVE},
+        {toSparse({0, 1, 2}), SentimentLabel::NEUTRAL}
+    };
+    NaiveBayes model;
+    ASSERT_TRUE(model.train(training));
+
+    std::vector<FeatureVector> validation;
+    for (size_t i = 0; i < 2000; ++i) {
+        SparseVector features = toSparse({double(i % 3), double(i % 5 % 3), double(i % 7 % 3)});
+        validation.push_back({features, static_cast<SentimentLabel>(i % 3)});
+    }
+
+    Evaluator single(model);
+    EvaluationMetrics expected = single.evaluate(validation);
+
+    // The batch path counts the same cells as one predict() per example
+    ConfusionMatrix reference;
+    for (const FeatureVector& example : validation) {
+        reference.add(example.label, model.predict(example.features));
+    }
+    EXPECT_EQ(single.getConfusionMatrix().counts, reference.counts);
+
+    // Labelled examples are scored in place
+    std::vector<SentimentLabel> blockLabels(100);
+    std::vector<double> blockScores(100);
+    std::vector<SentimentLabel> sparseLabels(100);
+    std::vector<double> sparseScores(100);
+    std::vector<SparseVector> block;
+    for (size_t i = 0; i < 100; ++i) {
+        block.push_back(validation[i].features);
+    }
+    model.predictBatch(validation.data(), 100, blockLabels.data(), blockScores.data());
+    model.predictBatch(block.data(), 100, sparseLabels.data(), sparseScores.data());
+    EXPECT_EQ(blockLabels, sparseLabels);
+    EXPECT_EQ(blockScores, sparseScores);
+
+    // Stream three uneven batches through both overloads on four workers
+    Evaluator streamed(model);
+    streamed.setThreadPool(std::make_shared<ThreadPool>(4));
+    streamed.reset();
+    streamed.accumulate(std::vector<FeatureVector>(validation.begin(), validation.begin() + 700));
+    std::vector<SparseVector> documents;
+    std::vector<SentimentLabel> labels;
+    for (size_t i = 700; i < validation.size(); ++i) {
+        documents.push_back(validation[i].features);
+        labels.push_back(validation[i].label);
+    }
+    streamed.accumulate(documents.data(), labels.data(), 1000);
+    streamed.accumulate(documents.data() + 1000, labels.data() + 1000, documents.size() - 1000);
+    EvaluationMetrics actual = streamed.finish();
+
+    EXPECT_EQ(streamed.getConfusionMatrix().counts, single.getConfusionMatrix().counts);
+    EXPECT_EQ(streamed.getConfusionMatrix().total(), validation.size());
+    EXPECT_DOUBLE_EQ(actual.accuracy, expected.accuracy);
+    EXPECT_DOUBLE_EQ(actual.f1Score, expected.f1Score);
+
+    // The analyzer streams a held-out file chunk by chunk
+    std::string path = ::testing::TempDir() + "sentiment_heldout.csv";
+    std::ofstream(path) << "text,label\n"
+                        << "great movie loved it,positive\n"
+                        << "awful plot hated it,negative\n"
+                        << "great cast great music,positive\n"
+                        << "awful awful movie,negative\n"
+                        << "loved the music,positive\n";
+    SentimentConfig config;
+    config.minWordFrequency = 1;
+    SentimentAnalyzer analyzer(config);
+    ASSERT_TRUE(analyzer.trainFromFile(path));
+    EXPECT_DOUBLE_EQ(analyzer.evaluateFile(path, 2).accuracy, 1.0);
+    EXPECT_EQ(analyzer.getConfusionMatrix().total(), 5u);
+    EXPECT_EQ(analyzer.getConfusionMatrix().at(SentimentLabel::POSITIVE, SentimentLabel::POSITIVE), 3u);
+
+    // Only the served snapshot is compressed; the saved model keeps doubles
+    config.modelPrecision = NaiveBayes::Precision::INT8;
+    SentimentAnalyzer compact(config);
+    ASSERT_TRUE(compact.trainFromFile(path));
+    EXPECT_EQ(compact.getSnapshot()->getModel().getPrecision(), NaiveBayes::Precision::INT8);
+    EXPECT_EQ(compact.predict("great music"), SentimentLabel::POSITIVE);
+    EXPECT_TRUE(compact.saveModel(::testing::TempDir() + "sentiment_compact.model"));
+    EXPECT_FALSE(saveModelFile(::testing::TempDir() + "sentiment_compact.model",
+                               compact.getSnapshot()->getFeatureExtractor(),
+                               compact.getSnapshot()->getModel(), true));
+}
+
+// Test that every fold and grid point scores like retraining the pipeline on its split
+TEST(CrossValidatorTest, MatchesRetrainingEachFold) {
+    const char* positive[] = {"great", "loved", "wonderful", "fun", "brilliant", "music"};
+    const char* negative[] = {"awful", "boring", "terrible", "waste", "dull", "music"};
+    const char* neutral[] = {"fine", "okay", "average", "plot", "cast", "music"};
+    std::vector<TextData> data;
+    for (size_t i = 0; i < 45; ++i) {
+        const char** words = i % 3 == 0 ? positive : (i % 3 == 1 ? negative : neutral);
+        std::string text;
+        for (size_t w = 0; w < 2 + i % 4; ++w) {
+            text += std::string(words[(i * 7 + w * 5) % 6]) + " ";
+        }
+        text += i % 5 == 0 ? "plot" : "cast";
+        // Some documents repeat a word of another label, which sublinear TF damps
+        if (i % 4 == 0) {
+            const char** other = i % 3 == 0 ? negative : (i % 3 == 1 ? neutral : positive);
+            for (size_t r = 0; r < 4; ++r) {
+                text += std::string(" ") + other[i % 5];
+            }
+        }
+        data.push_back({text, static_cast<SentimentLabel>(i % 3)});
+    }
+
+    Preprocessor preprocessor(true);
+    SearchGrid grid{{0.5, 1.0}, {1, 3}, {0, 6}};
+    for (int variant = 0; variant < 3; ++variant) {
+        // Bag-of-words, TF-IDF, and TF-IDF with sublinear term frequencies
+        auto method = variant == 0 ? FeatureExtractor::Method::BAG_OF_WORDS : FeatureExtractor::Method::TF_IDF;
+        bool sublinear = variant == 2;
+        FeatureExtractor settings(preprocessor, method);
+        settings.setTfIdfOptions(sublinear, false);
+        CrossValidator validator(preprocessor, settings, std::make_shared<ThreadPool>(3));
+        ASSERT_TRUE(validator.prepare(data, 4, 7));
+        std::vector<CrossValidationResult> results = validator.search(grid);
+        ASSERT_EQ(results.size(), 8u);
+        EXPECT_GE(results.front().meanAccuracy, results.back().meanAccuracy);
+
+        // Folds are stratified: each fold holds 11 or 12 documents
+        const std::vector<uint32_t>& assignment = validator.getFoldAssignment();
+        for (uint32_t fold = 0; fold < 4; ++fold) {
+            size_t size = std::count(assignment.begin(), assignment.end(), fold);
+            EXPECT_TRUE(size == 11 || size == 12);
+        }
+
+        for (const auto& result : results) {
+            ASSERT_EQ(result.foldAccuracies.size(), 4u);
+            for (uint32_t fold = 0; fold < 4; ++fold) {
+                std::vector<TextData> train;
+                std::vector<TextData> heldOut;
+                for (size_t i = 0; i < data.size(); ++i) {
+                    (assignment[i] == fold ? heldOut : train).push_back(data[i]);
+                }
+
+                FeatureExtractor extractor(preprocessor, method);
+                extractor.setTfIdfOptions(sublinear, false);
+                extractor.buildVocabulary(train, result.minWordFrequency, result.maxVocabularySize);
+                NaiveBayes model(result.alpha);
+                ASSERT_TRUE(model.train(extractor.batchTransform(train)));
+                Evaluator evaluator(model);
+                EvaluationMetrics metrics = evaluator.evaluate(extractor.batchTransform(heldOut));
+                EXPECT_DOUBLE_EQ(result.foldAccuracies[fold], metrics.accuracy) << "variant " << variant;
+            }
+        }
+    }
+
+    // Too many folds are rejected
+    FeatureExtractor settings(preprocessor);
+    CrossValidator validator(preprocessor, settings);
+    EXPECT_FALSE(validator.prepare(data, data.size() + 1));
+    EXPECT_TRUE(validator.search(grid).empty());
+
+    // So are L2-normalized TF-IDF features
+    FeatureExtractor normalized(preprocessor, FeatureExtractor::Method::TF_IDF);
+    normalized.setTfIdfOptions(false, true);
+    CrossValidator normalizedValidator(preprocessor, normalized);
+    EXPECT_FALSE(normalizedValidator.prepare(data, 4));
+}
+
+// Test that a loaded model tokenizes like it was trained and drops stale datasets
+TEST(SentimentAnalyzerTest, LoadModelKeepsStopWordSetting) {
+    std::string path = ::testing::TempDir() + "sentiment_stopwords.csv";
+    std::ofstream(path) << "text,label\n"
+                        << "not good,negative\n"
+                        << "not fun at all,negative\n"
+                        << "very good,positive\n"
+                        << "good fun,positive\n"
+                        << "it was not great,negative\n"
+                        << "it was great,positive\n"
+                        << "was it good,positive\n"
+                        << "not very fun,negative\n"
+                        << "great fun,positive\n"
+                        << "not it,negative\n";
+
+    SentimentConfig config;
+    config.minWordFrequency = 1;
+    config.useStopWords = false;
+    SentimentAnalyzer original(config);
+    ASSERT_TRUE(original.trainFromFile(path));
+    std::string modelPath = ::testing::TempDir() + "sentiment_stopwords.model";
+    ASSERT_TRUE(original.saveModel(modelPath));
+
+    // The loading analyzer removes stop words and holds split features of its own
+    config.useStopWords = true;
+    SentimentAnalyzer loaded(config);
+    ASSERT_TRUE(loaded.loadTrainingData(path));
+    ASSERT_TRUE(loaded.train());
+    EXPECT_GT(loaded.evaluate().accuracy, 0.0);
+    ASSERT_TRUE(loaded.loadModel(modelPath));
+
+    for (const char* text : {"not", "not good", "very fun", "it was great", "at all"}) {
+        EXPECT_EQ(loaded.predict(text), original.predict(text)) << text;
+        auto expected = original.predictWithConfidence(text);
+        auto actual = loaded.predictWithConfidence(text);
+        for (auto label : {SentimentLabel::POSITIVE, SentimentLabel::NEGATIVE, SentimentLabel::NEUTRAL}) {
+            EXPECT_DOUBLE_EQ(actual[label], expected[label]) << text;
+        }
+    }
+
+    // The saved setting is kept when the model is saved again
+    std::string resavedPath = ::testing::TempDir() + "sentiment_stopwords_resaved.model";
+    ASSERT_TRUE(loaded.saveModel(resavedPath));
+    SentimentAnalyzer reloaded(config);
+    ASSERT_TRUE(reloaded.loadModel(resavedPath));
+    EXPECT_DOUBLE_EQ(reloaded.predictWithConfidence("not")[SentimentLabel::POSITIVE],
+                     original.predictWithConfidence("not")[SentimentLabel::POSITIVE]);
+
+    // Features extracted for the previous vocabulary are not evaluated
+    EXPECT_EQ(loaded.getConfusionMatrix().total(), 0u);
+    EXPECT_EQ(loaded.evaluate().accuracy, 0.0);
+    EXPECT_EQ(loaded.getConfusionMatrix().total(), 0u);
+}
+
+// Test that predictions run concurrently with model updates on one shared analyzer
+TEST(SentimentAnalyzerTest, PredictsConcurrentlyWithModelSwaps) {
+    std::string path = ::testing::TempDir() + "sentiment_concurrent.csv";
+    std::ofstream(path) << "text,label\n"
+                        << "great movie loved it,positive\n"
+                        << "awful plot hated it,negative\n"
+                        << "great cast great music,positive\n"
+                        << "awful awful movie,negative\n";
+
+    SentimentConfig config;
+    config.minWordFrequency = 1;
+    SentimentAnalyzer analyzer(config);
+    EXPECT_EQ(analyzer.getSnapshot(), nullptr);
+    ASSERT_TRUE(analyzer.trainFromFile(path));
+
+    std::shared_ptr<const ModelSnapshot> first = analyzer.getSnapshot();
+    ASSERT_NE(first, nullptr);
+    size_t firstFeatures = first->getModel().getFeatureCount();
+
+    std::atomic<bool> done{false};
+    std::atomic<size_t> wrong{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&] {
+            InferenceContext context;
+            do {
+                if (analyzer.predict("great music", context) != SentimentLabel::POSITIVE ||
+                    analyzer.predict("awful plot", context) != SentimentLabel::NEGATIVE) {
+                    ++wrong;
+                }
+            } while (!done);
+        });
+    }
+
+    // Every update publishes a new snapshot while the readers keep predicting
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_TRUE(analyzer.partialFit({
+            {"superb soundtrack number " + std::to_string(i), SentimentLabel::POSITIVE},
+            {"dreadful pacing number " + std::to_string(i), SentimentLabel::NEGATIVE}
+        }));
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(wrong, 0u);
+
+    // A pinned snapshot is unaffected by later versions
+    EXPECT_NE(analyzer.getSnapshot(), first);
+    EXPECT_GT(analyzer.getSnapshot()->getModel().getFeatureCount(), firstFeatures);
+    EXPECT_EQ(first->getModel().getFeatureCount(), firstFeatures);
+    InferenceContext context;
+    EXPECT_EQ(first->predict("great music", context), SentimentLabel::POSITIVE);
+}
+
+// Test CLOCK eviction, generations and the counters of the prediction cache
+TEST(PredictionCacheTest, EvictsWithClockAndInvalidatesByGeneration) {
+    // One shard with a single set of kWays entries
+    PredictionCache cache(PredictionCache::kWays, 1);
+    EXPECT_EQ(cache.capacity(), PredictionCache::kWays);
+
+    uint64_t generation = cache.generation();
+    for (uint64_t key = 1; key <= PredictionCache::kWays; ++key) {
+        cache.insert(key, generation, SentimentLabel::POSITIVE, -static_cast<double>(key));
+    }
+    SentimentLabel label;
+    double score;
+    ASSERT_TRUE(cache.lookup(3, label, score));
+    EXPECT_EQ(label, SentimentLabel::POSITIVE);
+    EXPECT_DOUBLE_EQ(score, -3.0);
+
+    // The full set evicts the first unreferenced entry and keeps the one just hit
+    for (uint64_t key = 1; key <= PredictionCache::kWays; ++key) {
+        if (key != 3) {
+            cache.lookup(key, label, score);
+        }
+    }
+    cache.lookup(3, label, score);
+    cache.insert(100, generation, SentimentLabel::NEGATIVE, -1.0);
+    size_t kept = 0;
+    for (uint64_t key = 1; key <= PredictionCache::kWays; ++key) {
+        kept += cache.lookup(key, label, score);
+    }
+    EXPECT_EQ(kept, PredictionCache::kWays - 1);
+    ASSERT_TRUE(cache.lookup(100, label, score));
+    EXPECT_EQ(label, SentimentLabel::NEGATIVE);
+
+    PredictionCacheStats stats = cache.stats();
+    EXPECT_EQ(stats.insertions, PredictionCache::kWays + 1);
+    EXPECT_EQ(stats.evictions, 1u);
+    EXPECT_EQ(stats.hits + stats.misses, 2 * PredictionCache::kWays + 2);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_NEAR(stats.hitRate(), static_cast<double>(stats.hits) / (stats.hits + stats.misses), 1e-12);
+
+    // A new generation hides every entry and rejects late inserts of the old one
+    cache.invalidate();
+    EXPECT_FALSE(cache.lookup(100, label, score));
+    cache.insert(100, generation, SentimentLabel::NEGATIVE, -1.0);
+    EXPECT_FALSE(cache.lookup(100, label, score));
+    cache.insert(100, cache.generation(), SentimentLabel::NEUTRAL, -2.0);
+    ASSERT_TRUE(cache.lookup(100, label, score));
+    EXPECT_EQ(label, SentimentLabel::NEUTRAL);
+    EXPECT_EQ(cache.stats().evictions, 1u);
+
+    cache.resetStats();
+    EXPECT_EQ(cache.stats().hits, 0u);
+    EXPECT_EQ(cache.stats().hitRate(), 0.0);
+}
+
+// Test that cached predictions match the pipeline and follow model updates
+TEST(SentimentAnalyzerTest, CachesPredictionsByCleanText) {
+    Preprocessor preprocessor;
+    for (const char* text : {"Great movie!!", "  great\tMOVIE ", "", "...", "it's 2 good"}) {
+        EXPECT_EQ(preprocessor.hashCleanText(text), hashBytes(preprocessor.cleanText(text))) << text;
+    }
+
+    std::string path = ::testing::TempDir() + "sentiment_cache.csv";
+    std::ofstream(path) << "text,label\n"
+                        << "great movie loved it,positive\n"
+                        << "awful plot hated it,negative\n"
+                        << "great cast great music,positive\n"
+                        << "awful awful movie,negative\n";
+
+    SentimentConfig config;
+    config.minWordFrequency = 1;
+    SentimentAnalyzer plain(config);
+    config.predictionCacheSize = 64;
+    SentimentAnalyzer cached(config);
+    ASSERT_TRUE(plain.trainFromFile(path));
+    ASSERT_TRUE(cached.trainFromFile(path));
+    EXPECT_EQ(plain.predictionCacheStats().capacity, 0u);
+
+    std::vector<std::string> texts = {
+        "great music", "awful plot", "GREAT, music!", "great music", "awful   plot...", "unseen words"
+    };
+    std::vector<SentimentLabel> expected(texts.size());
+    std::vector<double> expectedScores(texts.size());
+    plain.predictBatch(texts.data(), texts.size(), expected.data(), expectedScores.data());
+
+    cached.resetStats();
+    std::vector<SentimentLabel> labels(texts.size());
+    std::vector<double> scores(texts.size());
+    cached.predictBatch(texts.data(), texts.size(), labels.data(), scores.data());
+    EXPECT_EQ(labels, expected);
+    EXPECT_EQ(cached.predictionCacheStats().misses, texts.size());
+
+    // Case, punctuation and spacing variants hit the same entries
+    cached.predictBatch(texts.data(), texts.size(), labels.data(), scores.data());
+    EXPECT_EQ(labels, expected);
+    for (size_t i = 0; i < texts.size(); ++i) {
+        EXPECT_NEAR(scores[i], expectedScores[i], 1e-9) << texts[i];
+        EXPECT_EQ(cached.predict(texts[i]), expected[i]) << texts[i];
+    }
+    PredictionCacheStats stats = cached.predictionCacheStats();
+    EXPECT_EQ(stats.hits, 2 * texts.size());
+    EXPECT_GE(stats.capacity, 64u);
+
+    // A new model replaces every cached prediction
+    ASSERT_TRUE(cached.partialFit({{"unseen words are lovely", SentimentLabel::POSITIVE},
+                                   {"unseen words are lovely", SentimentLabel::POSITIVE}}));
+    ASSERT_TRUE(plain.partialFit({{"unseen words are lovely", SentimentLabel::POSITIVE},
+                                  {"unseen words are lovely", SentimentLabel::POSITIVE}}));
+    uint64_t hitsBefore = cached.predictionCacheStats().hits;
+    EXPECT_EQ(cached.predict("unseen words"), plain.predict("unseen words"));
+    EXPECT_EQ(cached.predictionCacheStats().hits, hitsBefore);
+}
+
+// Test the latency histogram buckets and the per-stage counters
+TEST(PipelineStatsTest, CountsStagesAndExportsPrometheus) {
+    // Every bucket bound maps back to its bucket and the bounds are contiguous
+    for (size_t bucket = 0; bucket < StageStats::kBucketCount; ++bucket) {
+        uint64_t upper = StageStats::bucketUpperBound(bucket);
+        EXPECT_EQ(StageStats::bucketIndex(upper), bucket);
+        if (bucket + 1 < StageStats::kBucketCount) {
+            EXPECT_EQ(StageStats::bucketIndex(upper + 1), bucket + 1);
+        }
+    }
+    EXPECT_EQ(StageStats::bucketIndex(UINT64_MAX), StageStats::kBucketCount - 1);
+
+    if (!PipelineStats::kEnabled) {
+        GTEST_SKIP() << "Built with SENTIMENT_DISABLE_STATS";
+    }
+
+    Preprocessor preprocessor(false);
+    FeatureExtractor extractor(preprocessor);
+    std::vector<TextData> corpus = {
+        {"good movie", SentimentLabel::POSITIVE},
+        {"bad movie", SentimentLabel::NEGATIVE}
+    };
+    extractor.buildVocabulary(corpus, 1, 0);
+    NaiveBayes model;
+    ASSERT_TRUE(model.train(extractor.batchTransform(corpus)));
+
+    PipelineStats::reset();
+    InferenceContext context;
+    for (int i = 0; i < 10; ++i) {
+        model.predict(extractor.extractFeatures("good good movie", context));
+    }
+
+    // Samples recorded on another thread are included too
+    std::thread([&] {
+        InferenceContext local;
+        model.predict(extractor.extractFeatures("bad movie", local));
+    }).join();
+
+    StatsSnapshot stats = PipelineStats::snapshot();
+    for (Stage stage : {Stage::PREPROCESS, Stage::FEATURE_EXTRACTION, Stage::SCORING}) {
+        const StageStats& stageStats = stats[stage];
+        EXPECT_EQ(stageStats.count, 11u) << stageName(stage);
+        uint64_t histogramCount = 0;
+        for (uint64_t bucket : stageStats.buckets) {
+            histogramCount += bucket;
+        }
+        EXPECT_EQ(histogramCount, 11u);
+        EXPECT_LE(stageStats.percentileNanos(50), stageStats.percentileNanos(99));
+    }
+
+    std::string text = stats.toPrometheus();
+    EXPECT_NE(text.find("# TYPE sentiment_stage_duration_seconds histogram"), std::string::npos);
+    EXPECT_NE(text.find("sentiment_stage_duration_seconds_count{stage=\"scoring\"} 11"), std::string::npos);
+    EXPECT_NE(text.find("sentiment_stage_duration_seconds_bucket{stage=\"preprocess\",le=\"+Inf\"} 11"),
+              std::string::npos);
+
+    PipelineStats::reset();
+    EXPECT_EQ(PipelineStats::snapshot()[Stage::SCORING].count, 0u);
+}
+
+#ifndef _WIN32
+// Send one HTTP request and read back one complete response
+static std::string httpExchange(int socket, const std::string& request) {
+    EXPECT_EQ(::send(socket, request.data(), request.size(), 0), static_cast<ssize_t>(request.size()));
+
+    std::string response;
+    char chunk[4096];
+    for (;;) {
+        size_t headerEnd = response.find("\r\n\r\n");
+        if (headerEnd != std::string::npos) {
+            size_t lengthStart = response.find("Content-Length: ") + 16;
+            size_t length = std::stoul(response.substr(lengthStart));
+            if (response.size() >= headerEnd + 4 + length) {
+                return response;
+            }
+        }
+        ssize_t received = ::recv(socket, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            return response;
+        }
+        response.append(chunk, static_cast<size_t>(received));
+    }
+}
+
+static int connectTo(uint16_t port) {
+    int socket = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    ::inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    EXPECT_EQ(::connect(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+    return socket;
+}
+
+// Test keep-alive, batching of concurrent clients and request limits of the HTTP server
+TEST(InferenceServerTest, ServesBatchedPredictionsOverKeepAlive) {
+    std::vector<TextData> corpus = {
+        {"great movie loved it", SentimentLabel::POSITIVE},
+        {"awful plot hated it", SentimentLabel::NEGATIVE},
+        {"great cast great music", SentimentLabel::POSITIVE},
+        {"awful awful movie", SentimentLabel::NEGATIVE}
+    };
+    Preprocessor preprocessor(true);
+    FeatureExtractor extractor(preprocessor);
+    extractor.buildVocabulary(corpus, 1, 0);
+    NaiveBayes model;
+    ASSERT_TRUE(model.train(extractor.batchTransform(corpus)));
+
+    ServerConfig config;
+    config.host = "127.0.0.1";
+    config.port = 0;
+    config.connectionThreads = 4;
+    config.maxQueuedTexts = 8;
+    InferenceServer server(std::make_shared<const ModelSnapshot>(extractor, model, true), config);
+    ASSERT_TRUE(server.start());
+    ASSERT_NE(server.getPort(), 0);
+
+    // Two requests on one connection
+    int socket = connectTo(server.getPort());
+    std::string body = "great music\nawful plot\n";
+    std::string response = httpExchange(socket, "POST /predict HTTP/1.1\r\nHost: test\r\nContent-Length: " +
+                                        std::to_string(body.size()) + "\r\n\r\n" + body);
+    EXPECT_EQ(response.rfind("HTTP/1.1 200 OK", 0), 0u);
+    EXPECT_NE(response.find("Connection: keep-alive"), std::string::npos);
+    size_t first = response.find("\"label\":\"positive\"");
+    ASSERT_NE(first, std::string::npos);
+    EXPECT_NE(response.find("\"label\":\"negative\"", first), std::string::npos);
+
+    response = httpExchange(socket, "GET /health HTTP/1.1\r\n\r\n");
+    EXPECT_EQ(response.rfind("HTTP/1.1 200 OK", 0), 0u);
+
+    // Requests larger than the text queue are refused outright
+    std::string tooMany(9 * 2, '\n');
+    for (size_t i = 0; i < tooMany.size(); i += 2) {
+        tooMany[i] = 'a';
+    }
+    response = httpExchange(socket, "POST /predict HTTP/1.1\r\nContent-Length: " +
+                            std::to_string(tooMany.size()) + "\r\n\r\n" + tooMany);
+    EXPECT_EQ(response.rfind("HTTP/1.1 413", 0), 0u);
+
+    response = httpExchange(socket, "GET /missing HTTP/1.1\r\nConnection: close\r\n\r\n");
+    EXPECT_EQ(response.rfind("HTTP/1.1 404", 0), 0u);
+    EXPECT_NE(response.find("Connection: close"), std::string::npos);
+    ::close(socket);
+
+    // Concurrent clients are all answered correctly
+    std::atomic<size_t> correct{0};
+    std::vector<std::thread> clients;
+    for (int t = 0; t < 4; ++t) {
+        clients.emplace_back([&] {
+            int client = connectTo(server.getPort());
+            for (int i = 0; i < 25; ++i) {
+                std::string reply = httpExchange(client,
+                    "POST /predict HTTP/1.1\r\nContent-Length: 11\r\n\r\ngreat music");
+                correct += reply.find("\"label\":\"positive\"") != std::string::npos;
+            }
+            ::close(client);
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    EXPECT_EQ(correct, 100u);
+    server.stop();
+
+    // Idle keep-alive connections hold no thread: with a single connection
+    // thread, a second client is answered while the first stays open, and
+    // pipelined requests are answered in order
+    config.connectionThreads = 1;
+    config.keepAliveTimeoutMs = 200;
+    InferenceServer single(std::make_shared<const ModelSnapshot>(extractor, model, true), config);
+    ASSERT_TRUE(single.start());
+    int idleClient = connectTo(single.getPort());
+    EXPECT_EQ(httpExchange(idleClient, "GET /health HTTP/1.1\r\n\r\n").rfind("HTTP/1.1 200 OK", 0), 0u);
+    int otherClient = connectTo(single.getPort());
+    EXPECT_EQ(httpExchange(otherClient, "GET /health HTTP/1.1\r\n\r\n").rfind("HTTP/1.1 200 OK", 0), 0u);
+    std::string pipelined = "GET /health HTTP/1.1\r\n\r\nGET /missing HTTP/1.1\r\n\r\n";
+    ASSERT_EQ(::send(idleClient, pipelined.data(), pipelined.size(), 0), static_cast<ssize_t>(pipelined.size()));
+    response.clear();
+    char chunk[4096];
+    while (response.find("HTTP/1.1 404") == std::string::npos) {
+        ssize_t received = ::recv(idleClient, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            break;
+        }
+        response.append(chunk, static_cast<size_t>(received));
+    }
+    EXPECT_EQ(response.rfind("HTTP/1.1 200 OK", 0), 0u);
+    EXPECT_NE(response.find("HTTP/1.1 404"), std::string::npos);
+
+    // Connections idle for longer than the timeout are closed by the server
+    timeval waitLimit{2, 0};
+    ::setsockopt(otherClient, SOL_SOCKET, SO_RCVTIMEO, &waitLimit, sizeof(waitLimit));
+    EXPECT_EQ(::recv(otherClient, chunk, 1, 0), 0);
+    ::close(idleClient);
+    ::close(otherClient);
+    single.stop();
+}
+#endif
+
+// Test that the lock-free queues deliver every element exactly once, in order per producer
+TEST(ConcurrentQueueTest, DeliversEveryElementOnce) {
+    SpscQueue<int> spsc(3);
+    EXPECT_EQ(spsc.capacity(), 4u);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(spsc.tryPush(i));
+    }
+    int value = 99;
+    EXPECT_FALSE(spsc.tryPush(value));
+    EXPECT_EQ(value, 99);
+
+    constexpr int kCount = 20000;
+    std::thread producer([&] {
+        for (int i = 4; i < kCount; ++i) {
+            pushWait(spsc, i);
+        }
+    });
+    for (int i = 0; i < kCount; ++i) {
+        ASSERT_EQ(popWait<int>(spsc), i);
+    }
+    producer.join();
+    EXPECT_FALSE(spsc.tryPop(value));
+
+    // Two producers and two consumers through a small MPMC ring
+    MpmcQueue<int> mpmc(8);
+    std::vector<std::vector<int>> received(2);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < 2; ++p) {
+        threads.emplace_back([&, p] {
+            for (int i = 1; i <= kCount; ++i) {
+                pushWait(mpmc, p * kCount + i);
+            }
+        });
+    }
+    for (int c = 0; c < 2; ++c) {
+        threads.emplace_back([&, c] {
+            while (int item = popWait<int>(mpmc)) {
+                received[c].push_back(item);
+            }
+        });
+    }
+    threads[0].join();
+    threads[1].join();
+    pushWait(mpmc, 0);
+    pushWait(mpmc, 0);
+    threads[2].join();
+    threads[3].join();
+
+    std::vector<int> all;
+    for (const auto& items : received) {
+        // Each consumer sees every producer's items in push order
+        int last[2] = {0, 0};
+        for (int item : items) {
+            int producerIndex = (item - 1) / kCount;
+            EXPECT_GT(item, last[producerIndex]);
+            last[producerIndex] = item;
+        }
+        all.insert(all.end(), items.begin(), items.end());
+    }
+    std::sort(all.begin(), all.end());
+    ASSERT_EQ(all.size(), 2u * kCount);
+    for (size_t i = 0; i < all.size(); ++i) {
+        ASSERT_EQ(all[i], static_cast<int>(i) + 1);
+    }
+}
+
+// Test that the file pipeline writes one prediction per line in input order
+TEST(FilePredictorTest, ScoresLinesInOrder) {
+    std::vector<TextData> corpus = {
+        {"great movie loved it", SentimentLabel::POSITIVE},
+        {"awful plot hated it", SentimentLabel::NEGATIVE},
+        {"great cast great music", SentimentLabel::POSITIVE},
+        {"awful awful movie", SentimentLabel::NEGATIVE}
+    };
+    Preprocessor preprocessor(true);
+    FeatureExtractor extractor(preprocessor, FeatureExtractor::Method::TF_IDF);
+    extractor.buildVocabulary(corpus, 1, 0);
+    NaiveBayes model;
+    ASSERT_TRUE(model.train(extractor.batchTransform(corpus)));
+    auto snapshot = std::make_shared<const ModelSnapshot>(extractor, model, true);
+
+    // Mixed lengths, an empty line, CRLF and no final line break
+    const char* phrases[] = {"great music", "awful plot", "", "great cast loved it\r",
+                             "awful awful awful", "unknown words only"};
+    std::vector<std::string> lines;
+    std::string input;
+    for (size_t i = 0; i < 1000; ++i) {
+        lines.push_back(phrases[i % 6]);
+        input += lines.back() + (i + 1 < 1000 ? "\n" : "");
+    }
+    std::string inputPath = ::testing::TempDir() + "sentiment_predict_in.txt";
+    std::string outputPath = ::testing::TempDir() + "sentiment_predict_out.csv";
+    std::ofstream(inputPath, std::ios::binary) << input;
+
+    std::vector<std::string> texts;
+    for (const auto& line : lines) {
+        texts.push_back(!line.empty() && line.back() == '\r' ? line.substr(0, line.size() - 1) : line);
+    }
+    std::vector<SentimentLabel> labels(texts.size());
+    std::vector<double> scores(texts.size());
+    snapshot->predictBatch(texts.data(), texts.size(), labels.data(), scores.data());
+
+    // Borrowed views score the same as owned strings
+    std::vector<std::string_view> views(texts.begin(), texts.end());
+    std::vector<SentimentLabel> viewLabels(views.size());
+    std::vector<double> viewScores(views.size());
+    snapshot->predictBatch(views.data(), views.size(), viewLabels.data(), viewScores.data());
+    EXPECT_EQ(viewLabels, labels);
+    EXPECT_EQ(viewScores, scores);
+
+    // Small batches and few buffers force the writer to reorder
+    FilePredictionConfig config;
+    config.workerThreads = 3;
+    config.batchLines = 7;
+    config.batchesInFlight = 4;
+    FilePredictor predictor(snapshot, config);
+    ASSERT_TRUE(predictor.run(inputPath, outputPath));
+    EXPECT_EQ(predictor.getStats().lines, 1000u);
+    EXPECT_EQ(predictor.getStats().batches, (1000u + 6) / 7);
+    EXPECT_EQ(predictor.getStats().bytesRead, input.size());
+
+    std::ifstream output(outputPath);
+    std::string line;
+    size_t count = 0;
+    while (std::getline(output, line)) {
+        ASSERT_LT(count, labels.size());
+        size_t comma = line.find(',');
+        ASSERT_NE(comma, std::string::npos);
+        EXPECT_EQ(line.substr(0, comma), sentimentToString(labels[count])) << "line " << count;
+        EXPECT_DOUBLE_EQ(std::stod(line.substr(comma + 1)), scores[count]) << "line " << count;
+        count++;
+    }
+    EXPECT_EQ(count, lines.size());
+
+    // An empty input gives an empty output; a missing one fails
+    std::ofstream(inputPath, std::ios::binary | std::ios::trunc).close();
+    ASSERT_TRUE(predictor.run(inputPath, outputPath));
+    EXPECT_EQ(predictor.getStats().lines, 0u);
+    EXPECT_EQ(std::ifstream(outputPath).peek(), std::ifstream::traits_type::eof());
+    EXPECT_FALSE(predictor.run(inputPath + ".missing", outputPath));
+}
+
 // Test main function (required for Google Test)
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);